@@ -0,0 +1,168 @@
+/*
+ * alloc_track.c - Отладочный перехват malloc/free
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "alloc_track.h"
+
+#ifdef ECAT_ALLOC_TRACK
+
+/* Счетчики одной команды */
+typedef struct {
+    char name[32];
+    uint64_t runs;
+    uint64_t allocs;
+    uint64_t bytes;
+    uint64_t max_allocs;       /* Максимум за один запуск */
+} alloc_track_cmd_t;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static __thread const char *alloc_forbidden = NULL;
+
+static uint64_t alloc_total;
+static uint64_t alloc_total_bytes;
+/* Счетчики команды - в потоке REPL: выделения циклического и диагностических потоков в них не попадают */
+static __thread uint64_t alloc_cmd_count;
+static __thread uint64_t alloc_cmd_bytes;
+static int alloc_cmd_current = -1;
+static alloc_track_cmd_t alloc_cmds[ALLOC_TRACK_MAX_COMMANDS];
+static int alloc_cmd_used = 0;
+
+/**
+ * Учет выделения; в запрещенном потоке - аварийное завершение.
+ * Сообщение без printf: он сам может выделять память.
+ */
+static void alloc_track_note(size_t size) {
+    if (alloc_forbidden) {
+        fputs("FATAL: memory allocation in steady-state thread '", stderr);
+        fputs(alloc_forbidden, stderr);
+        fputs("'\n", stderr);
+        abort();
+    }
+    __atomic_add_fetch(&alloc_total, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&alloc_total_bytes, size, __ATOMIC_RELAXED);
+    alloc_cmd_count++;
+    alloc_cmd_bytes += size;
+}
+
+void *__wrap_malloc(size_t size) {
+    alloc_track_note(size);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    size_t total;
+    /* Переполнение: calloc сам вернет NULL, учитывать нечего */
+    if (!__builtin_mul_overflow(n, size, &total)) {
+        alloc_track_note(total);
+    }
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    alloc_track_note(size);
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+    __real_free(ptr);
+}
+
+bool alloc_track_enabled(void) {
+    return true;
+}
+
+void alloc_track_forbid_thread(const char *thread_name) {
+    alloc_forbidden = thread_name;
+}
+
+void alloc_track_allow_thread(void) {
+    alloc_forbidden = NULL;
+}
+
+void alloc_track_command_begin(const char *command) {
+    int idx = -1;
+
+    for (int i = 0; i < alloc_cmd_used; i++) {
+        if (strcmp(alloc_cmds[i].name, command) == 0) {
+            idx = i;
+            break;
+        }
+    }
+    if (idx < 0 && alloc_cmd_used < ALLOC_TRACK_MAX_COMMANDS) {
+        idx = alloc_cmd_used++;
+        strncpy(alloc_cmds[idx].name, command, sizeof(alloc_cmds[idx].name) - 1);
+    }
+
+    alloc_cmd_current = idx;
+    alloc_cmd_count = 0;
+    alloc_cmd_bytes = 0;
+}
+
+void alloc_track_command_end(void) {
+    if (alloc_cmd_current < 0) {
+        return;
+    }
+
+    alloc_track_cmd_t *c = &alloc_cmds[alloc_cmd_current];
+    uint64_t count = alloc_cmd_count;
+
+    c->runs++;
+    c->allocs += count;
+    c->bytes += alloc_cmd_bytes;
+    if (count > c->max_allocs) {
+        c->max_allocs = count;
+    }
+    alloc_cmd_current = -1;
+}
+
+void alloc_track_print(void) {
+    printf("Heap allocations: %llu (%llu bytes) since start\n",
+           (unsigned long long)alloc_total, (unsigned long long)alloc_total_bytes);
+    if (alloc_cmd_used == 0) {
+        return;
+    }
+
+    printf("  Per command: REPL thread only (cyclic/diagnostic threads count in the total)\n");
+    printf("  %-20s %8s %10s %12s %10s\n", "Command", "Runs", "Allocs", "Bytes", "Max/run");
+    for (int i = 0; i < alloc_cmd_used; i++) {
+        const alloc_track_cmd_t *c = &alloc_cmds[i];
+        printf("  %-20s %8llu %10llu %12llu %10llu\n", c->name,
+               (unsigned long long)c->runs, (unsigned long long)c->allocs,
+               (unsigned long long)c->bytes, (unsigned long long)c->max_allocs);
+    }
+}
+
+#else /* !ECAT_ALLOC_TRACK */
+
+bool alloc_track_enabled(void) {
+    return false;
+}
+
+void alloc_track_forbid_thread(const char *thread_name) {
+    (void)thread_name;
+}
+
+void alloc_track_allow_thread(void) {
+}
+
+void alloc_track_command_begin(const char *command) {
+    (void)command;
+}
+
+void alloc_track_command_end(void) {
+}
+
+void alloc_track_print(void) {
+    printf("Allocation tracking disabled (build with -DECAT_ALLOC_TRACK=ON)\n");
+}
+
+#endif /* ECAT_ALLOC_TRACK */
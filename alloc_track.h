@@ -0,0 +1,42 @@
+/*
+ * alloc_track.h - Отладочный перехват malloc/free
+ *
+ * При сборке с -DECAT_ALLOC_TRACK=ON линкер перенаправляет malloc, calloc,
+ * realloc и free (-Wl,--wrap) в обертки, которые:
+ * - аварийно завершают программу при выделении памяти в потоке,
+ *   объявившем установившийся режим (alloc_track_forbid_thread);
+ * - считают выделения для каждой команды REPL (только в потоке REPL;
+ *   выделения других потоков - в общем итоге).
+ *
+ * Перехватываются вызовы из объектов программы и статических библиотек
+ * (в том числе SOEM); внутренние выделения самой libc не видны.
+ * Без ECAT_ALLOC_TRACK все функции пустые.
+ */
+
+#ifndef ALLOC_TRACK_H
+#define ALLOC_TRACK_H
+
+#include <stdbool.h>
+
+#define ALLOC_TRACK_MAX_COMMANDS 48
+
+bool alloc_track_enabled(void);
+
+/**
+ * Запрет выделений в текущем потоке (вызывать после инициализации потока)
+ */
+void alloc_track_forbid_thread(const char *thread_name);
+void alloc_track_allow_thread(void);
+
+/**
+ * Начало и конец учета выделений для команды
+ */
+void alloc_track_command_begin(const char *command);
+void alloc_track_command_end(void);
+
+/**
+ * Таблица выделений по командам
+ */
+void alloc_track_print(void);
+
+#endif /* ALLOC_TRACK_H */
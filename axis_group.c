@@ -0,0 +1,722 @@
+/*
+ * axis_group.c - Группы осей: команды всем членам в одном кадре
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "axis_group.h"
+
+/* Controlword */
+#define AG_CW_SHUTDOWN      0x0006
+#define AG_CW_SWITCH_ON     0x0007
+#define AG_CW_ENABLE_OP     0x000F
+#define AG_CW_QUICK_STOP    0x0004
+#define AG_CW_NEW_SETPOINT  0x0010
+#define AG_CW_HALT          0x0100
+
+/* Statusword */
+#define AG_SW_FAULT         0x0008
+#define AG_SW_TARGET_REACHED 0x0400
+#define AG_SW_SETPOINT_ACK  0x1000       /* PP: бит 12 */
+#define AG_SW_HOMING_ATTAINED 0x1000     /* HM: бит 12 */
+#define AG_SW_HOMING_ERROR  0x2000       /* HM: бит 13 */
+
+#define AG_SW_STATE(sw)     ((sw) & 0x6F)
+#define AG_ST_READY         0x21
+#define AG_ST_SWITCHED_ON   0x23
+#define AG_ST_ENABLED       0x27
+
+/* ============================================================================
+ * Группы (индекс 1..AXIS_GROUP_MAX)
+ * ============================================================================ */
+
+static int ag_n[AXIS_GROUP_MAX + 1];
+static uint16_t ag_slave[AXIS_GROUP_MAX + 1][AXIS_GROUP_MAX_MEMBERS];
+static axis_group_pdo_t ag_pdo[AXIS_GROUP_MAX + 1][AXIS_GROUP_MAX_MEMBERS];
+static int32_t ag_value[AXIS_GROUP_MAX + 1][AXIS_GROUP_MAX_MEMBERS];
+
+/* Передача задания: CLI пишет ag_next и переводит состояние в PENDING */
+static int ag_state[AXIS_GROUP_MAX + 1];
+static int ag_next[AXIS_GROUP_MAX + 1];
+static bool ag_cancel[AXIS_GROUP_MAX + 1];
+static uint32_t ag_timeout[AXIS_GROUP_MAX + 1];
+
+/* Задание (пишет циклический поток под seqlock) */
+static axis_group_job_t ag_job[AXIS_GROUP_MAX + 1];
+static bool ag_resp[AXIS_GROUP_MAX + 1][AXIS_GROUP_MAX_MEMBERS];
+static uint16_t ag_sw_commit[AXIS_GROUP_MAX + 1][AXIS_GROUP_MAX_MEMBERS];  /* Statusword при фиксации */
+static bool ag_home_started[AXIS_GROUP_MAX + 1][AXIS_GROUP_MAX_MEMBERS];
+static uint64_t ag_cycle = 0;
+static uint32_t ag_seq;
+
+static int ag_get_state(int g) {
+#ifdef _WIN32
+    return *(volatile int *)&ag_state[g];        /* Windows: циклы только в вызывающем потоке */
+#else
+    return __atomic_load_n(&ag_state[g], __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void ag_set_state(int g, int st) {
+#ifdef _WIN32
+    *(volatile int *)&ag_state[g] = st;
+#else
+    __atomic_store_n(&ag_state[g], st, __ATOMIC_RELEASE);
+#endif
+}
+
+static bool ag_cas_state(int g, int from, int to) {
+#ifdef _WIN32
+    if (ag_state[g] != from) {
+        return false;
+    }
+    ag_state[g] = to;
+    return true;
+#else
+    return __atomic_compare_exchange_n(&ag_state[g], &from, to, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static bool ag_get_flag(const bool *p) {
+#ifdef _WIN32
+    return *(const volatile bool *)p;
+#else
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void ag_set_flag(bool *p, bool v) {
+#ifdef _WIN32
+    *(volatile bool *)p = v;
+#else
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#endif
+}
+
+static void ag_write_begin(void) {
+#ifdef _WIN32
+    ag_seq++;
+#else
+    __atomic_store_n(&ag_seq, ag_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+#endif
+}
+
+static void ag_write_end(void) {
+#ifdef _WIN32
+    ag_seq++;
+#else
+    __atomic_store_n(&ag_seq, ag_seq + 1, __ATOMIC_RELEASE);
+#endif
+}
+
+static bool ag_valid(int g) {
+    return g >= 1 && g <= AXIS_GROUP_MAX;
+}
+
+/* Группа занята: задание зафиксировано или идет */
+static bool ag_busy(int g) {
+    int st = ag_get_state(g);
+    return st == AXIS_JOB_PENDING || st == AXIS_JOB_ACTIVE;
+}
+
+static uint16_t ag_rd16(const uint8_t *p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static int32_t ag_rd32(const uint8_t *p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void ag_wr16(uint8_t *p, uint16_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+static void ag_wr32(uint8_t *p, int32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+/* ============================================================================
+ * Состав групп (поток CLI)
+ * ============================================================================ */
+
+bool axis_group_add(int group, uint16_t slave, const axis_group_pdo_t *pdo) {
+    if (!ag_valid(group) || ag_busy(group) || pdo == NULL) {
+        return false;
+    }
+    int other = axis_group_of(slave);
+    if (other == group) {
+        return true;
+    }
+    if (other != 0 || ag_n[group] >= AXIS_GROUP_MAX_MEMBERS) {
+        return false;
+    }
+    int m = ag_n[group];
+    ag_slave[group][m] = slave;
+    ag_pdo[group][m] = *pdo;
+    ag_value[group][m] = 0;
+    ag_n[group] = m + 1;
+    return true;
+}
+
+bool axis_group_remove(int group, uint16_t slave) {
+    if (!ag_valid(group) || ag_busy(group)) {
+        return false;
+    }
+    for (int m = 0; m < ag_n[group]; m++) {
+        if (ag_slave[group][m] != slave) {
+            continue;
+        }
+        /* Порядок членов сохраняется: по нему раскладываются списки значений */
+        for (int k = m + 1; k < ag_n[group]; k++) {
+            ag_slave[group][k - 1] = ag_slave[group][k];
+            ag_pdo[group][k - 1] = ag_pdo[group][k];
+            ag_value[group][k - 1] = ag_value[group][k];
+        }
+        ag_n[group]--;
+        return true;
+    }
+    return false;
+}
+
+void axis_group_clear(int group) {
+    if (!ag_valid(group)) {
+        return;
+    }
+    axis_group_cancel(group);
+    ag_n[group] = 0;
+    ag_set_state(group, AXIS_JOB_IDLE);
+}
+
+void axis_group_clear_all(void) {
+    for (int g = 1; g <= AXIS_GROUP_MAX; g++) {
+        axis_group_clear(g);
+    }
+}
+
+int axis_group_of(uint16_t slave) {
+    for (int g = 1; g <= AXIS_GROUP_MAX; g++) {
+        for (int m = 0; m < ag_n[g]; m++) {
+            if (ag_slave[g][m] == slave) {
+                return g;
+            }
+        }
+    }
+    return 0;
+}
+
+int axis_group_members(int group, uint16_t *slaves) {
+    if (!ag_valid(group)) {
+        return 0;
+    }
+    if (slaves != NULL) {
+        memcpy(slaves, ag_slave[group], (size_t)ag_n[group] * sizeof(slaves[0]));
+    }
+    return ag_n[group];
+}
+
+/* ============================================================================
+ * Задания (поток CLI)
+ * ============================================================================ */
+
+bool axis_group_stage(int group, int index, int32_t value) {
+    if (!ag_valid(group) || index < 0 || index >= ag_n[group] || ag_get_state(group) == AXIS_JOB_PENDING) {
+        return false;
+    }
+    /* Идущее задание значений не читает: они применяются только при фиксации */
+    ag_value[group][index] = value;
+    return true;
+}
+
+bool axis_group_commit(int group, axis_group_cmd_t cmd) {
+    bool preempt = cmd == AXIS_GROUP_HALT || cmd == AXIS_GROUP_QUICK_STOP;
+
+    if (!ag_valid(group) || ag_n[group] == 0) {
+        return false;
+    }
+    for (;;) {
+        int st = ag_get_state(group);
+        if (st == AXIS_JOB_PENDING || (st == AXIS_JOB_ACTIVE && !preempt)) {
+            return false;
+        }
+        ag_next[group] = cmd;
+        ag_set_flag(&ag_cancel[group], false);
+        /* Цикл мог как раз завершить задание: тогда повтор из DONE/FAILED */
+        if (ag_cas_state(group, st, AXIS_JOB_PENDING)) {
+            return true;
+        }
+    }
+}
+
+void axis_group_set_timeout(int group, uint32_t cycles) {
+    if (ag_valid(group)) {
+        ag_timeout[group] = cycles;              /* Читается циклом при старте задания */
+    }
+}
+
+void axis_group_cancel(int group) {
+    if (!ag_valid(group)) {
+        return;
+    }
+    ag_set_flag(&ag_cancel[group], true);
+    ag_cas_state(group, AXIS_JOB_PENDING, AXIS_JOB_FAILED);
+}
+
+/* ============================================================================
+ * Цикл (циклический поток)
+ * ============================================================================ */
+
+static void ag_finish(int g, axis_job_state_t st, uint16_t slave, const char *reason) {
+    if (ag_job[g].cmd == AXIS_GROUP_MOVE || ag_job[g].cmd == AXIS_GROUP_HOME) {
+        /* Снятый бит 4 прерывает homing оси, не дошедшей до нуля */
+        for (int m = 0; m < ag_n[g]; m++) {
+            uint8_t *cwp = ag_pdo[g][m].outputs + ag_pdo[g][m].control_word;
+            ag_wr16(cwp, (uint16_t)(ag_rd16(cwp) & ~AG_CW_NEW_SETPOINT));
+        }
+    }
+    ag_job[g].state = st;
+    ag_job[g].end_cycle = ag_cycle;
+    ag_job[g].fail_slave = slave;
+    ag_job[g].fail_reason = reason;
+    /* CLI мог уже зафиксировать останов поверх: он выполнится следующим циклом */
+    ag_cas_state(g, AXIS_JOB_ACTIVE, st);
+}
+
+/**
+ * Запись команды всем членам; для скорости и перемещения - только если
+ * все оси в Operation Enabled
+ */
+static bool ag_apply(int g) {
+    axis_group_job_t *job = &ag_job[g];
+    int n = ag_n[g];
+
+    if (job->cmd == AXIS_GROUP_VELOCITY || job->cmd == AXIS_GROUP_MOVE || job->cmd == AXIS_GROUP_HOME) {
+        for (int m = 0; m < n; m++) {
+            const axis_group_pdo_t *p = &ag_pdo[g][m];
+            if (AG_SW_STATE(ag_rd16(p->inputs + p->statusword)) != AG_ST_ENABLED) {
+                ag_finish(g, AXIS_JOB_FAILED, ag_slave[g][m], "not in Operation Enabled, nothing written");
+                return false;
+            }
+        }
+    }
+
+    for (int m = 0; m < n; m++) {
+        const axis_group_pdo_t *p = &ag_pdo[g][m];
+        uint8_t *cwp = p->outputs + p->control_word;
+        uint16_t cw = ag_rd16(cwp);
+
+        switch (job->cmd) {
+            case AXIS_GROUP_ENABLE:
+                /* Enable Operation - позже, всем сразу */
+                ag_wr32(p->outputs + p->target_velocity, 0);
+                continue;
+            case AXIS_GROUP_DISABLE:
+                ag_wr32(p->outputs + p->target_velocity, 0);
+                cw = 0;
+                break;
+            case AXIS_GROUP_VELOCITY:
+                ag_wr32(p->outputs + p->target_velocity, ag_value[g][m]);
+                cw = (uint16_t)((cw | AG_CW_ENABLE_OP) & ~(AG_CW_HALT | AG_CW_NEW_SETPOINT));
+                break;
+            case AXIS_GROUP_MOVE:
+                ag_wr32(p->outputs + p->target_position, ag_value[g][m]);
+                cw = (uint16_t)(((cw | AG_CW_ENABLE_OP) & ~AG_CW_HALT) | AG_CW_NEW_SETPOINT);
+                break;
+            case AXIS_GROUP_HOME:
+                cw = (uint16_t)(((cw | AG_CW_ENABLE_OP) & ~AG_CW_HALT) | AG_CW_NEW_SETPOINT);
+                break;
+            case AXIS_GROUP_MODE:
+                /* Controlword не меняется; бит 4 снят, чтобы новый режим не стартовал сам */
+                if (p->mode && p->mode_display) {
+                    p->outputs[p->mode] = (uint8_t)(int8_t)ag_value[g][m];
+                }
+                cw = (uint16_t)(cw & ~AG_CW_NEW_SETPOINT);
+                break;
+            case AXIS_GROUP_HALT:
+                cw = (uint16_t)((cw | AG_CW_HALT) & ~AG_CW_NEW_SETPOINT);
+                break;
+            case AXIS_GROUP_QUICK_STOP:
+                cw = (uint16_t)(cw & ~(AG_CW_QUICK_STOP | AG_CW_NEW_SETPOINT));
+                break;
+        }
+        ag_wr16(cwp, cw);
+    }
+
+    if (job->cmd != AXIS_GROUP_ENABLE) {
+        job->commit_cycle = ag_cycle;
+    }
+    return true;
+}
+
+/**
+ * Включение: каждую ось до Switched On, затем Enable Operation всем в
+ * одном цикле
+ */
+static bool ag_enable_prepare(int g) {
+    bool ready = true;
+
+    for (int m = 0; m < ag_n[g]; m++) {
+        const axis_group_pdo_t *p = &ag_pdo[g][m];
+        uint16_t sw = ag_rd16(p->inputs + p->statusword);
+        uint16_t st = AG_SW_STATE(sw);
+
+        if (sw & AG_SW_FAULT) {
+            ag_finish(g, AXIS_JOB_FAILED, ag_slave[g][m], "in Fault, reset it with 'motor-enable'");
+            return false;
+        }
+        if (st == AG_ST_ENABLED || st == AG_ST_SWITCHED_ON) {
+            continue;
+        }
+        ready = false;
+        if (st == AG_ST_READY) {
+            ag_wr16(p->outputs + p->control_word, AG_CW_SWITCH_ON);
+        } else if ((sw & 0x4F) == 0x40) {
+            ag_wr16(p->outputs + p->control_word, AG_CW_SHUTDOWN);
+        }
+    }
+    if (!ready) {
+        return false;
+    }
+    for (int m = 0; m < ag_n[g]; m++) {
+        const axis_group_pdo_t *p = &ag_pdo[g][m];
+        ag_wr16(p->outputs + p->control_word, AG_CW_ENABLE_OP);
+    }
+    ag_job[g].commit_cycle = ag_cycle;
+    return true;
+}
+
+/**
+ * Отклик оси на команду
+ */
+static bool ag_responded(int g, int m, uint16_t sw, int32_t vel) {
+    const axis_group_pdo_t *p = &ag_pdo[g][m];
+
+    switch (ag_job[g].cmd) {
+        case AXIS_GROUP_ENABLE:
+            return AG_SW_STATE(sw) == AG_ST_ENABLED;
+        case AXIS_GROUP_DISABLE:
+            return AG_SW_STATE(sw) != AG_ST_ENABLED;
+        case AXIS_GROUP_VELOCITY: {
+            /* На скорости: Target Reached и 0x606C у задания (не старый флаг) */
+            int64_t target = ag_rd32(p->outputs + p->target_velocity);
+            int64_t err = llabs((int64_t)vel - target);
+            return (sw & AG_SW_TARGET_REACHED) && err <= llabs(target) / 8 + AXIS_GROUP_STANDSTILL;
+        }
+        case AXIS_GROUP_MOVE:
+            return (sw & AG_SW_SETPOINT_ACK) != 0;
+        case AXIS_GROUP_HOME:
+            return ag_home_started[g][m] &&
+                   (sw & (AG_SW_HOMING_ATTAINED | AG_SW_TARGET_REACHED)) ==
+                   (AG_SW_HOMING_ATTAINED | AG_SW_TARGET_REACHED);
+        case AXIS_GROUP_MODE:
+            /* Без 0x6060 в PDO режим записан по SDO до фиксации */
+            return !p->mode || !p->mode_display || p->inputs[p->mode_display] == p->outputs[p->mode];
+        case AXIS_GROUP_HALT:
+        case AXIS_GROUP_QUICK_STOP:
+            return abs(vel) <= AXIS_GROUP_STANDSTILL;
+    }
+    return false;
+}
+
+/**
+ * Отклики осей после фиксации; все откликнулись - задание завершено
+ */
+static void ag_track(int g) {
+    axis_group_job_t *job = &ag_job[g];
+    bool must_run = job->cmd == AXIS_GROUP_ENABLE || job->cmd == AXIS_GROUP_VELOCITY ||
+                    job->cmd == AXIS_GROUP_MOVE || job->cmd == AXIS_GROUP_HOME;
+    bool reached = true;
+
+    for (int m = 0; m < ag_n[g]; m++) {
+        const axis_group_pdo_t *p = &ag_pdo[g][m];
+        uint16_t sw = ag_rd16(p->inputs + p->statusword);
+        int32_t vel = ag_rd32(p->inputs + p->actual_velocity);
+
+        if (must_run && (sw & AG_SW_FAULT)) {
+            ag_finish(g, AXIS_JOB_FAILED, ag_slave[g][m], "went to Fault");
+            return;
+        }
+        if (must_run && ag_resp[g][m] && AG_SW_STATE(sw) != AG_ST_ENABLED) {
+            ag_finish(g, AXIS_JOB_FAILED, ag_slave[g][m], "left Operation Enabled");
+            return;
+        }
+        /* Биты 12, 13 и 10 держатся от прошлого хоуминга до нового фронта бита 4:
+         * они засчитываются, только если при фиксации их не было или Statusword
+         * с тех пор сменился */
+        if (job->cmd == AXIS_GROUP_HOME && !ag_home_started[g][m] &&
+            (!(sw & (AG_SW_HOMING_ATTAINED | AG_SW_HOMING_ERROR)) || sw != ag_sw_commit[g][m])) {
+            ag_home_started[g][m] = true;
+        }
+        if (job->cmd == AXIS_GROUP_HOME && ag_home_started[g][m] && (sw & AG_SW_HOMING_ERROR)) {
+            ag_finish(g, AXIS_JOB_FAILED, ag_slave[g][m], "homing error");
+            return;
+        }
+        if (!ag_resp[g][m] && ag_responded(g, m, sw, vel)) {
+            ag_resp[g][m] = true;
+            if (job->responded++ == 0) {
+                job->first_response = ag_cycle;
+            }
+            job->last_response = ag_cycle;
+        }
+        if (job->cmd == AXIS_GROUP_HOME && ag_resp[g][m]) {
+            uint8_t *cwp = p->outputs + p->control_word;
+            ag_wr16(cwp, (uint16_t)(ag_rd16(cwp) & ~AG_CW_NEW_SETPOINT));
+        }
+        if (job->cmd == AXIS_GROUP_MOVE) {
+            /* Квитирование New Setpoint, затем ждем Target Reached */
+            if (ag_resp[g][m]) {
+                uint8_t *cwp = p->outputs + p->control_word;
+                ag_wr16(cwp, (uint16_t)(ag_rd16(cwp) & ~AG_CW_NEW_SETPOINT));
+            }
+            reached = reached && ag_resp[g][m] && (sw & AG_SW_TARGET_REACHED);
+        }
+    }
+
+    if (job->responded == job->members && reached) {
+        ag_finish(g, AXIS_JOB_DONE, 0, NULL);
+    }
+}
+
+void axis_group_cycle(void) {
+    bool any = false;
+
+    ag_cycle++;
+    for (int g = 1; g <= AXIS_GROUP_MAX; g++) {
+        int st = ag_get_state(g);
+        if (st != AXIS_JOB_PENDING && st != AXIS_JOB_ACTIVE) {
+            continue;
+        }
+        if (!any) {
+            ag_write_begin();
+            any = true;
+        }
+
+        if (st == AXIS_JOB_PENDING) {
+            axis_group_job_t *job = &ag_job[g];
+            /* Отмена до применения: CLI сам перевел задание в FAILED */
+            if (!ag_cas_state(g, AXIS_JOB_PENDING, AXIS_JOB_ACTIVE)) {
+                continue;
+            }
+            memset(job, 0, sizeof(*job));
+            memset(ag_resp[g], 0, sizeof(ag_resp[g]));
+            memset(ag_home_started[g], 0, sizeof(ag_home_started[g]));
+            for (int m = 0; m < ag_n[g]; m++) {
+                const axis_group_pdo_t *p = &ag_pdo[g][m];
+                ag_sw_commit[g][m] = ag_rd16(p->inputs + p->statusword);
+            }
+            job->group = g;
+            job->members = ag_n[g];
+            job->cmd = (axis_group_cmd_t)ag_next[g];
+            job->state = AXIS_JOB_ACTIVE;
+            job->deadline = ag_timeout[g] ? ag_cycle + ag_timeout[g] : 0;
+            /* Отклики - со следующего цикла: этот кадр команду еще не нес */
+            ag_apply(g);
+            continue;
+        }
+
+        if (ag_get_flag(&ag_cancel[g])) {
+            ag_finish(g, AXIS_JOB_FAILED, 0, "cancelled");
+            continue;
+        }
+        if (ag_job[g].deadline && ag_cycle >= ag_job[g].deadline) {
+            /* Виновник - первая ось без отклика */
+            int m = 0;
+            while (m < ag_n[g] - 1 && ag_resp[g][m]) {
+                m++;
+            }
+            ag_finish(g, AXIS_JOB_FAILED, ag_slave[g][m], "timed out");
+            continue;
+        }
+        if (ag_job[g].commit_cycle == 0) {
+            ag_enable_prepare(g);
+            continue;
+        }
+        ag_track(g);
+    }
+    if (any) {
+        ag_write_end();
+    }
+}
+
+/* ============================================================================
+ * Наблюдение
+ * ============================================================================ */
+
+uint64_t axis_group_cycles(void) {
+#ifdef _WIN32
+    return ag_cycle;
+#else
+    return __atomic_load_n(&ag_cycle, __ATOMIC_RELAXED);
+#endif
+}
+
+axis_job_state_t axis_group_state(int group) {
+    return ag_valid(group) ? (axis_job_state_t)ag_get_state(group) : AXIS_JOB_IDLE;
+}
+
+/**
+ * Согласованная копия задания и откликов
+ */
+static void ag_snapshot(int g, axis_group_job_t *job, bool *resp) {
+    uint32_t s0, s1;
+
+    do {
+#ifdef _WIN32
+        s0 = ag_seq;
+#else
+        s0 = __atomic_load_n(&ag_seq, __ATOMIC_ACQUIRE);
+#endif
+        *job = ag_job[g];
+        if (resp != NULL) {
+            memcpy(resp, ag_resp[g], sizeof(ag_resp[g]));
+        }
+#ifndef _WIN32
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        s1 = __atomic_load_n(&ag_seq, __ATOMIC_RELAXED);
+#else
+        s1 = ag_seq;
+#endif
+    } while ((s0 & 1) || s0 != s1);
+}
+
+bool axis_group_job(int group, axis_group_job_t *job) {
+    if (!ag_valid(group)) {
+        return false;
+    }
+    int st = ag_get_state(group);
+    ag_snapshot(group, job, NULL);
+    if (st == AXIS_JOB_PENDING) {
+        memset(job, 0, sizeof(*job));
+        job->group = group;
+        job->members = ag_n[group];
+        job->cmd = (axis_group_cmd_t)ag_next[group];
+    } else if (st == AXIS_JOB_FAILED && job->state != AXIS_JOB_FAILED) {
+        /* Отменено до применения */
+        job->fail_slave = 0;
+        job->fail_reason = "cancelled";
+    }
+    job->state = (axis_job_state_t)st;
+    return true;
+}
+
+const char *axis_group_cmd_name(axis_group_cmd_t cmd) {
+    switch (cmd) {
+        case AXIS_GROUP_ENABLE: return "enable";
+        case AXIS_GROUP_DISABLE: return "disable";
+        case AXIS_GROUP_VELOCITY: return "velocity";
+        case AXIS_GROUP_MOVE: return "move";
+        case AXIS_GROUP_HALT: return "halt";
+        case AXIS_GROUP_QUICK_STOP: return "quick stop";
+        case AXIS_GROUP_HOME: return "home";
+        case AXIS_GROUP_MODE: return "mode";
+    }
+    return "?";
+}
+
+static const char *ag_state_name(axis_job_state_t st) {
+    switch (st) {
+        case AXIS_JOB_IDLE: return "Idle";
+        case AXIS_JOB_PENDING: return "Pending";
+        case AXIS_JOB_ACTIVE: return "Active";
+        case AXIS_JOB_DONE: return "Done";
+        case AXIS_JOB_FAILED: return "Failed";
+    }
+    return "?";
+}
+
+/**
+ * Номера slave диапазонами: "1-4 7 9-12"
+ */
+static void ag_print_slaves(const uint16_t *slaves, const bool *skip, int n, int max_items) {
+    int items = 0;
+
+    for (int m = 0; m < n; m++) {
+        if (skip != NULL && skip[m]) {
+            continue;
+        }
+        int k = m;
+        while (k + 1 < n && slaves[k + 1] == slaves[k] + 1 && (skip == NULL || !skip[k + 1])) {
+            k++;
+        }
+        if (items++ == max_items) {
+            printf(" ...");
+            return;
+        }
+        if (k > m) {
+            printf(" %u-%u", slaves[m], slaves[k]);
+        } else {
+            printf(" %u", slaves[m]);
+        }
+        m = k;
+    }
+}
+
+static void ag_print_group(int g, bool detail) {
+    static bool resp[AXIS_GROUP_MAX_MEMBERS];
+    axis_group_job_t job;
+    int st = ag_get_state(g);
+
+    ag_snapshot(g, &job, resp);
+    axis_group_job(g, &job);             /* Состояние с учетом PENDING и отмены */
+    printf("  Group %d: %d axes:", g, ag_n[g]);
+    ag_print_slaves(ag_slave[g], NULL, ag_n[g], detail ? 64 : 8);
+    printf("\n");
+    if (st == AXIS_JOB_IDLE) {
+        printf("    No command yet\n");
+        return;
+    }
+    printf("    Last: %s, %s", axis_group_cmd_name(job.cmd), ag_state_name(job.state));
+    if (job.commit_cycle) {
+        printf(", written to all axes in cycle %llu", (unsigned long long)job.commit_cycle);
+    }
+    printf("\n");
+    if (job.state == AXIS_JOB_ACTIVE && job.deadline) {
+        printf("    Timeout in cycle %llu\n", (unsigned long long)job.deadline);
+    }
+    if (job.responded > 0) {
+        printf("    Responses: %d/%d, cycles %llu..%llu (+%llu..+%llu after commit)\n",
+               job.responded, job.members,
+               (unsigned long long)job.first_response, (unsigned long long)job.last_response,
+               (unsigned long long)(job.first_response - job.commit_cycle),
+               (unsigned long long)(job.last_response - job.commit_cycle));
+    }
+    if (job.state == AXIS_JOB_DONE) {
+        printf("    Done in cycle %llu\n", (unsigned long long)job.end_cycle);
+    }
+    if (job.state == AXIS_JOB_FAILED) {
+        if (job.fail_slave) {
+            printf("    Failed: slave %u %s\n", job.fail_slave, job.fail_reason);
+        } else {
+            printf("    Failed: %s\n", job.fail_reason ? job.fail_reason : "cancelled");
+        }
+    }
+    if (detail && (job.state == AXIS_JOB_ACTIVE || job.state == AXIS_JOB_FAILED) &&
+        job.commit_cycle && job.responded < job.members && job.members == ag_n[g]) {
+        printf("    Waiting for:");
+        ag_print_slaves(ag_slave[g], resp, ag_n[g], 16);
+        printf("\n");
+    }
+}
+
+void axis_group_print(int group) {
+    int n = 0;
+
+    printf("\n=== Axis Groups ===\n");
+    printf("Cycle:             %llu\n", (unsigned long long)axis_group_cycles());
+    for (int g = 1; g <= AXIS_GROUP_MAX; g++) {
+        if ((group == 0 && ag_n[g] > 0) || g == group) {
+            ag_print_group(g, group != 0);
+            n++;
+        }
+    }
+    if (n == 0) {
+        printf("  No groups ('group <g> add <idx|a-b|all> ...')\n");
+    }
+    printf("\n");
+}
@@ -0,0 +1,157 @@
+/*
+ * axis_group.h - Группы осей: команды всем членам в одном кадре
+ *
+ * Команда motor-* пишет выходы одной оси и сама делает обмен, поэтому
+ * команды нескольким осям расходятся по циклам и обходам REPL. Группа
+ * собирает команду (включение, скорость, перемещение, останов) для всех
+ * своих осей заранее, а применяет ее циклический шаг - целиком, за один
+ * вызов axis_group_cycle(). Выходы всех членов меняются между двумя
+ * кадрами, и следующий кадр несет команду всем сразу.
+ *
+ * Поток CLI готовит значения (axis_group_stage) и фиксирует команду
+ * (axis_group_commit); дальше ею владеет задание группы в циклическом
+ * потоке. Задание фиксирует номер цикла применения, отслеживает отклик
+ * каждой оси по Statusword/0x606C и завершается, когда откликнулись все
+ * (или ось ушла в Fault / из Operation Enabled - тогда отказ с номером
+ * slave). Останов можно зафиксировать поверх идущего задания.
+ *
+ * Включение: оси по одной доводятся до Switched On, затем Enable
+ * Operation уходит всем в одном цикле. Скорость (PV) и перемещение (PP,
+ * бит 4 New Setpoint) применяются, только если все оси в Operation
+ * Enabled; иначе не пишется ничего.
+ *
+ * Homing (HM, режим оси уже 6): бит 4 всем осям в одном цикле, дальше
+ * задание следит за битами 12 (homing attained), 10 и 13 (ошибка) каждой
+ * оси и снимает бит 4 у закончивших. Оси ищут нуль одновременно, CLI не
+ * ждет; заданию можно дать предел в циклах (axis_group_set_timeout).
+ *
+ * Смена режима (0x6060 в PDO): байт режима всем осям в одном цикле, отклик
+ * оси - 0x6061 равен заданному; без SDO и mailbox. Члены без 0x6060/0x6061
+ * в PDO пропускаются: режим им заранее пишет вызывающий по SDO.
+ *
+ * Номер цикла - счетчик вызовов axis_group_cycle() с запуска (циклы с
+ * верным WKC).
+ */
+
+#ifndef AXIS_GROUP_H
+#define AXIS_GROUP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AXIS_GROUP_MAX          8        /* Группы 1..AXIS_GROUP_MAX */
+#define AXIS_GROUP_MAX_MEMBERS  256
+#define AXIS_GROUP_STANDSTILL   2        /* |0x606C| остановленной оси, единицы привода */
+
+typedef enum {
+    AXIS_GROUP_ENABLE = 0,
+    AXIS_GROUP_DISABLE,
+    AXIS_GROUP_VELOCITY,         /* 0x60FF из подготовленных значений */
+    AXIS_GROUP_MOVE,             /* 0x607A из подготовленных значений, New Setpoint */
+    AXIS_GROUP_HALT,             /* Бит 8 Controlword */
+    AXIS_GROUP_QUICK_STOP,       /* Сброс бита 2 Controlword */
+    AXIS_GROUP_HOME,             /* HM: бит 4 до homing attained */
+    AXIS_GROUP_MODE              /* 0x6060 в PDO из подготовленных значений (у кого смаплен) */
+} axis_group_cmd_t;
+
+typedef enum {
+    AXIS_JOB_IDLE = 0,
+    AXIS_JOB_PENDING,            /* Зафиксировано CLI, цикл еще не применил */
+    AXIS_JOB_ACTIVE,             /* Применяется / ждет отклика осей */
+    AXIS_JOB_DONE,
+    AXIS_JOB_FAILED
+} axis_job_state_t;
+
+/* Где в PDO лежат объекты оси (смещения в байтах) */
+typedef struct {
+    const uint8_t *inputs;
+    uint8_t *outputs;
+    uint16_t statusword;         /* 0x6041 */
+    uint16_t actual_velocity;    /* 0x606C */
+    uint16_t control_word;       /* 0x6040 */
+    uint16_t target_position;    /* 0x607A */
+    uint16_t target_velocity;    /* 0x60FF */
+    uint16_t mode;               /* 0x6060, 0 - не в PDO */
+    uint16_t mode_display;       /* 0x6061, 0 - не в PDO */
+} axis_group_pdo_t;
+
+/* Последнее задание группы */
+typedef struct {
+    int group;
+    int members;
+    axis_group_cmd_t cmd;
+    axis_job_state_t state;
+    uint64_t commit_cycle;       /* Цикл, в котором команда записана всем осям (0 - еще нет) */
+    uint64_t first_response;     /* Первый и последний отклик оси */
+    uint64_t last_response;
+    int responded;
+    uint64_t end_cycle;          /* Задание завершено (DONE/FAILED) */
+    uint64_t deadline;           /* Цикл отказа по таймауту, 0 - без предела */
+    uint16_t fail_slave;         /* FAILED: ось-причина, 0 - отменено */
+    const char *fail_reason;
+} axis_group_job_t;
+
+/**
+ * Добавить ось в группу (не во время задания)
+ *
+ * @return false если группа занята заданием, полна или ось уже в другой группе
+ */
+bool axis_group_add(int group, uint16_t slave, const axis_group_pdo_t *pdo);
+bool axis_group_remove(int group, uint16_t slave);
+void axis_group_clear(int group);
+
+/**
+ * Распустить все группы (PDO остановлен)
+ */
+void axis_group_clear_all(void);
+
+/**
+ * Группа оси, 0 - ни в одной
+ */
+int axis_group_of(uint16_t slave);
+
+/**
+ * Члены группы по порядку добавления
+ * @return число членов
+ */
+int axis_group_members(int group, uint16_t *slaves);
+
+/**
+ * Значение команды для члена index (0x60FF, 0x607A или 0x6060)
+ */
+bool axis_group_stage(int group, int index, int32_t value);
+
+/**
+ * Зафиксировать команду; HALT и QUICK_STOP вытесняют идущее задание
+ *
+ * @return false если группа пуста или задание еще не применено / идет
+ */
+bool axis_group_commit(int group, axis_group_cmd_t cmd);
+
+/**
+ * Предел длительности следующих заданий группы в циклах, 0 - без предела
+ * (действует с фиксации следующей команды)
+ */
+void axis_group_set_timeout(int group, uint32_t cycles);
+
+/**
+ * Прервать задание (FAILED, fail_slave 0); выходы остаются как есть
+ */
+void axis_group_cancel(int group);
+
+/**
+ * Все группы за один цикл (циклический поток)
+ */
+void axis_group_cycle(void);
+
+uint64_t axis_group_cycles(void);
+axis_job_state_t axis_group_state(int group);
+bool axis_group_job(int group, axis_group_job_t *job);
+const char *axis_group_cmd_name(axis_group_cmd_t cmd);
+
+/**
+ * Отчет по группе; 0 - все группы
+ */
+void axis_group_print(int group);
+
+#endif /* AXIS_GROUP_H */
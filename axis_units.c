@@ -0,0 +1,340 @@
+/*
+ * axis_units.c - Единицы осей: развертка положения и масштабирование
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "axis_units.h"
+
+#define AU_MULT_LIMIT   4294967296.0   /* Мантисса коэффициента < 2^32 */
+#define AU_FACTOR_LIMIT 4611686018427387904.0  /* Коэффициент < 2^62 */
+
+/* Коэффициент: v = mult * 2^-shift, 32 значащих бита при любом порядке */
+typedef struct {
+    uint32_t mult;
+    int shift;
+} au_factor_t;
+
+/* ============================================================================
+ * Состояние осей (индекс - номер slave)
+ * ============================================================================ */
+
+static volatile bool au_bound[AXIS_UNITS_MAX_AXES];
+static int au_hi = 0;
+static const uint8_t *au_inputs[AXIS_UNITS_MAX_AXES];
+static uint16_t au_pos_offset[AXIS_UNITS_MAX_AXES];
+static int32_t au_last[AXIS_UNITS_MAX_AXES];
+static int64_t au_pos[AXIS_UNITS_MAX_AXES];
+static int32_t au_wraps[AXIS_UNITS_MAX_AXES];
+
+/* Масштаб */
+static bool au_user[AXIS_UNITS_MAX_AXES];
+static char au_name[AXIS_UNITS_MAX_AXES][AXIS_UNITS_NAME_LEN];
+static char au_vel_name[AXIS_UNITS_MAX_AXES][AXIS_UNITS_NAME_LEN + 4];
+static double au_units_per_rev[AXIS_UNITS_MAX_AXES];
+static uint32_t au_inc_per_rev[AXIS_UNITS_MAX_AXES];
+static axis_vel_unit_t au_vel_unit[AXIS_UNITS_MAX_AXES];
+
+/* Коэффициенты (значения пользователя - в миллионных долях) */
+static au_factor_t au_user_per_inc[AXIS_UNITS_MAX_AXES];
+static au_factor_t au_inc_per_user[AXIS_UNITS_MAX_AXES];
+static au_factor_t au_drive_per_vel[AXIS_UNITS_MAX_AXES];
+static au_factor_t au_vel_per_drive[AXIS_UNITS_MAX_AXES];
+static au_factor_t au_rpm_per_vel[AXIS_UNITS_MAX_AXES];
+
+/**
+ * a * mult >> shift с округлением; произведение 64x32 собирается из двух
+ * частичных 32x32 без 128-битной арифметики, результат насыщается
+ */
+static int64_t au_mul(int64_t a, const au_factor_t *f) {
+    uint64_t m = a < 0 ? (uint64_t)0 - (uint64_t)a : (uint64_t)a;
+    uint64_t lo = (m & 0xFFFFFFFFu) * f->mult;
+    uint64_t mid = (m >> 32) * f->mult + (lo >> 32);    /* m * mult = mid * 2^32 + lo[31:0] */
+    uint64_t r;
+
+    lo &= 0xFFFFFFFFu;
+    if (f->shift >= 32) {
+        int s = f->shift - 32;
+        if (s >= 64) {
+            r = 0;
+        } else if (s == 0) {
+            r = mid + (lo >> 31);
+        } else {
+            r = (mid >> s) + ((mid >> (s - 1)) & 1);
+        }
+    } else {
+        int s = 32 - f->shift;                          /* 1..63 */
+        if (mid >> (63 - s)) {
+            r = INT64_MAX;
+        } else if (f->shift > 0) {
+            r = (mid << s) + ((lo + ((uint64_t)1 << (f->shift - 1))) >> f->shift);
+        } else {
+            r = (mid << s) + (lo << -f->shift);
+        }
+    }
+    if (r > INT64_MAX) {
+        r = INT64_MAX;
+    }
+    return a < 0 ? -(int64_t)r : (int64_t)r;
+}
+
+/**
+ * Коэффициент с 32-битной мантиссой (как масштаб timebase)
+ *
+ * @return false - вне диапазона [2^-63, 2^62)
+ */
+static bool au_factor(au_factor_t *f, double v) {
+    int exp;
+    double mant;
+
+    if (!(v > 0.0) || v >= AU_FACTOR_LIMIT) {
+        return false;
+    }
+    mant = frexp(v, &exp);                       /* v = mant * 2^exp, mant в [0.5, 1) */
+    if (exp < -63) {
+        return false;
+    }
+    double mult = ldexp(mant, 32);
+    int shift = 32 - exp;
+    if (llround(mult) >= (long long)AU_MULT_LIMIT) {
+        mult /= 2.0;
+        shift--;
+    }
+    f->mult = (uint32_t)llround(mult);
+    f->shift = shift;
+    return true;
+}
+
+static bool au_valid(uint16_t slave) {
+    return slave > 0 && slave < AXIS_UNITS_MAX_AXES && au_bound[slave];
+}
+
+static int32_t au_rd32(uint16_t slave) {
+    int32_t v;
+    memcpy(&v, au_inputs[slave] + au_pos_offset[slave], sizeof(v));
+    return v;
+}
+
+static void au_store_pos(uint16_t slave, int64_t v) {
+#ifdef _WIN32
+    au_pos[slave] = v;                           /* Windows: циклы только в вызывающем потоке */
+#else
+    __atomic_store_n(&au_pos[slave], v, __ATOMIC_RELAXED);
+#endif
+}
+
+/**
+ * Пересчет коэффициентов из масштаба оси
+ *
+ * Миллионные доли входят в коэффициент: у мантиссы 32 значащих бита при
+ * любом порядке, так что 1/AXIS_UNITS_MICRO точность не съедает.
+ */
+static bool au_factors(uint16_t slave, bool user, double units_per_rev) {
+    double ipr = au_inc_per_rev[slave];
+    double user_per_inc = user ? units_per_rev * AXIS_UNITS_MICRO / ipr : (double)AXIS_UNITS_MICRO;
+    double rpm_per_vel = user ? 1.0 / (units_per_rev * AXIS_UNITS_MICRO) : 1.0 / AXIS_UNITS_MICRO;
+    double drive_per_rpm = au_vel_unit[slave] == AXIS_VEL_RPM ? 1.0 : ipr / 60.0;
+    au_factor_t f_user, f_inc, f_drive, f_vel, f_rpm;
+
+    if (!au_factor(&f_user, user_per_inc) ||
+        !au_factor(&f_inc, 1.0 / user_per_inc) ||
+        !au_factor(&f_drive, rpm_per_vel * drive_per_rpm) ||
+        !au_factor(&f_vel, 1.0 / (rpm_per_vel * drive_per_rpm)) ||
+        !au_factor(&f_rpm, rpm_per_vel)) {
+        return false;
+    }
+
+    au_user_per_inc[slave] = f_user;
+    au_inc_per_user[slave] = f_inc;
+    au_drive_per_vel[slave] = f_drive;
+    au_vel_per_drive[slave] = f_vel;
+    au_rpm_per_vel[slave] = f_rpm;
+    return true;
+}
+
+/* ============================================================================
+ * Настройка (поток CLI)
+ * ============================================================================ */
+
+bool axis_units_bind(uint16_t slave, const uint8_t *inputs, uint16_t pos_offset,
+                     uint32_t inc_per_rev, axis_vel_unit_t vel_unit) {
+    if (slave == 0 || slave >= AXIS_UNITS_MAX_AXES || inputs == NULL || inc_per_rev == 0) {
+        return false;
+    }
+
+    au_bound[slave] = false;
+    au_inputs[slave] = inputs;
+    au_pos_offset[slave] = pos_offset;
+    au_inc_per_rev[slave] = inc_per_rev;
+    au_vel_unit[slave] = vel_unit;
+    if (!au_factors(slave, au_user[slave], au_units_per_rev[slave])) {
+        /* Прежний масштаб не сходится с новым разрешением - отсчеты */
+        au_user[slave] = false;
+        au_factors(slave, false, 0.0);
+    }
+
+    au_last[slave] = au_rd32(slave);
+    au_wraps[slave] = 0;
+    au_store_pos(slave, au_last[slave]);
+
+    if (slave >= au_hi) {
+        au_hi = slave + 1;
+    }
+    au_bound[slave] = true;
+    return true;
+}
+
+bool axis_units_bound(uint16_t slave) {
+    return au_valid(slave);
+}
+
+void axis_units_unbind_all(void) {
+    for (int i = 0; i < AXIS_UNITS_MAX_AXES; i++) {
+        au_bound[i] = false;
+    }
+}
+
+void axis_units_clear(void) {
+    axis_units_unbind_all();
+    for (int i = 0; i < AXIS_UNITS_MAX_AXES; i++) {
+        au_user[i] = false;
+    }
+    au_hi = 0;
+}
+
+bool axis_units_set_user(uint16_t slave, const char *name, double units_per_rev) {
+    if (!au_valid(slave)) {
+        return false;
+    }
+    if (name == NULL) {
+        au_user[slave] = false;
+        return au_factors(slave, false, 0.0);
+    }
+    if (!au_factors(slave, true, units_per_rev)) {
+        return false;
+    }
+    au_user[slave] = true;
+    au_units_per_rev[slave] = units_per_rev;
+    snprintf(au_name[slave], sizeof(au_name[slave]), "%s", name);
+    snprintf(au_vel_name[slave], sizeof(au_vel_name[slave]), "%s/min", au_name[slave]);
+    return true;
+}
+
+/* ============================================================================
+ * Цикл (циклический поток)
+ * ============================================================================ */
+
+void axis_units_cycle(void) {
+    int n = au_hi;
+
+    for (int i = 1; i < n; i++) {
+        if (!au_bound[i]) {
+            continue;
+        }
+        int32_t raw = au_rd32((uint16_t)i);
+        int32_t delta = (int32_t)((uint32_t)raw - (uint32_t)au_last[i]);
+        /* Знак сменился вопреки направлению - переход через границу int32 */
+        au_wraps[i] += (delta > 0 && raw < au_last[i]) - (delta < 0 && raw > au_last[i]);
+        au_last[i] = raw;
+        au_store_pos((uint16_t)i, au_pos[i] + delta);
+    }
+}
+
+int64_t axis_units_position(uint16_t slave) {
+    if (!au_valid(slave)) {
+        return 0;
+    }
+#ifdef _WIN32
+    return au_pos[slave];
+#else
+    return __atomic_load_n(&au_pos[slave], __ATOMIC_RELAXED);
+#endif
+}
+
+/* ============================================================================
+ * Пересчеты
+ * ============================================================================ */
+
+int64_t axis_units_parse(const char *text) {
+    return llround(strtod(text, NULL) * AXIS_UNITS_MICRO);
+}
+
+/* Ось в отсчетах - целочисленно и точно; в единицах - через коэффициент */
+int64_t axis_units_inc_from_user(uint16_t slave, int64_t user) {
+    return au_valid(slave) && au_user[slave] ? au_mul(user, &au_inc_per_user[slave])
+                                             : user / AXIS_UNITS_MICRO;
+}
+
+int64_t axis_units_user_from_inc(uint16_t slave, int64_t inc) {
+    return au_valid(slave) && au_user[slave] ? au_mul(inc, &au_user_per_inc[slave])
+                                             : inc * AXIS_UNITS_MICRO;
+}
+
+int32_t axis_units_drive_from_vel(uint16_t slave, int64_t user_per_min) {
+    int64_t v = au_valid(slave) ? au_mul(user_per_min, &au_drive_per_vel[slave])
+                                : user_per_min / AXIS_UNITS_MICRO;
+    return v > INT32_MAX ? INT32_MAX : v < INT32_MIN ? INT32_MIN : (int32_t)v;
+}
+
+int64_t axis_units_vel_from_drive(uint16_t slave, int32_t drive) {
+    return au_valid(slave) ? au_mul(drive, &au_vel_per_drive[slave]) : (int64_t)drive * AXIS_UNITS_MICRO;
+}
+
+int32_t axis_units_rpm_from_vel(uint16_t slave, int64_t user_per_min) {
+    int64_t v = au_valid(slave) ? au_mul(user_per_min, &au_rpm_per_vel[slave])
+                                : user_per_min / AXIS_UNITS_MICRO;
+    return v > INT32_MAX ? INT32_MAX : v < INT32_MIN ? INT32_MIN : (int32_t)v;
+}
+
+const char *axis_units_pos_name(uint16_t slave) {
+    return au_valid(slave) && au_user[slave] ? au_name[slave] : "counts";
+}
+
+const char *axis_units_vel_name(uint16_t slave) {
+    return au_valid(slave) && au_user[slave] ? au_vel_name[slave] : "rpm";
+}
+
+/* ============================================================================
+ * Наблюдение
+ * ============================================================================ */
+
+bool axis_units_info(uint16_t slave, axis_units_info_t *info) {
+    if (!au_valid(slave)) {
+        return false;
+    }
+    info->slave = slave;
+    info->user = au_user[slave];
+    snprintf(info->name, sizeof(info->name), "%s", axis_units_pos_name(slave));
+    info->units_per_rev = au_user[slave] ? au_units_per_rev[slave] : au_inc_per_rev[slave];
+    info->inc_per_rev = au_inc_per_rev[slave];
+    info->vel_unit = au_vel_unit[slave];
+    info->raw = au_last[slave];
+    info->position = axis_units_position(slave);
+    info->wraps = au_wraps[slave];
+    return true;
+}
+
+void axis_units_print(void) {
+    axis_units_info_t a;
+    int n = 0;
+
+    printf("\n=== Axis Units ===\n");
+    printf("  Slave  Unit    Units/rev    Inc/rev  Drive vel  Raw 0x6064    Position (inc)       Position (unit)    Wraps\n");
+    for (int i = 1; i < au_hi; i++) {
+        if (!axis_units_info((uint16_t)i, &a)) {
+            continue;
+        }
+        printf("  %5u  %-6s  %9.4f  %9u  %-9s  %11d  %16lld  %20.6f  %6d\n",
+               a.slave, a.name, a.units_per_rev, a.inc_per_rev,
+               a.vel_unit == AXIS_VEL_RPM ? "rpm" : "inc/s", a.raw, (long long)a.position,
+               axis_units_user_from_inc(a.slave, a.position) / (double)AXIS_UNITS_MICRO, a.wraps);
+        n++;
+    }
+    if (n == 0) {
+        printf("  No axes (bound on first motion command or 'units <idx> ...')\n");
+    }
+    printf("\n");
+}
@@ -0,0 +1,112 @@
+/*
+ * axis_units.h - Единицы осей: развертка положения и масштабирование
+ *
+ * 0x6064 Position Actual - int32 и переполняется на длинных прогонах
+ * (конвейер, поворотный стол). Каждый цикл после приема входов положение
+ * разворачивается в int64: к нему добавляется разность с прошлым
+ * значением по модулю 2^32. Разность за цикл всегда много меньше 2^31.
+ *
+ * Масштаб оси - пользовательские единицы на оборот мотора (мм, градусы),
+ * инкременты на оборот (0x608F) и единица скорости привода (0x60A9:
+ * об/мин или, по умолчанию CiA 402, инкременты/с). Коэффициенты
+ * пересчета вычисляются при настройке как 32-битная мантисса и сдвиг,
+ * в цикле - только целочисленные умножения. Ось без пользовательских
+ * единиц пересчитывается точно (отсчеты * AXIS_UNITS_MICRO); в единицах
+ * погрешность - округление коэффициента до 32 бит мантиссы.
+ *
+ * Значения пользователя - целые в миллионных долях единицы
+ * (AXIS_UNITS_MICRO): положение в единицах, скорость в единицах/мин. Для
+ * оси без настройки единица положения - отсчет, скорости - об/мин.
+ */
+
+#ifndef AXIS_UNITS_H
+#define AXIS_UNITS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AXIS_UNITS_MAX_AXES             256      /* По номеру slave */
+#define AXIS_UNITS_MICRO                1000000LL
+#define AXIS_UNITS_DEFAULT_INC_PER_REV  4000     /* Если 0x608F не читается */
+#define AXIS_UNITS_NAME_LEN             8
+
+/* 0x60A9 SI unit velocity: об/мин (CiA 402 notation) */
+#define AXIS_UNITS_SI_RPM               0x00B44700
+
+/* Единица 0x60FF / 0x606C */
+typedef enum {
+    AXIS_VEL_INC_PER_S = 0,
+    AXIS_VEL_RPM
+} axis_vel_unit_t;
+
+/* Снимок оси */
+typedef struct {
+    uint16_t slave;
+    bool user;                   /* Заданы пользовательские единицы */
+    char name[AXIS_UNITS_NAME_LEN];
+    double units_per_rev;
+    uint32_t inc_per_rev;
+    axis_vel_unit_t vel_unit;
+    int32_t raw;                 /* Последнее 0x6064 */
+    int64_t position;            /* Развернутое, инкременты */
+    int32_t wraps;               /* Переходов через границу int32 */
+} axis_units_info_t;
+
+/**
+ * Подключить ось к развертке; начальное положение = текущему 0x6064
+ */
+bool axis_units_bind(uint16_t slave, const uint8_t *inputs, uint16_t pos_offset,
+                     uint32_t inc_per_rev, axis_vel_unit_t vel_unit);
+bool axis_units_bound(uint16_t slave);
+
+/**
+ * Остановить развертку всех осей (PDO остановлен); масштаб сохраняется
+ */
+void axis_units_unbind_all(void);
+
+/**
+ * Забыть все оси (новый скан)
+ */
+void axis_units_clear(void);
+
+/**
+ * Пользовательские единицы: name на units_per_rev за оборот мотора
+ *
+ * @param name NULL - вернуть отсчеты и об/мин
+ * @return false если ось не подключена или коэффициенты вне диапазона
+ */
+bool axis_units_set_user(uint16_t slave, const char *name, double units_per_rev);
+
+/**
+ * Развертка всех осей (циклический поток)
+ */
+void axis_units_cycle(void);
+
+int64_t axis_units_position(uint16_t slave);
+
+/**
+ * Число из командной строки в миллионных долях ("12.5" -> 12500000)
+ */
+int64_t axis_units_parse(const char *text);
+
+/* Пересчеты (значения пользователя - в миллионных долях) */
+int64_t axis_units_inc_from_user(uint16_t slave, int64_t user);
+int64_t axis_units_user_from_inc(uint16_t slave, int64_t inc);
+int32_t axis_units_drive_from_vel(uint16_t slave, int64_t user_per_min);
+int64_t axis_units_vel_from_drive(uint16_t slave, int32_t drive);
+
+/**
+ * Об/мин мотора для скорости пользователя (контуры мастера считают в об/мин)
+ */
+int32_t axis_units_rpm_from_vel(uint16_t slave, int64_t user_per_min);
+
+/**
+ * Подписи единиц положения и скорости ("mm", "mm/min"; "counts", "rpm")
+ */
+const char *axis_units_pos_name(uint16_t slave);
+const char *axis_units_vel_name(uint16_t slave);
+
+bool axis_units_info(uint16_t slave, axis_units_info_t *info);
+void axis_units_print(void);
+
+#endif /* AXIS_UNITS_H */
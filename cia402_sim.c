@@ -0,0 +1,684 @@
+/*
+ * cia402_sim.c - Модель привода CiA 402 для симулированной шины
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "cia402_sim.h"
+
+/* Controlword */
+#define CW_SWITCH_ON        0x0001
+#define CW_ENABLE_VOLTAGE   0x0002
+#define CW_QUICK_STOP       0x0004
+#define CW_ENABLE_OPERATION 0x0008
+#define CW_NEW_SETPOINT     0x0010       /* PP: новая цель; HM: старт */
+#define CW_FAULT_RESET      0x0080
+#define CW_HALT             0x0100
+
+/* Statusword */
+#define SW_VOLTAGE_ENABLED  0x0010
+#define SW_QUICK_STOP       0x0020
+#define SW_WARNING          0x0080
+#define SW_REMOTE           0x0200
+#define SW_TARGET_REACHED   0x0400
+#define SW_MODE_BIT12       0x1000       /* PP: setpoint ack, PV: скорость 0, HM: attained */
+#define SW_FOLLOWING_ERROR  0x2000
+#define SW_HOMING_ERROR     0x2000       /* HM: тот же бит 13 */
+
+/* Режимы 0x6060 */
+#define MODE_PP  1
+#define MODE_PV  3
+#define MODE_HM  6
+#define MODE_CSP 8
+#define MODE_CSV 9
+#define MODE_CST 10
+
+typedef enum {
+    AX_NOT_READY = 0,
+    AX_SWITCH_ON_DISABLED,
+    AX_READY_TO_SWITCH_ON,
+    AX_SWITCHED_ON,
+    AX_OPERATION_ENABLED,
+    AX_QUICK_STOP_ACTIVE,
+    AX_FAULT_REACTION,
+    AX_FAULT
+} ax_state_t;
+
+static const char *const ax_state_names[] = {
+    "Not Ready", "Switch On Disabled", "Ready to Switch On", "Switched On",
+    "Operation Enabled", "Quick Stop Active", "Fault Reaction", "Fault"
+};
+
+/* Фазы homing модели */
+typedef enum {
+    HM_IDLE = 0,
+    HM_SEARCH,                   /* К датчику на скорости поиска */
+    HM_BACKOFF,                  /* От датчика к метке на скорости подхода */
+    HM_STOP,                     /* Метка найдена (положение = 0x607C), доводка к ней */
+    HM_DONE,
+    HM_ERROR
+} hm_phase_t;
+
+/* Биты Statusword состояния (маска 0x6F и voltage enabled) */
+static const uint16_t ax_state_bits[] = {
+    0x0000, 0x0040, 0x0021 | SW_VOLTAGE_ENABLED, 0x0023 | SW_VOLTAGE_ENABLED,
+    0x0027 | SW_VOLTAGE_ENABLED, 0x0007 | SW_VOLTAGE_ENABLED, 0x000F, 0x0008
+};
+
+/* Состояние одной оси */
+typedef struct {
+    uint8_t state;
+    int8_t mode;
+    uint16_t cw_prev;
+    uint16_t statusword;         /* Последний отправленный мастеру */
+    uint16_t error_code;
+    uint16_t pending_fault;      /* Отказ, введенный через SDO или команду */
+    double pos;                  /* Отсчеты */
+    double vel;                  /* об/мин */
+    double ramp;                 /* Заданная скорость после рампы, об/мин */
+    double torque;               /* 0.1% номинального */
+    int32_t pp_target;
+    bool pp_active;
+    bool homed;
+    uint8_t hm_phase;
+    int8_t hm_method;            /* 0x6098 */
+    uint32_t hm_fast;            /* 0x6099:01, об/мин */
+    uint32_t hm_slow;            /* 0x6099:02 */
+    uint32_t hm_accel;           /* 0x609A, об/мин/с */
+    int32_t hm_offset;           /* 0x607C: положение после homing */
+    double hm_switch;            /* Датчик нуля, отсчеты (в текущих координатах) */
+    double hm_travel;            /* Пройдено в поиске */
+    int64_t follow_ns;           /* Время вне окна слежения */
+    uint32_t lag_us;
+    uint32_t accel;
+    uint32_t decel;
+    uint32_t quick_decel;
+    uint32_t profile_vel;
+    uint32_t max_torque;
+    uint32_t follow_window;
+    uint16_t follow_ms;
+    uint32_t transitions;
+} ax_t;
+
+static void ax_init(void *state, int slave) {
+    ax_t *ax = state;
+
+    memset(ax, 0, sizeof(*ax));
+    ax->state = AX_NOT_READY;
+    ax->lag_us = CIA402_SIM_DEFAULT_LAG_US;
+    ax->accel = CIA402_SIM_DEFAULT_ACCEL;
+    ax->decel = CIA402_SIM_DEFAULT_ACCEL;
+    ax->quick_decel = CIA402_SIM_DEFAULT_ACCEL * 4;
+    ax->profile_vel = CIA402_SIM_DEFAULT_VELOCITY;
+    ax->max_torque = CIA402_SIM_DEFAULT_MAX_TORQUE;
+    ax->follow_window = CIA402_SIM_DEFAULT_FOLLOW;
+    ax->follow_ms = CIA402_SIM_DEFAULT_FOLLOW_MS;
+    ax->hm_fast = CIA402_SIM_DEFAULT_VELOCITY;
+    ax->hm_slow = CIA402_SIM_DEFAULT_VELOCITY / 10;
+    /* Датчики осей стоят по-разному: поиск у группы заканчивается не разом */
+    ax->hm_switch = -(double)CIA402_SIM_HOME_SWITCH * (1 + slave % 4);
+}
+
+static void ax_set_state(ax_t *ax, ax_state_t state) {
+    if (ax->state != state) {
+        ax->state = (uint8_t)state;
+        ax->transitions++;
+    }
+}
+
+static void ax_fault(ax_t *ax, uint16_t code) {
+    if (ax->state == AX_FAULT || ax->state == AX_FAULT_REACTION) {
+        return;
+    }
+    ax->error_code = code;
+    ax_set_state(ax, AX_FAULT_REACTION);
+}
+
+static double ax_step_toward(double value, double target, double max_step) {
+    if (target > value + max_step) return value + max_step;
+    if (target < value - max_step) return value - max_step;
+    return target;
+}
+
+/**
+ * Переходы машины состояний по Controlword (CiA 402, рис. 10)
+ */
+static void ax_state_machine(ax_t *ax, uint16_t cw) {
+    bool fault_reset_edge = (cw & CW_FAULT_RESET) && !(ax->cw_prev & CW_FAULT_RESET);
+    bool disable_voltage = !(cw & CW_ENABLE_VOLTAGE);
+    bool quick_stop = (cw & CW_ENABLE_VOLTAGE) && !(cw & CW_QUICK_STOP);
+    bool shutdown = (cw & 0x0007) == 0x0006;
+    bool switch_on = (cw & 0x000F) == 0x0007;
+    bool enable_op = (cw & 0x000F) == 0x000F;
+
+    switch (ax->state) {
+        case AX_NOT_READY:
+            /* Самотестирование закончено: переход 1 */
+            ax_set_state(ax, AX_SWITCH_ON_DISABLED);
+            break;
+        case AX_SWITCH_ON_DISABLED:
+            if (shutdown) ax_set_state(ax, AX_READY_TO_SWITCH_ON);
+            break;
+        case AX_READY_TO_SWITCH_ON:
+            if (disable_voltage || quick_stop) ax_set_state(ax, AX_SWITCH_ON_DISABLED);
+            else if (enable_op) ax_set_state(ax, AX_OPERATION_ENABLED);
+            else if (switch_on) ax_set_state(ax, AX_SWITCHED_ON);
+            break;
+        case AX_SWITCHED_ON:
+            if (disable_voltage || quick_stop) ax_set_state(ax, AX_SWITCH_ON_DISABLED);
+            else if (shutdown) ax_set_state(ax, AX_READY_TO_SWITCH_ON);
+            else if (enable_op) ax_set_state(ax, AX_OPERATION_ENABLED);
+            break;
+        case AX_OPERATION_ENABLED:
+            if (disable_voltage) ax_set_state(ax, AX_SWITCH_ON_DISABLED);
+            else if (quick_stop) ax_set_state(ax, AX_QUICK_STOP_ACTIVE);
+            else if (shutdown) ax_set_state(ax, AX_READY_TO_SWITCH_ON);
+            else if (switch_on) ax_set_state(ax, AX_SWITCHED_ON);
+            break;
+        case AX_QUICK_STOP_ACTIVE:
+            /* Quick stop option 2: торможение, затем Switch On Disabled */
+            if (disable_voltage) ax_set_state(ax, AX_SWITCH_ON_DISABLED);
+            break;
+        case AX_FAULT_REACTION:
+            break;
+        case AX_FAULT:
+            if (fault_reset_edge) {
+                ax->error_code = 0;
+                ax_set_state(ax, AX_SWITCH_ON_DISABLED);
+            }
+            break;
+    }
+}
+
+/**
+ * Homing: поиск датчика, отход к метке, положение := 0x607C
+ *
+ * Методы 35/37 - нуль в текущем положении без движения; 1..34 - поиск
+ * датчика модели в его сторону; прочие (и 0) - ошибка homing. Снятие
+ * бита 4 прерывает поиск.
+ */
+static double ax_homing(ax_t *ax, uint16_t cw, double dt) {
+    const double counts_per_rpm_s = CIA402_SIM_COUNTS_PER_REV / 60.0;
+
+    if (!(cw & CW_NEW_SETPOINT)) {
+        if (ax->hm_phase == HM_SEARCH || ax->hm_phase == HM_BACKOFF || ax->hm_phase == HM_STOP) {
+            ax->hm_phase = HM_IDLE;
+        }
+        return 0.0;
+    }
+    if (!(ax->cw_prev & CW_NEW_SETPOINT)) {
+        ax->homed = false;
+        ax->hm_travel = 0.0;
+        if (ax->hm_method == 35 || ax->hm_method == 37) {
+            ax->hm_switch += ax->hm_offset - ax->pos;
+            ax->pos = ax->hm_offset;
+            ax->homed = true;
+            ax->hm_phase = HM_DONE;
+        } else {
+            ax->hm_phase = ax->hm_method >= 1 && ax->hm_method <= 34 ? HM_SEARCH : HM_ERROR;
+        }
+    }
+
+    double dir;
+    switch (ax->hm_phase) {
+        case HM_SEARCH:
+            dir = ax->hm_switch >= ax->pos ? 1.0 : -1.0;
+            ax->hm_travel += fabs(ax->vel) * counts_per_rpm_s * dt;
+            if (ax->hm_travel > CIA402_SIM_HOME_RANGE) {
+                ax->hm_phase = HM_ERROR;
+                return 0.0;
+            }
+            if (fabs(ax->hm_switch - ax->pos) < fabs(ax->vel) * counts_per_rpm_s * dt + 1.0) {
+                ax->hm_phase = HM_BACKOFF;
+            }
+            return dir * ax->hm_fast;
+        case HM_BACKOFF: {
+            /* Метка - в CIA402_SIM_HOME_BACKOFF отсчетах за датчиком по ходу отхода */
+            double index = ax->hm_switch + CIA402_SIM_HOME_BACKOFF;
+            dir = index >= ax->pos ? 1.0 : -1.0;
+            if (fabs(index - ax->pos) <= fmax(fabs(ax->vel) * counts_per_rpm_s * dt, 1.0) + 1.0) {
+                double shift = ax->hm_offset - index;
+                ax->pos += shift;
+                ax->hm_switch += shift;
+                ax->hm_phase = HM_STOP;
+                return 0.0;
+            }
+            double rate = ax->hm_accel ? ax->hm_accel : ax->decel;
+            return dir * fmin((double)ax->hm_slow, sqrt(2.0 * rate * fabs(index - ax->pos) / counts_per_rpm_s));
+        }
+        case HM_STOP: {
+            /* Выбег за метку возвращается; homing attained - стоя на метке */
+            double err = ax->hm_offset - ax->pos;
+            double rate = ax->hm_accel ? ax->hm_accel : ax->decel;
+            if (fabs(err) < 1.0 && fabs(ax->vel) < 1.0) {
+                ax->homed = true;
+                ax->hm_phase = HM_DONE;
+                return 0.0;
+            }
+            double v = fmin((double)ax->hm_slow, sqrt(2.0 * rate * fabs(err) / counts_per_rpm_s));
+            return err >= 0 ? v : -v;
+        }
+        default:
+            return 0.0;
+    }
+}
+
+/**
+ * Заданная скорость режима, об/мин
+ */
+static double ax_demand(ax_t *ax, uint16_t cw, int32_t target_pos, int32_t target_vel, double dt) {
+    const double counts_per_rpm_s = CIA402_SIM_COUNTS_PER_REV / 60.0;
+
+    switch (ax->mode) {
+        case MODE_PV:
+            return (cw & CW_HALT) ? 0.0 : (double)target_vel;
+        case MODE_CSV:
+            return (double)target_vel;
+        case MODE_CSP:
+            /* Интерполированная цель: скорость, догоняющая ее за один цикл */
+            return dt > 0 ? (target_pos - ax->pos) / dt / counts_per_rpm_s : 0.0;
+        case MODE_PP: {
+            if ((cw & CW_NEW_SETPOINT) && !(ax->cw_prev & CW_NEW_SETPOINT)) {
+                ax->pp_target = target_pos;
+                ax->pp_active = true;
+            }
+            if (!ax->pp_active || (cw & CW_HALT)) {
+                return 0.0;
+            }
+            double err = ax->pp_target - ax->pos;
+            /* Треугольный/трапециевидный профиль: v <= sqrt(2 a s) */
+            double v_brake = sqrt(2.0 * ax->decel * fabs(err) / counts_per_rpm_s);
+            double v = fmin((double)ax->profile_vel, v_brake);
+            return err >= 0 ? v : -v;
+        }
+        case MODE_HM:
+            return ax_homing(ax, cw, dt);
+        default:
+            return 0.0;
+    }
+}
+
+/**
+ * Смена режима 0x6060 (SDO или байт режима в PDO)
+ */
+static void ax_set_mode(ax_t *ax, int8_t mode) {
+    ax->mode = mode;
+    ax->pp_active = false;
+    ax->homed = ax->mode == MODE_HM ? false : ax->homed;
+    ax->hm_phase = HM_IDLE;
+}
+
+/**
+ * Один цикл оси
+ *
+ * @param has_torque В раскладке 0x6071/0x6077 (смещение 10)
+ * @param has_mode   В раскладке 0x6060/0x6061 (последний байт выходов/входов)
+ */
+static void ax_cycle(ax_t *ax, const uint8_t *outputs, uint8_t *inputs, int64_t dt_ns,
+                     bool has_torque, bool has_mode) {
+    const double counts_per_rpm_s = CIA402_SIM_COUNTS_PER_REV / 60.0;
+    double dt = dt_ns / 1e9;
+    double vel_prev = ax->vel;
+    uint16_t cw;
+    int32_t target_pos, target_vel;
+    int16_t target_torque = 0;
+
+    memcpy(&cw, outputs, sizeof(cw));
+    memcpy(&target_pos, outputs + 2, sizeof(target_pos));
+    memcpy(&target_vel, outputs + 6, sizeof(target_vel));
+    if (has_torque) {
+        memcpy(&target_torque, outputs + 10, sizeof(target_torque));
+    }
+    size_t mode_offset = has_torque ? 12 : 10;
+    if (has_mode && (int8_t)outputs[mode_offset] != ax->mode) {
+        /* 0x6060 в PDO: режим меняется в этом же цикле, без mailbox */
+        ax_set_mode(ax, (int8_t)outputs[mode_offset]);
+    }
+
+    if (ax->pending_fault) {
+        ax_fault(ax, ax->pending_fault);
+        ax->pending_fault = 0;
+    }
+    ax_state_machine(ax, cw);
+
+    /* Заданная скорость и допустимое изменение за цикл */
+    double demand = 0.0;
+    double rate = ax->accel;
+    switch (ax->state) {
+        case AX_OPERATION_ENABLED:
+            demand = ax_demand(ax, cw, target_pos, target_vel, dt);
+            if (fabs(demand) < fabs(ax->ramp)) rate = ax->decel;
+            if (ax->mode == MODE_HM && ax->hm_accel) rate = ax->hm_accel;
+            break;
+        case AX_QUICK_STOP_ACTIVE:
+        case AX_FAULT_REACTION:
+            rate = ax->quick_decel;
+            break;
+        default:
+            /* Без питания мотор свободно останавливается за один цикл */
+            ax->ramp = 0.0;
+            ax->vel = 0.0;
+            rate = 0.0;
+            break;
+    }
+
+    double k = ax->lag_us > 0 && dt > 0 ? 1.0 - exp(-dt * 1e6 / ax->lag_us) : 1.0;
+    if (ax->state == AX_OPERATION_ENABLED && ax->mode == MODE_CST) {
+        /* CST: lag - контур тока, скорость - интеграл момента минус вязкое трение */
+        double cmd = fmax(-(double)ax->max_torque, fmin((double)ax->max_torque, target_torque));
+        ax->torque += (cmd - ax->torque) * k;
+        ax->vel += (ax->torque * CIA402_SIM_TORQUE_ACCEL - ax->vel * CIA402_SIM_DAMPING) * dt;
+        ax->ramp = ax->vel;
+    } else {
+        if (ax->mode == MODE_CSP || ax->mode == MODE_CSV) {
+            /* Циклические режимы: рампа у мастера, у привода только lag */
+            ax->ramp = ax->state == AX_OPERATION_ENABLED ? demand
+                                                        : ax_step_toward(ax->ramp, 0.0, rate * dt);
+        } else {
+            ax->ramp = ax_step_toward(ax->ramp, demand, rate * dt);
+        }
+
+        /* Апериодическое звено: скорость догоняет рампу с постоянной lag */
+        ax->vel += (ax->ramp - ax->vel) * k;
+        /* Момент, нужный для такого ускорения */
+        ax->torque = dt > 0 ? (ax->vel - vel_prev) / dt / CIA402_SIM_TORQUE_ACCEL : 0.0;
+    }
+    ax->pos += ax->vel * counts_per_rpm_s * dt;
+
+    /* Торможение закончено */
+    if (fabs(ax->vel) < 0.5 && fabs(ax->ramp) < 0.5) {
+        if (ax->state == AX_QUICK_STOP_ACTIVE) {
+            ax_set_state(ax, AX_SWITCH_ON_DISABLED);
+        } else if (ax->state == AX_FAULT_REACTION) {
+            ax_set_state(ax, AX_FAULT);
+        }
+    }
+
+    /* Ошибка слежения в позиционных режимах */
+    bool following_error = false;
+    if (ax->state == AX_OPERATION_ENABLED && ax->mode == MODE_CSP && ax->follow_window > 0) {
+        following_error = fabs(target_pos - ax->pos) > ax->follow_window;
+        ax->follow_ns = following_error ? ax->follow_ns + dt_ns : 0;
+        if (ax->follow_ns > (int64_t)ax->follow_ms * 1000000LL) {
+            ax_fault(ax, CIA402_SIM_FAULT_FOLLOWING);
+        }
+    } else {
+        ax->follow_ns = 0;
+    }
+
+    /* Statusword */
+    uint16_t sw = ax_state_bits[ax->state] | SW_REMOTE;
+    if (ax->state == AX_OPERATION_ENABLED) {
+        switch (ax->mode) {
+            case MODE_PV:
+                if (fabs(ax->vel - demand) < 1.0) sw |= SW_TARGET_REACHED;
+                if (fabs(ax->vel) < 1.0) sw |= SW_MODE_BIT12;
+                break;
+            case MODE_PP:
+                if (ax->pp_active && fabs(ax->pp_target - ax->pos) < 1.0 && fabs(ax->vel) < 1.0) {
+                    sw |= SW_TARGET_REACHED;
+                }
+                if (cw & CW_NEW_SETPOINT) sw |= SW_MODE_BIT12;
+                break;
+            case MODE_HM:
+                /* Бит 12 - homing attained, 10 - закончено/остановлено, 13 - ошибка */
+                if (ax->homed) sw |= SW_MODE_BIT12;
+                if (ax->hm_phase == HM_ERROR) sw |= SW_HOMING_ERROR;
+                if ((ax->hm_phase == HM_DONE || ax->hm_phase == HM_ERROR || ax->hm_phase == HM_IDLE) &&
+                    fabs(ax->vel) < 1.0) {
+                    sw |= SW_TARGET_REACHED;
+                }
+                break;
+            case MODE_CSP:
+            case MODE_CSV:
+            case MODE_CST:
+                sw |= SW_MODE_BIT12;     /* Target value followed */
+                break;
+        }
+        if (following_error) sw |= SW_FOLLOWING_ERROR;
+    } else if (ax->state == AX_QUICK_STOP_ACTIVE && fabs(ax->vel) < 1.0) {
+        sw |= SW_TARGET_REACHED;
+    }
+
+    /* Как у энкодера: 0x6064 переполняется по модулю 2^32 */
+    int32_t pos = (int32_t)(uint32_t)llround(ax->pos);
+    int32_t vel = (int32_t)lround(ax->vel);
+    ax->statusword = sw;
+    memcpy(inputs, &sw, sizeof(sw));
+    memcpy(inputs + 2, &pos, sizeof(pos));
+    memcpy(inputs + 6, &vel, sizeof(vel));
+    if (has_torque) {
+        int16_t torque = (int16_t)lround(ax->torque);
+        memcpy(inputs + 10, &torque, sizeof(torque));
+    }
+    if (has_mode) {
+        inputs[mode_offset] = (uint8_t)ax->mode;
+    }
+    /* Фронты битов (Fault Reset, New Setpoint) - относительно прошлого цикла */
+    ax->cw_prev = cw;
+}
+
+static void ax_cycle_pv(void *state, const uint8_t *outputs, uint8_t *inputs, int64_t dt_ns) {
+    ax_cycle(state, outputs, inputs, dt_ns, false, false);
+}
+
+static void ax_cycle_cst(void *state, const uint8_t *outputs, uint8_t *inputs, int64_t dt_ns) {
+    ax_cycle(state, outputs, inputs, dt_ns, true, false);
+}
+
+static void ax_cycle_pv_mode(void *state, const uint8_t *outputs, uint8_t *inputs, int64_t dt_ns) {
+    ax_cycle(state, outputs, inputs, dt_ns, false, true);
+}
+
+static void ax_cycle_cst_mode(void *state, const uint8_t *outputs, uint8_t *inputs, int64_t dt_ns) {
+    ax_cycle(state, outputs, inputs, dt_ns, true, true);
+}
+
+static int ax_sdo_u32(uint32_t *field, bool write, void *data, int size) {
+    if (write) {
+        uint32_t v = 0;
+        memcpy(&v, data, size < 4 ? (size_t)size : 4);
+        *field = v;
+        return size;
+    }
+    if (size < 4) return -1;
+    memcpy(data, field, 4);
+    return 4;
+}
+
+static int ax_sdo(ax_t *ax, bool write, uint16_t index, uint8_t subindex, void *data, int size) {
+    switch (index) {
+        case 0x6060:
+            /* При 0x6060 в PDO запись перекроется байтом режима следующего цикла */
+            if (!write || size < 1) return -1;
+            ax_set_mode(ax, *(const int8_t *)data);
+            return 1;
+        case 0x6061:
+            if (write || size < 1) return -1;
+            *(int8_t *)data = ax->mode;
+            return 1;
+        case 0x6502: {
+            /* Supported Drive Modes: PP, PV, HM, CSP, CSV, CST */
+            uint32_t modes = 0x000003A5;
+            if (write || size < 4) return -1;
+            memcpy(data, &modes, 4);
+            return 4;
+        }
+        case 0x608F: {
+            /* Position Encoder Resolution: инкременты / обороты мотора */
+            uint32_t v = subindex == 1 ? CIA402_SIM_COUNTS_PER_REV : 1;
+            if (write || size < 4 || subindex < 1 || subindex > 2) return -1;
+            memcpy(data, &v, 4);
+            return 4;
+        }
+        case 0x60A9: {
+            /* SI unit velocity: об/мин */
+            uint32_t v = 0x00B44700;
+            if (write || size < 4) return -1;
+            memcpy(data, &v, 4);
+            return 4;
+        }
+        case 0x603F:
+            if (write || size < 2) return -1;
+            memcpy(data, &ax->error_code, 2);
+            return 2;
+        case 0x6077: {
+            if (write || size < 2) return -1;
+            int16_t torque = (int16_t)lround(ax->torque);
+            memcpy(data, &torque, 2);
+            return 2;
+        }
+        case 0x6098:
+            if (size < 1) return -1;
+            if (write) ax->hm_method = *(const int8_t *)data;
+            else *(int8_t *)data = ax->hm_method;
+            return 1;
+        case 0x6099:
+            if (subindex == 1) return ax_sdo_u32(&ax->hm_fast, write, data, size);
+            if (subindex == 2) return ax_sdo_u32(&ax->hm_slow, write, data, size);
+            return -1;
+        case 0x609A: return ax_sdo_u32(&ax->hm_accel, write, data, size);
+        case 0x607C: return ax_sdo_u32((uint32_t *)&ax->hm_offset, write, data, size);
+        case 0x6072: return ax_sdo_u32(&ax->max_torque, write, data, size);
+        case 0x6081: return ax_sdo_u32(&ax->profile_vel, write, data, size);
+        case 0x6083: return ax_sdo_u32(&ax->accel, write, data, size);
+        case 0x6084: return ax_sdo_u32(&ax->decel, write, data, size);
+        case 0x6085: return ax_sdo_u32(&ax->quick_decel, write, data, size);
+        case 0x6065: return ax_sdo_u32(&ax->follow_window, write, data, size);
+        case 0x6066: {
+            uint32_t ms = ax->follow_ms;
+            int n = ax_sdo_u32(&ms, write, data, size);
+            ax->follow_ms = (uint16_t)ms;
+            return n;
+        }
+        case CIA402_SIM_OBJ_CONFIG:
+            if (subindex == CIA402_SIM_SUB_LAG) {
+                return ax_sdo_u32(&ax->lag_us, write, data, size);
+            }
+            if (subindex == CIA402_SIM_SUB_FAULT && write && size >= 2) {
+                uint16_t code;
+                memcpy(&code, data, 2);
+                ax->pending_fault = code ? code : CIA402_SIM_FAULT_EXTERNAL;
+                return size;
+            }
+            return -1;
+        default:
+            return -1;
+    }
+}
+
+static int ax_sdo_write(void *state, uint16_t index, uint8_t subindex, const void *data, int size) {
+    return ax_sdo(state, true, index, subindex, (void *)data, size);
+}
+
+static int ax_sdo_read(void *state, uint16_t index, uint8_t subindex, void *data, int size) {
+    return ax_sdo(state, false, index, subindex, data, size);
+}
+
+const sim_model_t cia402_sim_model = {
+    .name = "cia402",
+    .slave_name = "SIM-CiA402 axis",
+    .vendor = 0x00004321,            /* Как у EM3E-556 (Leadshine) */
+    .product = 0x10000402,
+    .obytes = 10,
+    .ibytes = 10,
+    .state_size = sizeof(ax_t),
+    .init = ax_init,
+    .cycle = ax_cycle_pv,
+    .sdo_write = ax_sdo_write,
+    .sdo_read = ax_sdo_read,
+};
+
+/* Та же ось с раскладкой pdo-layout torque: + 0x6071 / 0x6077 */
+const sim_model_t cia402_cst_sim_model = {
+    .name = "cia402-cst",
+    .slave_name = "SIM-CiA402 axis CST",
+    .vendor = 0x00004321,
+    .product = 0x10000403,
+    .obytes = 12,
+    .ibytes = 12,
+    .state_size = sizeof(ax_t),
+    .init = ax_init,
+    .cycle = ax_cycle_cst,
+    .sdo_write = ax_sdo_write,
+    .sdo_read = ax_sdo_read,
+};
+
+/* Раскладки pdo-layout ... mode: + 0x6060 / 0x6061 последним байтом */
+const sim_model_t cia402_mode_sim_model = {
+    .name = "cia402-mode",
+    .slave_name = "SIM-CiA402 axis MODE",
+    .vendor = 0x00004321,
+    .product = 0x10000404,
+    .obytes = 11,
+    .ibytes = 11,
+    .state_size = sizeof(ax_t),
+    .init = ax_init,
+    .cycle = ax_cycle_pv_mode,
+    .sdo_write = ax_sdo_write,
+    .sdo_read = ax_sdo_read,
+};
+
+const sim_model_t cia402_cst_mode_sim_model = {
+    .name = "cia402-cst-mode",
+    .slave_name = "SIM-CiA402 axis CST MODE",
+    .vendor = 0x00004321,
+    .product = 0x10000405,
+    .obytes = 13,
+    .ibytes = 13,
+    .state_size = sizeof(ax_t),
+    .init = ax_init,
+    .cycle = ax_cycle_cst_mode,
+    .sdo_write = ax_sdo_write,
+    .sdo_read = ax_sdo_read,
+};
+
+bool cia402_sim_active(void) {
+    const sim_model_t *m = sim_bus_model();
+    return m == &cia402_sim_model || m == &cia402_cst_sim_model ||
+           m == &cia402_mode_sim_model || m == &cia402_cst_mode_sim_model;
+}
+
+static ax_t *ax_get(uint16_t slave) {
+    if (!cia402_sim_active()) {
+        return NULL;
+    }
+    return sim_bus_slave_state(slave);
+}
+
+bool cia402_sim_info(uint16_t slave, cia402_sim_info_t *info) {
+    ax_t *ax = ax_get(slave);
+    if (!ax) {
+        return false;
+    }
+
+    info->state = ax_state_names[ax->state];
+    info->mode = ax->mode;
+    info->statusword = ax->statusword;
+    info->error_code = ax->error_code;
+    info->position = ax->pos;
+    info->velocity = ax->vel;
+    info->torque = ax->torque;
+    info->lag_us = ax->lag_us;
+    info->transitions = ax->transitions;
+    return true;
+}
+
+bool cia402_sim_inject_fault(uint16_t slave, uint16_t code) {
+    ax_t *ax = ax_get(slave);
+    if (!ax) {
+        return false;
+    }
+    ax->pending_fault = code ? code : CIA402_SIM_FAULT_EXTERNAL;
+    return true;
+}
+
+bool cia402_sim_set_lag(uint16_t slave, uint32_t lag_us) {
+    ax_t *ax = ax_get(slave);
+    if (!ax) {
+        return false;
+    }
+    ax->lag_us = lag_us;
+    return true;
+}
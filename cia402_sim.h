@@ -0,0 +1,90 @@
+/*
+ * cia402_sim.h - Модель привода CiA 402 для симулированной шины
+ *
+ * Процессные данные совпадают с PDO EM3E-556 (motor_em3e_556_*_t):
+ *   выходы: 0x6040 Controlword, 0x607A Target Position, 0x60FF Target Velocity
+ *   входы:  0x6041 Statusword, 0x6064 Position Actual, 0x606C Velocity Actual
+ * Модель "cia402-cst" - раскладка pdo-layout torque: дополнительно выход
+ * 0x6071 Target Torque и вход 0x6077 Torque Actual (по 2 байта).
+ * Модели "cia402-mode" и "cia402-cst-mode" - раскладки pdo-layout ... mode:
+ * последним байтом выход 0x6060 и вход 0x6061; режим берется из кадра в
+ * том же цикле.
+ *
+ * Машина состояний отвечает на биты Controlword переходами Statusword по
+ * CiA 402 (включая Quick Stop и Fault Reaction). Режимы 0x6060: PP, PV,
+ * HM, CSP, CSV, CST. Динамика: скорость - апериодическое звено с постоянной
+ * времени lag и ограничением ускорения, позиция - интеграл скорости.
+ * В CST lag - у момента, ускорение пропорционально моменту.
+ * Скорость в об/мин, позиция в отсчетах (CIA402_SIM_COUNTS_PER_REV),
+ * 0x6064 переполняется как int32. 0x608F и 0x60A9 сообщают разрешение и
+ * единицу скорости.
+ *
+ * Параметры через SDO: 0x6083/0x6084/0x6085 ускорения (об/мин/с), 0x6081
+ * скорость профиля, 0x6065/0x6066 окно и время ошибки слежения, 0x6072
+ * предел момента, 0x2F00:01 lag (мкс), 0x2F00:02 запись кода ошибки -
+ * ввод отказа. Homing: 0x6098 метод, 0x6099:01/02 скорости поиска и
+ * подхода, 0x609A ускорение, 0x607C положение после homing; датчик нуля
+ * оси стоит на -CIA402_SIM_HOME_SWITCH x (1 + slave % 4) отсчетов.
+ */
+
+#ifndef CIA402_SIM_H
+#define CIA402_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim_bus.h"
+
+#define CIA402_SIM_COUNTS_PER_REV   4000
+#define CIA402_SIM_DEFAULT_LAG_US   5000
+#define CIA402_SIM_DEFAULT_ACCEL    3000     /* об/мин/с */
+#define CIA402_SIM_DEFAULT_VELOCITY 600      /* об/мин, скорость профиля PP/HM */
+#define CIA402_SIM_DEFAULT_FOLLOW   4000     /* Окно ошибки слежения, отсчеты */
+#define CIA402_SIM_DEFAULT_FOLLOW_MS 10
+#define CIA402_SIM_DEFAULT_MAX_TORQUE 3000   /* 0.1%: 300% номинального */
+#define CIA402_SIM_TORQUE_ACCEL     30.0     /* об/мин/с на 0.1% момента */
+#define CIA402_SIM_DAMPING          0.5      /* Вязкое трение, 1/с */
+#define CIA402_SIM_FAULT_EXTERNAL   0x5000   /* Код ввода отказа по умолчанию */
+#define CIA402_SIM_FAULT_FOLLOWING  0x8611
+#define CIA402_SIM_HOME_SWITCH      2000     /* Шаг положения датчиков нуля, отсчеты */
+#define CIA402_SIM_HOME_BACKOFF     200      /* Метка за датчиком, отсчеты */
+#define CIA402_SIM_HOME_RANGE       400000   /* Поиск дальше - ошибка homing */
+
+/* Объекты модели */
+#define CIA402_SIM_OBJ_CONFIG       0x2F00
+#define CIA402_SIM_SUB_LAG          1
+#define CIA402_SIM_SUB_FAULT        2
+
+extern const sim_model_t cia402_sim_model;
+extern const sim_model_t cia402_cst_sim_model;
+extern const sim_model_t cia402_mode_sim_model;
+extern const sim_model_t cia402_cst_mode_sim_model;
+
+/**
+ * Шина создана с одной из моделей cia402
+ */
+bool cia402_sim_active(void);
+
+/* Снимок оси для вывода */
+typedef struct {
+    const char *state;
+    int8_t mode;
+    uint16_t statusword;
+    uint16_t error_code;
+    double position;             /* Отсчеты */
+    double velocity;             /* об/мин */
+    double torque;               /* 0.1% */
+    uint32_t lag_us;
+    uint32_t transitions;        /* Переходов машины состояний */
+} cia402_sim_info_t;
+
+bool cia402_sim_info(uint16_t slave, cia402_sim_info_t *info);
+
+/**
+ * Ввод отказа (code 0 - CIA402_SIM_FAULT_EXTERNAL)
+ */
+bool cia402_sim_inject_fault(uint16_t slave, uint16_t code);
+
+bool cia402_sim_set_lag(uint16_t slave, uint32_t lag_us);
+
+#endif /* CIA402_SIM_H */
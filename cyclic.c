@@ -0,0 +1,441 @@
+/*
+ * cyclic.c - Циклический real-time поток обмена
+ */
+
+#define _GNU_SOURCE  /* CPU_SET, pthread_attr_setaffinity_np */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cyclic.h"
+#include "alloc_track.h"
+#include "timebase.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+static cyclic_config_t cyclic_cfg;
+static cyclic_stats_t cyclic_stats;
+static bool cyclic_has_stats = false;
+
+/* ============================================================================
+ * Виртуальное время: циклы выполняются в вызывающем потоке без ожидания
+ * ============================================================================ */
+
+static bool cyclic_virtual_on = false;
+static int64_t cyclic_virtual_next;       /* Дедлайн следующего цикла, нс */
+
+static bool cyclic_virtual_start(const cyclic_config_t *cfg) {
+    if (!timebase_virtual()) {
+        printf("ERROR: Virtual-time cycles need the simulated bus (--sim ... --virtual-time)\n");
+        return false;
+    }
+
+    cyclic_cfg = *cfg;
+    memset(&cyclic_stats, 0, sizeof(cyclic_stats));
+    cyclic_stats.period_us = cfg->period_us;
+    cyclic_stats.cpu = -1;
+    cyclic_stats.virtual_time = true;
+    rt_hist_reset(&cyclic_stats.wake);
+    sched_report_reset(&cyclic_stats.sched, SCHED_MONITOR_DEFAULT_EVERY);
+
+    cyclic_virtual_next = timebase_now_ns() + (int64_t)cfg->period_us * 1000;
+    cyclic_virtual_on = true;
+    cyclic_has_stats = true;
+    return true;
+}
+
+/**
+ * Один цикл: часы переводятся на его дедлайн, время обмена - по часам хоста
+ */
+static bool cyclic_virtual_step(void) {
+    timebase_virtual_set(cyclic_virtual_next);
+    cyclic_virtual_next += (int64_t)cyclic_cfg.period_us * 1000;
+
+    uint64_t t0 = timebase_ticks();
+    bool ok = cyclic_cfg.exchange(cyclic_cfg.arg);
+    int64_t exec_ns = (int64_t)timebase_ticks_to_ns(timebase_ticks() - t0);
+
+    cyclic_stats.cycles++;
+    cyclic_stats.last_ok = ok;
+    if (!ok) cyclic_stats.errors++;
+    if (exec_ns > cyclic_stats.exec_max_ns) cyclic_stats.exec_max_ns = exec_ns;
+    cyclic_stats.exec_sum_ns += (double)exec_ns;
+    return ok;
+}
+
+bool cyclic_advance(int64_t ns) {
+    if (!cyclic_virtual_on) {
+        return false;
+    }
+
+    int64_t target = timebase_now_ns() + ns;
+    while (cyclic_virtual_on && cyclic_virtual_next <= target) {
+        cyclic_virtual_step();
+    }
+    timebase_virtual_set(target);
+    return true;
+}
+
+#ifndef _WIN32
+
+static uint32_t cyclic_seq;               /* seqlock: нечетный - идет запись */
+static uint64_t cyclic_done;              /* Завершенные циклы (для cyclic_wait_cycle) */
+static volatile bool cyclic_run = false;
+static bool cyclic_thread_started = false;
+static pthread_t cyclic_thread;
+
+static int64_t cyclic_ts_ns(const struct timespec *ts) {
+    return (int64_t)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static void cyclic_ts_add_ns(struct timespec *ts, int64_t ns) {
+    ts->tv_nsec += ns;
+    while (ts->tv_nsec >= 1000000000L) {
+        ts->tv_nsec -= 1000000000L;
+        ts->tv_sec++;
+    }
+}
+
+/* Метки цикла через timebase: та же шкала CLOCK_MONOTONIC, без системного вызова */
+static int64_t cyclic_now_ns(void) {
+    return timebase_now_ns();
+}
+
+static void cyclic_write_begin(void) {
+    __atomic_store_n(&cyclic_seq, cyclic_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void cyclic_write_end(void) {
+    __atomic_store_n(&cyclic_seq, cyclic_seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Предварительное касание стека, чтобы page faults случились до цикла
+ */
+static void cyclic_prefault_stack(void) {
+    volatile uint8_t stack[64 * 1024];
+    memset((uint8_t *)stack, 0, sizeof(stack));
+}
+
+static void *cyclic_thread_fn(void *p) {
+    (void)p;
+    const int64_t period_ns = (int64_t)cyclic_cfg.period_us * 1000;
+    const uint64_t wait_threshold_ns = (uint64_t)period_ns / 10;
+    const uint32_t every = cyclic_stats.sched.every;
+    sched_monitor_t mon;
+    sched_sample_t delta;
+    struct timespec next;
+    uint32_t window_overruns = 0;
+
+    cyclic_prefault_stack();
+    bool mon_ok = sched_monitor_open(&mon);
+    if (mon_ok) {
+        sched_monitor_sample(&mon, &delta);
+    }
+
+    /* Инициализация закончена: дальше никаких выделений памяти */
+    alloc_track_forbid_thread("cyclic");
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (cyclic_run) {
+        cyclic_ts_add_ns(&next, period_ns);
+        int ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        if (ret != 0 && ret != EINTR) {
+            break;
+        }
+
+        int64_t t_deadline = cyclic_ts_ns(&next);
+        int64_t t_wake = cyclic_now_ns();
+        bool ok = cyclic_cfg.exchange(cyclic_cfg.arg);
+        int64_t t_end = cyclic_now_ns();
+
+        int64_t wake_ns = t_wake - t_deadline;
+        int64_t exec_ns = t_end - t_wake;
+        bool overrun = t_end > t_deadline + period_ns;
+        uint64_t skipped = 0;
+
+        /* После переполнения не догоняем пропущенные периоды пачкой */
+        if (overrun) {
+            window_overruns++;
+            while (cyclic_ts_ns(&next) + period_ns < t_end) {
+                cyclic_ts_add_ns(&next, period_ns);
+                skipped++;
+            }
+        }
+
+        /* Чтение /proc - до секции записи: читатели не ждут системного вызова */
+        bool sampled = false;
+        if (mon_ok && (cyclic_stats.cycles + 1) % every == 0) {
+            sampled = sched_monitor_sample(&mon, &delta);
+        }
+
+        cyclic_write_begin();
+        cyclic_stats.cycles++;
+        cyclic_stats.last_ok = ok;
+        if (!ok) cyclic_stats.errors++;
+        if (overrun) {
+            cyclic_stats.overruns++;
+            if (wake_ns > exec_ns) {
+                cyclic_stats.overrun_wake++;
+            } else {
+                cyclic_stats.overrun_exec++;
+            }
+            cyclic_stats.skipped += skipped;
+        }
+        if (exec_ns > cyclic_stats.exec_max_ns) cyclic_stats.exec_max_ns = exec_ns;
+        cyclic_stats.exec_sum_ns += (double)exec_ns;
+        rt_hist_add(&cyclic_stats.wake, wake_ns);
+        if (mon_ok && cyclic_stats.cycles % every == 0) {
+            if (sampled) {
+                sched_report_add(&cyclic_stats.sched, &delta, window_overruns, wait_threshold_ns);
+            }
+            window_overruns = 0;
+        }
+        cyclic_write_end();
+
+        __atomic_add_fetch(&cyclic_done, 1, __ATOMIC_RELEASE);
+
+        /* Вне измеряемого участка; между пересчетами - одно чтение тиков */
+        timebase_maintain();
+    }
+
+    alloc_track_allow_thread();
+    if (mon_ok) {
+        sched_monitor_close(&mon);
+    }
+    return NULL;
+}
+
+bool cyclic_start(const cyclic_config_t *cfg) {
+    pthread_attr_t attr;
+    struct sched_param param;
+    cpu_set_t set;
+
+    if (cyclic_running()) {
+        printf("ERROR: Cyclic thread already running\n");
+        return false;
+    }
+    if (!cfg->exchange || cfg->period_us < CYCLIC_MIN_PERIOD_US || cfg->period_us > CYCLIC_MAX_PERIOD_US) {
+        printf("ERROR: Invalid cycle period %u us (must be %d-%d)\n",
+               cfg->period_us, CYCLIC_MIN_PERIOD_US, CYCLIC_MAX_PERIOD_US);
+        return false;
+    }
+    if (cfg->virtual_time) {
+        return cyclic_virtual_start(cfg);
+    }
+    if (cfg->cpu >= (int)sysconf(_SC_NPROCESSORS_ONLN)) {
+        printf("ERROR: CPU %d is not online (%ld CPU(s) available)\n",
+               cfg->cpu, sysconf(_SC_NPROCESSORS_ONLN));
+        return false;
+    }
+
+    cyclic_cfg = *cfg;
+    if (cyclic_cfg.priority <= 0) {
+        cyclic_cfg.priority = CYCLIC_DEFAULT_PRIORITY;
+    }
+
+    memset(&cyclic_stats, 0, sizeof(cyclic_stats));
+    cyclic_stats.period_us = cfg->period_us;
+    cyclic_stats.cpu = cfg->cpu;
+    rt_hist_reset(&cyclic_stats.wake);
+    sched_report_reset(&cyclic_stats.sched,
+                       cfg->monitor_every ? cfg->monitor_every : SCHED_MONITOR_DEFAULT_EVERY);
+
+    cyclic_stats.mem_locked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+    if (!cyclic_stats.mem_locked) {
+        printf("WARNING: mlockall() failed: %s (page faults possible in the cycle)\n", strerror(errno));
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    param.sched_priority = cyclic_cfg.priority;
+    pthread_attr_setschedparam(&attr, &param);
+    if (cfg->cpu >= 0) {
+        CPU_ZERO(&set);
+        CPU_SET(cfg->cpu, &set);
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    }
+
+    cyclic_run = true;
+    cyclic_stats.rt_sched = true;
+    if (pthread_create(&cyclic_thread, &attr, cyclic_thread_fn, NULL) != 0) {
+        /* Нет прав на SCHED_FIFO: работаем с обычным приоритетом */
+        cyclic_stats.rt_sched = false;
+        pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+        if (pthread_create(&cyclic_thread, &attr, cyclic_thread_fn, NULL) != 0) {
+            pthread_attr_destroy(&attr);
+            cyclic_run = false;
+            printf("ERROR: Failed to start cyclic thread\n");
+            return false;
+        }
+        printf("WARNING: No SCHED_FIFO permission, cyclic thread runs with normal priority\n");
+    }
+    pthread_attr_destroy(&attr);
+
+    cyclic_thread_started = true;
+    cyclic_has_stats = true;
+    return true;
+}
+
+void cyclic_stop(void) {
+    cyclic_virtual_on = false;
+    if (!cyclic_thread_started) {
+        return;
+    }
+    cyclic_run = false;
+    pthread_join(cyclic_thread, NULL);
+    cyclic_thread_started = false;
+    if (cyclic_stats.mem_locked) {
+        munlockall();
+    }
+}
+
+bool cyclic_running(void) {
+    return cyclic_thread_started || cyclic_virtual_on;
+}
+
+bool cyclic_wait_cycle(uint32_t timeout_ms) {
+    if (cyclic_virtual_on) {
+        return cyclic_virtual_step();
+    }
+
+    uint64_t start = __atomic_load_n(&cyclic_done, __ATOMIC_ACQUIRE);
+    int64_t deadline = cyclic_now_ns() + (int64_t)timeout_ms * 1000000LL;
+
+    while (cyclic_thread_started && cyclic_now_ns() < deadline) {
+        if (__atomic_load_n(&cyclic_done, __ATOMIC_ACQUIRE) != start) {
+            return __atomic_load_n(&cyclic_stats.last_ok, __ATOMIC_RELAXED);
+        }
+        usleep(50);
+    }
+    return false;
+}
+
+bool cyclic_get_stats(cyclic_stats_t *out) {
+    uint32_t s1, s2;
+
+    if (!cyclic_has_stats) {
+        return false;
+    }
+    do {
+        s1 = __atomic_load_n(&cyclic_seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) {
+            continue;
+        }
+        memcpy(out, &cyclic_stats, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        s2 = __atomic_load_n(&cyclic_seq, __ATOMIC_RELAXED);
+    } while ((s1 & 1) || s1 != s2);
+    return true;
+}
+
+#else /* _WIN32 */
+
+bool cyclic_start(const cyclic_config_t *cfg) {
+    if (cyclic_virtual_on) {
+        printf("ERROR: Cyclic thread already running\n");
+        return false;
+    }
+    if (cfg->virtual_time && cfg->exchange && cfg->period_us >= CYCLIC_MIN_PERIOD_US &&
+        cfg->period_us <= CYCLIC_MAX_PERIOD_US) {
+        return cyclic_virtual_start(cfg);
+    }
+    printf("ERROR: Cyclic real-time thread is only available on Linux\n");
+    return false;
+}
+
+void cyclic_stop(void) {
+    cyclic_virtual_on = false;
+}
+
+bool cyclic_running(void) {
+    return cyclic_virtual_on;
+}
+
+bool cyclic_wait_cycle(uint32_t timeout_ms) {
+    (void)timeout_ms;
+    return cyclic_virtual_on && cyclic_virtual_step();
+}
+
+bool cyclic_get_stats(cyclic_stats_t *out) {
+    if (!cyclic_has_stats) {
+        return false;
+    }
+    memcpy(out, &cyclic_stats, sizeof(*out));
+    return true;
+}
+
+#endif /* _WIN32 */
+
+void cyclic_print_stats(const cyclic_stats_t *stats) {
+    static cyclic_stats_t snap;
+
+    if (stats == NULL) {
+        if (!cyclic_get_stats(&snap)) {
+            printf("Cyclic thread has not been started\n");
+            return;
+        }
+        stats = &snap;
+    }
+    const cyclic_stats_t *s = stats;
+
+    if (s->virtual_time) {
+        double sim_s = (double)s->cycles * s->period_us / 1e6;
+        printf("Period:            %u us (virtual time)\n", s->period_us);
+        printf("Cycles:            %llu (errors %llu, last %s), %.3f s simulated\n",
+               (unsigned long long)s->cycles, (unsigned long long)s->errors,
+               s->last_ok ? "OK" : "FAILED", sim_s);
+        if (s->cycles > 0) {
+            printf("Exchange time:     avg %.1f us, max %.1f us (host CPU)\n",
+                   s->exec_sum_ns / s->cycles / 1000.0, s->exec_max_ns / 1000.0);
+            printf("Speed-up:          %.0fx real time (exchange only)\n",
+                   s->exec_sum_ns > 0 ? sim_s * 1e9 / s->exec_sum_ns : 0.0);
+        }
+        return;
+    }
+
+    char cpu[16];
+    if (s->cpu < 0) {
+        snprintf(cpu, sizeof(cpu), "any");
+    } else {
+        snprintf(cpu, sizeof(cpu), "%d", s->cpu);
+    }
+    printf("Period:            %u us (CPU %s, %s, memory %s)\n", s->period_us, cpu,
+           s->rt_sched ? "SCHED_FIFO" : "SCHED_OTHER", s->mem_locked ? "locked" : "NOT locked");
+    printf("Cycles:            %llu (errors %llu, last %s)\n", (unsigned long long)s->cycles,
+           (unsigned long long)s->errors, s->last_ok ? "OK" : "FAILED");
+    printf("Overruns:          %llu (late wake-up %llu, long exchange %llu, skipped periods %llu)\n",
+           (unsigned long long)s->overruns, (unsigned long long)s->overrun_wake,
+           (unsigned long long)s->overrun_exec, (unsigned long long)s->skipped);
+    if (s->cycles > 0) {
+        printf("Exchange time:     avg %.1f us, max %.1f us\n",
+               s->exec_sum_ns / s->cycles / 1000.0, s->exec_max_ns / 1000.0);
+    }
+    printf("Wake-up latency:\n");
+    rt_hist_print(&s->wake);
+    printf("Scheduling interference:\n");
+    sched_report_print(&s->sched);
+
+    if (s->overruns == 0) {
+        return;
+    }
+    /* Источник переполнений: хост (планировщик/таймер) или шина (долгий обмен) */
+    if (s->sched.host_windows * 2 > s->sched.overrun_windows) {
+        printf("Verdict:           overruns coincide with host scheduling interference\n");
+    } else if (s->overrun_wake > s->overrun_exec) {
+        printf("Verdict:           late wake-ups without thread preemption - timer/IRQ/SMI or\n");
+        printf("                   hypervisor latency on the host (see list-adapters --rt-check)\n");
+    } else {
+        printf("Verdict:           exchange exceeded the period - bus/NIC side (frame loss, RTT)\n");
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * cyclic.h - Циклический real-time поток обмена
+ *
+ * Поток с SCHED_FIFO, привязкой к ядру (--rt-cpu) и заблокированной
+ * памятью просыпается по абсолютному времени (clock_nanosleep TIMER_ABSTIME)
+ * и вызывает функцию обмена. Учитываются задержка пробуждения, время обмена,
+ * переполнения цикла и помехи планировщика (sched_monitor).
+ *
+ * Статистика публикуется через seqlock: поток не берет мьютексов,
+ * читатель копирует согласованный снимок.
+ *
+ * В виртуальном времени (симулированная шина) потока нет: циклы
+ * выполняются в вызывающем потоке из cyclic_wait_cycle() и cyclic_advance(),
+ * каждый переводит часы timebase на свой дедлайн. Программа движения
+ * проходит с той же последовательностью циклов, что и в реальном времени,
+ * но так быстро, как позволяет CPU.
+ */
+
+#ifndef CYCLIC_H
+#define CYCLIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rt_check.h"
+#include "sched_monitor.h"
+
+#define CYCLIC_DEFAULT_PRIORITY 80
+#define CYCLIC_MIN_PERIOD_US    100
+#define CYCLIC_MAX_PERIOD_US    1000000
+
+/**
+ * Функция обмена одного цикла
+ * @return false при ошибке обмена (WKC, нет кадра)
+ */
+typedef bool (*cyclic_exchange_fn)(void *arg);
+
+typedef struct {
+    uint32_t period_us;
+    int cpu;                   /* -1 - без привязки */
+    int priority;              /* SCHED_FIFO приоритет */
+    uint32_t monitor_every;    /* Циклов в окне sched_monitor (0 - по умолчанию) */
+    cyclic_exchange_fn exchange;
+    void *arg;
+    bool virtual_time;         /* Циклы в виртуальном времени (timebase_set_virtual) */
+} cyclic_config_t;
+
+typedef struct {
+    uint32_t period_us;
+    int cpu;
+    bool rt_sched;             /* Удалось получить SCHED_FIFO */
+    bool mem_locked;           /* mlockall() успешен */
+    bool virtual_time;
+    bool last_ok;              /* Результат последнего обмена */
+    uint64_t cycles;
+    uint64_t errors;           /* Обмен вернул false */
+    uint64_t overruns;         /* Цикл закончился позже начала следующего */
+    uint64_t overrun_wake;     /* ... из них из-за позднего пробуждения */
+    uint64_t overrun_exec;     /* ... из-за долгого обмена */
+    uint64_t skipped;          /* Пропущенные периоды после переполнений */
+    int64_t exec_max_ns;
+    double exec_sum_ns;
+    rt_hist_t wake;            /* Задержка пробуждения */
+    sched_report_t sched;
+} cyclic_stats_t;
+
+/**
+ * Запуск потока. Повторный запуск без cyclic_stop() - ошибка.
+ */
+bool cyclic_start(const cyclic_config_t *cfg);
+
+/**
+ * Остановка потока и ожидание его завершения (статистика сохраняется)
+ */
+void cyclic_stop(void);
+
+bool cyclic_running(void);
+
+/**
+ * Ожидание завершения следующего цикла
+ *
+ * @return результат обмена этого цикла; false также по таймауту
+ */
+bool cyclic_wait_cycle(uint32_t timeout_ms);
+
+/**
+ * Продвинуть виртуальное время на ns, выполнив все циклы с дедлайнами
+ * в этом интервале
+ *
+ * @return false если циклы идут не в виртуальном времени
+ */
+bool cyclic_advance(int64_t ns);
+
+/**
+ * Согласованный снимок статистики
+ * @return false если поток ни разу не запускался
+ */
+bool cyclic_get_stats(cyclic_stats_t *out);
+
+/**
+ * Отчет по статистике; stats - уже снятый снимок, NULL - снять
+ */
+void cyclic_print_stats(const cyclic_stats_t *stats);
+
+#endif /* CYCLIC_H */
@@ -0,0 +1,598 @@
+/*
+ * diag_history.c - Чтение истории диагностики ETG.1020 (объект 0x10F3)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "diag_history.h"
+#include "mem_arena.h"
+#include "timebase.h"
+
+#define DIAG_SUB_MAX_MESSAGES    1
+#define DIAG_SUB_NEWEST          2
+#define DIAG_SUB_NEWEST_ACK      3
+#define DIAG_MESSAGE_HEADER_LEN  16       /* Code, Flags, TextID, TimeStamp */
+#define DIAG_SLEEP_STEP_MS       50
+
+/* Состояние опроса одного slave */
+typedef struct {
+    bool supported;
+    uint8_t max_messages;
+    uint8_t last_seen;            /* Последний прочитанный subindex, 0 - еще не читали */
+} diag_slave_t;
+
+static ecx_contextt *diag_ctx = NULL;
+static diag_slave_t diag_slaves[EC_MAXSLAVE];
+
+/* Журнал линии: список в порядке добавления, блоки из пула */
+#define DIAG_EVENT_BLOCK ((sizeof(diag_event_t) + MEM_ARENA_ALIGN - 1) / MEM_ARENA_ALIGN * MEM_ARENA_ALIGN)
+static uint8_t diag_pool_buf[DIAG_LOG_CAPACITY * DIAG_EVENT_BLOCK];
+static mem_pool_t diag_pool;
+static diag_event_t *diag_head = NULL;
+static diag_event_t *diag_tail = NULL;
+static diag_stats_t diag_stats;
+static uint32_t diag_seq = 0;
+
+/* Пачка одного прохода, сортируется до добавления в журнал */
+static diag_event_t diag_batch[DIAG_LOG_CAPACITY];
+
+static volatile bool diag_run = false;
+static bool diag_thread_started = false;
+static int diag_interval_ms = DIAG_POLL_DEFAULT_MS;
+
+#ifdef _WIN32
+static CRITICAL_SECTION diag_lock;
+static bool diag_lock_ready = false;
+static volatile LONG diag_polling = 0;
+static HANDLE diag_thread;
+#else
+static pthread_mutex_t diag_lock = PTHREAD_MUTEX_INITIALIZER;
+static int diag_polling = 0;
+static pthread_t diag_thread;
+#endif
+
+/* ============================================================================
+ * Синхронизация
+ * ============================================================================ */
+
+static void diag_lock_enter(void) {
+#ifdef _WIN32
+    EnterCriticalSection(&diag_lock);
+#else
+    pthread_mutex_lock(&diag_lock);
+#endif
+}
+
+static void diag_lock_leave(void) {
+#ifdef _WIN32
+    LeaveCriticalSection(&diag_lock);
+#else
+    pthread_mutex_unlock(&diag_lock);
+#endif
+}
+
+/**
+ * Опрос slaves (SDO) выполняет только один поток; журнал при этом не блокируется
+ */
+static bool diag_poll_begin(void) {
+#ifdef _WIN32
+    return InterlockedExchange(&diag_polling, 1) == 0;
+#else
+    return __atomic_exchange_n(&diag_polling, 1, __ATOMIC_ACQUIRE) == 0;
+#endif
+}
+
+static void diag_poll_end(void) {
+#ifdef _WIN32
+    InterlockedExchange(&diag_polling, 0);
+#else
+    __atomic_store_n(&diag_polling, 0, __ATOMIC_RELEASE);
+#endif
+}
+
+/* ============================================================================
+ * Разбор сообщения
+ * ============================================================================ */
+
+static uint16_t diag_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t diag_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t diag_le64(const uint8_t *p) {
+    return (uint64_t)diag_le32(p) | ((uint64_t)diag_le32(p + 4) << 32);
+}
+
+/**
+ * Размер параметра базового типа CoE, 0 - тип не поддерживается
+ */
+static size_t diag_type_size(uint16_t type) {
+    switch (type) {
+        case 0x0001: case 0x0002: case 0x0005: return 1;   /* BOOL, INT8, UINT8 */
+        case 0x0003: case 0x0006:              return 2;   /* INT16, UINT16 */
+        case 0x0004: case 0x0007: case 0x0008: return 4;   /* INT32, UINT32, REAL32 */
+        case 0x0011: case 0x0015: case 0x001B: return 8;   /* REAL64, INT64, UINT64 */
+        default:                               return 0;
+    }
+}
+
+static void diag_append(char *text, size_t *pos, const char *fmt_value) {
+    size_t len = strlen(fmt_value);
+    if (*pos > 0 && *pos + 2 < DIAG_TEXT_LEN) {
+        text[(*pos)++] = ',';
+        text[(*pos)++] = ' ';
+    }
+    for (size_t i = 0; i < len && *pos + 1 < DIAG_TEXT_LEN; i++) {
+        text[(*pos)++] = fmt_value[i];
+    }
+    text[*pos] = '\0';
+}
+
+/**
+ * Параметры сообщения в текст: числа, байтовые массивы и строки
+ */
+static void diag_decode_params(const uint8_t *p, size_t len, int count, char *text) {
+    size_t pos = 0;
+    char value[DIAG_TEXT_LEN];
+
+    text[0] = '\0';
+    for (int n = 0; n < count && len >= 2; n++) {
+        uint16_t pflags = diag_le16(p);
+        uint16_t kind = pflags >> 12;
+        uint16_t arg = pflags & 0x0FFF;
+        size_t size;
+        p += 2;
+        len -= 2;
+
+        if (kind == 0) {
+            size = diag_type_size(arg);
+            if (size == 0 || size > len) {
+                break;
+            }
+            switch (arg) {
+                case 0x0002: snprintf(value, sizeof(value), "%d", (int8_t)p[0]); break;
+                case 0x0003: snprintf(value, sizeof(value), "%d", (int16_t)diag_le16(p)); break;
+                case 0x0004: snprintf(value, sizeof(value), "%d", (int32_t)diag_le32(p)); break;
+                case 0x0015: snprintf(value, sizeof(value), "%lld", (long long)diag_le64(p)); break;
+                case 0x0008: {
+                    float f;
+                    uint32_t raw = diag_le32(p);
+                    memcpy(&f, &raw, sizeof(f));
+                    snprintf(value, sizeof(value), "%g", f);
+                    break;
+                }
+                case 0x0011: {
+                    double d;
+                    uint64_t raw = diag_le64(p);
+                    memcpy(&d, &raw, sizeof(d));
+                    snprintf(value, sizeof(value), "%g", d);
+                    break;
+                }
+                case 0x001B:
+                    snprintf(value, sizeof(value), "%llu", (unsigned long long)diag_le64(p));
+                    break;
+                default:
+                    snprintf(value, sizeof(value), "%u",
+                             size == 1 ? p[0] : size == 2 ? diag_le16(p) : diag_le32(p));
+                    break;
+            }
+        } else if (kind == 1 || kind == 2) {
+            /* 1 - массив байт, 2 - ASCII строка */
+            size = arg;
+            if (size > len) {
+                break;
+            }
+            size_t v = 0;
+            if (kind == 2) {
+                value[v++] = '"';
+                for (size_t i = 0; i < size && p[i] && v + 2 < sizeof(value); i++) {
+                    value[v++] = (p[i] >= 0x20 && p[i] < 0x7F) ? (char)p[i] : '?';
+                }
+                value[v++] = '"';
+                value[v] = '\0';
+            } else {
+                for (size_t i = 0; i < size && v + 3 < sizeof(value); i++) {
+                    v += (size_t)snprintf(value + v, sizeof(value) - v, "%02X", p[i]);
+                }
+                value[v] = '\0';
+            }
+        } else {
+            /* Unicode строки и ссылки на тексты без ESI не разбираем */
+            break;
+        }
+
+        diag_append(text, &pos, value);
+        p += size;
+        len -= size;
+    }
+}
+
+static bool diag_decode(const uint8_t *msg, size_t len, diag_event_t *e) {
+    if (len < DIAG_MESSAGE_HEADER_LEN) {
+        return false;
+    }
+
+    uint16_t flags = diag_le16(msg + 4);
+    e->code = diag_le32(msg);
+    e->severity = (uint8_t)(flags & 0x0F);
+    e->text_id = diag_le16(msg + 6);
+    e->timestamp_ns = diag_le64(msg + 8);
+    diag_decode_params(msg + DIAG_MESSAGE_HEADER_LEN, len - DIAG_MESSAGE_HEADER_LEN,
+                       flags >> 8, e->text);
+    return true;
+}
+
+/* ============================================================================
+ * Опрос
+ * ============================================================================ */
+
+static bool diag_read_u8(uint16_t slave, uint8_t sub, uint8_t *value) {
+    int size = sizeof(*value);
+    return ecx_SDOread(diag_ctx, slave, DIAG_HISTORY_INDEX, sub, FALSE, &size, value,
+                       DIAG_SDO_TIMEOUT_US) > 0;
+}
+
+static uint8_t diag_next_sub(const diag_slave_t *st, uint8_t sub) {
+    return sub + 1 >= DIAG_FIRST_MESSAGE_SUB + st->max_messages ? DIAG_FIRST_MESSAGE_SUB : sub + 1;
+}
+
+/**
+ * Новые сообщения одного slave в пачку
+ *
+ * @return новое количество записей в пачке
+ */
+static int diag_poll_slave(uint16_t slave, diag_slave_t *st, int n, uint32_t *errors) {
+    uint8_t last_sub = DIAG_FIRST_MESSAGE_SUB + st->max_messages - 1;
+    uint8_t newest;
+    uint8_t start;
+    bool whole_ring = false;
+
+    if (!diag_read_u8(slave, DIAG_SUB_NEWEST, &newest)) {
+        (*errors)++;
+        return n;
+    }
+    if (newest < DIAG_FIRST_MESSAGE_SUB || newest > last_sub || newest == st->last_seen) {
+        return n;
+    }
+
+    if (st->last_seen == 0) {
+        uint8_t ack = 0;
+        diag_read_u8(slave, DIAG_SUB_NEWEST_ACK, &ack);
+        if (ack == newest) {
+            st->last_seen = newest;
+            return n;
+        }
+        if (ack >= DIAG_FIRST_MESSAGE_SUB && ack <= last_sub) {
+            start = diag_next_sub(st, ack);
+        } else {
+            /* Подтвержденных нет: все кольцо, начиная с самого старого */
+            start = diag_next_sub(st, newest);
+            whole_ring = true;
+        }
+    } else {
+        start = diag_next_sub(st, st->last_seen);
+    }
+
+    uint8_t sub = start;
+    uint8_t done = st->last_seen;
+    for (int i = 0; i < st->max_messages && n < DIAG_LOG_CAPACITY; i++) {
+        uint8_t msg[DIAG_MESSAGE_MAX_LEN];
+        int size = sizeof(msg);
+
+        if (ecx_SDOread(diag_ctx, slave, DIAG_HISTORY_INDEX, sub, FALSE, &size, msg,
+                        DIAG_SDO_TIMEOUT_US) > 0) {
+            diag_event_t *e = &diag_batch[n];
+            memset(e, 0, sizeof(*e));
+            if (diag_decode(msg, (size_t)size, e)) {
+                e->slave = slave;
+                e->subindex = sub;
+                n++;
+            }
+        } else if (!whole_ring) {
+            /* В незаполненном кольце пустые subindex - не ошибка */
+            (*errors)++;
+        }
+        done = sub;
+        if (sub == newest) {
+            break;
+        }
+        sub = diag_next_sub(st, sub);
+    }
+
+    /* Пачка заполнилась раньше newest - остаток дочитаем следующим опросом */
+    st->last_seen = done;
+    return n;
+}
+
+static int diag_compare_time(const void *a, const void *b) {
+    const diag_event_t *ea = a;
+    const diag_event_t *eb = b;
+    if (ea->timestamp_ns != eb->timestamp_ns) {
+        return ea->timestamp_ns < eb->timestamp_ns ? -1 : 1;
+    }
+    return ea->slave - eb->slave;
+}
+
+/**
+ * Добавление пачки в журнал, самые старые записи вытесняются
+ */
+static void diag_log_append(int n) {
+    diag_lock_enter();
+    for (int i = 0; i < n; i++) {
+        if (diag_pool.free_count == 0 && diag_head) {
+            diag_event_t *old = diag_head;
+            diag_head = old->next;
+            if (!diag_head) {
+                diag_tail = NULL;
+            }
+            mem_pool_free(&diag_pool, old);
+            diag_stats.dropped++;
+        }
+
+        diag_event_t *e = mem_pool_alloc(&diag_pool);
+        if (!e) {
+            break;
+        }
+        *e = diag_batch[i];
+        e->seq = ++diag_seq;
+        e->next = NULL;
+        if (diag_tail) {
+            diag_tail->next = e;
+        } else {
+            diag_head = e;
+        }
+        diag_tail = e;
+        diag_stats.events++;
+    }
+    diag_lock_leave();
+}
+
+int diag_history_init(ecx_contextt *ctx) {
+    diag_history_stop();
+
+#ifdef _WIN32
+    if (!diag_lock_ready) {
+        InitializeCriticalSection(&diag_lock);
+        diag_lock_ready = true;
+    }
+#endif
+
+    diag_lock_enter();
+    diag_ctx = ctx;
+    memset(diag_slaves, 0, sizeof(diag_slaves));
+    mem_pool_init(&diag_pool, "diag-log", diag_pool_buf, sizeof(diag_pool_buf), sizeof(diag_event_t));
+    diag_head = NULL;
+    diag_tail = NULL;
+    diag_seq = 0;
+    memset(&diag_stats, 0, sizeof(diag_stats));
+    diag_lock_leave();
+
+    int supported = 0;
+    for (int i = 1; i <= ctx->slavecount && i < EC_MAXSLAVE; i++) {
+        ec_slavet *s = &ctx->slavelist[i];
+        uint16_t state = s->state & 0x0F;
+        uint8_t max_messages = 0;
+
+        if (!(s->mbx_proto & ECT_MBXPROT_COE) || state == EC_STATE_NONE ||
+            state == EC_STATE_INIT || state == EC_STATE_BOOT) {
+            continue;
+        }
+        if (diag_read_u8((uint16_t)i, DIAG_SUB_MAX_MESSAGES, &max_messages) && max_messages > 0) {
+            diag_slaves[i].supported = true;
+            diag_slaves[i].max_messages = max_messages;
+            supported++;
+        }
+    }
+
+    /* Abort коды slaves без 0x10F3 не относятся к ошибкам линии */
+    while (ecx_iserror(ctx)) {
+        ecx_elist2string(ctx);
+    }
+
+    diag_lock_enter();
+    diag_stats.supported = supported;
+    diag_lock_leave();
+    return supported;
+}
+
+int diag_history_poll(void) {
+    if (!diag_ctx || !diag_poll_begin()) {
+        return 0;
+    }
+
+    int64_t t0 = timebase_now_ns();
+    uint32_t errors = 0;
+    int n = 0;
+
+    for (int i = 1; i <= diag_ctx->slavecount && i < EC_MAXSLAVE; i++) {
+        if (diag_slaves[i].supported) {
+            n = diag_poll_slave((uint16_t)i, &diag_slaves[i], n, &errors);
+        }
+    }
+
+    /* DC время общее для линии: пачка разных slaves сводится по нему */
+    qsort(diag_batch, (size_t)n, sizeof(diag_batch[0]), diag_compare_time);
+    diag_log_append(n);
+
+    diag_lock_enter();
+    diag_stats.polls++;
+    diag_stats.sdo_errors += errors;
+    diag_stats.last_poll_us = (uint32_t)((timebase_now_ns() - t0) / 1000);
+    diag_lock_leave();
+
+    diag_poll_end();
+    return n;
+}
+
+int diag_history_ack(void) {
+    if (!diag_ctx || !diag_poll_begin()) {
+        return 0;
+    }
+
+    int acked = 0;
+    for (int i = 1; i <= diag_ctx->slavecount && i < EC_MAXSLAVE; i++) {
+        diag_slave_t *st = &diag_slaves[i];
+        if (!st->supported || st->last_seen == 0) {
+            continue;
+        }
+        if (ecx_SDOwrite(diag_ctx, (uint16_t)i, DIAG_HISTORY_INDEX, DIAG_SUB_NEWEST_ACK, FALSE,
+                         sizeof(st->last_seen), &st->last_seen, DIAG_SDO_TIMEOUT_US) > 0) {
+            acked++;
+        }
+    }
+
+    diag_poll_end();
+    return acked;
+}
+
+/* ============================================================================
+ * Фоновый опрос
+ * ============================================================================ */
+
+#ifdef _WIN32
+static DWORD WINAPI diag_thread_fn(LPVOID p) {
+#else
+static void *diag_thread_fn(void *p) {
+#endif
+    (void)p;
+    while (diag_run) {
+        diag_history_poll();
+        for (int waited = 0; diag_run && waited < diag_interval_ms; waited += DIAG_SLEEP_STEP_MS) {
+            osal_usleep(DIAG_SLEEP_STEP_MS * 1000);
+        }
+    }
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+bool diag_history_start(int interval_ms) {
+    if (diag_thread_started || !diag_ctx) {
+        return false;
+    }
+
+    diag_interval_ms = interval_ms;
+    diag_run = true;
+#ifdef _WIN32
+    diag_thread = CreateThread(NULL, 0, diag_thread_fn, NULL, 0, NULL);
+    if (diag_thread == NULL) {
+        diag_run = false;
+        return false;
+    }
+#else
+    if (pthread_create(&diag_thread, NULL, diag_thread_fn, NULL) != 0) {
+        diag_run = false;
+        return false;
+    }
+#endif
+    diag_thread_started = true;
+    return true;
+}
+
+void diag_history_stop(void) {
+    if (!diag_thread_started) {
+        return;
+    }
+
+    diag_run = false;
+#ifdef _WIN32
+    WaitForSingleObject(diag_thread, INFINITE);
+    CloseHandle(diag_thread);
+#else
+    pthread_join(diag_thread, NULL);
+#endif
+    diag_thread_started = false;
+}
+
+bool diag_history_running(void) {
+    return diag_thread_started;
+}
+
+/* ============================================================================
+ * Вывод
+ * ============================================================================ */
+
+void diag_history_get_stats(diag_stats_t *stats) {
+    if (!diag_ctx) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    diag_lock_enter();
+    *stats = diag_stats;
+    diag_lock_leave();
+}
+
+static const char *diag_severity_name(uint8_t severity) {
+    switch (severity) {
+        case DIAG_SEVERITY_INFO:    return "INFO";
+        case DIAG_SEVERITY_WARNING: return "WARN";
+        case DIAG_SEVERITY_ERROR:   return "ERROR";
+        default:                    return "?";
+    }
+}
+
+void diag_history_print(int max_events, uint16_t slave) {
+    if (!diag_ctx) {
+        printf("Diagnosis history not initialized\n");
+        return;
+    }
+
+    diag_lock_enter();
+
+    int total = 0;
+    for (diag_event_t *e = diag_head; e; e = e->next) {
+        if (slave == 0 || e->slave == slave) total++;
+    }
+
+    printf("\n=== Diagnosis History (%d slave(s) with 0x10F3) ===\n", diag_stats.supported);
+    printf("Polls: %u, messages: %u, dropped from log: %u, SDO errors: %u, last poll: %.1f ms\n\n",
+           diag_stats.polls, diag_stats.events, diag_stats.dropped, diag_stats.sdo_errors,
+           diag_stats.last_poll_us / 1000.0);
+
+    if (total == 0) {
+        printf("No diagnosis messages%s\n\n", slave ? " for this slave" : "");
+        diag_lock_leave();
+        return;
+    }
+
+    printf("%-6s %-20s %-5s %-5s %-10s %-6s %s\n",
+           "Seq", "DC Time [s]", "Slave", "Type", "Code", "TextID", "Parameters");
+    printf("--------------------------------------------------------------------------\n");
+
+    int skip = total > max_events ? total - max_events : 0;
+    for (diag_event_t *e = diag_head; e; e = e->next) {
+        if (slave != 0 && e->slave != slave) {
+            continue;
+        }
+        if (skip > 0) {
+            skip--;
+            continue;
+        }
+
+        char ts[24] = "-";
+        if (e->timestamp_ns) {
+            snprintf(ts, sizeof(ts), "%llu.%06llu",
+                     (unsigned long long)(e->timestamp_ns / 1000000000ULL),
+                     (unsigned long long)(e->timestamp_ns % 1000000000ULL / 1000ULL));
+        }
+        printf("%-6u %-20s %-5u %-5s 0x%08X 0x%04X %s\n",
+               e->seq, ts, e->slave, diag_severity_name(e->severity),
+               e->code, e->text_id, e->text);
+    }
+    printf("\n");
+
+    diag_lock_leave();
+}
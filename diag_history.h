@@ -0,0 +1,101 @@
+/*
+ * diag_history.h - Чтение истории диагностики ETG.1020 (объект 0x10F3)
+ *
+ * 0x10F3:02 (Newest Message) - subindex последнего записанного сообщения,
+ * сообщения лежат в кольце 0x10F3:06..(5 + Maximum Messages). Для каждого
+ * slave запоминается последний прочитанный subindex, и на следующем опросе
+ * загружаются только сообщения после него. При первом опросе чтение
+ * начинается после 0x10F3:03 (Newest Acknowledged Message), а если
+ * подтвержденных нет - со всего кольца.
+ *
+ * Сообщения всех slaves сводятся в общий журнал линии: пачка каждого
+ * прохода сортируется по DC времени сообщений. Журнал хранится в пуле
+ * фиксированных блоков; при переполнении вытесняются самые старые записи.
+ * Опрос может идти в фоновом потоке (diag_history_start).
+ *
+ * Текст по TextID хранится в ESI устройства и здесь недоступен:
+ * журнал содержит код, TextID и расшифрованные параметры сообщения.
+ */
+
+#ifndef DIAG_HISTORY_H
+#define DIAG_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "soem/soem.h"
+
+#define DIAG_HISTORY_INDEX       0x10F3
+#define DIAG_FIRST_MESSAGE_SUB   6
+#define DIAG_MESSAGE_MAX_LEN     256      /* Байт на одно сообщение */
+#define DIAG_TEXT_LEN            96
+#define DIAG_LOG_CAPACITY        256      /* Записей в журнале линии */
+#define DIAG_SDO_TIMEOUT_US      200000
+#define DIAG_POLL_DEFAULT_MS     1000
+#define DIAG_PRINT_DEFAULT       50
+
+typedef enum {
+    DIAG_SEVERITY_INFO = 0,
+    DIAG_SEVERITY_WARNING = 1,
+    DIAG_SEVERITY_ERROR = 2
+} diag_severity_t;
+
+/* Одно сообщение в журнале линии */
+typedef struct diag_event {
+    struct diag_event *next;
+    uint32_t seq;                 /* Номер в журнале (сквозной) */
+    uint16_t slave;
+    uint8_t subindex;
+    uint8_t severity;             /* diag_severity_t */
+    uint32_t code;                /* Diag Code */
+    uint16_t text_id;
+    uint64_t timestamp_ns;        /* DC время сообщения */
+    char text[DIAG_TEXT_LEN];     /* Расшифрованные параметры */
+} diag_event_t;
+
+/* Счетчики журнала */
+typedef struct {
+    int supported;                /* Slaves с объектом 0x10F3 */
+    uint32_t polls;
+    uint32_t events;              /* Всего прочитано сообщений */
+    uint32_t dropped;             /* Вытеснено из журнала */
+    uint32_t sdo_errors;
+    uint32_t last_poll_us;
+} diag_stats_t;
+
+/**
+ * Поиск slaves с 0x10F3 и сброс журнала
+ *
+ * @return количество slaves с историей диагностики
+ */
+int diag_history_init(ecx_contextt *ctx);
+
+/**
+ * Один проход по всем slaves с историей
+ *
+ * @return количество новых сообщений
+ */
+int diag_history_poll(void);
+
+/**
+ * Фоновый опрос с периодом interval_ms
+ */
+bool diag_history_start(int interval_ms);
+void diag_history_stop(void);
+bool diag_history_running(void);
+
+/**
+ * Подтверждение всех прочитанных сообщений (запись 0x10F3:03)
+ *
+ * @return количество slaves, принявших подтверждение
+ */
+int diag_history_ack(void);
+
+void diag_history_get_stats(diag_stats_t *stats);
+
+/**
+ * Последние max_events записей журнала (slave = 0 - все slaves)
+ */
+void diag_history_print(int max_events, uint16_t slave);
+
+#endif /* DIAG_HISTORY_H */
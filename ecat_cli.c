@@ -18,10 +18,12 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <stdarg.h>
+#include <signal.h>
 
 #ifdef _WIN32
 #include <winsock2.h>
 #else
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -29,6 +31,26 @@
 #endif
 
 #include "soem/soem.h"
+#include "ecat_probe.h"
+#include "nic_lowlat.h"
+#include "cyclic.h"
+#include "ecat_zerocopy.h"
+#include "mem_arena.h"
+#include "alloc_track.h"
+#include "timebase.h"
+#include "inventory.h"
+#include "diag_history.h"
+#include "latency_map.h"
+#include "wkc_diag.h"
+#include "freshness.h"
+#include "servo_loop.h"
+#include "tune.h"
+#include "supervise.h"
+#include "axis_units.h"
+#include "path_plan.h"
+#include "axis_group.h"
+#include "cia402_sim.h"
+#include "sim_bus.h"
 
 /* ============================================================================
  * Глобальные переменные для состояния SOEM
@@ -37,17 +59,31 @@
 #define MAX_IO_MAP_SIZE 4096
 #define MAX_COMMAND_LEN 256
 #define MAX_ARGS 32
+#define CYCLIC_WAIT_TIMEOUT_MS 1000
+#define CMD_ARENA_SIZE  4096
 
 static char IOmap[MAX_IO_MAP_SIZE];  /* Буфер для I/O mapping */
 static bool soem_initialized = false; /* Флаг инициализации SOEM */
 static bool verbose_mode = false;     /* Флаг verbose режима */
-static char interface_name[64] = "";  /* Имя сетевого интерфейса */
+static char interface_name[128] = ""; /* Имя сетевого интерфейса */
 static bool pdo_active = false;       /* Флаг активности PDO обмена */
 static volatile bool pdo_running = false; /* Флаг работы PDO цикла */
 
+static int rt_cpu = -1;                   /* Ядро для циклического потока (--rt-cpu) */
+static int plan_cpu = -1;                 /* Ядро планировщика траектории (--plan-cpu) */
+static nic_tune_state_t nic_tune_state;   /* Исходные настройки NIC для отката */
+static volatile sig_atomic_t nic_tune_stop = 0;  /* SIGINT/SIGTERM при примененных настройках */
+static ecat_zc_t pdo_zc;                  /* Кадры режима zero-copy (pdo-start zerocopy) */
+static inventory_t line_inventory;        /* Результат последней команды inventory */
+static bool diag_ready = false;           /* Поддержка 0x10F3 определена после scan */
+
 /* SOEM 2.0 context structure */
 static ecx_contextt ecx_context;
 
+/* Арена данных команды: сбрасывается перед каждой командой REPL */
+static uint8_t cmd_arena_buf[CMD_ARENA_SIZE];
+static mem_arena_t cmd_arena;
+
 /* ============================================================================
  * Утилиты для вывода и логирования
  * ============================================================================ */
@@ -103,6 +139,25 @@ static const char* state_to_string(uint16_t state) {
     }
 }
 
+/**
+ * Пауза команды. В виртуальном времени не ждет, а продвигает часы
+ * (и циклы движка, если он запущен) на ту же величину.
+ */
+static void soem_sleep_ms(uint32_t ms) {
+    if (timebase_virtual()) {
+        int64_t ns = (int64_t)ms * 1000000LL;
+        if (!cyclic_advance(ns)) {
+            timebase_virtual_set(timebase_now_ns() + ns);
+        }
+        return;
+    }
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
 /* ============================================================================
  * Функции работы с SOEM
  * ============================================================================ */
@@ -136,6 +191,280 @@ static bool soem_init(const char *ifname) {
     return true;
 }
 
+/**
+ * Симулированная шина вместо сетевого интерфейса
+ *
+ * @param spec "<count>[:<model>]", например "200:io"
+ */
+static bool soem_sim_init(const char *spec, bool virtual_time) {
+    char model[32] = SIM_BUS_DEFAULT_MODEL;
+    int count = atoi(spec);
+    const char *colon = strchr(spec, ':');
+
+    if (colon) {
+        strncpy(model, colon + 1, sizeof(model) - 1);
+        model[sizeof(model) - 1] = '\0';
+    }
+    if (!sim_bus_create(model, count)) {
+        printf("ERROR: Invalid simulated bus '%s' (count 1-%d, models:)\n", spec, EC_MAXSLAVE - 1);
+        sim_bus_print_models();
+        return false;
+    }
+
+    snprintf(interface_name, sizeof(interface_name), "sim: %s", sim_bus_describe());
+    soem_initialized = true;
+    if (virtual_time) {
+        timebase_set_virtual(true);
+    }
+    printf("Simulated bus: %s, %s time\n", sim_bus_describe(), virtual_time ? "virtual" : "real");
+    return true;
+}
+
+/**
+ * Автоматический выбор интерфейса: параллельный опрос всех поднятых
+ * интерфейсов и выбор того, на котором найдено больше всего slaves
+ *
+ * @param ifname   Буфер для имени выбранного интерфейса
+ * @param ifname_len Размер буфера
+ * @return true если EtherCAT найден
+ */
+static bool soem_auto_select_interface(char *ifname, size_t ifname_len) {
+    ecat_probe_result_t results[ECAT_PROBE_MAX_IFACES];
+
+    printf("Probing all interfaces for EtherCAT slaves...\n");
+    int count = ecat_probe_all(results, ECAT_PROBE_MAX_IFACES, ECAT_PROBE_DEFAULT_TIMEOUT_MS);
+    if (count < 0) {
+        printf("ERROR: Failed to enumerate network interfaces\n");
+        return false;
+    }
+
+    if (verbose_mode) {
+        ecat_probe_print(results, count, ECAT_PROBE_DEFAULT_TIMEOUT_MS);
+    }
+
+    int best = ecat_probe_select_best(results, count);
+    if (best < 0) {
+        printf("ERROR: No EtherCAT slaves found on any of %d interface(s)\n", count);
+        printf("  Run list-adapters --probe for details\n");
+        return false;
+    }
+
+    printf("Auto-selected interface: %s (%d slave(s), RTT %u us)\n",
+           results[best].name, results[best].slave_count, results[best].rtt_us);
+    strncpy(ifname, results[best].name, ifname_len - 1);
+    ifname[ifname_len - 1] = '\0';
+    return true;
+}
+
+/**
+ * Откат настроек NIC (atexit и сигналы завершения)
+ */
+static void nic_tune_cleanup(void) {
+    nic_tune_restore(&nic_tune_state);
+}
+
+/**
+ * Только флаг: откат (ioctl, printf) не async-signal-safe и выполняется
+ * из REPL при выходе через atexit. Повторный сигнал завершает процесс
+ * без отката.
+ */
+static void nic_tune_signal_handler(int sig) {
+    nic_tune_stop = 1;
+    signal(sig, SIG_DFL);
+}
+
+/**
+ * Применение low-latency настроек NIC с замером времени круга до и после
+ */
+static void soem_tune_nic(void) {
+    ecat_rtt_stats_t before, after;
+
+    if (!ecat_probe_rtt(&ecx_context.port, ECAT_RTT_DEFAULT_SAMPLES, &before)) {
+        printf("WARNING: No BRD replies on %s, round-trip cannot be compared\n", interface_name);
+    }
+
+    if (rt_cpu < 0) {
+        printf("NOTE: --rt-cpu not given, NIC IRQ affinity left unchanged\n");
+    }
+    if (!nic_tune_apply(interface_name, rt_cpu, &nic_tune_state)) {
+        return;
+    }
+
+    atexit(nic_tune_cleanup);
+#ifdef _WIN32
+    signal(SIGINT, nic_tune_signal_handler);
+    signal(SIGTERM, nic_tune_signal_handler);
+#else
+    /* Без SA_RESTART: сигнал прерывает ожидание ввода в fgets */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = nic_tune_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+#endif
+
+    ecat_probe_rtt(&ecx_context.port, ECAT_RTT_DEFAULT_SAMPLES, &after);
+
+    printf("\nBRD round-trip (%d frames):\n", ECAT_RTT_DEFAULT_SAMPLES);
+    ecat_rtt_print("before:", &before);
+    ecat_rtt_print("after:", &after);
+    if (before.replies > 0 && after.replies > 0) {
+        printf("  median %+d us, p99 %+d us\n",
+               (int)after.median_us - (int)before.median_us,
+               (int)after.p99_us - (int)before.p99_us);
+    }
+    printf("Original NIC settings will be restored on exit\n\n");
+}
+
+/* ============================================================================
+ * Раскладка PDO приводов (pdo-layout)
+ * ============================================================================ */
+
+typedef enum {
+    PDO_LAYOUT_STANDARD = 0,     /* 0x6040/0x607A/0x60FF -> 0x6041/0x6064/0x606C */
+    PDO_LAYOUT_TORQUE            /* + 0x6071 Target Torque -> + 0x6077 Torque Actual */
+} pdo_layout_t;
+
+static pdo_layout_t pdo_layout = PDO_LAYOUT_STANDARD;
+static bool pdo_layout_mode = false;     /* + 0x6060 Modes of Operation -> + 0x6061 Display */
+static bool pdo_mode_mapped[EC_MAXSLAVE]; /* Slave принял 0x6060/0x6061 (хук PO2SO или модель) */
+
+/* Записи PDO: индекс << 16 | подындекс << 8 | бит */
+static const uint32_t pdo_layout_rx[] = { 0x60400010, 0x607A0020, 0x60FF0020, 0x60710010 };
+static const uint32_t pdo_layout_tx[] = { 0x60410010, 0x60640020, 0x606C0020, 0x60770010 };
+#define PDO_LAYOUT_RX_MODE      0x60600008
+#define PDO_LAYOUT_TX_MODE      0x60610008
+
+/* Байт выходов/входов раскладок standard и torque (режим - следующим байтом) */
+#define PDO_LAYOUT_BYTES        10
+#define PDO_LAYOUT_TORQUE_BYTES 12
+
+/**
+ * Перезапись одного PDO и его назначения в SM (0x1C12/0x1C13)
+ */
+static bool pdo_layout_write(ecx_contextt *ctx, uint16 slave, uint16 assign, uint16 pdo,
+                             const uint32_t *entries, uint8_t count) {
+    uint8_t zero = 0;
+    uint8_t one = 1;
+
+    if (ecx_SDOwrite(ctx, slave, assign, 0, FALSE, sizeof(zero), &zero, EC_TIMEOUTRXM) <= 0 ||
+        ecx_SDOwrite(ctx, slave, pdo, 0, FALSE, sizeof(zero), &zero, EC_TIMEOUTRXM) <= 0) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (ecx_SDOwrite(ctx, slave, pdo, (uint8)(i + 1), FALSE, sizeof(entries[i]), &entries[i],
+                         EC_TIMEOUTRXM) <= 0) {
+            return false;
+        }
+    }
+    return ecx_SDOwrite(ctx, slave, pdo, 0, FALSE, sizeof(count), &count, EC_TIMEOUTRXM) > 0 &&
+           ecx_SDOwrite(ctx, slave, assign, 1, FALSE, sizeof(pdo), &pdo, EC_TIMEOUTRXM) > 0 &&
+           ecx_SDOwrite(ctx, slave, assign, 0, FALSE, sizeof(one), &one, EC_TIMEOUTRXM) > 0;
+}
+
+/**
+ * RxPDO 0x1600 и TxPDO 0x1A00: стандартные объекты, момент, байт режима
+ */
+static bool pdo_layout_apply(ecx_contextt *ctx, uint16 slave, bool torque, bool mode) {
+    uint32_t rx[5], tx[5];
+    uint8_t n = torque ? 4 : 3;
+
+    memcpy(rx, pdo_layout_rx, n * sizeof(rx[0]));
+    memcpy(tx, pdo_layout_tx, n * sizeof(tx[0]));
+    if (mode) {
+        rx[n] = PDO_LAYOUT_RX_MODE;
+        tx[n] = PDO_LAYOUT_TX_MODE;
+        n++;
+    }
+    return pdo_layout_write(ctx, slave, 0x1C12, 0x1600, rx, n) &&
+           pdo_layout_write(ctx, slave, 0x1C13, 0x1A00, tx, n);
+}
+
+/**
+ * Хук PRE-OP -> SAFE-OP: раскладка с моментом для приводов с CST и/или
+ * с 0x6060/0x6061
+ *
+ * SOEM вызывает его в ecx_config_map_group до чтения назначений PDO,
+ * поэтому размеры образа уже учитывают новые объекты. Привод, не
+ * принявший 0x6060 в PDO (объект не мапится), получает раскладку без
+ * него - режим у такого slave меняется по SDO.
+ */
+static int pdo_layout_po2so(ecx_contextt *ctx, uint16 slave) {
+    uint32_t modes = 0;
+    int size = sizeof(modes);
+    bool torque = pdo_layout == PDO_LAYOUT_TORQUE;
+
+    /* 0x6502 Supported Drive Modes: бит 9 - Cyclic Synchronous Torque */
+    if (torque && (ecx_SDOread(ctx, slave, 0x6502, 0, FALSE, &size, &modes, EC_TIMEOUTRXM) <= 0 ||
+                   !(modes & (1u << 9)))) {
+        torque = false;
+    }
+    if (!torque && !pdo_layout_mode) {
+        return 0;
+    }
+    if (pdo_layout_apply(ctx, slave, torque, pdo_layout_mode)) {
+        pdo_mode_mapped[slave] = pdo_layout_mode;
+        return 1;
+    }
+    if (pdo_layout_mode) {
+        printf("WARNING: Slave %u rejected 0x6060/0x6061 in PDO, its mode changes stay on SDO\n", slave);
+        if (pdo_layout_apply(ctx, slave, torque, false)) {
+            return 1;
+        }
+    }
+    if (torque) {
+        printf("WARNING: Slave %u rejected the torque PDO layout\n", slave);
+    }
+    /* Назначения могли остаться пустыми: стандартная раскладка */
+    pdo_layout_apply(ctx, slave, false, false);
+    return 0;
+}
+
+/**
+ * Байты 0x6060 (выходы) и 0x6061 (входы) slave - последние в раскладке
+ *
+ * @return false если режим не в PDO (раскладку с ним slave не принимал)
+ */
+static bool pdo_layout_mode_offsets(int slave_idx, uint16_t *out, uint16_t *in) {
+    const ec_slavet *s = &ecx_context.slavelist[slave_idx];
+
+    if (slave_idx < 1 || slave_idx >= EC_MAXSLAVE || !pdo_mode_mapped[slave_idx]) {
+        return false;
+    }
+    if ((s->Obytes != PDO_LAYOUT_BYTES + 1 && s->Obytes != PDO_LAYOUT_TORQUE_BYTES + 1) ||
+        s->Ibytes != s->Obytes || s->outputs == NULL || s->inputs == NULL) {
+        return false;
+    }
+    *out = (uint16_t)(s->Obytes - 1);
+    *in = (uint16_t)(s->Ibytes - 1);
+    return true;
+}
+
+/**
+ * Байт 0x6060 в выходах - текущий режим привода (0x6061 по SDO)
+ *
+ * Иначе первый кадр OPERATIONAL переписал бы режим, заданный до pdo-start.
+ */
+static void pdo_layout_mode_init(void) {
+    for (int i = 1; i <= ecx_context.slavecount; i++) {
+        uint16_t out, in;
+        int8_t mode = 0;
+        int size = sizeof(mode);
+        int wkc;
+
+        if (!pdo_layout_mode_offsets(i, &out, &in)) {
+            continue;
+        }
+        if (sim_bus_active()) {
+            wkc = sim_bus_sdo_read((uint16_t)i, 0x6061, 0, &mode, &size);
+        } else {
+            wkc = ecx_SDOread(&ecx_context, i, 0x6061, 0, FALSE, &size, &mode, EC_TIMEOUTRXM);
+        }
+        ecx_context.slavelist[i].outputs[out] = wkc > 0 ? (uint8_t)mode : 0;
+    }
+}
+
 /**
  * Сканирование EtherCAT шины и обнаружение устройств
  *
@@ -152,18 +481,44 @@ static void soem_scan_bus(void) {
 
     log_verbose("Starting bus scan...");
 
-    /* Конфигурирование сети */
-    int wkc = ecx_config_init(&ecx_context);
-    log_verbose("ecx_config_init returned: %d", wkc);
+    /* Фоновый опрос диагностики работает со старым списком slaves */
+    diag_history_stop();
+    diag_ready = false;
+    axis_units_clear();
+    memset(pdo_mode_mapped, 0, sizeof(pdo_mode_mapped));
+
+    if (sim_bus_active()) {
+        /* Симулированная шина: slavelist и раскладка IOmap без кадров */
+        if (sim_bus_scan(&ecx_context, (uint8_t *)IOmap, sizeof(IOmap)) < 0) {
+            printf("ERROR: Simulated process image exceeds IOmap (%d bytes)\n", MAX_IO_MAP_SIZE);
+            return;
+        }
+        /* Режим в PDO задает модель, а не pdo-layout */
+        bool mode = sim_bus_model() == &cia402_mode_sim_model ||
+                    sim_bus_model() == &cia402_cst_mode_sim_model;
+        for (int i = 1; i <= ecx_context.slavecount && i < EC_MAXSLAVE; i++) {
+            pdo_mode_mapped[i] = mode;
+        }
+    } else {
+        /* Конфигурирование сети */
+        int wkc = ecx_config_init(&ecx_context);
+        log_verbose("ecx_config_init returned: %d", wkc);
 
-    if (wkc <= 0) {
-        print_error("No slaves found on the bus");
-        return;
-    }
+        if (wkc <= 0) {
+            print_error("No slaves found on the bus");
+            return;
+        }
 
-    /* Mapping процесс данных */
-    ecx_config_map_group(&ecx_context, &IOmap, 0);
-    log_verbose("I/O mapping completed");
+        /* Раскладка с моментом / режимом пишется в PRE-OP, до чтения mapping */
+        for (int i = 1; i <= ecx_context.slavecount; i++) {
+            ecx_context.slavelist[i].PO2SOconfig =
+                pdo_layout == PDO_LAYOUT_TORQUE || pdo_layout_mode ? pdo_layout_po2so : NULL;
+        }
+
+        /* Mapping процесс данных */
+        ecx_config_map_group(&ecx_context, &IOmap, 0);
+        log_verbose("I/O mapping completed");
+    }
 
     /* Вывод информации об обнаруженных slaves */
     printf("\n=== EtherCAT Bus Scan Results ===\n");
@@ -221,7 +576,27 @@ static void soem_read_config(int slave_idx) {
     printf("Vendor ID:        0x%08X\n", slave->eep_man);
     printf("Product ID:       0x%08X\n", slave->eep_id);
     printf("Revision:         0x%08X\n", slave->eep_rev);
-    printf("Serial:           0x%08X\n", slave->eep_man); /* Note: eep_serial not available in structure */
+
+    /* Serial SOEM при сканировании не читает: SII 0x000E и 0x1018:04 */
+    inventory_entry_t id;
+    inventory_read_slave(&ecx_context, (uint16_t)slave_idx, &id);
+    if (id.sii_serial_ok) {
+        printf("Serial (SII):     %u\n", id.sii_serial);
+    } else {
+        printf("Serial (SII):     not programmed\n");
+    }
+    if (id.coe_serial_ok) {
+        printf("Serial (0x1018):  %u\n", id.coe_serial);
+    }
+    if (id.device_name[0]) {
+        printf("Device Name:      %s\n", id.device_name);
+    }
+    if (id.hw_version[0]) {
+        printf("HW Version:       %s\n", id.hw_version);
+    }
+    if (id.sw_version[0]) {
+        printf("SW Version:       %s\n", id.sw_version);
+    }
     printf("\n");
 
     printf("Station Address:  0x%04X\n", slave->configadr);
@@ -306,9 +681,9 @@ static void soem_read_data(int slave_idx, uint32_t addr, size_t len) {
         return;
     }
 
-    uint8_t *buffer = malloc(len);
+    uint8_t *buffer = mem_arena_alloc(&cmd_arena, len);
     if (!buffer) {
-        printf("ERROR: Memory allocation failed\n");
+        printf("ERROR: Command buffer exhausted (%zu bytes requested)\n", len);
         return;
     }
 
@@ -321,7 +696,6 @@ static void soem_read_data(int slave_idx, uint32_t addr, size_t len) {
 
     if (wkc <= 0) {
         print_error("Failed to read data");
-        free(buffer);
         return;
     }
 
@@ -330,8 +704,6 @@ static void soem_read_data(int slave_idx, uint32_t addr, size_t len) {
     printf("Data:\n");
     print_hex_dump(buffer, len);
     printf("\n");
-
-    free(buffer);
 }
 
 /**
@@ -385,7 +757,22 @@ static void soem_write_data(int slave_idx, uint32_t addr, const uint8_t *data, s
 static void soem_cleanup(void) {
     if (soem_initialized) {
         log_verbose("Cleaning up SOEM resources");
-        ecx_close(&ecx_context);
+        servo_loop_detach_all();
+        tune_abort();
+        path_plan_release();
+        axis_group_clear_all();
+        supervise_detach_all();
+        axis_units_unbind_all();
+        cyclic_stop();
+        diag_history_stop();
+        wkc_diag_disarm();
+        freshness_disable();
+        ecat_zc_release(&pdo_zc);
+        if (sim_bus_active()) {
+            sim_bus_destroy();
+        } else {
+            ecx_close(&ecx_context);
+        }
         soem_initialized = false;
         pdo_active = false;
         pdo_running = false;
@@ -408,6 +795,11 @@ static bool soem_request_state(uint16_t state, uint32_t timeout_ms) {
     const char *state_name = state_to_string(state);
     log_verbose("Requesting state %s for all slaves", state_name);
 
+    if (sim_bus_active()) {
+        sim_bus_set_state(&ecx_context, state);
+        return true;
+    }
+
     /* Запрос изменения состояния для всех slaves (0 = все) */
     ecx_context.slavelist[0].state = state;
     ecx_writestate(&ecx_context, 0);
@@ -465,6 +857,8 @@ static bool soem_start_pdo(void) {
         //return false;
     }
 
+    pdo_layout_mode_init();
+
     /* Переход в OPERATIONAL */
     if (!soem_request_state(EC_STATE_OPERATIONAL, 5000)) {
         print_error("Failed to reach OPERATIONAL state");
@@ -495,6 +889,21 @@ static void soem_stop_pdo(void) {
     log_verbose("Stopping PDO exchange...");
     pdo_running = false;
 
+    /* Циклический поток не должен обмениваться с шиной в INIT */
+    servo_loop_detach_all();
+    tune_abort();
+    path_plan_release();
+    axis_group_clear_all();
+    supervise_detach_all();
+    axis_units_unbind_all();
+    if (cyclic_running()) {
+        cyclic_stop();
+        printf("Cyclic thread stopped\n");
+    }
+    wkc_diag_disarm();
+    freshness_disable();
+    ecat_zc_release(&pdo_zc);
+
     /* Переход в INIT состояние */
     soem_request_state(EC_STATE_INIT, 5000);
 
@@ -502,8 +911,98 @@ static void soem_stop_pdo(void) {
     printf("✓ PDO exchange stopped\n");
 }
 
+/* WKC последнего обмена (пишется циклическим потоком, если он запущен) */
+static volatile int pdo_last_wkc = 0;
+
+static int soem_expected_wkc(void) {
+    return (ecx_context.grouplist[0].outputsWKC * 2) + ecx_context.grouplist[0].inputsWKC;
+}
+
+/**
+ * Один цикл обмена: send outputs, receive inputs, проверка WKC.
+ * Вызывается и из циклического потока, поэтому ничего не печатает.
+ */
+static bool soem_exchange_cycle(void *arg) {
+    (void)arg;
+    int wkc;
+
+    freshness_send();
+    if (sim_bus_active()) {
+        wkc = sim_bus_exchange(&ecx_context);
+    } else if (wkc_diag_investigating()) {
+        wkc = wkc_diag_exchange(EC_TIMEOUTRET);
+    } else if (pdo_zc.active) {
+        wkc = ecat_zc_exchange(&pdo_zc, EC_TIMEOUTRET);
+    } else {
+        ecx_send_processdata(&ecx_context);
+        wkc = ecx_receive_processdata(&ecx_context, EC_TIMEOUTRET);
+    }
+    pdo_last_wkc = wkc;
+    freshness_check(EC_TIMEOUTRET, wkc >= soem_expected_wkc());
+    wkc_diag_note(wkc, soem_expected_wkc());
+
+    /* Контуры мастера по свежим входам; без кадра момент остается прежним.
+     * Контроль осей последним и в каждом цикле: его реакция перекрывает Controlword */
+    bool ok = wkc >= soem_expected_wkc();
+    if (ok) {
+        axis_units_cycle();
+        servo_loop_cycle();
+        tune_cycle();
+        path_plan_cycle();
+        axis_group_cycle();
+    }
+    supervise_cycle(ok);
+    return ok;
+}
+
+/**
+ * Указатель на участок образа процесса: IOmap или буферы кадров zero-copy
+ *
+ * @return NULL если в режиме zero-copy участок пересекает границу кадров
+ */
+static uint8_t *soem_image_ptr(size_t offset, size_t len) {
+    if (pdo_zc.active) {
+        return ecat_zc_image_ptr(&pdo_zc, (uint32_t)offset, (uint32_t)len);
+    }
+    return (uint8_t *)&IOmap[offset];
+}
+
+/**
+ * Перевод образа процесса в буферы кадров (zero-copy)
+ */
+static bool soem_enable_zerocopy(void) {
+    if (pdo_zc.active) {
+        printf("Zero-copy mode already active\n");
+        return true;
+    }
+    if (wkc_diag_armed()) {
+        printf("ERROR: WKC diagnostics use the IOmap image, run 'wkc-diag off' first\n");
+        return false;
+    }
+    if (freshness_enabled()) {
+        printf("ERROR: Freshness counters point into the IOmap, run 'freshness off' first\n");
+        return false;
+    }
+    if (sim_bus_active()) {
+        printf("ERROR: Zero-copy frames need a real bus\n");
+        return false;
+    }
+    if (cyclic_running()) {
+        printf("ERROR: Stop the cyclic thread before switching to zero-copy\n");
+        return false;
+    }
+    if (!ecat_zc_setup(&pdo_zc, &ecx_context, 0)) {
+        printf("Continuing with IOmap copy mode\n");
+        return false;
+    }
+    printf("✓ Zero-copy mode: process image in %d pre-built frame(s)\n", pdo_zc.nsegments);
+    return true;
+}
+
 /**
  * Однократный обмен PDO данными (send outputs, receive inputs)
+ *
+ * Если запущен циклический поток, обмен выполняет он: ждем его следующий цикл.
  */
 static bool soem_exchange_pdo(void) {
     if (!pdo_active) {
@@ -511,19 +1010,20 @@ static bool soem_exchange_pdo(void) {
         return false;
     }
 
-    /* Отправка outputs и получение inputs */
-    ecx_send_processdata(&ecx_context);
-    int wkc = ecx_receive_processdata(&ecx_context, EC_TIMEOUTRET);
-
-    int expected_wkc = (ecx_context.grouplist[0].outputsWKC * 2) +
-                       ecx_context.grouplist[0].inputsWKC;
+    bool ok;
+    if (cyclic_running()) {
+        ok = cyclic_wait_cycle(CYCLIC_WAIT_TIMEOUT_MS);
+    } else {
+        ok = soem_exchange_cycle(NULL);
+    }
 
-    if (wkc < expected_wkc) {
-        log_verbose("WARNING: Working counter mismatch (got %d, expected %d)", wkc, expected_wkc);
+    if (!ok) {
+        log_verbose("WARNING: Working counter mismatch (got %d, expected %d)",
+                    pdo_last_wkc, soem_expected_wkc());
         return false;
     }
 
-    log_verbose("PDO exchange successful (WKC: %d)", wkc);
+    log_verbose("PDO exchange successful (WKC: %d)", pdo_last_wkc);
     return true;
 }
 
@@ -566,7 +1066,12 @@ static void soem_read_pdo_inputs(void) {
     }
 
     printf("\n=== Complete IOmap (Inputs) ===\n");
-    print_hex_dump((uint8_t*)IOmap, input_bytes);
+    uint8_t *image = soem_image_ptr(0, input_bytes);
+    if (image) {
+        print_hex_dump(image, input_bytes);
+    } else {
+        printf("(spans several zero-copy frames, see per-slave data above)\n");
+    }
     printf("\n");
 }
 
@@ -595,8 +1100,13 @@ static void soem_write_pdo_outputs(const uint8_t *data, size_t offset, size_t le
 
     log_verbose("Writing %zu bytes to output offset %zu", len, offset);
 
-    /* Записываем данные в IOmap */
-    memcpy(&IOmap[output_offset + offset], data, len);
+    /* Записываем данные в IOmap (в zero-copy режиме - прямо в TX кадр) */
+    uint8_t *dst = soem_image_ptr(output_offset + offset, len);
+    if (!dst) {
+        printf("ERROR: Write crosses a zero-copy frame boundary, split it\n");
+        return;
+    }
+    memcpy(dst, data, len);
 
     /* Выполняем обмен данными */
     if (!soem_exchange_pdo()) {
@@ -610,7 +1120,10 @@ static void soem_write_pdo_outputs(const uint8_t *data, size_t offset, size_t le
         print_hex_dump(data, len);
 
         printf("\n=== Complete IOmap (Outputs) ===\n");
-        print_hex_dump((uint8_t*)&IOmap[output_offset], output_bytes);
+        uint8_t *image = soem_image_ptr(output_offset, output_bytes);
+        if (image) {
+            print_hex_dump(image, output_bytes);
+        }
         printf("\n");
     }
 }
@@ -641,11 +1154,7 @@ static void soem_run_pdo_loop(int cycles, int interval_ms) {
             fflush(stdout);
         }
 
-#ifdef _WIN32
-        Sleep(interval_ms);
-#else
-        usleep(interval_ms * 1000);
-#endif
+        soem_sleep_ms(interval_ms);
     }
 
     printf("\n\n✓ PDO loop completed: %d cycles, %d errors\n", cycles, errors);
@@ -665,8 +1174,20 @@ static void cmd_help(void) {
     printf("  help              - Show this help message\n");
     printf("  scan              - Scan EtherCAT bus and list all slaves\n");
     printf("  read-config <idx> - Read configuration of slave at index <idx>\n");
+    printf("  inventory [csv|json] [file]\n");
+    printf("                    - Identity, serial numbers and versions of all slaves\n");
+    printf("  diag-history [idx] [count]\n");
+    printf("                    - Read new 0x10F3 diagnosis messages, show line event log\n");
+    printf("  diag-watch <ms>|stop\n");
+    printf("                    - Poll diagnosis history of all slaves in background\n");
+    printf("  diag-ack          - Acknowledge read diagnosis messages (0x10F3:03)\n");
+    printf("  latency-map [samples]\n");
+    printf("                    - Per-position ESC latency (median/tail) to find slow slaves\n");
     printf("  status            - Show current status and statistics\n");
     printf("  verbose [on|off]  - Enable/disable verbose mode\n");
+    printf("  mem-stats         - Show command arena usage and heap allocations per command\n");
+    printf("  wait <ms>         - Pause a script (instant in virtual time, cycles still run)\n");
+    printf("  timebase [iters]  - Show timestamp source and compare its cost to the OS clock\n");
     printf("  quit, exit        - Exit the program\n");
     printf("\n");
     printf("Direct Memory Access:\n");
@@ -682,7 +1203,9 @@ static void cmd_help(void) {
     printf("                      Example: text-write 1 0x1000 Hello World\n");
     printf("\n");
     printf("PDO Cyclic Data Exchange:\n");
-    printf("  pdo-start         - Start PDO exchange (transition to OPERATIONAL)\n");
+    printf("  pdo-start [zerocopy]\n");
+    printf("                    - Start PDO exchange (transition to OPERATIONAL)\n");
+    printf("                      zerocopy: outputs/inputs live in pre-built frame buffers\n");
     printf("  pdo-stop          - Stop PDO exchange (transition to INIT)\n");
     printf("  pdo-read          - Read PDO input data from all slaves\n");
     printf("  pdo-write <offset> <byte1> <byte2> ...\n");
@@ -691,18 +1214,74 @@ static void cmd_help(void) {
     printf("  pdo-loop <cycles> [interval_ms]\n");
     printf("                    - Run PDO exchange loop for testing\n");
     printf("                      Example: pdo-loop 1000 10\n");
+    printf("  cyclic-start <period_us> [priority] [sample_every]\n");
+    printf("                    - Run PDO exchange in a real-time thread (Linux, uses --rt-cpu)\n");
+    printf("                      Scheduler interference sampled every N cycles (default %d)\n",
+           SCHED_MONITOR_DEFAULT_EVERY);
+    printf("                      Example: cyclic-start 1000 80\n");
+    printf("  cyclic-stop       - Stop the real-time thread and print its statistics\n");
+    printf("  wkc-diag [on [window]|off]\n");
+    printf("                    - Find the slave behind a WKC mismatch: after a mismatch the\n");
+    printf("                      next <window> cycles (default %d) use per-slave datagrams\n",
+           WKC_DIAG_DEFAULT_WINDOW);
+    printf("                      Without arguments prints the report\n");
+    printf("  freshness [on [cycles]|off|counter <idx> <offset> [len]]\n");
+    printf("                    - Flag slaves whose inputs stay in the same SM buffer (or whose\n");
+    printf("                      input counter does not change) for <cycles> (default %d)\n",
+           FRESHNESS_DEFAULT_CYCLES);
     printf("\n");
     printf("Leadshine EM3E-556 Motor Control:\n");
-    printf("  motor-enable <idx>       - Enable motor drive at slave <idx>\n");
+    printf("  motor-enable <idx|all>   - Enable motor drive at slave <idx> (or every slave)\n");
     printf("  motor-disable <idx>      - Disable motor drive\n");
-    printf("  motor-run <idx> <rpm> <sec>\n");
-    printf("                           - Run motor for <sec> seconds at <rpm> RPM\n");
+    printf("  motor-run <idx> <vel> <sec>\n");
+    printf("                           - Run motor for <sec> seconds at <vel> (rpm or units/min)\n");
     printf("                             Example: motor-run 1 100 10\n");
-    printf("  motor-velocity <idx> <rpm>\n");
+    printf("  motor-velocity <idx> <vel>\n");
     printf("                           - Set motor velocity (+ forward, - reverse)\n");
     printf("                             Example: motor-velocity 1 200\n");
     printf("  motor-stop <idx>         - Emergency stop motor\n");
     printf("  motor-status <idx>       - Show motor status\n");
+    printf("  units [<idx|all> <name> <units_per_rev>|<idx|all> off]\n");
+    printf("                           - Axis units (e.g. mm 5.0 per motor rev): positions in\n");
+    printf("                             units, velocities in units/min; off: counts and rpm.\n");
+    printf("                             Positions unwrap to 64 bits; no args: table\n");
+    printf("  pdo-layout [standard|torque] [mode]\n");
+    printf("                           - Drive PDO layout for the next scan; torque adds\n");
+    printf("                             0x6071 Target Torque / 0x6077 Torque Actual (CST drives),\n");
+    printf("                             mode adds 0x6060/0x6061: mode changes in the cyclic frame\n");
+    printf("  servo [on <idx> [cpr]|off <idx>|gains <idx> <kp_pos> <kp_vel> <ki_vel> [kd_vel]|\n");
+    printf("         ff <idx> <kvff> <kaff>|limits <idx> <rpm> <torque>|move <idx> <pos> [vel]|reset]\n");
+    printf("                           - Position/velocity loops in the master (CST, up to %d\n",
+           SERVO_MAX_AXES);
+    printf("                             axes, runs in the cyclic thread); cpr defaults to 0x608F;\n");
+    printf("                             no args: report\n");
+    printf("  tune-step <idx> [vel] [ms]\n");
+    printf("                           - Velocity step from the cyclic thread (default %d rpm or\n",
+           TUNE_DEFAULT_STEP_VEL);
+    printf("                             units/min, %d ms): rise time, overshoot, settling\n",
+           TUNE_DEFAULT_STEP_MS);
+    printf("  tune-chirp <idx> <f0> <f1> [vel] [ms]\n");
+    printf("                           - Velocity sweep f0 -> f1 Hz: frequency response (FFT)\n");
+    printf("  tune-result [csv <path>] - Last tuning analysis or export of the record\n");
+    printf("  path [group <x> <y> [z]|limits <accel> <junction> [rapid]|gcode <words>|run <file>|\n");
+    printf("        wait|stop|off]\n");
+    printf("                           - Coordinated G0/G1/G2/G3 moves of a CSP axis group with\n");
+    printf("                             look-ahead (planner thread, --plan-cpu); no args: report\n");
+    printf("  group [<g> [add <idx|a-b|all>...|remove <idx>...|clear|enable|disable|\n");
+    printf("              velocity <v[,v...]>|move <pos[,pos...]> [vel]|stop [quick]|wait|\n");
+    printf("              home-params <method> <fast> <slow> [accel] [offset]|home [timeout_s]]]\n");
+    printf("                           - Axis groups (1-%d): a command is written to every member\n",
+           AXIS_GROUP_MAX);
+    printf("                             in the same cycle (PV velocity, PP move, HM homing runs\n");
+    printf("                             in the background); no args: report\n");
+    printf("  supervise [<idx|all> follow <counts>|velocity <vel>|position <min> <max>|position off|\n");
+    printf("             reaction <quickstop|halt|event>|reset|off]\n");
+    printf("                           - Per-axis following error, velocity and soft limits checked\n");
+    printf("                             every cycle (velocity in rpm or units/min, 0 disables\n");
+    printf("                             a check); no args: report\n");
+    printf("  sim-axis <idx|all> [lag <us>|fault [code]]\n");
+    printf("                           - Simulated axes (--sim N:cia402): show state, set\n");
+    printf("                             velocity lag or inject a fault\n");
     printf("\n");
 }
 
@@ -720,56 +1299,318 @@ static void cmd_read_config(int argc, char **argv) {
 }
 
 /**
- * Команда read
+ * Команда inventory
  */
-static void cmd_read(int argc, char **argv) {
-    if (argc < 4) {
-        printf("ERROR: Usage: read <slave_idx> <addr> <len>\n");
+static void cmd_inventory(int argc, char **argv) {
+    if (!soem_initialized || ecx_context.slavecount == 0) {
+        printf("ERROR: No slaves found. Run 'scan' first.\n");
         return;
     }
 
-    int slave_idx = atoi(argv[1]);
-    uint32_t addr = (uint32_t)strtoul(argv[2], NULL, 0);
-    size_t len = (size_t)strtoul(argv[3], NULL, 0);
+    const char *format = argc >= 2 ? argv[1] : NULL;
+    const char *path = argc >= 3 ? argv[2] : NULL;
+    if (format && strcmp(format, "csv") != 0 && strcmp(format, "json") != 0) {
+        printf("ERROR: Usage: inventory [csv|json] [file]\n");
+        return;
+    }
 
-    soem_read_data(slave_idx, addr, len);
+    if (!format || path) {
+        printf("Collecting identity of %d slaves (%d workers)...\n",
+               ecx_context.slavecount, INVENTORY_DEFAULT_WORKERS);
+    }
+    inventory_collect(&line_inventory, &ecx_context, INVENTORY_DEFAULT_WORKERS);
+
+    if (!format) {
+        inventory_print(&line_inventory);
+    } else {
+        inventory_export(&line_inventory, format, path);
+    }
 }
 
 /**
- * Команда write
+ * Определение slaves с историей диагностики (один раз после scan)
  */
-static void cmd_write(int argc, char **argv) {
-    if (argc < 4) {
-        printf("ERROR: Usage: write <slave_idx> <addr> <byte1> [byte2] ...\n");
+static bool diag_prepare(void) {
+    if (!soem_initialized || ecx_context.slavecount == 0) {
+        printf("ERROR: No slaves found. Run 'scan' first.\n");
+        return false;
+    }
+    if (!diag_ready) {
+        int supported = diag_history_init(&ecx_context);
+        printf("Diagnosis history (0x10F3) supported by %d of %d slave(s)\n",
+               supported, ecx_context.slavecount);
+        diag_ready = true;
+    }
+    return true;
+}
+
+/**
+ * Команда diag-history
+ */
+static void cmd_diag_history(int argc, char **argv) {
+    if (!diag_prepare()) {
         return;
     }
 
-    int slave_idx = atoi(argv[1]);
-    uint32_t addr = (uint32_t)strtoul(argv[2], NULL, 0);
-    size_t len = argc - 3;
+    int slave_idx = argc >= 2 ? atoi(argv[1]) : 0;
+    int count = argc >= 3 ? atoi(argv[2]) : DIAG_PRINT_DEFAULT;
+    if (slave_idx < 0 || slave_idx > ecx_context.slavecount) {
+        printf("ERROR: Invalid slave index %d (valid range: 0-%d, 0 = all)\n",
+               slave_idx, ecx_context.slavecount);
+        return;
+    }
+    if (count < 1 || count > DIAG_LOG_CAPACITY) {
+        printf("ERROR: Invalid count (must be 1-%d)\n", DIAG_LOG_CAPACITY);
+        return;
+    }
 
-    uint8_t *data = malloc(len);
-    if (!data) {
-        printf("ERROR: Memory allocation failed\n");
+    /* При фоновом опросе журнал уже актуален */
+    if (!diag_history_running()) {
+        int n = diag_history_poll();
+        printf("%d new message(s)\n", n);
+    }
+    diag_history_print(count, (uint16_t)slave_idx);
+}
+
+/**
+ * Команда diag-watch
+ */
+static void cmd_diag_watch(int argc, char **argv) {
+    if (argc < 2) {
+        printf("ERROR: Usage: diag-watch <interval_ms>|stop\n");
+        printf("Example: diag-watch 1000\n");
         return;
     }
 
-    for (size_t i = 0; i < len; i++) {
-        data[i] = (uint8_t)strtoul(argv[3 + i], NULL, 0);
+    if (strcmp(argv[1], "stop") == 0) {
+        if (!diag_history_running()) {
+            printf("Diagnosis watch is not running\n");
+            return;
+        }
+        diag_history_stop();
+        printf("Diagnosis watch stopped\n");
+        return;
     }
 
-    soem_write_data(slave_idx, addr, data, len);
-    free(data);
+    int interval_ms = atoi(argv[1]);
+    if (interval_ms < 100 || interval_ms > 60000) {
+        printf("ERROR: Invalid interval (must be 100-60000 ms)\n");
+        return;
+    }
+    if (!diag_prepare()) {
+        return;
+    }
+    if (diag_history_running()) {
+        printf("ERROR: Diagnosis watch already running. Use 'diag-watch stop' first.\n");
+        return;
+    }
+
+    if (diag_history_start(interval_ms)) {
+        printf("Diagnosis watch started: every %d ms, view with 'diag-history'\n", interval_ms);
+    } else {
+        printf("ERROR: Failed to start diagnosis watch thread\n");
+    }
 }
 
 /**
- * Конвертация UTF-8 в коды символов дисплея MT-08S2A-2KLW (кириллица)
- *
- * Дисплей MT-08S2A-2KLW использует специальную таблицу знакогенератора с поддержкой
- * кириллицы. Таблица преобразования (используется Страница 0 встроенного знакогенератора):
- *
- * ASCII (0x20-0x7F) - стандартные символы без изменений
- *
+ * Команда diag-ack
+ */
+static void cmd_diag_ack(void) {
+    if (!diag_prepare()) {
+        return;
+    }
+    int acked = diag_history_ack();
+    printf("Acknowledged diagnosis messages on %d slave(s)\n", acked);
+}
+
+/**
+ * Команда wkc-diag
+ */
+static void cmd_wkc_diag(int argc, char **argv) {
+    if (argc < 2) {
+        wkc_diag_print();
+        return;
+    }
+
+    if (strcmp(argv[1], "off") == 0) {
+        wkc_diag_disarm();
+        printf("WKC diagnostics off\n");
+        return;
+    }
+    if (strcmp(argv[1], "on") != 0) {
+        printf("ERROR: Usage: wkc-diag [on [window]|off]\n");
+        return;
+    }
+
+    if (!pdo_active) {
+        printf("ERROR: PDO exchange not active. Run 'pdo-start' first.\n");
+        return;
+    }
+    if (pdo_zc.active) {
+        printf("ERROR: WKC diagnostics need the IOmap image (restart with 'pdo-start' without zerocopy)\n");
+        return;
+    }
+
+    int window = argc >= 3 ? atoi(argv[2]) : WKC_DIAG_DEFAULT_WINDOW;
+    if (window < 1 || window > 100000) {
+        printf("ERROR: Invalid window (must be 1-100000 cycles)\n");
+        return;
+    }
+
+    /* Раскладка перестраивается, когда поток уже не внутри wkc_diag_exchange() */
+    wkc_diag_disarm();
+    if (cyclic_running()) {
+        cyclic_wait_cycle(CYCLIC_WAIT_TIMEOUT_MS);
+    }
+    if (!wkc_diag_arm(&ecx_context, 0, window)) {
+        printf("ERROR: Per-slave datagrams do not fit into %d frames\n", WKC_DIAG_MAX_FRAMES);
+        return;
+    }
+    printf("WKC diagnostics armed: expected WKC %d, window %d cycles\n",
+           soem_expected_wkc(), window);
+}
+
+/**
+ * Выключение контроля свежести: запрос исполняет циклический поток после
+ * своей проверки, FMMU освобождаются уже вне цикла
+ */
+static void soem_freshness_off(void) {
+    freshness_request_off();
+    if (cyclic_running()) {
+        cyclic_wait_cycle(CYCLIC_WAIT_TIMEOUT_MS);
+    }
+    freshness_disable();
+}
+
+/**
+ * Команда freshness
+ */
+static void cmd_freshness(int argc, char **argv) {
+    if (argc < 2) {
+        freshness_print();
+        return;
+    }
+
+    if (strcmp(argv[1], "off") == 0) {
+        soem_freshness_off();
+        printf("Input freshness check off\n");
+        return;
+    }
+
+    if (strcmp(argv[1], "counter") == 0) {
+        if (argc < 4) {
+            printf("ERROR: Usage: freshness counter <idx> <offset> [len]\n");
+            return;
+        }
+        int slave_idx = atoi(argv[2]);
+        int offset = (int)strtol(argv[3], NULL, 0);
+        int len = argc >= 5 ? atoi(argv[4]) : 1;
+        if (offset < 0 || offset > 0xFFFF || len < 0 || len > FRESHNESS_MAX_COUNTER ||
+            !freshness_set_counter(slave_idx, (uint16_t)offset, (uint8_t)len)) {
+            printf("ERROR: Invalid counter (len 0-%d, 0 removes it)\n", FRESHNESS_MAX_COUNTER);
+            return;
+        }
+        printf("Slave %d: %s, applied on next 'freshness on'\n", slave_idx,
+               len ? "input counter set" : "SM buffer status");
+        return;
+    }
+
+    if (strcmp(argv[1], "on") != 0) {
+        printf("ERROR: Usage: freshness [on [cycles]|off|counter <idx> <offset> [len]]\n");
+        return;
+    }
+    if (!pdo_active) {
+        printf("ERROR: PDO exchange not active. Run 'pdo-start' first.\n");
+        return;
+    }
+
+    int cycles = argc >= 3 ? atoi(argv[2]) : FRESHNESS_DEFAULT_CYCLES;
+    if (cycles < 2 || cycles > 1000000) {
+        printf("ERROR: Invalid cycle count (must be 2-1000000)\n");
+        return;
+    }
+    soem_freshness_off();
+    int monitored = freshness_enable(&ecx_context, 0, cycles, soem_image_ptr);
+    if (monitored <= 0) {
+        printf("ERROR: No slave inputs can be monitored\n");
+        return;
+    }
+    printf("Input freshness check on: %d slave(s), stale after %d cycles\n", monitored, cycles);
+}
+
+/**
+ * Команда latency-map
+ */
+static void cmd_latency_map(int argc, char **argv) {
+    if (!soem_initialized || ecx_context.slavecount == 0) {
+        printf("ERROR: No slaves found. Run 'scan' first.\n");
+        return;
+    }
+
+    int samples = argc >= 2 ? atoi(argv[1]) : LATENCY_MAP_DEFAULT_SAMPLES;
+    if (samples < 1 || samples > LATENCY_MAP_MAX_SAMPLES) {
+        printf("ERROR: Invalid sample count (must be 1-%d)\n", LATENCY_MAP_MAX_SAMPLES);
+        return;
+    }
+
+    printf("Measuring %d slave(s), %d samples...\n", ecx_context.slavecount, samples);
+    if (latency_map_run(&ecx_context, samples) < 0) {
+        printf("ERROR: Latency map failed\n");
+        return;
+    }
+    latency_map_print();
+}
+
+/**
+ * Команда read
+ */
+static void cmd_read(int argc, char **argv) {
+    if (argc < 4) {
+        printf("ERROR: Usage: read <slave_idx> <addr> <len>\n");
+        return;
+    }
+
+    int slave_idx = atoi(argv[1]);
+    uint32_t addr = (uint32_t)strtoul(argv[2], NULL, 0);
+    size_t len = (size_t)strtoul(argv[3], NULL, 0);
+
+    soem_read_data(slave_idx, addr, len);
+}
+
+/**
+ * Команда write
+ */
+static void cmd_write(int argc, char **argv) {
+    if (argc < 4) {
+        printf("ERROR: Usage: write <slave_idx> <addr> <byte1> [byte2] ...\n");
+        return;
+    }
+
+    int slave_idx = atoi(argv[1]);
+    uint32_t addr = (uint32_t)strtoul(argv[2], NULL, 0);
+    size_t len = argc - 3;
+
+    uint8_t *data = mem_arena_alloc(&cmd_arena, len);
+    if (!data) {
+        printf("ERROR: Command buffer exhausted (%zu bytes requested)\n", len);
+        return;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (uint8_t)strtoul(argv[3 + i], NULL, 0);
+    }
+
+    soem_write_data(slave_idx, addr, data, len);
+}
+
+/**
+ * Конвертация UTF-8 в коды символов дисплея MT-08S2A-2KLW (кириллица)
+ *
+ * Дисплей MT-08S2A-2KLW использует специальную таблицу знакогенератора с поддержкой
+ * кириллицы. Таблица преобразования (используется Страница 0 встроенного знакогенератора):
+ *
+ * ASCII (0x20-0x7F) - стандартные символы без изменений
+ *
  * Кириллица:
  *   Все буквы которые похожи в алфавите английском и кириллице - сэкономлены.
  *   т.е. А а, В, Д д, Е е, К, М, Н, О о, Р р, С с, Т, у - взяты из английского алфавита по стандартным адресам
@@ -849,9 +1690,9 @@ static void cmd_text_write(int argc, char **argv) {
         if (i < argc - 1) total_len++; /* Пробел между словами */
     }
 
-    char *text = malloc(total_len + 1);
+    char *text = mem_arena_alloc(&cmd_arena, total_len + 1);
     if (!text) {
-        printf("ERROR: Memory allocation failed\n");
+        printf("ERROR: Command buffer exhausted (%zu bytes requested)\n", total_len + 1);
         return;
     }
 
@@ -863,10 +1704,9 @@ static void cmd_text_write(int argc, char **argv) {
 
     size_t text_len = strlen(text);
     /* Выделяем буфер с запасом для конвертированных символов */
-    uint8_t *data = malloc(text_len + 1);
+    uint8_t *data = mem_arena_alloc(&cmd_arena, text_len + 1);
     if (!data) {
-        printf("ERROR: Memory allocation failed\n");
-        free(text);
+        printf("ERROR: Command buffer exhausted (%zu bytes requested)\n", text_len + 1);
         return;
     }
 
@@ -880,9 +1720,6 @@ static void cmd_text_write(int argc, char **argv) {
     // }
 
     soem_write_data(slave_idx, addr, text, text_len);
-
-    free(data);
-    free(text);
 }
 
 /**
@@ -912,6 +1749,9 @@ static void cmd_status(void) {
     printf("\n=== EtherCAT Status ===\n");
     printf("SOEM Initialized:  %s\n", soem_initialized ? "Yes" : "No");
     printf("Interface:         %s\n", interface_name[0] ? interface_name : "None");
+    if (timebase_virtual()) {
+        printf("Clock:             virtual, %.6f s\n", timebase_now_ns() / 1e9);
+    }
     printf("Verbose Mode:      %s\n", verbose_mode ? "ON" : "OFF");
     printf("PDO Active:        %s\n", pdo_active ? "Yes (OPERATIONAL)" : "No");
 
@@ -923,6 +1763,37 @@ static void cmd_status(void) {
         if (pdo_active) {
             printf("Input bytes:       %d\n", ecx_context.grouplist[0].Ibytes);
             printf("Output bytes:      %d\n", ecx_context.grouplist[0].Obytes);
+            if (pdo_zc.active) {
+                printf("PDO Mode:          zero-copy (%d frame(s))\n", pdo_zc.nsegments);
+            } else {
+                printf("PDO Mode:          IOmap copy\n");
+            }
+        }
+        printf("Cyclic Thread:     %s\n", cyclic_running() ? "Running" : "Stopped");
+        printf("Diag Watch:        %s\n", diag_history_running() ? "Running" : "Stopped");
+        printf("WKC Diagnostics:   %s\n", wkc_diag_investigating() ? "Investigating" :
+                                        wkc_diag_armed() ? "Armed" : "Off");
+        if (freshness_enabled()) {
+            int stale = 0;
+            freshness_stale_bitmap(&stale);
+            printf("Input Freshness:   %d stale slave(s)\n", stale);
+        } else {
+            printf("Input Freshness:   Off\n");
+        }
+        int grouped = 0;
+        for (int g = 1; g <= AXIS_GROUP_MAX; g++) {
+            grouped += axis_group_members(g, NULL);
+        }
+        if (grouped > 0) {
+            printf("Axis Groups:       %d axes\n", grouped);
+        } else {
+            printf("Axis Groups:       Off\n");
+        }
+        if (supervise_axes() > 0) {
+            printf("Axis Supervision:  %d axes, %llu trips\n", supervise_axes(),
+                   (unsigned long long)supervise_trips());
+        } else {
+            printf("Axis Supervision:  Off\n");
         }
         printf("\n");
 
@@ -946,13 +1817,30 @@ static void cmd_status(void) {
         printf("Slaves Count:      0\n");
         printf("\n");
     }
+
+    static cyclic_stats_t stats;
+    if (cyclic_get_stats(&stats)) {
+        printf("=== Cyclic Thread ===\n");
+        cyclic_print_stats(&stats);
+        printf("\n");
+    }
 }
 
 /**
  * Команда pdo-start
  */
-static void cmd_pdo_start(void) {
+static void cmd_pdo_start(int argc, char **argv) {
+    bool zerocopy = argc >= 2 && strcmp(argv[1], "zerocopy") == 0;
+
+    if (argc >= 2 && !zerocopy) {
+        printf("ERROR: Usage: pdo-start [zerocopy]\n");
+        return;
+    }
+
     if (soem_start_pdo()) {
+        if (zerocopy) {
+            soem_enable_zerocopy();
+        }
         printf("\n");
         cmd_status();
     }
@@ -985,9 +1873,9 @@ static void cmd_pdo_write(int argc, char **argv) {
     size_t offset = (size_t)strtoul(argv[1], NULL, 0);
     size_t len = argc - 2;
 
-    uint8_t *data = malloc(len);
+    uint8_t *data = mem_arena_alloc(&cmd_arena, len);
     if (!data) {
-        printf("ERROR: Memory allocation failed\n");
+        printf("ERROR: Command buffer exhausted (%zu bytes requested)\n", len);
         return;
     }
 
@@ -996,7 +1884,6 @@ static void cmd_pdo_write(int argc, char **argv) {
     }
 
     soem_write_pdo_outputs(data, offset, len);
-    free(data);
 }
 
 /**
@@ -1029,6 +1916,187 @@ static void cmd_pdo_loop(int argc, char **argv) {
     soem_run_pdo_loop(cycles, interval_ms);
 }
 
+/**
+ * Команда mem-stats
+ */
+static void cmd_mem_stats(void) {
+    printf("\n=== Memory ===\n");
+    mem_arena_print(&cmd_arena);
+    alloc_track_print();
+    printf("\n");
+}
+
+/**
+ * Команда wait: пауза скрипта (в виртуальном времени - мгновенная)
+ */
+static void cmd_wait(int argc, char **argv) {
+    if (argc < 2) {
+        printf("ERROR: Usage: wait <ms>\n");
+        return;
+    }
+
+    long ms = strtol(argv[1], NULL, 0);
+    if (ms < 0 || ms > 86400000L) {
+        printf("ERROR: Invalid time (must be 0-86400000 ms)\n");
+        return;
+    }
+
+    int64_t t0 = timebase_now_ns();
+    soem_sleep_ms((uint32_t)ms);
+    if (timebase_virtual()) {
+        log_verbose("Virtual clock advanced %.3f s", (timebase_now_ns() - t0) / 1e9);
+    }
+}
+
+/**
+ * Команда timebase
+ */
+static void cmd_timebase(int argc, char **argv) {
+    int iterations = TIMEBASE_BENCH_DEFAULT_ITERATIONS;
+
+    if (argc >= 2) {
+        iterations = atoi(argv[1]);
+        if (iterations < 1000 || iterations > 100000000) {
+            printf("ERROR: Invalid iteration count (must be 1000-100000000)\n");
+            return;
+        }
+    }
+
+    printf("\n=== Timebase ===\n");
+    timebase_print();
+    timebase_bench(iterations);
+    printf("\n");
+}
+
+/**
+ * Команда cyclic-start
+ */
+static void cmd_cyclic_start(int argc, char **argv) {
+    if (argc < 2) {
+        printf("ERROR: Usage: cyclic-start <period_us> [priority] [sample_every]\n");
+        printf("Example: cyclic-start 1000 80\n");
+        return;
+    }
+
+    if (!pdo_active) {
+        printf("ERROR: PDO exchange not active. Run 'pdo-start' first.\n");
+        return;
+    }
+
+    cyclic_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.period_us = (uint32_t)strtoul(argv[1], NULL, 0);
+    cfg.priority = argc >= 3 ? atoi(argv[2]) : CYCLIC_DEFAULT_PRIORITY;
+    cfg.monitor_every = argc >= 4 ? (uint32_t)strtoul(argv[3], NULL, 0) : SCHED_MONITOR_DEFAULT_EVERY;
+    cfg.cpu = rt_cpu;
+    cfg.exchange = soem_exchange_cycle;
+    cfg.virtual_time = timebase_virtual();
+
+    if (cfg.priority < 1 || cfg.priority > 99) {
+        printf("ERROR: Invalid priority (must be 1-99)\n");
+        return;
+    }
+
+    if (!cyclic_start(&cfg)) {
+        return;
+    }
+
+    if (cfg.virtual_time) {
+        printf("✓ Cyclic engine started: %u us period in virtual time (advanced by commands and 'wait')\n",
+               cfg.period_us);
+        return;
+    }
+    printf("✓ Cyclic thread started: %u us period, priority %d", cfg.period_us, cfg.priority);
+    if (rt_cpu >= 0) {
+        printf(", CPU %d\n", rt_cpu);
+    } else {
+        printf(", no CPU pinning (use --rt-cpu)\n");
+    }
+}
+
+/**
+ * Команда cyclic-stop
+ */
+static void cmd_cyclic_stop(void) {
+    if (!cyclic_running()) {
+        printf("Cyclic thread not running\n");
+        return;
+    }
+
+    cyclic_stop();
+    printf("✓ Cyclic thread stopped\n\n");
+    cyclic_print_stats(NULL);
+    printf("\n");
+}
+
+/* ============================================================================
+ * Проверка таймера хоста без шины (--timer-test)
+ * ============================================================================ */
+
+#define TIMER_TEST_DEFAULT_SECONDS 10
+
+/**
+ * Обмен режима --timer-test: вместо кадров - занятость ядра на load_ns
+ */
+static bool timer_test_load(void *arg) {
+    int64_t load_ns = *(const int64_t *)arg;
+    int64_t end = timebase_now_ns() + load_ns;
+
+    while (timebase_now_ns() < end) {
+        /* busy wait */
+    }
+    return true;
+}
+
+/**
+ * Циклический поток с теми же приоритетом, привязкой, mlockall и ожиданием,
+ * что и cyclic-start, но без шины: гистограмма задержки пробуждения хоста
+ */
+static int run_timer_test(uint32_t period_us, uint32_t load_us, int seconds) {
+    static int64_t load_ns;
+    static cyclic_stats_t st;
+    cyclic_config_t cfg;
+
+    if (load_us >= period_us) {
+        printf("ERROR: Load %u us must be shorter than the period %u us\n", load_us, period_us);
+        return 1;
+    }
+
+    load_ns = (int64_t)load_us * 1000;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.period_us = period_us;
+    cfg.priority = CYCLIC_DEFAULT_PRIORITY;
+    cfg.monitor_every = SCHED_MONITOR_DEFAULT_EVERY;
+    cfg.cpu = rt_cpu;
+    cfg.exchange = timer_test_load;
+    cfg.arg = &load_ns;
+
+    printf("Timer test: %u us period, %u us busy load, %d s, priority %d, CPU %s\n",
+           period_us, load_us, seconds, cfg.priority, rt_cpu >= 0 ? "pinned (--rt-cpu)" : "any");
+    if (!cyclic_start(&cfg)) {
+        return 1;
+    }
+
+    for (int sec = 1; sec <= seconds; sec++) {
+        soem_sleep_ms(1000);
+        if (cyclic_get_stats(&st)) {
+            printf("  %3d s: %llu cycles, wake-up max %lld us, overruns %llu\n", sec,
+                   (unsigned long long)st.cycles, (long long)(st.wake.max_ns / 1000),
+                   (unsigned long long)st.overruns);
+        }
+    }
+
+    cyclic_stop();
+    printf("\n");
+    cyclic_print_stats(NULL);
+    if (cyclic_get_stats(&st) && st.wake.count > 0) {
+        printf("Host rating:       %s for a %u us cycle (max wake-up latency vs period)\n",
+               rt_result_str(rt_rate_latency(st.wake.max_ns, period_us)), period_us);
+    }
+    printf("\n");
+    return 0;
+}
+
 /* ============================================================================
  * Leadshine EM3E-556 Stepper Motor Control Functions
  * ============================================================================ */
@@ -1057,6 +2125,10 @@ static void cmd_pdo_loop(int argc, char **argv) {
 #define MODE_PROFILE_VELOCITY   3
 #define MODE_HOMING             6
 #define MODE_CYCLIC_SYNC_POS    8
+#define MODE_CYCLIC_SYNC_VEL    9
+#define MODE_CYCLIC_SYNC_TORQUE 10
+
+#define MODE_PDO_TIMEOUT_CYCLES 100          /* Ожидание 0x6061 после 0x6060 в PDO */
 
 /* State machine states */
 #define STATE_NOT_READY         0
@@ -1079,37 +2151,124 @@ typedef struct __attribute__((__packed__)) {
     int32_t actual_velocity;    /* 0x606C Velocity Actual Value */
 } motor_em3e_556_inputs_t;
 
+/* Раскладка pdo-layout torque: стандартные объекты + момент */
+typedef struct __attribute__((__packed__)) {
+    motor_em3e_556_outputs_t base;
+    int16_t target_torque;      /* 0x6071 Target Torque, 0.1% */
+} motor_em3e_556_cst_outputs_t;
+
+typedef struct __attribute__((__packed__)) {
+    motor_em3e_556_inputs_t base;
+    int16_t actual_torque;      /* 0x6077 Torque Actual Value, 0.1% */
+} motor_em3e_556_cst_inputs_t;
+
 /**
- * Get current drive state from status word
+ * Чтение объекта до 32 бит по SDO (CoE или модель симулированной шины)
  */
-static int motor_em3e_556_get_state(uint16_t status_word) {
-    uint16_t state_mask = status_word & 0x6F;
-    
-    if ((state_mask & 0x4F) == 0x00) {
-        return STATE_NOT_READY;
-    } else if ((state_mask & 0x4F) == 0x40) {
-        return STATE_SWITCH_ON_DISABLED;
-    } else if ((state_mask & 0x6F) == 0x21) {
-        return STATE_READY_TO_SWITCH_ON;
-    } else if ((state_mask & 0x6F) == 0x23) {
-        return STATE_SWITCHED_ON;
-    } else if ((state_mask & 0x6F) == 0x27) {
-        return STATE_OPERATION_ENABLED;
-    } else if ((state_mask & 0x08) != 0) {
-        return STATE_FAULT;
+static bool motor_em3e_556_read_u32(int slave_idx, uint16_t index, uint8_t subindex, uint32_t *value) {
+    int size = sizeof(*value);
+    int wkc;
+
+    *value = 0;
+    if (sim_bus_active()) {
+        wkc = sim_bus_sdo_read((uint16_t)slave_idx, index, subindex, value, &size);
+    } else {
+        wkc = ecx_SDOread(&ecx_context, slave_idx, index, subindex, FALSE, &size, value, EC_TIMEOUTRXM);
     }
-    
-    return STATE_NOT_READY;
+    return wkc > 0;
 }
 
 /**
- * Get state name
+ * Запись объекта по SDO без вывода (для команд многим осям)
  */
-static const char* motor_em3e_556_state_name(int state) {
-    switch (state) {
-        case STATE_NOT_READY: return "Not Ready";
-        case STATE_SWITCH_ON_DISABLED: return "Switch On Disabled";
-        case STATE_READY_TO_SWITCH_ON: return "Ready to Switch On";
+static bool motor_em3e_556_write_sdo(int slave_idx, uint16_t index, uint8_t subindex, void *value, int size) {
+    int wkc;
+
+    if (sim_bus_active()) {
+        wkc = sim_bus_sdo_write((uint16_t)slave_idx, index, subindex, value, size);
+    } else {
+        wkc = ecx_SDOwrite(&ecx_context, slave_idx, index, subindex, FALSE, size, value, EC_TIMEOUTRXM);
+    }
+    return wkc > 0;
+}
+
+/**
+ * Поддерживаемые режимы 0x6502 (бит N-1 - режим N)
+ */
+static uint32_t motor_em3e_556_supported_modes(int slave_idx) {
+    uint32_t modes;
+    return motor_em3e_556_read_u32(slave_idx, 0x6502, 0, &modes) ? modes : 0;
+}
+
+/**
+ * Ось в развертке положения и масштабе единиц
+ *
+ * Разрешение из 0x608F (инкременты / обороты мотора), единица скорости
+ * из 0x60A9; без ответа - AXIS_UNITS_DEFAULT_INC_PER_REV и инкременты/с.
+ */
+static bool motor_em3e_556_axis(int slave_idx) {
+    const ec_slavet *s = &ecx_context.slavelist[slave_idx];
+    uint32_t inc = 0, revs = 0, si = 0;
+
+    if (axis_units_bound((uint16_t)slave_idx)) {
+        return true;
+    }
+    if (s->Ibytes < sizeof(motor_em3e_556_inputs_t) || s->Obytes < sizeof(motor_em3e_556_outputs_t)) {
+        return false;
+    }
+
+    uint32_t inc_per_rev = AXIS_UNITS_DEFAULT_INC_PER_REV;
+    if (motor_em3e_556_read_u32(slave_idx, 0x608F, 1, &inc) &&
+        motor_em3e_556_read_u32(slave_idx, 0x608F, 2, &revs) && inc > 0 && revs > 0) {
+        inc_per_rev = inc / revs;
+    }
+    axis_vel_unit_t vel_unit = motor_em3e_556_read_u32(slave_idx, 0x60A9, 0, &si) &&
+                               si == AXIS_UNITS_SI_RPM ? AXIS_VEL_RPM : AXIS_VEL_INC_PER_S;
+
+    return axis_units_bind((uint16_t)slave_idx, s->inputs,
+                           offsetof(motor_em3e_556_inputs_t, actual_position), inc_per_rev, vel_unit);
+}
+
+/**
+ * У slave смаплены объекты момента (pdo-layout torque или модель cia402-cst)
+ */
+static bool motor_em3e_556_has_torque(int slave_idx) {
+    const ec_slavet *s = &ecx_context.slavelist[slave_idx];
+    return s->Obytes >= sizeof(motor_em3e_556_cst_outputs_t) &&
+           s->Ibytes >= sizeof(motor_em3e_556_cst_inputs_t);
+}
+
+/**
+ * Get current drive state from status word
+ */
+static int motor_em3e_556_get_state(uint16_t status_word) {
+    uint16_t state_mask = status_word & 0x6F;
+    
+    if ((state_mask & 0x4F) == 0x00) {
+        return STATE_NOT_READY;
+    } else if ((state_mask & 0x4F) == 0x40) {
+        return STATE_SWITCH_ON_DISABLED;
+    } else if ((state_mask & 0x6F) == 0x21) {
+        return STATE_READY_TO_SWITCH_ON;
+    } else if ((state_mask & 0x6F) == 0x23) {
+        return STATE_SWITCHED_ON;
+    } else if ((state_mask & 0x6F) == 0x27) {
+        return STATE_OPERATION_ENABLED;
+    } else if ((state_mask & 0x08) != 0) {
+        return STATE_FAULT;
+    }
+    
+    return STATE_NOT_READY;
+}
+
+/**
+ * Get state name
+ */
+static const char* motor_em3e_556_state_name(int state) {
+    switch (state) {
+        case STATE_NOT_READY: return "Not Ready";
+        case STATE_SWITCH_ON_DISABLED: return "Switch On Disabled";
+        case STATE_READY_TO_SWITCH_ON: return "Ready to Switch On";
         case STATE_SWITCHED_ON: return "Switched On";
         case STATE_OPERATION_ENABLED: return "Operation Enabled";
         case STATE_FAULT: return "Fault";
@@ -1129,6 +2288,7 @@ static bool motor_em3e_556_enable(int slave_idx) {
     motor_em3e_556_outputs_t *outputs = (motor_em3e_556_outputs_t*)ecx_context.slavelist[slave_idx].outputs;
     motor_em3e_556_inputs_t *inputs = (motor_em3e_556_inputs_t*)ecx_context.slavelist[slave_idx].inputs;
 
+    motor_em3e_556_axis(slave_idx);
     printf("Enabling drive (slave %d)...\n", slave_idx);
 
     /* Transition sequence */
@@ -1159,11 +2319,7 @@ static bool motor_em3e_556_enable(int slave_idx) {
                     break;
                 }
                 reset_attempts++;
-#ifdef _WIN32
-                Sleep(100);
-#else
-                usleep(100000);
-#endif
+                soem_sleep_ms(100);
             }
             if (!fault_cleared) {
                 printf("  Failed to clear fault.\n");
@@ -1176,11 +2332,7 @@ static bool motor_em3e_556_enable(int slave_idx) {
             outputs->control_word = CW_SWITCH_ON | CW_ENABLE_VOLTAGE | CW_QUICK_STOP | CW_ENABLE_OPERATION;
         }
         
-#ifdef _WIN32
-        Sleep(50);
-#else
-        usleep(50000);
-#endif
+        soem_sleep_ms(50);
     }
 
     printf("\n✗ Failed to enable drive (timeout)\n");
@@ -1207,16 +2359,31 @@ static bool motor_em3e_556_disable(int slave_idx) {
 
 /**
  * Set operation mode
+ *
+ * 0x6060 в PDO (pdo-layout ... mode): байт режима в выходах, подтверждение
+ * по 0x6061 во входах через цикл-два; иначе - SDO.
  */
 static bool motor_em3e_556_set_mode(int slave_idx, int8_t mode) {
+    uint16_t mode_out, mode_in;
+    int cycles = -1;
+
     if (slave_idx < 1 || slave_idx > ecx_context.slavecount) {
         return false;
     }
 
-    /* Write Mode of Operation (0x6060) */
-    int wkc = ecx_SDOwrite(&ecx_context, slave_idx, 0x6060, 0, FALSE, sizeof(mode), &mode, EC_TIMEOUTRXM);
-    
-    if (wkc <= 0) {
+    if (pdo_active && pdo_layout_mode_offsets(slave_idx, &mode_out, &mode_in)) {
+        ec_slavet *s = &ecx_context.slavelist[slave_idx];
+        s->outputs[mode_out] = (uint8_t)mode;
+        for (cycles = 0; (int8_t)s->inputs[mode_in] != mode; cycles++) {
+            if (cycles == MODE_PDO_TIMEOUT_CYCLES) {
+                printf("ERROR: Slave %d did not show mode %d in 0x6061 within %d cycles (shows %d)\n",
+                       slave_idx, mode, MODE_PDO_TIMEOUT_CYCLES, (int8_t)s->inputs[mode_in]);
+                return false;
+            }
+            soem_exchange_pdo();
+        }
+    } else if (!motor_em3e_556_write_sdo(slave_idx, 0x6060, 0, &mode, sizeof(mode))) {
+        /* Write Mode of Operation (0x6060) */
         printf("ERROR: Failed to set operation mode\n");
         return false;
     }
@@ -1227,25 +2394,37 @@ static bool motor_em3e_556_set_mode(int slave_idx, int8_t mode) {
         case MODE_PROFILE_VELOCITY: mode_name = "Profile Velocity"; break;
         case MODE_HOMING: mode_name = "Homing"; break;
         case MODE_CYCLIC_SYNC_POS: mode_name = "Cyclic Sync Position"; break;
+        case MODE_CYCLIC_SYNC_VEL: mode_name = "Cyclic Sync Velocity"; break;
+        case MODE_CYCLIC_SYNC_TORQUE: mode_name = "Cyclic Sync Torque"; break;
     }
     
-    printf("Operation mode set to: %s (%d)\n", mode_name, mode);
+    if (cycles >= 0) {
+        printf("Operation mode set to: %s (%d) via PDO, 0x6061 confirmed after %d cycle%s\n",
+               mode_name, mode, cycles, cycles == 1 ? "" : "s");
+    } else {
+        printf("Operation mode set to: %s (%d)\n", mode_name, mode);
+    }
     return true;
 }
 
 /**
  * Set target velocity (Profile Velocity mode)
+ *
+ * @param velocity Единицы оси в минуту x AXIS_UNITS_MICRO (без настройки - об/мин);
+ *                 в 0x60FF уходит в единицах скорости привода
  */
-static bool motor_em3e_556_set_velocity(int slave_idx, int32_t velocity_rpm) {
+static bool motor_em3e_556_set_velocity(int slave_idx, int64_t velocity) {
     if (!pdo_active || slave_idx < 1 || slave_idx > ecx_context.slavecount) {
         return false;
     }
 
     motor_em3e_556_outputs_t *outputs = (motor_em3e_556_outputs_t*)ecx_context.slavelist[slave_idx].outputs;
     
-    outputs->target_velocity = velocity_rpm;
+    motor_em3e_556_axis(slave_idx);
+    outputs->target_velocity = axis_units_drive_from_vel((uint16_t)slave_idx, velocity);
     
-    printf("Target velocity set to: %d RPM\n", velocity_rpm);
+    printf("Target velocity set to: %g %s (0x60FF = %d)\n", velocity / (double)AXIS_UNITS_MICRO,
+           axis_units_vel_name((uint16_t)slave_idx), outputs->target_velocity);
     return true;
 }
 
@@ -1267,8 +2446,23 @@ static void motor_em3e_556_print_status(int slave_idx) {
     printf("\n=== EM3E-556 Status (Slave %d) ===\n", slave_idx);
     printf("State:            %s\n", motor_em3e_556_state_name(state));
     printf("Status Word:      0x%04X\n", inputs->status_word);
-    printf("Actual Position:  %d counts\n", inputs->actual_position);
-    printf("Actual Velocity:  %d RPM\n", inputs->actual_velocity);
+    if (motor_em3e_556_axis(slave_idx)) {
+        uint16_t axis = (uint16_t)slave_idx;
+        int64_t position = axis_units_position(axis);
+        printf("Actual Position:  %g %s (%lld increments, 0x6064 = %d)\n",
+               axis_units_user_from_inc(axis, position) / (double)AXIS_UNITS_MICRO,
+               axis_units_pos_name(axis), (long long)position, inputs->actual_position);
+        printf("Actual Velocity:  %g %s (0x606C = %d)\n",
+               axis_units_vel_from_drive(axis, inputs->actual_velocity) / (double)AXIS_UNITS_MICRO,
+               axis_units_vel_name(axis), inputs->actual_velocity);
+    } else {
+        printf("Actual Position:  %d counts\n", inputs->actual_position);
+        printf("Actual Velocity:  %d\n", inputs->actual_velocity);
+    }
+    if (motor_em3e_556_has_torque(slave_idx)) {
+        const motor_em3e_556_cst_inputs_t *cst = (const motor_em3e_556_cst_inputs_t *)inputs;
+        printf("Actual Torque:    %.1f %%\n", cst->actual_torque / 10.0);
+    }
     printf("\nStatus Flags:\n");
     printf("  Ready to Switch On: %s\n", (inputs->status_word & SW_READY_TO_SWITCH_ON) ? "YES" : "NO");
     printf("  Switched On:        %s\n", (inputs->status_word & SW_SWITCHED_ON) ? "YES" : "NO");
@@ -1282,14 +2476,14 @@ static void motor_em3e_556_print_status(int slave_idx) {
 /**
  * Run motor for specified duration
  */
-static bool motor_em3e_556_run_timed(int slave_idx, int32_t velocity_rpm, int duration_sec) {
-    printf("\n=== Running motor for %d seconds at %d RPM ===\n", duration_sec, velocity_rpm);
-    
+static bool motor_em3e_556_run_timed(int slave_idx, int64_t velocity, int duration_sec) {
     if (!motor_em3e_556_enable(slave_idx)) {
         return false;
     }
+    printf("\n=== Running motor for %d seconds at %g %s ===\n", duration_sec,
+           velocity / (double)AXIS_UNITS_MICRO, axis_units_vel_name((uint16_t)slave_idx));
     
-    motor_em3e_556_set_velocity(slave_idx, velocity_rpm);
+    motor_em3e_556_set_velocity(slave_idx, velocity);
     
     printf("Motor running");
     for (int i = 0; i < duration_sec; i++) {
@@ -1298,11 +2492,7 @@ static bool motor_em3e_556_run_timed(int slave_idx, int32_t velocity_rpm, int du
         
         for (int j = 0; j < 10; j++) {
             soem_exchange_pdo();
-#ifdef _WIN32
-            Sleep(100);
-#else
-            usleep(100000);
-#endif
+            soem_sleep_ms(100);
         }
     }
     printf(" Done!\n");
@@ -1310,11 +2500,7 @@ static bool motor_em3e_556_run_timed(int slave_idx, int32_t velocity_rpm, int du
     /* Stop motor */
     motor_em3e_556_set_velocity(slave_idx, 0);
     soem_exchange_pdo();
-#ifdef _WIN32
-    Sleep(500);
-#else
-    usleep(500000);
-#endif
+    soem_sleep_ms(500);
     
     motor_em3e_556_print_status(slave_idx);
     
@@ -1347,11 +2533,25 @@ static bool motor_em3e_556_stop(int slave_idx) {
 
 static void cmd_motor_enable(int argc, char **argv) {
     if (argc < 2) {
-        printf("Usage: motor-enable <slave_idx>\n");
+        printf("Usage: motor-enable <slave_idx|all>\n");
         printf("Example: motor-enable 1\n");
         return;
     }
     
+    if (strcmp(argv[1], "all") == 0) {
+        /* Все оси подряд: на симулированной шине - замер логики включения */
+        int64_t t0 = timebase_now_ns();
+        int enabled = 0;
+        for (int i = 1; i <= ecx_context.slavecount; i++) {
+            if (motor_em3e_556_set_mode(i, MODE_PROFILE_VELOCITY) && motor_em3e_556_enable(i)) {
+                enabled++;
+            }
+        }
+        printf("Enabled %d/%d drives in %.1f ms%s\n", enabled, ecx_context.slavecount,
+               (timebase_now_ns() - t0) / 1e6, timebase_virtual() ? " (virtual time)" : "");
+        return;
+    }
+
     int slave_idx = atoi(argv[1]);
     motor_em3e_556_set_mode(slave_idx, MODE_PROFILE_VELOCITY);
     motor_em3e_556_enable(slave_idx);
@@ -1370,13 +2570,13 @@ static void cmd_motor_disable(int argc, char **argv) {
 
 static void cmd_motor_run(int argc, char **argv) {
     if (argc < 4) {
-        printf("Usage: motor-run <slave_idx> <velocity_rpm> <duration_sec>\n");
+        printf("Usage: motor-run <slave_idx> <velocity> <duration_sec>\n");
         printf("Example: motor-run 1 100 10   (run at 100 RPM for 10 seconds)\n");
         return;
     }
     
     int slave_idx = atoi(argv[1]);
-    int32_t velocity = atoi(argv[2]);
+    int64_t velocity = axis_units_parse(argv[2]);
     int duration = atoi(argv[3]);
     
     motor_em3e_556_run_timed(slave_idx, velocity, duration);
@@ -1384,14 +2584,15 @@ static void cmd_motor_run(int argc, char **argv) {
 
 static void cmd_motor_velocity(int argc, char **argv) {
     if (argc < 3) {
-        printf("Usage: motor-velocity <slave_idx> <velocity_rpm>\n");
+        printf("Usage: motor-velocity <slave_idx> <velocity>\n");
         printf("Example: motor-velocity 1 200\n");
         printf("  Positive = forward, Negative = reverse\n");
+        printf("  rpm, or axis units per minute after 'units <idx> <name> <per_rev>'\n");
         return;
     }
     
     int slave_idx = atoi(argv[1]);
-    int32_t velocity = atoi(argv[2]);
+    int64_t velocity = axis_units_parse(argv[2]);
     
     motor_em3e_556_set_velocity(slave_idx, velocity);
 }
@@ -1418,169 +2619,1604 @@ static void cmd_motor_status(int argc, char **argv) {
     motor_em3e_556_print_status(slave_idx);
 }
 
-/* ============================================================================
- * REPL - Read-Eval-Print Loop
- * ============================================================================ */
-
 /**
- * Разбор строки команды на аргументы
+ * Команда pdo-layout: раскладка PDO приводов для следующего scan
  */
-static int parse_command(char *line, char **argv, int max_args) {
-    int argc = 0;
-    char *token = strtok(line, " \t\n\r");
+static void cmd_pdo_layout(int argc, char **argv) {
+    const char *mode_text = pdo_layout_mode ? " + mode" : "";
 
-    while (token != NULL && argc < max_args) {
-        argv[argc++] = token;
-        token = strtok(NULL, " \t\n\r");
+    if (argc >= 2) {
+        if (pdo_active) {
+            printf("ERROR: Stop PDO exchange first ('pdo-stop'), the layout is applied by 'scan'\n");
+            return;
+        }
+        bool mode = argc >= 3 && strcmp(argv[2], "mode") == 0;
+        if (argc >= 3 && !mode) {
+            printf("ERROR: Usage: pdo-layout [standard|torque] [mode]\n");
+            return;
+        }
+        if (strcmp(argv[1], "standard") == 0) {
+            pdo_layout = PDO_LAYOUT_STANDARD;
+        } else if (strcmp(argv[1], "torque") == 0) {
+            pdo_layout = PDO_LAYOUT_TORQUE;
+        } else {
+            printf("ERROR: Usage: pdo-layout [standard|torque] [mode]\n");
+            return;
+        }
+        pdo_layout_mode = mode;
+        printf("Drive PDO layout: %s%s (applied on next 'scan')\n", argv[1], mode ? " + mode" : "");
+    } else {
+        printf("Drive PDO layout: %s%s\n", pdo_layout == PDO_LAYOUT_TORQUE ? "torque" : "standard", mode_text);
     }
 
-    return argc;
+    if (sim_bus_active()) {
+        printf("Simulated bus: the layout comes from the model (cia402-cst maps torque, *-mode maps 0x6060)\n");
+    }
+    for (int i = 1; soem_initialized && i <= ecx_context.slavecount; i++) {
+        uint16_t out, in;
+        bool torque = motor_em3e_556_has_torque(i);
+        bool mode = pdo_layout_mode_offsets(i, &out, &in);
+        if (torque || mode) {
+            printf("  Slave %d:%s%s mapped\n", i,
+                   torque ? " 0x6071 Target Torque / 0x6077 Torque Actual" : "",
+                   mode ? (torque ? ", 0x6060 / 0x6061 Modes of Operation" : " 0x6060 / 0x6061 Modes of Operation") : "");
+        }
+    }
 }
 
 /**
- * Обработка одной команды
+ * Разбор номера оси servo-команд
  */
-static bool process_command(char *line) {
-    char *argv[MAX_ARGS];
-    int argc = parse_command(line, argv, MAX_ARGS);
-
-    if (argc == 0) {
-        /* Пустая команда - показываем help */
-        cmd_help();
-        return true;
-    }
-
-    /* Обработка команд */
-    if (strcmp(argv[0], "help") == 0 || strcmp(argv[0], "?") == 0) {
-        cmd_help();
-    }
-    else if (strcmp(argv[0], "quit") == 0 || strcmp(argv[0], "exit") == 0) {
-        return false;  /* Выход из REPL */
-    }
-    else if (strcmp(argv[0], "scan") == 0) {
-        soem_scan_bus();
-    }
-    else if (strcmp(argv[0], "read-config") == 0) {
-        cmd_read_config(argc, argv);
-    }
-    else if (strcmp(argv[0], "read") == 0) {
-        cmd_read(argc, argv);
-    }
-    else if (strcmp(argv[0], "write") == 0) {
-        cmd_write(argc, argv);
+static int servo_slave_arg(const char *arg) {
+    int slave_idx = atoi(arg);
+    if (slave_idx < 1 || slave_idx > ecx_context.slavecount) {
+        printf("ERROR: Invalid slave index (1-%d)\n", ecx_context.slavecount);
+        return 0;
     }
-    else if (strcmp(argv[0], "text-write") == 0) {
-        cmd_text_write(argc, argv);
+    if (!servo_loop_attached((uint16_t)slave_idx)) {
+        printf("ERROR: Slave %d is not in the servo loop ('servo on %d')\n", slave_idx, slave_idx);
+        return 0;
     }
-    else if (strcmp(argv[0], "verbose") == 0) {
-        cmd_verbose(argc, argv);
+    return slave_idx;
+}
+
+/**
+ * servo on: CST, подключение к контуру и включение привода
+ *
+ * @param counts_per_rev 0 - разрешение оси из axis_units (0x608F)
+ */
+static void servo_on(int slave_idx, uint32_t counts_per_rev) {
+    static cyclic_stats_t st;
+    axis_units_info_t ai;
+
+    if (!pdo_active || !cyclic_running() || !cyclic_get_stats(&st)) {
+        printf("ERROR: The servo loop runs in the cyclic thread: 'pdo-start' and 'cyclic-start' first\n");
+        return;
     }
-    else if (strcmp(argv[0], "status") == 0) {
-        cmd_status();
+    if (slave_idx < 1 || slave_idx > ecx_context.slavecount) {
+        printf("ERROR: Invalid slave index (1-%d)\n", ecx_context.slavecount);
+        return;
     }
-    else if (strcmp(argv[0], "pdo-start") == 0) {
-        cmd_pdo_start();
+    if (!motor_em3e_556_has_torque(slave_idx)) {
+        printf("ERROR: Slave %d has no torque objects mapped ('pdo-layout torque', then 'scan')\n",
+               slave_idx);
+        return;
     }
-    else if (strcmp(argv[0], "pdo-stop") == 0) {
-        cmd_pdo_stop();
+    if (axis_group_of((uint16_t)slave_idx)) {
+        printf("ERROR: Slave %d is in group %d, remove it first\n", slave_idx, axis_group_of((uint16_t)slave_idx));
+        return;
     }
-    else if (strcmp(argv[0], "pdo-read") == 0) {
-        cmd_pdo_read();
+    if (!motor_em3e_556_axis(slave_idx) || !axis_units_info((uint16_t)slave_idx, &ai)) {
+        printf("ERROR: Slave %d has no drive PDO layout\n", slave_idx);
+        return;
     }
-    else if (strcmp(argv[0], "pdo-write") == 0) {
-        cmd_pdo_write(argc, argv);
+    if (counts_per_rev == 0) {
+        counts_per_rev = ai.inc_per_rev;
     }
-    else if (strcmp(argv[0], "pdo-loop") == 0) {
-        cmd_pdo_loop(argc, argv);
+
+    ec_slavet *s = &ecx_context.slavelist[slave_idx];
+    servo_pdo_t pdo = {
+        .inputs = s->inputs,
+        .outputs = s->outputs,
+        .statusword = offsetof(motor_em3e_556_inputs_t, status_word),
+        .actual_position = offsetof(motor_em3e_556_inputs_t, actual_position),
+        .actual_velocity = offsetof(motor_em3e_556_inputs_t, actual_velocity),
+        .target_position = offsetof(motor_em3e_556_outputs_t, target_position),
+        .target_torque = offsetof(motor_em3e_556_cst_outputs_t, target_torque),
+    };
+
+    /* Контур держит момент 0, пока привод не в Operation Enabled */
+    if (!servo_loop_attach((uint16_t)slave_idx, &pdo, st.period_us, counts_per_rev,
+                           ai.vel_unit == AXIS_VEL_RPM, axis_units_position((uint16_t)slave_idx))) {
+        printf("ERROR: Cannot attach slave %d (already attached or %d axes in use)\n",
+               slave_idx, SERVO_MAX_AXES);
+        return;
     }
-    else if (strcmp(argv[0], "motor-enable") == 0) {
-        cmd_motor_enable(argc, argv);
+    if (!motor_em3e_556_set_mode(slave_idx, MODE_CYCLIC_SYNC_TORQUE) ||
+        !motor_em3e_556_enable(slave_idx)) {
+        servo_loop_detach((uint16_t)slave_idx);
+        return;
     }
-    else if (strcmp(argv[0], "motor-disable") == 0) {
-        cmd_motor_disable(argc, argv);
+    printf("✓ Slave %d in master servo loop at %u us (%u counts/rev)\n",
+           slave_idx, st.period_us, counts_per_rev);
+}
+
+/**
+ * Команда units: масштаб единиц осей и развернутое положение
+ */
+static void cmd_units(int argc, char **argv) {
+    if (!pdo_active) {
+        printf("ERROR: PDO exchange not active. Run 'pdo-start' first.\n");
+        return;
     }
-    else if (strcmp(argv[0], "motor-run") == 0) {
-        cmd_motor_run(argc, argv);
+    if (argc < 2) {
+        axis_units_print();
+        return;
     }
-    else if (strcmp(argv[0], "motor-velocity") == 0) {
-        cmd_motor_velocity(argc, argv);
+    bool off = argc == 3 && strcmp(argv[2], "off") == 0;
+    if (argc < 4 && !off) {
+        printf("ERROR: Usage: units <idx|all> <name> <units_per_rev> | units <idx|all> off\n");
+        printf("       Example: units 1 mm 5.0   (5 mm per motor revolution)\n");
+        return;
     }
-    else if (strcmp(argv[0], "motor-stop") == 0) {
-        cmd_motor_stop(argc, argv);
+
+    bool all = strcmp(argv[1], "all") == 0;
+    int first = all ? 1 : atoi(argv[1]);
+    int last = all ? ecx_context.slavecount : first;
+    if (first < 1 || last > ecx_context.slavecount) {
+        printf("ERROR: Invalid slave index (1-%d)\n", ecx_context.slavecount);
+        return;
     }
-    else if (strcmp(argv[0], "motor-status") == 0) {
-        cmd_motor_status(argc, argv);
+
+    double per_rev = off ? 0.0 : atof(argv[3]);
+    int n = 0;
+    for (int i = first; i <= last; i++) {
+        if (!motor_em3e_556_axis(i)) {
+            if (!all) {
+                printf("ERROR: Slave %d has no drive PDO layout\n", i);
+            }
+            continue;
+        }
+        if (!axis_units_set_user((uint16_t)i, off ? NULL : argv[2], per_rev)) {
+            printf("ERROR: Scale %s %s per rev out of range for slave %d\n", argv[2], argv[3], i);
+            return;
+        }
+        n++;
     }
-    else {
-        printf("ERROR: Unknown command '%s'. Type 'help' for list of commands.\n", argv[0]);
+    if (off) {
+        printf("Counts and rpm on %d axes\n", n);
+    } else {
+        printf("Units '%s', %g per motor rev on %d axes (velocities in %s/min)\n",
+               argv[2], per_rev, n, argv[2]);
     }
-
-    return true;
 }
 
 /**
- * Главный цикл REPL
+ * Команда servo: контуры положения/скорости в мастере (CST)
  */
-static void repl_loop(void) {
-    char line[MAX_COMMAND_LEN];
-
-    printf("\nEtherCAT CLI - Interactive Mode\n");
-    printf("Type 'help' for commands, 'quit' to exit\n\n");
+static void cmd_servo(int argc, char **argv) {
+    if (!soem_initialized || ecx_context.slavecount == 0) {
+        printf("ERROR: No slaves found. Run 'scan' first.\n");
+        return;
+    }
+    if (argc < 2) {
+        servo_loop_print();
+        return;
+    }
 
-    while (1) {
-        printf("dummy_says> ");
-        fflush(stdout);
+    const char *action = argv[1];
+    int slave_idx;
 
-        if (fgets(line, sizeof(line), stdin) == NULL) {
-            break;  /* EOF или ошибка */
+    if (strcmp(action, "on") == 0 && argc >= 3) {
+        uint32_t cpr = argc >= 4 ? (uint32_t)strtoul(argv[3], NULL, 0) : 0;
+        if (argc >= 4 && cpr == 0) {
+            printf("ERROR: Invalid counts per revolution\n");
+            return;
         }
-
-        /* Убираем trailing whitespace */
-        size_t len = strlen(line);
-        while (len > 0 && isspace((unsigned char)line[len - 1])) {
-            line[--len] = '\0';
+        servo_on(atoi(argv[2]), cpr);
+    } else if (strcmp(action, "off") == 0 && argc >= 3) {
+        if ((slave_idx = servo_slave_arg(argv[2])) == 0) {
+            return;
         }
-
-        if (len == 0) {
-            continue;  /* Пустая строка */
+        servo_loop_detach((uint16_t)slave_idx);
+        /* Последний момент контура мог уйти в текущем цикле: обнуляем после него */
+        soem_exchange_pdo();
+        ((motor_em3e_556_cst_outputs_t *)ecx_context.slavelist[slave_idx].outputs)->target_torque = 0;
+        soem_exchange_pdo();
+        printf("Slave %d removed from the servo loop, torque 0 (drive still enabled, 'motor-disable %d')\n",
+               slave_idx, slave_idx);
+    } else if (strcmp(action, "gains") == 0 && argc >= 6) {
+        servo_gains_t g;
+        if ((slave_idx = servo_slave_arg(argv[2])) == 0) {
+            return;
         }
-
-        if (!process_command(line)) {
-            break;  /* Команда quit/exit */
+        servo_loop_get_gains((uint16_t)slave_idx, &g);
+        g.kp_pos = atof(argv[3]);
+        g.kp_vel = atof(argv[4]);
+        g.ki_vel = atof(argv[5]);
+        if (argc >= 7) {
+            g.kd_vel = atof(argv[6]);
+        }
+        servo_loop_set_gains((uint16_t)slave_idx, &g);
+        printf("Slave %d gains: Kp pos %.3f rpm/count, Kp vel %.3f, Ki vel %.3f, Kd vel %.4f\n",
+               slave_idx, g.kp_pos, g.kp_vel, g.ki_vel, g.kd_vel);
+    } else if (strcmp(action, "ff") == 0 && argc >= 5) {
+        servo_gains_t g;
+        if ((slave_idx = servo_slave_arg(argv[2])) == 0) {
+            return;
+        }
+        servo_loop_get_gains((uint16_t)slave_idx, &g);
+        g.kvff = atof(argv[3]);
+        g.kaff = atof(argv[4]);
+        servo_loop_set_gains((uint16_t)slave_idx, &g);
+        printf("Slave %d feed-forward: velocity %.3f, acceleration %.4f\n", slave_idx, g.kvff, g.kaff);
+    } else if (strcmp(action, "limits") == 0 && argc >= 5) {
+        if ((slave_idx = servo_slave_arg(argv[2])) == 0) {
+            return;
+        }
+        long vel = strtol(argv[3], NULL, 0);
+        long torque = strtol(argv[4], NULL, 0);
+        if (vel < 1 || vel > 100000 || torque < 1 || torque > 32767 ||
+            !servo_loop_set_limits((uint16_t)slave_idx, (uint32_t)vel, (uint16_t)torque)) {
+            printf("ERROR: Invalid limits (velocity 1-100000 rpm, torque 1-32767 x 0.1%%)\n");
+            return;
         }
+        printf("Slave %d limits: %ld rpm, %.1f%% torque\n", slave_idx, vel, torque / 10.0);
+    } else if (strcmp(action, "move") == 0 && argc >= 4) {
+        if ((slave_idx = servo_slave_arg(argv[2])) == 0) {
+            return;
+        }
+        /* Цель в единицах оси; контур считает в той же развертке 0x6064 */
+        uint16_t axis = (uint16_t)slave_idx;
+        int64_t target = axis_units_inc_from_user(axis, axis_units_parse(argv[3]));
+        int32_t vel = argc >= 5 ? axis_units_rpm_from_vel(axis, axis_units_parse(argv[4])) : 0;
+        if (vel < 0) {
+            printf("ERROR: Velocity must be positive\n");
+            return;
+        }
+        servo_loop_move(axis, target, (uint32_t)vel);
+        printf("Slave %d moving to %s %s (%lld increments)\n", slave_idx, argv[3],
+               axis_units_pos_name(axis), (long long)target);
+    } else if (strcmp(action, "reset") == 0) {
+        servo_loop_reset_stats();
+        printf("Servo loop statistics reset\n");
+    } else {
+        printf("ERROR: Usage: servo [on <idx> [counts_per_rev]|off <idx>|gains <idx> <kp_pos> <kp_vel> <ki_vel> [kd_vel]|\n");
+        printf("                     ff <idx> <kvff> <kaff>|limits <idx> <rpm> <torque>|move <idx> <pos> [vel]|reset]\n");
     }
-
-    printf("\nExiting...\n");
 }
 
-/* ============================================================================
- * Главная функция и парсинг аргументов
- * ============================================================================ */
-
 /**
- * Вывод информации об использовании программы
+ * Запись отклика оси: возбуждение из циклического потока, анализ после
  */
-static void print_usage(const char *prog_name) {
-    printf("Usage: %s [OPTIONS]\n", prog_name);
-    printf("\nOptions:\n");
-    printf("  -i, --interface <name>  Network interface name (required)\n");
-    printf("  -v, --verbose           Enable verbose output\n");
-    printf("  -h, --help              Show this help\n");
-    printf("\nExamples:\n");
-    printf("  %s -i eth0\n", prog_name);
-    printf("  %s -i \"\\\\Device\\\\NPF_{...}\" -v\n", prog_name);
-    printf("\n");
-}
+static void tune_run(int slave_idx, bool chirp, double f0, double f1, int64_t amplitude, uint32_t ms) {
+    static cyclic_stats_t st;
+    axis_units_info_t ai;
 
-/**
- * Главная функция программы
- */
+    if (!pdo_active || !cyclic_running() || !cyclic_get_stats(&st)) {
+        printf("ERROR: Tuning records at the cycle rate: 'pdo-start' and 'cyclic-start' first\n");
+        return;
+    }
+    if (slave_idx < 1 || slave_idx > ecx_context.slavecount) {
+        printf("ERROR: Invalid slave index (1-%d)\n", ecx_context.slavecount);
+        return;
+    }
+    if (servo_loop_attached((uint16_t)slave_idx)) {
+        printf("ERROR: Slave %d is in the servo loop, run 'servo off %d' first\n", slave_idx, slave_idx);
+        return;
+    }
+    if (tune_state() == TUNE_RUNNING) {
+        printf("ERROR: Another tuning record is running\n");
+        return;
+    }
+    if (!motor_em3e_556_axis(slave_idx) || !axis_units_info((uint16_t)slave_idx, &ai)) {
+        printf("ERROR: Slave %d has no drive PDO layout\n", slave_idx);
+        return;
+    }
+
+    uint64_t samples = (uint64_t)ms * 1000 / st.period_us;
+    if (samples < 16 || samples > TUNE_MAX_SAMPLES) {
+        printf("ERROR: Record of %u ms is %llu cycles at %u us (allowed 16-%d)\n", ms,
+               (unsigned long long)samples, st.period_us, TUNE_MAX_SAMPLES);
+        return;
+    }
+
+    /* CSV: задание без профиля привода; иначе отклик включает рампу PV */
+    bool csv = (motor_em3e_556_supported_modes(slave_idx) & (1u << (MODE_CYCLIC_SYNC_VEL - 1))) != 0;
+    if (!motor_em3e_556_set_mode(slave_idx, csv ? MODE_CYCLIC_SYNC_VEL : MODE_PROFILE_VELOCITY)) {
+        return;
+    }
+    if (!csv) {
+        printf("Note: no CSV mode (0x6502), the response includes the drive's PV profile ramp\n");
+    }
+    motor_em3e_556_inputs_t *inputs = (motor_em3e_556_inputs_t *)ecx_context.slavelist[slave_idx].inputs;
+    if (motor_em3e_556_get_state(inputs->status_word) != STATE_OPERATION_ENABLED &&
+        !motor_em3e_556_enable(slave_idx)) {
+        return;
+    }
+
+    /* Запись начинается с оси в покое, иначе затухание прошлого движения попадет в отклик */
+    ec_slavet *s = &ecx_context.slavelist[slave_idx];
+    ((motor_em3e_556_outputs_t *)s->outputs)->target_velocity = 0;
+    for (int i = 0; i < 100 && (inputs->actual_velocity != 0 || i == 0); i++) {
+        soem_sleep_ms(10);
+        soem_exchange_pdo();
+    }
+
+    tune_pdo_t pdo = {
+        .inputs = s->inputs,
+        .outputs = s->outputs,
+        .statusword = offsetof(motor_em3e_556_inputs_t, status_word),
+        .actual_position = offsetof(motor_em3e_556_inputs_t, actual_position),
+        .actual_velocity = offsetof(motor_em3e_556_inputs_t, actual_velocity),
+        .target_velocity = offsetof(motor_em3e_556_outputs_t, target_velocity),
+    };
+    bool started = chirp
+        ? tune_start_chirp((uint16_t)slave_idx, &pdo, st.period_us, ai.inc_per_rev, f0, f1, amplitude,
+                           (uint32_t)samples)
+        : tune_start_step((uint16_t)slave_idx, &pdo, st.period_us, ai.inc_per_rev, amplitude,
+                          (uint32_t)samples);
+    if (!started) {
+        printf("ERROR: Invalid excitation (chirp needs 0 < f0 < f1 < %.0f Hz)\n", 0.5e6 / st.period_us);
+        return;
+    }
+
+    printf("Recording %llu cycles (%u ms)...\n", (unsigned long long)samples, ms);
+    int64_t deadline = timebase_now_ns() + ((int64_t)ms + CYCLIC_WAIT_TIMEOUT_MS) * 1000000LL;
+    while (tune_state() == TUNE_RUNNING && timebase_now_ns() < deadline) {
+        soem_sleep_ms(10);
+    }
+    if (tune_state() == TUNE_RUNNING) {
+        tune_abort();
+        cyclic_wait_cycle(CYCLIC_WAIT_TIMEOUT_MS);
+        printf("WARNING: Cyclic thread did not finish the record in time\n");
+    }
+
+    motor_em3e_556_set_mode(slave_idx, MODE_PROFILE_VELOCITY);
+    tune_print_result();
+}
+
+/**
+ * Команда tune-step
+ */
+static void cmd_tune_step(int argc, char **argv) {
+    if (argc < 2) {
+        printf("ERROR: Usage: tune-step <idx> [vel] [ms]\n");
+        return;
+    }
+    int64_t vel = argc >= 3 ? axis_units_parse(argv[2]) : TUNE_DEFAULT_STEP_VEL * AXIS_UNITS_MICRO;
+    uint32_t ms = argc >= 4 ? (uint32_t)strtoul(argv[3], NULL, 0) : TUNE_DEFAULT_STEP_MS;
+    tune_run(atoi(argv[1]), false, 0.0, 0.0, vel, ms);
+}
+
+/**
+ * Команда tune-chirp
+ */
+static void cmd_tune_chirp(int argc, char **argv) {
+    if (argc < 4) {
+        printf("ERROR: Usage: tune-chirp <idx> <f0_hz> <f1_hz> [vel] [ms]\n");
+        return;
+    }
+    double f0 = atof(argv[2]);
+    double f1 = atof(argv[3]);
+    int64_t vel = argc >= 5 ? axis_units_parse(argv[4]) : TUNE_DEFAULT_CHIRP_VEL * AXIS_UNITS_MICRO;
+    /* По умолчанию - 10 периодов нижней частоты, не больше буфера */
+    double auto_ms = f0 > 1.0 ? 10000.0 / f0 : 10000.0;
+    uint32_t ms = argc >= 6 ? (uint32_t)strtoul(argv[5], NULL, 0) : (uint32_t)auto_ms;
+    tune_run(atoi(argv[1]), true, f0, f1, vel, ms);
+}
+
+/**
+ * Команда tune-result
+ */
+static void cmd_tune_result(int argc, char **argv) {
+    if (argc >= 3 && strcmp(argv[1], "csv") == 0) {
+        if (!tune_save_csv(argv[2])) {
+            printf("ERROR: No finished record or cannot write '%s'\n", argv[2]);
+            return;
+        }
+        printf("Record saved to %s\n", argv[2]);
+        return;
+    }
+    if (argc >= 2) {
+        printf("ERROR: Usage: tune-result [csv <path>]\n");
+        return;
+    }
+    tune_print_result();
+}
+
+/**
+ * path group: оси в CSP с 0x607A = факту, включение, старт планировщика
+ */
+static void path_group(int argc, char **argv) {
+    static cyclic_stats_t st;
+    uint16_t slaves[PATH_PLAN_MAX_AXES];
+    path_axis_pdo_t pdo[PATH_PLAN_MAX_AXES];
+    int64_t start[PATH_PLAN_MAX_AXES];
+    int axes = argc - 2;
+
+    if (!pdo_active || !cyclic_running() || !cyclic_get_stats(&st)) {
+        printf("ERROR: Setpoints go out every cycle: 'pdo-start' and 'cyclic-start' first\n");
+        return;
+    }
+    if (axes < 2 || axes > PATH_PLAN_MAX_AXES) {
+        printf("ERROR: Usage: path group <x_idx> <y_idx> [z_idx]\n");
+        return;
+    }
+    /* Прежняя группа: состояние переписывается, когда поток вышел из path_plan_cycle() */
+    path_plan_release();
+    cyclic_wait_cycle(CYCLIC_WAIT_TIMEOUT_MS);
+
+    for (int i = 0; i < axes; i++) {
+        int idx = atoi(argv[2 + i]);
+        if (idx < 1 || idx > ecx_context.slavecount) {
+            printf("ERROR: Invalid slave index (1-%d)\n", ecx_context.slavecount);
+            return;
+        }
+        for (int k = 0; k < i; k++) {
+            if (slaves[k] == idx) {
+                printf("ERROR: Slave %d given twice\n", idx);
+                return;
+            }
+        }
+        if (servo_loop_attached((uint16_t)idx)) {
+            printf("ERROR: Slave %d is in the servo loop, run 'servo off %d' first\n", idx, idx);
+            return;
+        }
+        int group = axis_group_of((uint16_t)idx);
+        if (group) {
+            printf("ERROR: Slave %d is in group %d ('group %d remove %d')\n", idx, group, group, idx);
+            return;
+        }
+        if (!motor_em3e_556_axis(idx)) {
+            printf("ERROR: Slave %d has no drive PDO layout\n", idx);
+            return;
+        }
+        slaves[i] = (uint16_t)idx;
+    }
+
+    /* CSP без скачка: задание = факт до включения */
+    for (int i = 0; i < axes; i++) {
+        ec_slavet *s = &ecx_context.slavelist[slaves[i]];
+        motor_em3e_556_outputs_t *outputs = (motor_em3e_556_outputs_t *)s->outputs;
+        const motor_em3e_556_inputs_t *inputs = (const motor_em3e_556_inputs_t *)s->inputs;
+
+        outputs->target_position = inputs->actual_position;
+        if (!motor_em3e_556_set_mode(slaves[i], MODE_CYCLIC_SYNC_POS)) {
+            return;
+        }
+        if (motor_em3e_556_get_state(inputs->status_word) != STATE_OPERATION_ENABLED &&
+            !motor_em3e_556_enable(slaves[i])) {
+            return;
+        }
+        pdo[i].inputs = s->inputs;
+        pdo[i].outputs = s->outputs;
+        pdo[i].statusword = offsetof(motor_em3e_556_inputs_t, status_word);
+        pdo[i].target_position = offsetof(motor_em3e_556_outputs_t, target_position);
+        start[i] = axis_units_position(slaves[i]);
+    }
+
+    /* В виртуальном времени циклы идут в потоке CLI: планировщик - в том же шаге */
+    bool threaded = !timebase_virtual();
+    if (!path_plan_group(axes, slaves, pdo, start, st.period_us, threaded, plan_cpu)) {
+        return;
+    }
+    printf("✓ Path group:");
+    for (int i = 0; i < axes; i++) {
+        printf(" %c=slave %u", "XYZ"[i], slaves[i]);
+    }
+    printf(" in CSP at %u us, planner %s\n", st.period_us,
+           threaded ? (plan_cpu >= 0 ? "thread pinned (--plan-cpu)" : "thread") : "in the cyclic step");
+}
+
+/**
+ * Строка G-code в планировщик; ждет места в кольце сегментов
+ */
+static bool path_feed_line(const char *line, int line_no) {
+    char error[128];
+    int r;
+
+    while ((r = path_plan_gcode(line, line_no, error, sizeof(error))) == 0) {
+        soem_sleep_ms(1);
+    }
+    if (r < 0) {
+        printf("ERROR: G-code %s\n", error);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Команда path: траектория группы осей
+ */
+static void cmd_path(int argc, char **argv) {
+    if (argc < 2) {
+        path_plan_print();
+        return;
+    }
+    const char *action = argv[1];
+
+    if (strcmp(action, "group") == 0) {
+        path_group(argc, argv);
+        return;
+    }
+    if (strcmp(action, "limits") == 0 && argc >= 4) {
+        double accel = atof(argv[2]);
+        double junction = atof(argv[3]);
+        double rapid = argc >= 5 ? atof(argv[4]) : PATH_PLAN_DEFAULT_RAPID;
+        if (accel <= 0.0 || junction <= 0.0 || rapid <= 0.0) {
+            printf("ERROR: Limits must be positive\n");
+            return;
+        }
+        path_plan_set_limits(accel, junction, rapid);
+        printf("Path limits: accel %g /s^2, junction deviation %g, rapid %g /min\n", accel, junction, rapid);
+        return;
+    }
+    if (!path_plan_active()) {
+        printf("ERROR: No axis group. Run 'path group <x> <y> [z]' first.\n");
+        return;
+    }
+
+    if (strcmp(action, "gcode") == 0 && argc >= 3) {
+        char line[256];
+        int n = 0;
+        line[0] = '\0';
+        for (int i = 2; i < argc && n < (int)sizeof(line) - 1; i++) {
+            n += snprintf(line + n, sizeof(line) - (size_t)n, "%s ", argv[i]);
+        }
+        path_feed_line(line, 0);
+    } else if (strcmp(action, "run") == 0 && argc >= 3) {
+        char line[256];
+        int line_no = 0;
+        FILE *f = fopen(argv[2], "r");
+        if (!f) {
+            printf("ERROR: Cannot open '%s'\n", argv[2]);
+            return;
+        }
+        bool ok = true;
+        while (ok && fgets(line, sizeof(line), f)) {
+            line_no++;
+            ok = path_feed_line(line, line_no);
+        }
+        fclose(f);
+        if (!ok) {
+            path_plan_stop();
+            return;
+        }
+        printf("%d lines from %s queued\n", line_no, argv[2]);
+    } else if (strcmp(action, "wait") == 0) {
+        while (path_plan_state() == PATH_RUNNING) {
+            soem_sleep_ms(10);
+        }
+        path_plan_print();
+    } else if (strcmp(action, "stop") == 0) {
+        path_plan_stop();
+        printf("Path stopping at the group deceleration\n");
+    } else if (strcmp(action, "off") == 0) {
+        path_plan_release();
+        printf("Path group released (axes stay in CSP at the last setpoint)\n");
+    } else {
+        printf("ERROR: Usage: path [group <x> <y> [z]|limits <accel> <junction> [rapid]|gcode <words>|\n");
+        printf("                    run <file>|wait|stop|off]\n");
+    }
+}
+
+/* ============================================================================
+ * Группы осей: команды всем членам в одном кадре
+ * ============================================================================ */
+
+#define GROUP_ENABLE_TIMEOUT_MS 5000
+#define GROUP_HOME_TIMEOUT_S    60
+#define GROUP_MODE_TIMEOUT_MS   100
+#define GROUP_HOME_WORKERS      8        /* Потоков записи параметров homing, как у inventory */
+
+/* Режим 0x6060 группы, выставленный последней командой (0 - неизвестен) */
+static int8_t group_mode[AXIS_GROUP_MAX + 1];
+
+/* Параметры homing группы; written - уже записаны всем текущим членам */
+typedef struct {
+    bool set;
+    bool written;
+    int8_t method;               /* 0x6098 */
+    int64_t fast;                /* 0x6099:01, единиц оси/мин (x AXIS_UNITS_MICRO) */
+    int64_t slow;                /* 0x6099:02 */
+    int64_t accel;               /* 0x609A, единиц оси/мин/с, 0 - не писать */
+    int64_t offset;              /* 0x607C, единиц оси */
+} group_home_t;
+
+static group_home_t group_home[AXIS_GROUP_MAX + 1];
+
+/* Общее задание потоков записи параметров homing */
+typedef struct {
+    const group_home_t *h;
+    const uint16_t *slaves;
+    int n;
+#ifdef _WIN32
+    volatile LONG next;
+#else
+    int next;
+#endif
+    bool ok[AXIS_GROUP_MAX_MEMBERS];     /* Пишет только поток, взявший члена */
+} group_home_job_t;
+
+/**
+ * Добавить ось: те же смещения PDO, что у motor_em3e_556
+ */
+static bool group_add_axis(int group, int idx) {
+    int other = axis_group_of((uint16_t)idx);
+
+    if (idx < 1 || idx > ecx_context.slavecount) {
+        printf("ERROR: Invalid slave index (1-%d)\n", ecx_context.slavecount);
+        return false;
+    }
+    if (other != 0 && other != group) {
+        printf("ERROR: Slave %d is already in group %d\n", idx, other);
+        return false;
+    }
+    if (servo_loop_attached((uint16_t)idx)) {
+        printf("ERROR: Slave %d is in the servo loop, run 'servo off %d' first\n", idx, idx);
+        return false;
+    }
+    if (path_plan_active()) {
+        path_info_t in;
+        path_plan_info(&in);
+        for (int i = 0; i < in.axes; i++) {
+            if (in.slaves[i] == idx) {
+                printf("ERROR: Slave %d is in the path group ('path off')\n", idx);
+                return false;
+            }
+        }
+    }
+    if (!motor_em3e_556_axis(idx)) {
+        printf("ERROR: Slave %d has no drive PDO layout\n", idx);
+        return false;
+    }
+
+    ec_slavet *s = &ecx_context.slavelist[idx];
+    axis_group_pdo_t pdo = {
+        .inputs = s->inputs,
+        .outputs = s->outputs,
+        .statusword = offsetof(motor_em3e_556_inputs_t, status_word),
+        .actual_velocity = offsetof(motor_em3e_556_inputs_t, actual_velocity),
+        .control_word = offsetof(motor_em3e_556_outputs_t, control_word),
+        .target_position = offsetof(motor_em3e_556_outputs_t, target_position),
+        .target_velocity = offsetof(motor_em3e_556_outputs_t, target_velocity),
+    };
+    if (!pdo_layout_mode_offsets(idx, &pdo.mode, &pdo.mode_display)) {
+        pdo.mode = pdo.mode_display = 0;
+    }
+    if (!axis_group_add(group, (uint16_t)idx, &pdo)) {
+        printf("ERROR: Cannot add slave %d to group %d (busy or %d axes)\n", idx, group, AXIS_GROUP_MAX_MEMBERS);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Значения членам: одно на всех или по одному через запятую
+ *
+ * @return false если число значений не 1 и не равно числу членов
+ */
+static bool group_values(const char *text, int members, int64_t *values) {
+    char buf[MAX_COMMAND_LEN];
+    int n = 0;
+
+    snprintf(buf, sizeof(buf), "%s", text);
+    for (char *tok = strtok(buf, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        if (n == members) {
+            n++;
+            break;
+        }
+        values[n++] = axis_units_parse(tok);
+    }
+    if (n == 1) {
+        for (int m = 1; m < members; m++) {
+            values[m] = values[0];
+        }
+        return true;
+    }
+    if (n != members) {
+        printf("ERROR: Give one value for all %d axes or one per axis, comma-separated\n", members);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Параметры homing одного члена: 0x6098, 0x6099:01/02, 0x609A, 0x607C
+ */
+static bool group_home_write_axis(const group_home_t *h, uint16_t slave) {
+    int8_t method = h->method;
+    uint32_t fast = (uint32_t)axis_units_drive_from_vel(slave, h->fast);
+    uint32_t slow = (uint32_t)axis_units_drive_from_vel(slave, h->slow);
+    uint32_t accel = (uint32_t)axis_units_drive_from_vel(slave, h->accel);
+    int32_t offset = (int32_t)axis_units_inc_from_user(slave, h->offset);
+
+    return motor_em3e_556_write_sdo(slave, 0x6098, 0, &method, sizeof(method)) &&
+           motor_em3e_556_write_sdo(slave, 0x6099, 1, &fast, sizeof(fast)) &&
+           motor_em3e_556_write_sdo(slave, 0x6099, 2, &slow, sizeof(slow)) &&
+           (!h->accel || motor_em3e_556_write_sdo(slave, 0x609A, 0, &accel, sizeof(accel))) &&
+           motor_em3e_556_write_sdo(slave, 0x607C, 0, &offset, sizeof(offset));
+}
+
+/**
+ * Следующий член группы для записи, -1 - работы больше нет
+ */
+static int group_home_next(group_home_job_t *job) {
+#ifdef _WIN32
+    int m = (int)InterlockedIncrement(&job->next) - 1;
+#else
+    int m = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+#endif
+    return m < job->n ? m : -1;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI group_home_worker(LPVOID p) {
+#else
+static void *group_home_worker(void *p) {
+#endif
+    group_home_job_t *job = p;
+    int m;
+
+    while ((m = group_home_next(job)) >= 0) {
+        job->ok[m] = group_home_write_axis(job->h, job->slaves[m]);
+    }
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * Параметры homing всем членам по SDO (до задания)
+ *
+ * Mailbox у каждого slave свой: члены пишутся параллельно из
+ * GROUP_HOME_WORKERS потоков (как сбор inventory), время прохода - самые
+ * медленные оси, а не сумма. Повторный home без новых home-params не
+ * пишет ничего.
+ */
+static bool group_home_write(int group, const uint16_t *slaves, int n) {
+    static group_home_job_t job;
+#ifdef _WIN32
+    HANDLE threads[GROUP_HOME_WORKERS];
+#else
+    pthread_t threads[GROUP_HOME_WORKERS];
+#endif
+    group_home_t *h = &group_home[group];
+    int workers = n < GROUP_HOME_WORKERS ? n : GROUP_HOME_WORKERS;
+    int started = 0;
+    bool ok = true;
+
+    if (h->written) {
+        return true;
+    }
+    job.h = h;
+    job.slaves = slaves;
+    job.n = n;
+    job.next = 0;
+    memset(job.ok, 0, sizeof(job.ok));
+
+    for (int i = 0; i < workers; i++) {
+#ifdef _WIN32
+        threads[started] = CreateThread(NULL, 0, group_home_worker, &job, 0, NULL);
+        if (threads[started] == NULL) {
+            break;
+        }
+#else
+        if (pthread_create(&threads[started], NULL, group_home_worker, &job) != 0) {
+            break;
+        }
+#endif
+        started++;
+    }
+    if (started == 0) {
+        /* Потоки недоступны: пишем в текущем */
+        group_home_worker(&job);
+    }
+    for (int i = 0; i < started; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+
+    for (int m = 0; m < n; m++) {
+        if (!job.ok[m]) {
+            printf("ERROR: Failed to write homing parameters to slave %u\n", slaves[m]);
+            ok = false;
+        }
+    }
+    h->written = ok;
+    return ok;
+}
+
+/**
+ * Фиксация команды и ожидание цикла, который ее применит
+ */
+static bool group_commit(int group, axis_group_cmd_t cmd) {
+    axis_group_job_t job;
+
+    if (!axis_group_commit(group, cmd)) {
+        printf("ERROR: Group %d is busy ('group %d wait' or 'group %d stop')\n", group, group, group);
+        return false;
+    }
+    for (int i = 0; i < 100 && axis_group_state(group) == AXIS_JOB_PENDING; i++) {
+        soem_exchange_pdo();
+    }
+    if (axis_group_state(group) == AXIS_JOB_PENDING) {
+        axis_group_cancel(group);
+        printf("ERROR: Group %d command not applied (no cycles with a valid WKC)\n", group);
+        return false;
+    }
+    axis_group_job(group, &job);
+    if (job.state == AXIS_JOB_FAILED) {
+        printf("ERROR: Group %d %s failed: slave %u %s\n", group, axis_group_cmd_name(cmd),
+               job.fail_slave, job.fail_reason);
+        return false;
+    }
+    if (job.commit_cycle) {
+        printf("✓ Group %d: %s written to %d axes in cycle %llu (one frame)\n", group,
+               axis_group_cmd_name(cmd), job.members, (unsigned long long)job.commit_cycle);
+    }
+    return true;
+}
+
+/**
+ * Ожидание отклика всех членов
+ *
+ * @param timeout_ms 0 - без ограничения
+ */
+static bool group_wait(int group, uint32_t timeout_ms) {
+    axis_group_job_t job;
+    uint32_t waited = 0;
+
+    while (axis_group_state(group) == AXIS_JOB_ACTIVE || axis_group_state(group) == AXIS_JOB_PENDING) {
+        if (!cyclic_running() || (timeout_ms && waited >= timeout_ms)) {
+            axis_group_cancel(group);
+            printf("ERROR: Group %d timed out\n", group);
+            axis_group_print(group);
+            return false;
+        }
+        soem_sleep_ms(1);
+        waited++;
+    }
+    axis_group_job(group, &job);
+    if (job.state == AXIS_JOB_FAILED) {
+        if (job.fail_slave) {
+            printf("ERROR: Group %d %s failed: slave %u %s\n", group, axis_group_cmd_name(job.cmd),
+                   job.fail_slave, job.fail_reason);
+        } else {
+            printf("ERROR: Group %d %s %s\n", group, axis_group_cmd_name(job.cmd), job.fail_reason);
+        }
+        return false;
+    }
+    printf("✓ Group %d: %s done in cycle %llu (commit %llu), %d axes responded in cycles %llu..%llu\n",
+           group, axis_group_cmd_name(job.cmd), (unsigned long long)job.end_cycle,
+           (unsigned long long)job.commit_cycle, job.responded,
+           (unsigned long long)job.first_response, (unsigned long long)job.last_response);
+    return true;
+}
+
+/**
+ * Режим 0x6060 всем членам до фиксации команды
+ *
+ * Члены без 0x6060 в PDO - SDO по одному (блокирующе), затем члены с
+ * 0x6060 в PDO - задание группы: байт режима всем в одном цикле, ожидание
+ * 0x6061 (цикл-два). В выходы осей CLI сам не пишет.
+ */
+static bool group_set_mode(int group, const uint16_t *slaves, int n, int8_t mode) {
+    int pdo = 0;
+
+    if (group_mode[group] == mode) {
+        return true;
+    }
+    group_mode[group] = 0;
+    for (int m = 0; m < n; m++) {
+        uint16_t out, in;
+        int8_t v = mode;
+        if (pdo_layout_mode_offsets(slaves[m], &out, &in)) {
+            pdo++;
+        } else if (!motor_em3e_556_write_sdo(slaves[m], 0x6060, 0, &v, sizeof(v))) {
+            printf("ERROR: Failed to set operation mode %d on slave %u\n", mode, slaves[m]);
+            return false;
+        }
+    }
+    if (pdo > 0) {
+        for (int m = 0; m < n; m++) {
+            axis_group_stage(group, m, mode);
+        }
+        if (!group_commit(group, AXIS_GROUP_MODE) || !group_wait(group, GROUP_MODE_TIMEOUT_MS)) {
+            return false;
+        }
+    }
+    group_mode[group] = mode;
+    return true;
+}
+
+/**
+ * group <g> enable: PV у всех членов, Enable Operation в одном цикле
+ */
+static void group_enable(int group, const uint16_t *slaves, int n) {
+    int64_t t0 = timebase_now_ns();
+
+    if (!group_set_mode(group, slaves, n, MODE_PROFILE_VELOCITY) ||
+        !group_commit(group, AXIS_GROUP_ENABLE)) {
+        return;
+    }
+    if (group_wait(group, GROUP_ENABLE_TIMEOUT_MS)) {
+        printf("Enabled %d drives in %.1f ms%s\n", n, (timebase_now_ns() - t0) / 1e6,
+               timebase_virtual() ? " (virtual time)" : "");
+    }
+}
+
+/**
+ * group <g> home: HM у всех членов, бит 4 в одном цикле; CLI не ждет
+ */
+static void group_homing(int group, const uint16_t *slaves, int n, uint32_t timeout_s) {
+    static cyclic_stats_t st;
+
+    if (!group_home[group].set) {
+        printf("ERROR: No homing parameters ('group %d home-params <method> <fast> <slow> ...')\n", group);
+        return;
+    }
+    if (!cyclic_get_stats(&st) || st.period_us == 0) {
+        printf("ERROR: Cyclic period unknown\n");
+        return;
+    }
+    if (!group_home_write(group, slaves, n) ||
+        !group_set_mode(group, slaves, n, MODE_HOMING)) {
+        return;
+    }
+    axis_group_set_timeout(group, (uint32_t)((uint64_t)timeout_s * 1000000 / st.period_us));
+    bool ok = group_commit(group, AXIS_GROUP_HOME);
+    axis_group_set_timeout(group, 0);
+    if (ok) {
+        printf("Homing %d axes (timeout %u s): 'group %d' for progress, 'group %d wait' to block\n",
+               n, timeout_s, group, group);
+    }
+}
+
+/**
+ * Команда group: группы осей, команды всем членам в одном кадре
+ */
+static void cmd_group(int argc, char **argv) {
+    static uint16_t slaves[AXIS_GROUP_MAX_MEMBERS];
+    static int64_t values[AXIS_GROUP_MAX_MEMBERS];
+
+    if (!pdo_active) {
+        printf("ERROR: PDO exchange not active. Run 'pdo-start' first.\n");
+        return;
+    }
+    if (argc < 2) {
+        axis_group_print(0);
+        return;
+    }
+    int group = atoi(argv[1]);
+    if (group < 1 || group > AXIS_GROUP_MAX) {
+        printf("ERROR: Invalid group (1-%d)\n", AXIS_GROUP_MAX);
+        return;
+    }
+    if (argc < 3) {
+        axis_group_print(group);
+        return;
+    }
+    const char *action = argv[2];
+    int n = axis_group_members(group, slaves);
+
+    if (strcmp(action, "add") == 0 && argc >= 4) {
+        int added = 0;
+        for (int i = 3; i < argc; i++) {
+            int first, last;
+            if (strcmp(argv[i], "all") == 0) {
+                first = 1;
+                last = ecx_context.slavecount;
+            } else if (sscanf(argv[i], "%d-%d", &first, &last) != 2) {
+                first = last = atoi(argv[i]);
+            }
+            for (int idx = first; idx <= last; idx++) {
+                if (!group_add_axis(group, idx)) {
+                    break;
+                }
+                added++;
+            }
+        }
+        group_mode[group] = 0;
+        group_home[group].written = false;
+        printf("Group %d: %d axes (%d added)\n", group, axis_group_members(group, NULL), added);
+        return;
+    }
+    if (strcmp(action, "remove") == 0 && argc >= 4) {
+        for (int i = 3; i < argc; i++) {
+            if (!axis_group_remove(group, (uint16_t)atoi(argv[i]))) {
+                printf("ERROR: Slave %s is not in group %d or the group is busy\n", argv[i], group);
+            }
+        }
+        printf("Group %d: %d axes\n", group, axis_group_members(group, NULL));
+        return;
+    }
+    if (strcmp(action, "clear") == 0) {
+        axis_group_clear(group);
+        group_mode[group] = 0;
+        group_home[group].written = false;
+        printf("Group %d cleared (drives keep their last outputs)\n", group);
+        return;
+    }
+
+    if (n == 0) {
+        printf("ERROR: Group %d is empty ('group %d add <idx|a-b|all> ...')\n", group, group);
+        return;
+    }
+    if (!cyclic_running()) {
+        printf("ERROR: Group commands are applied by the cyclic step: 'cyclic-start' first\n");
+        return;
+    }
+    /* Смена режима по SDO не должна попасть под идущее задание; останов - можно */
+    axis_job_state_t st = axis_group_state(group);
+    if ((st == AXIS_JOB_ACTIVE || st == AXIS_JOB_PENDING) &&
+        strcmp(action, "stop") != 0 && strcmp(action, "wait") != 0) {
+        printf("ERROR: Group %d is busy ('group %d wait' or 'group %d stop')\n", group, group, group);
+        return;
+    }
+
+    if (strcmp(action, "home-params") == 0 && argc >= 6) {
+        group_home_t *h = &group_home[group];
+        h->method = (int8_t)atoi(argv[3]);
+        h->fast = axis_units_parse(argv[4]);
+        h->slow = axis_units_parse(argv[5]);
+        h->accel = argc >= 7 ? axis_units_parse(argv[6]) : 0;
+        h->offset = argc >= 8 ? axis_units_parse(argv[7]) : 0;
+        h->set = true;
+        h->written = false;
+        if (group_home_write(group, slaves, n)) {
+            printf("Group %d: homing method %d, speeds %s/%s %s written to %d axes\n", group,
+                   h->method, argv[4], argv[5], axis_units_vel_name(slaves[0]), n);
+        }
+    } else if (strcmp(action, "home") == 0) {
+        int timeout = argc >= 4 ? atoi(argv[3]) : GROUP_HOME_TIMEOUT_S;
+        group_homing(group, slaves, n, timeout > 0 ? (uint32_t)timeout : GROUP_HOME_TIMEOUT_S);
+    } else if (strcmp(action, "enable") == 0) {
+        group_enable(group, slaves, n);
+    } else if (strcmp(action, "disable") == 0) {
+        group_commit(group, AXIS_GROUP_DISABLE);
+    } else if (strcmp(action, "velocity") == 0 && argc >= 4) {
+        if (!group_values(argv[3], n, values) ||
+            !group_set_mode(group, slaves, n, MODE_PROFILE_VELOCITY)) {
+            return;
+        }
+        for (int m = 0; m < n; m++) {
+            axis_group_stage(group, m, axis_units_drive_from_vel(slaves[m], values[m]));
+        }
+        group_commit(group, AXIS_GROUP_VELOCITY);
+    } else if (strcmp(action, "move") == 0 && argc >= 4) {
+        if (!group_values(argv[3], n, values) ||
+            !group_set_mode(group, slaves, n, MODE_PROFILE_POSITION)) {
+            return;
+        }
+        for (int m = 0; m < n && argc >= 5; m++) {
+            /* 0x6081 Profile Velocity - в единицах скорости привода */
+            int64_t v = axis_units_parse(argv[4]);
+            uint32_t pv = (uint32_t)axis_units_drive_from_vel(slaves[m], v < 0 ? -v : v);
+            if (!motor_em3e_556_write_sdo(slaves[m], 0x6081, 0, &pv, sizeof(pv))) {
+                printf("ERROR: Failed to write profile velocity to slave %u\n", slaves[m]);
+                return;
+            }
+        }
+        for (int m = 0; m < n; m++) {
+            /* PP-цель в отсчетах 0x6064 (младшие 32 бита развертки) */
+            int64_t inc = axis_units_inc_from_user(slaves[m], values[m]);
+            axis_group_stage(group, m, (int32_t)(uint32_t)inc);
+        }
+        group_commit(group, AXIS_GROUP_MOVE);
+    } else if (strcmp(action, "stop") == 0) {
+        bool quick = argc >= 4 && strcmp(argv[3], "quick") == 0;
+        group_commit(group, quick ? AXIS_GROUP_QUICK_STOP : AXIS_GROUP_HALT);
+    } else if (strcmp(action, "wait") == 0) {
+        group_wait(group, 0);
+    } else {
+        printf("ERROR: Usage: group [<g> [add <idx|a-b|all>...|remove <idx>...|clear|enable|disable|\n");
+        printf("                        velocity <v[,v...]>|move <pos[,pos...]> [vel]|stop [quick]|wait|\n");
+        printf("                        home-params <method> <fast> <slow> [accel] [offset]|home [timeout_s]]]\n");
+    }
+}
+
+/**
+ * Подключение оси к контролю: смещения объектов в PDO motor_em3e_556
+ */
+static bool supervise_axis(int slave_idx) {
+    ec_slavet *s = &ecx_context.slavelist[slave_idx];
+    supervise_pdo_t pdo = {
+        .inputs = s->inputs,
+        .outputs = s->outputs,
+        .statusword = offsetof(motor_em3e_556_inputs_t, status_word),
+        .actual_position = offsetof(motor_em3e_556_inputs_t, actual_position),
+        .actual_velocity = offsetof(motor_em3e_556_inputs_t, actual_velocity),
+        .control_word = offsetof(motor_em3e_556_outputs_t, control_word),
+        .target_position = offsetof(motor_em3e_556_outputs_t, target_position),
+    };
+
+    /* Развертка и масштаб оси: предел скорости пересчитывается в единицы 0x606C */
+    if (!motor_em3e_556_axis(slave_idx)) {
+        printf("ERROR: Slave %d has no drive PDO layout (I:%d O:%d)\n", slave_idx, s->Ibytes, s->Obytes);
+        return false;
+    }
+    if (!supervise_attach((uint16_t)slave_idx, &pdo)) {
+        printf("ERROR: Cannot supervise slave %d (%d axes in use)\n", slave_idx, SUPERVISE_MAX_AXES);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Команда supervise: контроль ошибки слежения, скорости и пределов положения
+ */
+static void cmd_supervise(int argc, char **argv) {
+    if (!soem_initialized || ecx_context.slavecount == 0) {
+        printf("ERROR: No slaves found. Run 'scan' first.\n");
+        return;
+    }
+    if (argc < 2) {
+        supervise_print();
+        return;
+    }
+    if (argc < 3) {
+        printf("ERROR: Usage: supervise <idx|all> follow <counts>|velocity <vel>|position <min> <max>|\n");
+        printf("                         position off|reaction <quickstop|halt|event>|reset|off\n");
+        return;
+    }
+    if (!pdo_active || !cyclic_running()) {
+        printf("ERROR: Supervision runs in the cyclic thread: 'pdo-start' and 'cyclic-start' first\n");
+        return;
+    }
+
+    bool all = strcmp(argv[1], "all") == 0;
+    int first = all ? 1 : atoi(argv[1]);
+    int last = all ? ecx_context.slavecount : first;
+    if (first < 1 || last > ecx_context.slavecount) {
+        printf("ERROR: Invalid slave index (1-%d)\n", ecx_context.slavecount);
+        return;
+    }
+    const char *action = argv[2];
+    int n = last - first + 1;
+
+    if (strcmp(action, "off") == 0) {
+        for (int i = first; i <= last; i++) {
+            supervise_detach((uint16_t)i);
+        }
+        printf("Supervision off on %d axes (latched reactions stay in the Controlword)\n", n);
+        return;
+    }
+    if (strcmp(action, "reset") == 0) {
+        for (int i = first; i <= last; i++) {
+            supervise_reset((uint16_t)i);
+        }
+        printf("Latched reactions cleared on %d axes\n", n);
+        return;
+    }
+
+    long a = 0, b = 0;
+    int64_t vel = 0;
+    supervise_reaction_t reaction = SUPERVISE_QUICK_STOP;
+    bool position_off = false;
+
+    if (strcmp(action, "velocity") == 0 && argc >= 4) {
+        vel = axis_units_parse(argv[3]);
+        if (vel < 0) {
+            printf("ERROR: Limit must be >= 0 (0 disables the check)\n");
+            return;
+        }
+    } else if (strcmp(action, "follow") == 0 && argc >= 4) {
+        a = strtol(argv[3], NULL, 0);
+        if (a < 0) {
+            printf("ERROR: Limit must be >= 0 (0 disables the check)\n");
+            return;
+        }
+    } else if (strcmp(action, "position") == 0 && argc >= 4 && strcmp(argv[3], "off") == 0) {
+        position_off = true;
+    } else if (strcmp(action, "position") == 0 && argc >= 5) {
+        a = strtol(argv[3], NULL, 0);
+        b = strtol(argv[4], NULL, 0);
+        if (a >= b || a < INT32_MIN || b > INT32_MAX) {
+            printf("ERROR: Position limits need min < max\n");
+            return;
+        }
+    } else if (strcmp(action, "reaction") == 0 && argc >= 4) {
+        if (strcmp(argv[3], "quickstop") == 0) {
+            reaction = SUPERVISE_QUICK_STOP;
+        } else if (strcmp(argv[3], "halt") == 0) {
+            reaction = SUPERVISE_HALT;
+        } else if (strcmp(argv[3], "event") == 0) {
+            reaction = SUPERVISE_EVENT_ONLY;
+        } else {
+            printf("ERROR: Reaction must be quickstop, halt or event\n");
+            return;
+        }
+    } else {
+        printf("ERROR: Usage: supervise <idx|all> follow <counts>|velocity <vel>|position <min> <max>|\n");
+        printf("                         position off|reaction <quickstop|halt|event>|reset|off\n");
+        return;
+    }
+
+    for (int i = first; i <= last; i++) {
+        if (!supervise_axis(i)) {
+            return;
+        }
+        if (strcmp(action, "follow") == 0) {
+            supervise_set_following((uint16_t)i, (uint32_t)a);
+        } else if (strcmp(action, "velocity") == 0) {
+            supervise_set_velocity((uint16_t)i, vel);
+        } else if (strcmp(action, "position") == 0) {
+            supervise_set_position((uint16_t)i, !position_off, (int32_t)a, (int32_t)b);
+        } else {
+            supervise_set_reaction((uint16_t)i, reaction);
+        }
+    }
+
+    if (strcmp(action, "follow") == 0) {
+        printf("Following error window %ld counts on %d axes%s\n", a, n, a ? "" : " (off)");
+    } else if (strcmp(action, "velocity") == 0) {
+        printf("Velocity limit %s %s on %d axes%s\n", argv[3], axis_units_vel_name((uint16_t)first), n,
+               vel ? "" : " (off)");
+    } else if (strcmp(action, "position") == 0 && position_off) {
+        printf("Position limits off on %d axes\n", n);
+    } else if (strcmp(action, "position") == 0) {
+        printf("Position limits %ld..%ld counts on %d axes\n", a, b, n);
+    } else {
+        printf("Reaction '%s' on %d axes\n", argv[3], n);
+    }
+}
+
+/**
+ * Команда sim-axis: состояние и отказы осей модели cia402
+ */
+static void sim_axis_print(uint16_t slave) {
+    cia402_sim_info_t info;
+
+    if (cia402_sim_info(slave, &info)) {
+        printf("  %3u  %-20s %4d  0x%04X  0x%04X  %12.0f  %8.1f  %6.1f%%  %7u  %6u\n",
+               slave, info.state, info.mode, info.statusword, info.error_code,
+               info.position, info.velocity, info.torque / 10.0, info.lag_us, info.transitions);
+    }
+}
+
+static void cmd_sim_axis(int argc, char **argv) {
+    if (!cia402_sim_active()) {
+        printf("ERROR: No simulated CiA 402 axes. Start with --sim <count>:cia402\n");
+        return;
+    }
+    if (!soem_initialized || ecx_context.slavecount == 0) {
+        printf("ERROR: No slaves found. Run 'scan' first.\n");
+        return;
+    }
+    if (argc < 2) {
+        printf("Usage: sim-axis <idx|all> [lag <us>|fault [code]]\n");
+        return;
+    }
+
+    bool all = strcmp(argv[1], "all") == 0;
+    int first = all ? 1 : atoi(argv[1]);
+    int last = all ? ecx_context.slavecount : first;
+    if (first < 1 || last > ecx_context.slavecount) {
+        printf("ERROR: Invalid slave index (1-%d)\n", ecx_context.slavecount);
+        return;
+    }
+
+    if (argc >= 3 && strcmp(argv[2], "lag") == 0) {
+        long lag = argc >= 4 ? strtol(argv[3], NULL, 0) : -1;
+        if (lag < 0 || lag > 10000000L) {
+            printf("ERROR: Usage: sim-axis <idx|all> lag <us>\n");
+            return;
+        }
+        for (int i = first; i <= last; i++) {
+            cia402_sim_set_lag((uint16_t)i, (uint32_t)lag);
+        }
+        printf("Velocity lag set to %ld us on %d axes\n", lag, last - first + 1);
+        return;
+    }
+    if (argc >= 3 && strcmp(argv[2], "fault") == 0) {
+        uint16_t code = argc >= 4 ? (uint16_t)strtoul(argv[3], NULL, 0) : 0;
+        for (int i = first; i <= last; i++) {
+            cia402_sim_inject_fault((uint16_t)i, code);
+        }
+        printf("Fault 0x%04X injected on %d axes (applied on the next exchange)\n",
+               code ? code : CIA402_SIM_FAULT_EXTERNAL, last - first + 1);
+        return;
+    }
+    if (argc >= 3) {
+        printf("ERROR: Unknown action '%s'. Use 'lag' or 'fault'\n", argv[2]);
+        return;
+    }
+
+    printf("\n=== Simulated CiA 402 Axes ===\n");
+    printf("  Idx  State                Mode  SW      Error   Position(cnt)  Vel(rpm)   Torque  Lag(us)  Trans\n");
+    for (int i = first; i <= last; i++) {
+        sim_axis_print((uint16_t)i);
+    }
+    printf("\n");
+}
+
+/* ============================================================================
+ * REPL - Read-Eval-Print Loop
+ * ============================================================================ */
+
+/**
+ * Разбор строки команды на аргументы
+ */
+static int parse_command(char *line, char **argv, int max_args) {
+    int argc = 0;
+    char *token = strtok(line, " \t\n\r");
+
+    while (token != NULL && argc < max_args) {
+        argv[argc++] = token;
+        token = strtok(NULL, " \t\n\r");
+    }
+
+    return argc;
+}
+
+/**
+ * Обработка одной команды
+ */
+/* Команды, которым нужны кадры на реальной шине */
+static const char *const sim_bus_only_commands[] = {
+    "read-config", "read", "write", "text-write", "inventory", "diag-history",
+    "diag-watch", "diag-ack", "latency-map", "wkc-diag", "freshness",
+};
+
+static bool sim_unsupported_command(const char *cmd) {
+    for (size_t i = 0; i < sizeof(sim_bus_only_commands) / sizeof(sim_bus_only_commands[0]); i++) {
+        if (strcmp(cmd, sim_bus_only_commands[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool process_command(char *line) {
+    char *argv[MAX_ARGS];
+    int argc = parse_command(line, argv, MAX_ARGS);
+
+    if (argc == 0) {
+        /* Пустая команда - показываем help */
+        cmd_help();
+        return true;
+    }
+
+    /* Данные команды живут до следующей команды */
+    mem_arena_reset(&cmd_arena);
+    alloc_track_command_begin(argv[0]);
+
+    /* Обработка команд */
+    if (sim_bus_active() && sim_unsupported_command(argv[0])) {
+        printf("ERROR: '%s' needs a real bus (not available with --sim)\n", argv[0]);
+    }
+    else if (strcmp(argv[0], "help") == 0 || strcmp(argv[0], "?") == 0) {
+        cmd_help();
+    }
+    else if (strcmp(argv[0], "quit") == 0 || strcmp(argv[0], "exit") == 0) {
+        alloc_track_command_end();
+        return false;  /* Выход из REPL */
+    }
+    else if (strcmp(argv[0], "scan") == 0) {
+        soem_scan_bus();
+    }
+    else if (strcmp(argv[0], "read-config") == 0) {
+        cmd_read_config(argc, argv);
+    }
+    else if (strcmp(argv[0], "read") == 0) {
+        cmd_read(argc, argv);
+    }
+    else if (strcmp(argv[0], "write") == 0) {
+        cmd_write(argc, argv);
+    }
+    else if (strcmp(argv[0], "text-write") == 0) {
+        cmd_text_write(argc, argv);
+    }
+    else if (strcmp(argv[0], "verbose") == 0) {
+        cmd_verbose(argc, argv);
+    }
+    else if (strcmp(argv[0], "status") == 0) {
+        cmd_status();
+    }
+    else if (strcmp(argv[0], "pdo-start") == 0) {
+        cmd_pdo_start(argc, argv);
+    }
+    else if (strcmp(argv[0], "pdo-stop") == 0) {
+        cmd_pdo_stop();
+    }
+    else if (strcmp(argv[0], "pdo-read") == 0) {
+        cmd_pdo_read();
+    }
+    else if (strcmp(argv[0], "pdo-write") == 0) {
+        cmd_pdo_write(argc, argv);
+    }
+    else if (strcmp(argv[0], "pdo-loop") == 0) {
+        cmd_pdo_loop(argc, argv);
+    }
+    else if (strcmp(argv[0], "inventory") == 0) {
+        cmd_inventory(argc, argv);
+    }
+    else if (strcmp(argv[0], "diag-history") == 0) {
+        cmd_diag_history(argc, argv);
+    }
+    else if (strcmp(argv[0], "diag-watch") == 0) {
+        cmd_diag_watch(argc, argv);
+    }
+    else if (strcmp(argv[0], "diag-ack") == 0) {
+        cmd_diag_ack();
+    }
+    else if (strcmp(argv[0], "latency-map") == 0) {
+        cmd_latency_map(argc, argv);
+    }
+    else if (strcmp(argv[0], "wkc-diag") == 0) {
+        cmd_wkc_diag(argc, argv);
+    }
+    else if (strcmp(argv[0], "freshness") == 0) {
+        cmd_freshness(argc, argv);
+    }
+    else if (strcmp(argv[0], "wait") == 0) {
+        cmd_wait(argc, argv);
+    }
+    else if (strcmp(argv[0], "mem-stats") == 0) {
+        cmd_mem_stats();
+    }
+    else if (strcmp(argv[0], "timebase") == 0) {
+        cmd_timebase(argc, argv);
+    }
+    else if (strcmp(argv[0], "cyclic-start") == 0) {
+        cmd_cyclic_start(argc, argv);
+    }
+    else if (strcmp(argv[0], "cyclic-stop") == 0) {
+        cmd_cyclic_stop();
+    }
+    else if (strcmp(argv[0], "motor-enable") == 0) {
+        cmd_motor_enable(argc, argv);
+    }
+    else if (strcmp(argv[0], "motor-disable") == 0) {
+        cmd_motor_disable(argc, argv);
+    }
+    else if (strcmp(argv[0], "motor-run") == 0) {
+        cmd_motor_run(argc, argv);
+    }
+    else if (strcmp(argv[0], "motor-velocity") == 0) {
+        cmd_motor_velocity(argc, argv);
+    }
+    else if (strcmp(argv[0], "motor-stop") == 0) {
+        cmd_motor_stop(argc, argv);
+    }
+    else if (strcmp(argv[0], "motor-status") == 0) {
+        cmd_motor_status(argc, argv);
+    }
+    else if (strcmp(argv[0], "units") == 0) {
+        cmd_units(argc, argv);
+    }
+    else if (strcmp(argv[0], "servo") == 0) {
+        cmd_servo(argc, argv);
+    }
+    else if (strcmp(argv[0], "tune-step") == 0) {
+        cmd_tune_step(argc, argv);
+    }
+    else if (strcmp(argv[0], "tune-chirp") == 0) {
+        cmd_tune_chirp(argc, argv);
+    }
+    else if (strcmp(argv[0], "tune-result") == 0) {
+        cmd_tune_result(argc, argv);
+    }
+    else if (strcmp(argv[0], "path") == 0) {
+        cmd_path(argc, argv);
+    }
+    else if (strcmp(argv[0], "group") == 0) {
+        cmd_group(argc, argv);
+    }
+    else if (strcmp(argv[0], "supervise") == 0) {
+        cmd_supervise(argc, argv);
+    }
+    else if (strcmp(argv[0], "pdo-layout") == 0) {
+        cmd_pdo_layout(argc, argv);
+    }
+    else if (strcmp(argv[0], "sim-axis") == 0) {
+        cmd_sim_axis(argc, argv);
+    }
+    else {
+        printf("ERROR: Unknown command '%s'. Type 'help' for list of commands.\n", argv[0]);
+    }
+
+    alloc_track_command_end();
+    return true;
+}
+
+/**
+ * Главный цикл REPL
+ */
+static void repl_loop(void) {
+    char line[MAX_COMMAND_LEN];
+
+    printf("\nEtherCAT CLI - Interactive Mode\n");
+    printf("Type 'help' for commands, 'quit' to exit\n\n");
+
+    while (1) {
+        printf("dummy_says> ");
+        fflush(stdout);
+
+        if (fgets(line, sizeof(line), stdin) == NULL || nic_tune_stop) {
+            break;  /* EOF, ошибка или сигнал завершения */
+        }
+
+        /* Убираем trailing whitespace */
+        size_t len = strlen(line);
+        while (len > 0 && isspace((unsigned char)line[len - 1])) {
+            line[--len] = '\0';
+        }
+
+        if (len == 0) {
+            continue;  /* Пустая строка */
+        }
+
+        if (!process_command(line) || nic_tune_stop) {
+            break;  /* Команда quit/exit */
+        }
+    }
+
+    printf("\nExiting...\n");
+}
+
+/* ============================================================================
+ * Главная функция и парсинг аргументов
+ * ============================================================================ */
+
+/**
+ * Вывод информации об использовании программы
+ */
+static void print_usage(const char *prog_name) {
+    printf("Usage: %s [OPTIONS]\n", prog_name);
+    printf("\nOptions:\n");
+    printf("  -i, --interface <name>  Network interface name (required)\n");
+    printf("                          'auto' probes all interfaces and picks the one with slaves\n");
+    printf("  --rt-cpu <n>            CPU core reserved for the cyclic thread\n");
+    printf("  --plan-cpu <n>          CPU core for the path planner thread (path group)\n");
+    printf("  --tune-nic              Apply low-latency NIC/IRQ settings (restored on exit, Linux)\n");
+    printf("  --sim <count>[:model]   Simulated bus instead of -i (models below)\n");
+    printf("  --virtual-time          With --sim: cycles run in virtual time, as fast as the CPU allows\n");
+    printf("  --timer-test <period>   Run the cyclic thread without a bus (period in us) and\n");
+    printf("                          report the host wake-up latency histogram, then exit\n");
+    printf("  --timer-load <us>       Busy load per cycle in --timer-test (default 0)\n");
+    printf("  --timer-seconds <s>     Duration of --timer-test (default %d)\n", TIMER_TEST_DEFAULT_SECONDS);
+    printf("  -v, --verbose           Enable verbose output\n");
+    printf("  -h, --help              Show this help\n");
+    printf("\nExamples:\n");
+    printf("  %s -i eth0\n", prog_name);
+    printf("  %s -i auto\n", prog_name);
+    printf("  %s --timer-test 1000 --timer-load 200 --rt-cpu 3\n", prog_name);
+    printf("  %s --sim 100:io --virtual-time < script.txt\n", prog_name);
+    printf("  %s --sim 150:cia402 --virtual-time < motors.txt\n", prog_name);
+    printf("  %s -i \"\\\\Device\\\\NPF_{...}\" -v\n", prog_name);
+    printf("\nSimulation models:\n");
+    sim_bus_print_models();
+    printf("\n");
+}
+
+/**
+ * Главная функция программы
+ */
 int main(int argc, char *argv[]) {
     const char *nic_iface = NULL;
+    char auto_iface[ECAT_PROBE_NAME_LEN];
+    bool tune_nic = false;
+    uint32_t timer_period_us = 0;
+    uint32_t timer_load_us = 0;
+    int timer_seconds = TIMER_TEST_DEFAULT_SECONDS;
+    const char *sim_spec = NULL;
+    bool virtual_time = false;
 
     printf("=== EtherCAT CLI Tool ===\n");
     printf("Version 1.0 (SOEM 2.0)\n\n");
 
+    mem_arena_init(&cmd_arena, "command", cmd_arena_buf, sizeof(cmd_arena_buf));
+    timebase_init();
+
     /* Инициализация context structure */
     // memset(&ecx_context, 0, sizeof(ecx_context));
 
@@ -1595,6 +4231,56 @@ int main(int argc, char *argv[]) {
                 return 1;
             }
         }
+        else if (strcmp(argv[i], "--rt-cpu") == 0) {
+            if (i + 1 < argc) {
+                rt_cpu = atoi(argv[++i]);
+            } else {
+                printf("ERROR: --rt-cpu option requires an argument\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--plan-cpu") == 0) {
+            if (i + 1 < argc) {
+                plan_cpu = atoi(argv[++i]);
+            } else {
+                printf("ERROR: --plan-cpu option requires an argument\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--tune-nic") == 0) {
+            tune_nic = true;
+        }
+        else if (strcmp(argv[i], "--sim") == 0) {
+            if (i + 1 < argc) {
+                sim_spec = argv[++i];
+            } else {
+                printf("ERROR: --sim option requires an argument\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--virtual-time") == 0) {
+            virtual_time = true;
+        }
+        else if (strcmp(argv[i], "--timer-test") == 0 || strcmp(argv[i], "--timer-load") == 0 ||
+                 strcmp(argv[i], "--timer-seconds") == 0) {
+            if (i + 1 >= argc) {
+                printf("ERROR: %s option requires an argument\n", argv[i]);
+                print_usage(argv[0]);
+                return 1;
+            }
+            const char *opt = argv[i];
+            uint32_t value = (uint32_t)strtoul(argv[++i], NULL, 0);
+            if (strcmp(opt, "--timer-test") == 0) {
+                timer_period_us = value;
+            } else if (strcmp(opt, "--timer-load") == 0) {
+                timer_load_us = value;
+            } else {
+                timer_seconds = (int)value;
+            }
+        }
         else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
             verbose_mode = true;
             printf("Verbose mode enabled\n");
@@ -1610,6 +4296,33 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    /* Проверка таймера хоста: шина и интерфейс не нужны */
+    if (timer_period_us > 0) {
+        if (timer_seconds < 1 || timer_seconds > 3600) {
+            printf("ERROR: Invalid --timer-seconds (must be 1-3600)\n");
+            return 1;
+        }
+        return run_timer_test(timer_period_us, timer_load_us, timer_seconds);
+    }
+
+    /* Симулированная шина вместо интерфейса */
+    if (sim_spec) {
+        if (nic_iface || tune_nic) {
+            printf("ERROR: --sim cannot be combined with -i or --tune-nic\n");
+            return 1;
+        }
+        if (!soem_sim_init(sim_spec, virtual_time)) {
+            return 1;
+        }
+        repl_loop();
+        soem_cleanup();
+        return 0;
+    }
+    if (virtual_time) {
+        printf("ERROR: --virtual-time requires --sim\n");
+        return 1;
+    }
+
     /* Проверка обязательного параметра -i */
     if (nic_iface == NULL) {
         printf("ERROR: Network interface is required\n");
@@ -1617,6 +4330,14 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    /* Автоматический выбор интерфейса */
+    if (strcmp(nic_iface, "auto") == 0) {
+        if (!soem_auto_select_interface(auto_iface, sizeof(auto_iface))) {
+            return 1;
+        }
+        nic_iface = auto_iface;
+    }
+
     /* Инициализация SOEM */
     if (!soem_init(nic_iface)) {
         return 1;
@@ -1624,11 +4345,17 @@ int main(int argc, char *argv[]) {
 
     printf("SOEM initialized on interface: %s\n", nic_iface);
 
+    /* Low-latency настройки NIC */
+    if (tune_nic) {
+        soem_tune_nic();
+    }
+
     /* Запуск интерактивного режима */
     repl_loop();
 
     /* Очистка ресурсов */
     soem_cleanup();
 
-    return 0;
+    /* Откат настроек NIC - atexit */
+    return nic_tune_stop ? 130 : 0;
 }
@@ -0,0 +1,298 @@
+/*
+ * ecat_probe.c - Параллельный поиск EtherCAT сегментов на сетевых интерфейсах
+ *
+ * Все интерфейсы открываются сразу, BRD кадры уходят подряд, после чего
+ * ответы собираются опросом всех портов по кругу до истечения общего
+ * таймаута. Время опроса не зависит от количества интерфейсов.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#include <pcap.h>
+#else
+#include <time.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <ifaddrs.h>
+#endif
+
+#include "ecat_probe.h"
+#include "timebase.h"
+
+/* Состояние опроса одного интерфейса */
+typedef struct {
+    ecx_contextt *ctx;
+    uint8 idx;
+    uint16 data;
+    uint64_t t_sent_us;
+    bool pending;
+} probe_slot_t;
+
+/**
+ * Монотонное время в микросекундах
+ */
+static uint64_t probe_time_us(void) {
+    return (uint64_t)timebase_now_ns() / 1000ULL;
+}
+
+/**
+ * Добавление интерфейса в список (без дубликатов)
+ */
+static int probe_add_iface(ecat_probe_result_t *results, int count, int max_results,
+                           const char *name, const char *description) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(results[i].name, name) == 0) {
+            return count;
+        }
+    }
+    if (count >= max_results) {
+        return count;
+    }
+
+    ecat_probe_result_t *r = &results[count];
+    memset(r, 0, sizeof(*r));
+    strncpy(r->name, name, sizeof(r->name) - 1);
+    if (description) {
+        strncpy(r->description, description, sizeof(r->description) - 1);
+    }
+    return count + 1;
+}
+
+/**
+ * Перечисление поднятых интерфейсов, пригодных для EtherCAT
+ */
+static int probe_enumerate(ecat_probe_result_t *results, int max_results) {
+    int count = 0;
+
+#ifdef _WIN32
+    pcap_if_t *alldevs, *d;
+    char errbuf[PCAP_ERRBUF_SIZE];
+
+    if (pcap_findalldevs(&alldevs, errbuf) == -1) {
+        fprintf(stderr, "Error in pcap_findalldevs: %s\n", errbuf);
+        return -1;
+    }
+    for (d = alldevs; d; d = d->next) {
+        if (d->flags & PCAP_IF_LOOPBACK)
+            continue;
+        count = probe_add_iface(results, count, max_results, d->name, d->description);
+    }
+    pcap_freealldevs(alldevs);
+#else
+    struct ifaddrs *ifaddr, *ifa;
+
+    if (getifaddrs(&ifaddr) == -1) {
+        perror("getifaddrs");
+        return -1;
+    }
+    for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr == NULL || ifa->ifa_addr->sa_family != AF_PACKET)
+            continue;
+        if (!(ifa->ifa_flags & IFF_UP) || (ifa->ifa_flags & IFF_LOOPBACK))
+            continue;
+        count = probe_add_iface(results, count, max_results, ifa->ifa_name, NULL);
+    }
+    freeifaddrs(ifaddr);
+#endif
+
+    return count;
+}
+
+int ecat_probe_all(ecat_probe_result_t *results, int max_results, int timeout_ms) {
+    if (max_results > ECAT_PROBE_MAX_IFACES) {
+        max_results = ECAT_PROBE_MAX_IFACES;
+    }
+
+    int count = probe_enumerate(results, max_results);
+    if (count <= 0) {
+        return count;
+    }
+
+    probe_slot_t slots[ECAT_PROBE_MAX_IFACES];
+    memset(slots, 0, sizeof(slots));
+
+    /* Открываем все интерфейсы */
+    for (int i = 0; i < count; i++) {
+        ecx_contextt *ctx = calloc(1, sizeof(ecx_contextt));
+        if (!ctx) {
+            continue;
+        }
+        if (ecx_init(ctx, results[i].name) <= 0) {
+            free(ctx);
+            continue;
+        }
+        slots[i].ctx = ctx;
+        results[i].opened = true;
+    }
+
+    /* Отправляем BRD во все открытые интерфейсы подряд */
+    for (int i = 0; i < count; i++) {
+        probe_slot_t *s = &slots[i];
+        if (!s->ctx) {
+            continue;
+        }
+        s->idx = ecx_getindex(&s->ctx->port);
+        s->data = 0;
+        ecx_setupdatagram(&s->ctx->port, &(s->ctx->port.txbuf[s->idx]), EC_CMD_BRD, s->idx,
+                          0x0000, ECT_REG_TYPE, sizeof(s->data), &s->data);
+        s->t_sent_us = probe_time_us();
+        if (ecx_outframe_red(&s->ctx->port, s->idx) > 0) {
+            s->pending = true;
+        } else {
+            ecx_setbufstat(&s->ctx->port, s->idx, EC_BUF_EMPTY);
+        }
+    }
+
+    /* Общее окно ожидания: опрашиваем все порты по кругу */
+    uint64_t deadline = probe_time_us() + (uint64_t)timeout_ms * 1000ULL;
+    int pending;
+    do {
+        pending = 0;
+        for (int i = 0; i < count; i++) {
+            probe_slot_t *s = &slots[i];
+            if (!s->pending) {
+                continue;
+            }
+            int wkc = ecx_inframe(&s->ctx->port, s->idx, 0);
+            if (wkc > EC_NOFRAME) {
+                results[i].rtt_us = (uint32_t)(probe_time_us() - s->t_sent_us);
+                results[i].responded = true;
+                results[i].slave_count = wkc;
+                s->pending = false;
+                ecx_setbufstat(&s->ctx->port, s->idx, EC_BUF_EMPTY);
+            } else {
+                pending++;
+            }
+        }
+    } while (pending > 0 && probe_time_us() < deadline);
+
+    /* Закрываем все интерфейсы */
+    for (int i = 0; i < count; i++) {
+        probe_slot_t *s = &slots[i];
+        if (!s->ctx) {
+            continue;
+        }
+        if (s->pending) {
+            ecx_setbufstat(&s->ctx->port, s->idx, EC_BUF_EMPTY);
+        }
+        ecx_close(s->ctx);
+        free(s->ctx);
+    }
+
+    return count;
+}
+
+int ecat_probe_select_best(const ecat_probe_result_t *results, int count) {
+    int best = -1;
+
+    for (int i = 0; i < count; i++) {
+        if (!results[i].responded || results[i].slave_count <= 0) {
+            continue;
+        }
+        if (best < 0 ||
+            results[i].slave_count > results[best].slave_count ||
+            (results[i].slave_count == results[best].slave_count &&
+             results[i].rtt_us < results[best].rtt_us)) {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+void ecat_probe_print(const ecat_probe_result_t *results, int count, int timeout_ms) {
+    printf("\n=== EtherCAT Presence Probe (timeout %d ms) ===\n\n", timeout_ms);
+
+    if (count == 0) {
+        printf("No UP interfaces found.\n\n");
+        return;
+    }
+
+    printf("%-24s %-12s %-8s %-10s\n", "Interface", "Result", "Slaves", "RTT");
+    printf("-------------------------------------------------------------\n");
+
+    for (int i = 0; i < count; i++) {
+        const ecat_probe_result_t *r = &results[i];
+        const char *result;
+
+        if (!r->opened) {
+            result = "open failed";
+        } else if (!r->responded) {
+            result = "no reply";
+        } else if (r->slave_count == 0) {
+            result = "no slaves";
+        } else {
+            result = "EtherCAT";
+        }
+
+        printf("%-24s %-12s ", r->name, result);
+        if (r->responded) {
+            printf("%-8d %u us\n", r->slave_count, r->rtt_us);
+        } else {
+            printf("%-8s %s\n", "-", "-");
+        }
+        if (r->description[0]) {
+            printf("  %s\n", r->description);
+        }
+    }
+    printf("\n");
+}
+
+static int probe_cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+bool ecat_probe_rtt(ecx_portt *port, int samples, ecat_rtt_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (samples <= 0) {
+        return false;
+    }
+
+    uint32_t *rtt = malloc((size_t)samples * sizeof(uint32_t));
+    if (!rtt) {
+        return false;
+    }
+
+    uint64_t sum = 0;
+    for (int i = 0; i < samples; i++) {
+        uint16 data = 0;
+        uint64_t t0 = probe_time_us();
+        int wkc = ecx_BRD(port, 0x0000, ECT_REG_TYPE, sizeof(data), &data, EC_TIMEOUTRET);
+        uint64_t t1 = probe_time_us();
+
+        stats->samples++;
+        if (wkc > EC_NOFRAME) {
+            rtt[stats->replies++] = (uint32_t)(t1 - t0);
+            sum += t1 - t0;
+        }
+    }
+
+    if (stats->replies > 0) {
+        qsort(rtt, (size_t)stats->replies, sizeof(uint32_t), probe_cmp_u32);
+        stats->min_us = rtt[0];
+        stats->median_us = rtt[stats->replies / 2];
+        stats->p99_us = rtt[(stats->replies * 99) / 100];
+        stats->max_us = rtt[stats->replies - 1];
+        stats->avg_us = (double)sum / stats->replies;
+    }
+
+    free(rtt);
+    return stats->replies > 0;
+}
+
+void ecat_rtt_print(const char *label, const ecat_rtt_stats_t *stats) {
+    if (stats->replies == 0) {
+        printf("  %-8s no replies (%d frames sent)\n", label, stats->samples);
+        return;
+    }
+    printf("  %-8s min %4u  median %4u  avg %7.1f  p99 %4u  max %5u us  (%d/%d replies)\n",
+           label, stats->min_us, stats->median_us, stats->avg_us, stats->p99_us, stats->max_us,
+           stats->replies, stats->samples);
+}
@@ -0,0 +1,78 @@
+/*
+ * ecat_probe.h - Параллельный поиск EtherCAT сегментов на сетевых интерфейсах
+ *
+ * Открывает все поднятые интерфейсы одновременно, отправляет в каждый
+ * BRD датаграмму и собирает ответы в одном общем окне ожидания.
+ * Используется list-adapters (--probe) и dummy-ecat-cli (-i auto).
+ */
+
+#ifndef ECAT_PROBE_H
+#define ECAT_PROBE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "soem/soem.h"
+
+#define ECAT_PROBE_MAX_IFACES    16
+#define ECAT_PROBE_NAME_LEN      128
+#define ECAT_PROBE_DESC_LEN      128
+#define ECAT_PROBE_DEFAULT_TIMEOUT_MS 100
+#define ECAT_RTT_DEFAULT_SAMPLES 1000
+
+/* Результат опроса одного интерфейса */
+typedef struct {
+    char name[ECAT_PROBE_NAME_LEN];        /* Имя для ecx_init() */
+    char description[ECAT_PROBE_DESC_LEN]; /* Описание (Npcap) или пусто */
+    bool opened;                           /* ecx_init() прошел успешно */
+    bool responded;                        /* BRD вернулся в окне ожидания */
+    int slave_count;                       /* WKC ответа BRD = число slaves */
+    uint32_t rtt_us;                       /* Время круга BRD, мкс */
+} ecat_probe_result_t;
+
+/* Статистика времени круга BRD кадра */
+typedef struct {
+    int samples;                           /* Отправлено кадров */
+    int replies;                           /* Получено ответов */
+    uint32_t min_us;
+    uint32_t median_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+    double avg_us;
+} ecat_rtt_stats_t;
+
+/**
+ * Опрос всех поднятых (не loopback) интерфейсов
+ *
+ * @param results     Массив для результатов
+ * @param max_results Размер массива
+ * @param timeout_ms  Общее окно ожидания ответов
+ * @return количество опрошенных интерфейсов, -1 при ошибке перечисления
+ */
+int ecat_probe_all(ecat_probe_result_t *results, int max_results, int timeout_ms);
+
+/**
+ * Выбор лучшего интерфейса: больше всего slaves, при равенстве - меньший RTT
+ *
+ * @return индекс в results или -1, если EtherCAT не найден ни на одном
+ */
+int ecat_probe_select_best(const ecat_probe_result_t *results, int count);
+
+/**
+ * Вывод таблицы результатов опроса
+ */
+void ecat_probe_print(const ecat_probe_result_t *results, int count, int timeout_ms);
+
+/**
+ * Измерение времени круга: samples последовательных BRD кадров на открытом порту
+ *
+ * @return true если получен хотя бы один ответ
+ */
+bool ecat_probe_rtt(ecx_portt *port, int samples, ecat_rtt_stats_t *stats);
+
+/**
+ * Вывод одной строки статистики RTT
+ */
+void ecat_rtt_print(const char *label, const ecat_rtt_stats_t *stats);
+
+#endif /* ECAT_PROBE_H */
@@ -0,0 +1,217 @@
+/*
+ * ecat_zerocopy.c - Циклический обмен без копирования образа процесса
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ecat_zerocopy.h"
+
+/* Не больше половины индексов SOEM: остальное для mailbox и служебных кадров */
+#define ZC_MAX_FRAMES (EC_MAXBUF / 2)
+
+/**
+ * Сегмент, целиком содержащий участок образа
+ * @return индекс сегмента или -1
+ */
+static int zc_find_segment(const ecat_zc_t *zc, uint32_t offset, uint32_t len) {
+    for (int i = 0; i < zc->nsegments; i++) {
+        const ecat_zc_segment_t *s = &zc->seg[i];
+        if (offset >= s->image_offset && offset + len <= s->image_offset + s->length) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Перевод указателя из IOmap в буфер кадра
+ */
+static uint8 *zc_remap(ecat_zc_t *zc, uint8 *ptr, uint32_t len, bool output) {
+    uint32_t offset = (uint32_t)(ptr - zc->image);
+    int i = zc_find_segment(zc, offset, len);
+    if (i < 0) {
+        return NULL;
+    }
+    uint8_t *base = output ? zc->seg[i].tx_data : zc->seg[i].rx_data;
+    return base + (offset - zc->seg[i].image_offset);
+}
+
+bool ecat_zc_setup(ecat_zc_t *zc, ecx_contextt *ctx, uint8_t group) {
+    ec_groupt *grp = &ctx->grouplist[group];
+    ecx_portt *port = &ctx->port;
+
+    memset(zc, 0, sizeof(*zc));
+    zc->ctx = ctx;
+    zc->group = group;
+    zc->obytes = grp->Obytes;
+    zc->ibytes = grp->Ibytes;
+    zc->image = grp->outputs ? grp->outputs : grp->inputs;
+
+    uint32_t total = zc->obytes + zc->ibytes;
+    if (!zc->image || total == 0) {
+        printf("ERROR: Group %u has no process data\n", group);
+        return false;
+    }
+    if (grp->blockLRW) {
+        printf("ERROR: Group %u uses separate LRD/LWR (blockLRW), zero-copy needs LRW\n", group);
+        return false;
+    }
+
+    /* Сегменты в том же порядке, что у ecx_send_processdata() */
+    uint32_t offset = 0;
+    while (offset < total) {
+        if (zc->nsegments >= ZC_MAX_FRAMES) {
+            printf("ERROR: Process image needs more than %d frames\n", ZC_MAX_FRAMES);
+            return false;
+        }
+        uint32_t len = zc->nsegments < grp->nsegments ? grp->IOsegment[zc->nsegments] : 0;
+        if (len == 0 || len > total - offset) {
+            len = total - offset;
+        }
+        if (len > EC_MAXLRWDATA) {
+            len = EC_MAXLRWDATA;
+        }
+        zc->seg[zc->nsegments].image_offset = offset;
+        zc->seg[zc->nsegments].length = (uint16_t)len;
+        zc->nsegments++;
+        offset += len;
+    }
+
+    /* Данные каждого slave должны лежать внутри одного кадра */
+    for (int i = 1; i <= ctx->slavecount; i++) {
+        ec_slavet *s = &ctx->slavelist[i];
+        if (s->group != group) {
+            continue;
+        }
+        if (s->outputs && s->Obits > 0 &&
+            zc_find_segment(zc, (uint32_t)(s->outputs - zc->image), s->Obytes ? s->Obytes : 1) < 0) {
+            printf("ERROR: Slave %d outputs cross a frame boundary\n", i);
+            return false;
+        }
+        if (s->inputs && s->Ibits > 0 &&
+            zc_find_segment(zc, (uint32_t)(s->inputs - zc->image), s->Ibytes ? s->Ibytes : 1) < 0) {
+            printf("ERROR: Slave %d inputs cross a frame boundary\n", i);
+            return false;
+        }
+    }
+
+    /* Резервируем индексы и собираем кадры один раз */
+    for (int n = 0; n < zc->nsegments; n++) {
+        ecat_zc_segment_t *seg = &zc->seg[n];
+        uint32_t logadr = grp->logstartaddr + seg->image_offset;
+
+        seg->idx = ecx_getindex(port);
+        ecx_setupdatagram(port, &(port->txbuf[seg->idx]), EC_CMD_LRW, seg->idx,
+                          (uint16)(logadr & 0xFFFF), (uint16)(logadr >> 16),
+                          seg->length, zc->image + seg->image_offset);
+        if (n == 0 && grp->hasdc) {
+            int64 dc_zero = 0;
+            seg->dc_offset = ecx_adddatagram(port, &(port->txbuf[seg->idx]), EC_CMD_FRMW, seg->idx,
+                                             FALSE, ctx->slavelist[grp->DCnext].configadr,
+                                             ECT_REG_DCSYSTIME, sizeof(dc_zero), &dc_zero);
+        }
+
+        seg->tx_data = &(port->txbuf[seg->idx][ETH_HEADERSIZE + EC_HEADERSIZE]);
+        seg->rx_data = &(port->rxbuf[seg->idx][EC_HEADERSIZE]);
+        seg->tx_wkc = seg->tx_data + seg->length;
+
+        /* До первого приема входы в RX кадре совпадают с IOmap */
+        memcpy(seg->rx_data, zc->image + seg->image_offset, seg->length);
+    }
+
+    /* Приложение теперь пишет выходы прямо в TX кадр и читает входы из RX */
+    for (int i = 1; i <= ctx->slavecount; i++) {
+        ec_slavet *s = &ctx->slavelist[i];
+        if (s->group != group) {
+            continue;
+        }
+        zc->orig_outputs[i] = s->outputs;
+        zc->orig_inputs[i] = s->inputs;
+        if (s->outputs && s->Obits > 0) {
+            s->outputs = zc_remap(zc, s->outputs, s->Obytes ? s->Obytes : 1, true);
+        }
+        if (s->inputs && s->Ibits > 0) {
+            s->inputs = zc_remap(zc, s->inputs, s->Ibytes ? s->Ibytes : 1, false);
+        }
+    }
+
+    zc->active = true;
+    return true;
+}
+
+void ecat_zc_release(ecat_zc_t *zc) {
+    if (!zc->active) {
+        return;
+    }
+
+    ecx_contextt *ctx = zc->ctx;
+
+    /* Последнее состояние образа возвращается в IOmap */
+    for (int n = 0; n < zc->nsegments; n++) {
+        ecat_zc_segment_t *seg = &zc->seg[n];
+        uint32_t start = seg->image_offset;
+        uint32_t end = seg->image_offset + seg->length;
+        uint32_t split = zc->obytes < start ? start : (zc->obytes > end ? end : zc->obytes);
+
+        memcpy(zc->image + start, seg->tx_data, split - start);
+        memcpy(zc->image + split, seg->rx_data + (split - start), end - split);
+        ecx_setbufstat(&ctx->port, seg->idx, EC_BUF_EMPTY);
+    }
+
+    for (int i = 1; i <= ctx->slavecount; i++) {
+        if (ctx->slavelist[i].group != zc->group) {
+            continue;
+        }
+        ctx->slavelist[i].outputs = zc->orig_outputs[i];
+        ctx->slavelist[i].inputs = zc->orig_inputs[i];
+    }
+
+    zc->active = false;
+}
+
+int ecat_zc_exchange(ecat_zc_t *zc, int timeout_us) {
+    ecx_portt *port = &zc->ctx->port;
+    bool lost = false;
+    int wkc = 0;
+
+    for (int n = 0; n < zc->nsegments; n++) {
+        ecat_zc_segment_t *seg = &zc->seg[n];
+        seg->tx_wkc[0] = 0;
+        seg->tx_wkc[1] = 0;
+        ecx_outframe_red(port, seg->idx);
+    }
+
+    for (int n = 0; n < zc->nsegments; n++) {
+        ecat_zc_segment_t *seg = &zc->seg[n];
+        if (ecx_waitinframe(port, seg->idx, timeout_us) > EC_NOFRAME) {
+            /* WKC именно LRW датаграммы: за ней может идти FRMW для DC */
+            wkc += seg->rx_data[seg->length] | (seg->rx_data[seg->length + 1] << 8);
+            if (seg->dc_offset) {
+                memcpy(&zc->dc_time, &(port->rxbuf[seg->idx][seg->dc_offset]), sizeof(zc->dc_time));
+                /* Как ecx_receive_processdata: код, читающий ecx_context.DCtime, видит свежее время */
+                zc->ctx->DCtime = zc->dc_time;
+            }
+        } else {
+            lost = true;
+        }
+        /* Индекс остается за нами: ecx_getindex() берет только EC_BUF_EMPTY */
+        ecx_setbufstat(port, seg->idx, EC_BUF_ALLOC);
+    }
+
+    return lost ? EC_NOFRAME : wkc;
+}
+
+uint8_t *ecat_zc_image_ptr(ecat_zc_t *zc, uint32_t offset, uint32_t len) {
+    int i = zc_find_segment(zc, offset, len);
+    if (i < 0) {
+        return NULL;
+    }
+
+    bool output = offset < zc->obytes;
+    if (output && offset + len > zc->obytes) {
+        return NULL;
+    }
+    uint8_t *base = output ? zc->seg[i].tx_data : zc->seg[i].rx_data;
+    return base + (offset - zc->seg[i].image_offset);
+}
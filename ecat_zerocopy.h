@@ -0,0 +1,74 @@
+/*
+ * ecat_zerocopy.h - Циклический обмен без копирования образа процесса
+ *
+ * Обычный ecx_send_processdata() на каждом цикле копирует образ из IOmap
+ * в буфер кадра, а ecx_receive_processdata() - принятые данные обратно.
+ * В режиме zero-copy для каждого IO сегмента один раз резервируется индекс
+ * SOEM и собирается LRW кадр; указатели outputs/inputs slaves переводятся
+ * в TX/RX буферы этих кадров. На цикле в TX кадре обнуляется только WKC,
+ * кадры отправляются как есть, выходы пишутся приложением прямо в кадр.
+ */
+
+#ifndef ECAT_ZEROCOPY_H
+#define ECAT_ZEROCOPY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "soem/soem.h"
+
+/* Один LRW кадр образа процесса */
+typedef struct {
+    uint8 idx;                 /* Зарезервированный индекс SOEM */
+    uint32_t image_offset;     /* Смещение сегмента в образе (от начала outputs) */
+    uint16_t length;
+    uint8_t *tx_data;          /* Данные датаграммы в txbuf[idx] */
+    uint8_t *rx_data;          /* Данные датаграммы в rxbuf[idx] */
+    uint8_t *tx_wkc;
+    uint16_t dc_offset;        /* Смещение FRMW DC времени в rxbuf (0 - нет) */
+} ecat_zc_segment_t;
+
+typedef struct {
+    bool active;
+    ecx_contextt *ctx;
+    uint8_t group;
+    uint8_t *image;            /* Начало образа в IOmap (grouplist.outputs) */
+    uint32_t obytes;
+    uint32_t ibytes;
+    int nsegments;
+    ecat_zc_segment_t seg[EC_MAXIOSEGMENTS];
+    int64_t dc_time;           /* Системное время DC из последнего цикла */
+    uint8 *orig_outputs[EC_MAXSLAVE];  /* Указатели в IOmap для отката */
+    uint8 *orig_inputs[EC_MAXSLAVE];
+} ecat_zc_t;
+
+/**
+ * Построение кадров и перевод указателей slaves группы в буферы кадров.
+ * Текущее содержимое IOmap копируется в кадры один раз.
+ *
+ * @return false если группа не подходит (blockLRW, данные slave на границе
+ *         сегментов, не хватает индексов) - состояние не меняется
+ */
+bool ecat_zc_setup(ecat_zc_t *zc, ecx_contextt *ctx, uint8_t group);
+
+/**
+ * Возврат к IOmap: выходы копируются обратно, индексы освобождаются
+ */
+void ecat_zc_release(ecat_zc_t *zc);
+
+/**
+ * Один цикл: отправка всех кадров, прием и сумма WKC
+ *
+ * @return WKC или EC_NOFRAME если хотя бы один кадр не вернулся
+ */
+int ecat_zc_exchange(ecat_zc_t *zc, int timeout_us);
+
+/**
+ * Указатель на участок образа (выходы - TX кадр, входы - RX кадр)
+ *
+ * @param offset Смещение от начала образа (outputs, затем inputs)
+ * @return NULL если участок пересекает границу кадров
+ */
+uint8_t *ecat_zc_image_ptr(ecat_zc_t *zc, uint32_t offset, uint32_t len);
+
+#endif /* ECAT_ZEROCOPY_H */
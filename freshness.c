@@ -0,0 +1,393 @@
+/*
+ * freshness.c - Контроль обновления входов slaves (stale inputs)
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freshness.h"
+
+#define FR_REG_FMMU_COUNT   0x0004       /* Количество FMMU в ESC */
+#define FR_FMMU_SIZE        16
+#define FR_FMMU_ACTIVATE    12           /* Смещение байта активации в FMMU */
+#define FR_SM_SIZE          8
+#define FR_SM_STATUS        5            /* Смещение байта статуса в SM */
+#define FR_SMTYPE_INPUTS    4
+#define FR_SM_MODE_MASK     0x03         /* 00 - 3-буферный режим */
+
+typedef struct {
+    uint8_t source;
+    uint8_t sm;                  /* Входной SM (источник SM_STATUS) */
+    uint8_t fmmu;                /* Занятый FMMU */
+    uint16_t lrd_pos;            /* Байт статуса в LRD датаграмме */
+    const uint8_t *counter_ptr;  /* Счетчик в образе (источник COUNTER) */
+    uint8_t last[FRESHNESS_MAX_COUNTER];
+    bool primed;
+    uint32_t unchanged;          /* Циклов подряд без изменения */
+    uint32_t max_unchanged;
+    uint32_t stale_events;
+    uint64_t stale_cycles;
+} fr_slave_t;
+
+static ecx_contextt *fr_ctx = NULL;
+static bool fr_enabled = false;
+static bool fr_off_request = false;      /* Снимает циклический поток после freshness_check() */
+static int fr_threshold = FRESHNESS_DEFAULT_CYCLES;
+
+/* Настройка счетчиков сохраняется между включениями */
+static uint16_t fr_counter_offset[EC_MAXSLAVE];
+static uint8_t fr_counter_len[EC_MAXSLAVE];
+
+static fr_slave_t fr_slave[EC_MAXSLAVE];
+static uint16_t fr_list[EC_MAXSLAVE];
+static int fr_nlist = 0;
+static uint16_t fr_skipped[EC_MAXSLAVE];
+static int fr_nskipped = 0;
+
+static uint8 fr_status[EC_MAXSLAVE];
+static int fr_nbytes = 0;
+static uint8 fr_idx = 0;
+static bool fr_sent = false;
+
+static uint32_t fr_stale[FRESHNESS_BITMAP_WORDS];
+static int fr_stale_count = 0;
+static uint64_t fr_cycles = 0;
+static uint64_t fr_lost = 0;
+static uint64_t fr_wkc_short = 0;
+
+static bool fr_get_flag(const bool *p) {
+#ifdef _WIN32
+    return *(const volatile bool *)p;            /* Windows: все в одном потоке */
+#else
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void fr_set_flag(bool *p, bool v) {
+#ifdef _WIN32
+    *(volatile bool *)p = v;
+#else
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#endif
+}
+
+bool freshness_set_counter(int slave, uint16_t offset, uint8_t len) {
+    if (slave < 1 || slave >= EC_MAXSLAVE || len > FRESHNESS_MAX_COUNTER) {
+        return false;
+    }
+    fr_counter_offset[slave] = offset;
+    fr_counter_len[slave] = len;
+    return true;
+}
+
+/**
+ * Свободный FMMU slave: не занят конфигурацией SOEM и есть в ESC
+ */
+static int fr_find_fmmu(ecx_contextt *ctx, int slave) {
+    ec_slavet *s = &ctx->slavelist[slave];
+    uint8 count = 0;
+
+    if (ecx_FPRD(&ctx->port, s->configadr, FR_REG_FMMU_COUNT, sizeof(count), &count, EC_TIMEOUTRET) <= 0) {
+        return -1;
+    }
+    for (int f = 0; f < count && f < EC_MAXFMMU; f++) {
+        if (!s->FMMU[f].FMMUactive) {
+            return f;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Входной SM в 3-буферном режиме (байт статуса показывает номер буфера)
+ */
+static int fr_find_input_sm(ec_slavet *s) {
+    for (int n = 0; n < EC_MAXSM; n++) {
+        if (s->SMtype[n] == FR_SMTYPE_INPUTS && s->SM[n].SMlength > 0 &&
+            (s->SM[n].SMflags & FR_SM_MODE_MASK) == 0) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+/**
+ * FMMU чтения байта статуса SM в логический адрес
+ */
+static bool fr_map_status(ecx_contextt *ctx, int slave, int fmmu, int sm, uint32_t logaddr) {
+    uint16_t phys = (uint16_t)(ECT_REG_SM0 + sm * FR_SM_SIZE + FR_SM_STATUS);
+    uint8 cfg[FR_FMMU_SIZE];
+
+    memset(cfg, 0, sizeof(cfg));
+    cfg[0] = (uint8)(logaddr & 0xFF);
+    cfg[1] = (uint8)((logaddr >> 8) & 0xFF);
+    cfg[2] = (uint8)((logaddr >> 16) & 0xFF);
+    cfg[3] = (uint8)((logaddr >> 24) & 0xFF);
+    cfg[4] = 1;                  /* Длина: 1 байт */
+    cfg[6] = 0;                  /* Биты 0..7 */
+    cfg[7] = 7;
+    cfg[8] = (uint8)(phys & 0xFF);
+    cfg[9] = (uint8)(phys >> 8);
+    cfg[11] = 1;                 /* Тип: чтение */
+    cfg[FR_FMMU_ACTIVATE] = 1;
+
+    return ecx_FPWR(&ctx->port, ctx->slavelist[slave].configadr,
+                    (uint16)(ECT_REG_FMMU0 + fmmu * FR_FMMU_SIZE),
+                    sizeof(cfg), cfg, EC_TIMEOUTRET) == 1;
+}
+
+int freshness_enable(ecx_contextt *ctx, uint8_t group, int cycles, freshness_image_fn image_ptr) {
+    ec_groupt *grp = &ctx->grouplist[group];
+    uint8_t *image = grp->outputs ? grp->outputs : grp->inputs;
+    int count = ctx->slavecount < EC_MAXSLAVE ? ctx->slavecount : EC_MAXSLAVE - 1;
+
+    freshness_disable();
+
+    fr_ctx = ctx;
+    fr_threshold = cycles > 0 ? cycles : FRESHNESS_DEFAULT_CYCLES;
+    fr_nlist = 0;
+    fr_nskipped = 0;
+    fr_nbytes = 0;
+    memset(fr_slave, 0, sizeof(fr_slave));
+    if (!image) {
+        return -1;
+    }
+
+    for (int i = 1; i <= count; i++) {
+        ec_slavet *s = &ctx->slavelist[i];
+        fr_slave_t *fs = &fr_slave[i];
+
+        if (s->group != group || !s->inputs || s->Ibits == 0) {
+            continue;
+        }
+
+        if (fr_counter_len[i] > 0) {
+            size_t offset = (size_t)(s->inputs - image) + fr_counter_offset[i];
+            if (fr_counter_offset[i] + fr_counter_len[i] > s->Ibytes ||
+                !(fs->counter_ptr = image_ptr(offset, fr_counter_len[i]))) {
+                fr_skipped[fr_nskipped++] = (uint16_t)i;
+                continue;
+            }
+            fs->source = FRESHNESS_COUNTER;
+            fr_list[fr_nlist++] = (uint16_t)i;
+            continue;
+        }
+
+        int sm = fr_find_input_sm(s);
+        int fmmu = sm >= 0 ? fr_find_fmmu(ctx, i) : -1;
+        if (fmmu < 0 || !fr_map_status(ctx, i, fmmu, sm, FRESHNESS_LOGADDR + (uint32_t)fr_nbytes)) {
+            fr_skipped[fr_nskipped++] = (uint16_t)i;
+            continue;
+        }
+        fs->source = FRESHNESS_SM_STATUS;
+        fs->sm = (uint8_t)sm;
+        fs->fmmu = (uint8_t)fmmu;
+        fs->lrd_pos = (uint16_t)fr_nbytes++;
+        fr_list[fr_nlist++] = (uint16_t)i;
+    }
+
+    memset(fr_stale, 0, sizeof(fr_stale));
+    fr_stale_count = 0;
+    fr_cycles = 0;
+    fr_lost = 0;
+    fr_wkc_short = 0;
+    fr_sent = false;
+    fr_set_flag(&fr_enabled, fr_nlist > 0);
+    return fr_nlist;
+}
+
+void freshness_request_off(void) {
+    if (fr_get_flag(&fr_enabled)) {
+        fr_set_flag(&fr_off_request, true);
+    }
+}
+
+void freshness_disable(void) {
+    if (!fr_ctx) {
+        return;
+    }
+    fr_set_flag(&fr_enabled, false);
+    fr_set_flag(&fr_off_request, false);
+
+    /* Кадр, отправленный без парного freshness_check(), возвращаем SOEM */
+    if (fr_sent) {
+        ecx_setbufstat(&fr_ctx->port, fr_idx, EC_BUF_EMPTY);
+        fr_sent = false;
+    }
+
+    for (int n = 0; n < fr_nlist; n++) {
+        fr_slave_t *fs = &fr_slave[fr_list[n]];
+        uint8 off = 0;
+        if (fs->source == FRESHNESS_SM_STATUS) {
+            ecx_FPWR(&fr_ctx->port, fr_ctx->slavelist[fr_list[n]].configadr,
+                     (uint16)(ECT_REG_FMMU0 + fs->fmmu * FR_FMMU_SIZE + FR_FMMU_ACTIVATE),
+                     sizeof(off), &off, EC_TIMEOUTRET);
+        }
+    }
+    fr_nbytes = 0;
+}
+
+bool freshness_enabled(void) {
+    return fr_get_flag(&fr_enabled);
+}
+
+void freshness_send(void) {
+    fr_sent = false;
+    if (!fr_get_flag(&fr_enabled) || fr_nbytes == 0) {
+        return;
+    }
+
+    ecx_portt *port = &fr_ctx->port;
+    fr_idx = ecx_getindex(port);
+    memset(fr_status, 0, (size_t)fr_nbytes);
+    ecx_setupdatagram(port, &(port->txbuf[fr_idx]), EC_CMD_LRD, fr_idx,
+                      (uint16)(FRESHNESS_LOGADDR & 0xFFFF), (uint16)(FRESHNESS_LOGADDR >> 16),
+                      (uint16)fr_nbytes, fr_status);
+    ecx_outframe_red(port, fr_idx);
+    fr_sent = true;
+}
+
+/**
+ * Учет одного признака: изменился или нет
+ */
+static void fr_account(int slave, bool changed) {
+    fr_slave_t *fs = &fr_slave[slave];
+    uint32_t bit = 1u << (slave & 31);
+
+    if (changed) {
+        if (fs->unchanged >= (uint32_t)fr_threshold) {
+            fr_stale[slave >> 5] &= ~bit;
+            fr_stale_count--;
+        }
+        fs->unchanged = 0;
+        return;
+    }
+
+    fs->unchanged++;
+    if (fs->unchanged > fs->max_unchanged) {
+        fs->max_unchanged = fs->unchanged;
+    }
+    if (fs->unchanged == (uint32_t)fr_threshold) {
+        fr_stale[slave >> 5] |= bit;
+        fr_stale_count++;
+        fs->stale_events++;
+    }
+    if (fs->unchanged >= (uint32_t)fr_threshold) {
+        fs->stale_cycles++;
+    }
+}
+
+void freshness_check(int timeout_us, bool inputs_ok) {
+    if (!fr_get_flag(&fr_enabled)) {
+        return;
+    }
+
+    bool status_ok = false;
+    if (fr_sent) {
+        ecx_portt *port = &fr_ctx->port;
+        if (ecx_waitinframe(port, fr_idx, timeout_us) > EC_NOFRAME) {
+            const uint8 *rx = &(port->rxbuf[fr_idx][EC_HEADERSIZE]);
+            int wkc = rx[fr_nbytes] | (rx[fr_nbytes + 1] << 8);
+            memcpy(fr_status, rx, (size_t)fr_nbytes);
+            if (wkc < fr_nbytes) {
+                fr_wkc_short++;
+            }
+            status_ok = true;
+        } else {
+            fr_lost++;
+        }
+        ecx_setbufstat(port, fr_idx, EC_BUF_EMPTY);
+        fr_sent = false;
+    }
+
+    for (int n = 0; n < fr_nlist; n++) {
+        int slave = fr_list[n];
+        fr_slave_t *fs = &fr_slave[slave];
+
+        if (fs->source == FRESHNESS_SM_STATUS) {
+            /* Без кадра статуса цикл для этих slaves не учитывается */
+            if (!status_ok) {
+                continue;
+            }
+            uint8_t buf = (fr_status[fs->lrd_pos] >> 4) & 0x03;
+            if (fs->primed) {
+                fr_account(slave, buf != fs->last[0]);
+            }
+            fs->last[0] = buf;
+        } else {
+            /* Входы не обновлены в этом цикле: счетчик не показатель */
+            if (!inputs_ok) {
+                continue;
+            }
+            uint8_t len = fr_counter_len[slave];
+            if (fs->primed) {
+                fr_account(slave, memcmp(fs->counter_ptr, fs->last, len) != 0);
+            }
+            memcpy(fs->last, fs->counter_ptr, len);
+        }
+        fs->primed = true;
+    }
+    fr_cycles++;
+
+    /* Кадр статуса уже возвращен: следующий freshness_send() ничего не начнет */
+    if (fr_get_flag(&fr_off_request)) {
+        fr_set_flag(&fr_enabled, false);
+        fr_set_flag(&fr_off_request, false);
+    }
+}
+
+const uint32_t *freshness_stale_bitmap(int *stale_count) {
+    if (stale_count) {
+        *stale_count = fr_stale_count;
+    }
+    return fr_stale;
+}
+
+void freshness_print(void) {
+    printf("\n=== Input Freshness ===\n");
+    bool enabled = fr_get_flag(&fr_enabled);
+    printf("Mode:              %s", enabled ? "enabled" : "off");
+    if (enabled) {
+        printf(" (stale after %d unchanged cycles)", fr_threshold);
+    }
+    printf("\n");
+    if (!fr_ctx || fr_nlist == 0) {
+        printf("\n");
+        return;
+    }
+
+    printf("Cycles checked:    %llu\n", (unsigned long long)fr_cycles);
+    if (fr_nbytes > 0) {
+        printf("Status frames:     %d byte(s) per cycle, %llu lost, %llu with short WKC\n",
+               fr_nbytes, (unsigned long long)fr_lost, (unsigned long long)fr_wkc_short);
+    }
+    printf("Stale now:         %d slave(s)\n\n", fr_stale_count);
+
+    printf("%-5s %-20s %-18s %-10s %-10s %-8s %-12s\n",
+           "Slave", "Name", "Source", "Unchanged", "Max", "Events", "Stale cycles");
+    printf("--------------------------------------------------------------------------------------\n");
+    for (int n = 0; n < fr_nlist; n++) {
+        int slave = fr_list[n];
+        const fr_slave_t *fs = &fr_slave[slave];
+        char source[24];
+
+        if (fs->source == FRESHNESS_SM_STATUS) {
+            snprintf(source, sizeof(source), "SM%u status/FMMU%u", fs->sm, fs->fmmu);
+        } else {
+            snprintf(source, sizeof(source), "counter +%u/%u", fr_counter_offset[slave], fr_counter_len[slave]);
+        }
+        printf("%-5d %-20.20s %-18s %-10u %-10u %-8u %-12llu%s\n",
+               slave, fr_ctx->slavelist[slave].name, source, fs->unchanged, fs->max_unchanged,
+               fs->stale_events, (unsigned long long)fs->stale_cycles,
+               fs->unchanged >= (uint32_t)fr_threshold ? " STALE" : "");
+    }
+
+    if (fr_nskipped > 0) {
+        printf("\nNot monitored (no free FMMU, no 3-buffer input SM or bad counter):");
+        for (int n = 0; n < fr_nskipped; n++) {
+            printf(" %d", fr_skipped[n]);
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
@@ -0,0 +1,99 @@
+/*
+ * freshness.h - Контроль обновления входов slaves (stale inputs)
+ *
+ * Правильный WKC значит лишь, что ESC ответил: если PDI slave завис,
+ * ESC продолжает отдавать последний записанный буфер. Признак свежести:
+ *
+ *  - байт статуса входного SyncManager (0x0805 + 8 x n), биты 4-5 -
+ *    номер последнего записанного PDI буфера в 3-буферном режиме. Байт
+ *    отображается свободным FMMU slave в отдельную логическую область и
+ *    читается одной LRD датаграммой в каждом цикле;
+ *  - счетчик slave (например, toggle/counter в PDO входов), заданный
+ *    смещением в его входных данных: freshness_set_counter().
+ *
+ * Slave, у которого признак не менялся заданное число циклов, отмечается
+ * в битовой карте устаревших входов. Номер буфера повторяется и при двух
+ * записях PDI между чтениями мастера, поэтому порог берется больше 1.
+ */
+
+#ifndef FRESHNESS_H
+#define FRESHNESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "soem/soem.h"
+
+#define FRESHNESS_DEFAULT_CYCLES 10
+#define FRESHNESS_LOGADDR        0x0F000000u  /* Логическая область байтов статуса SM */
+#define FRESHNESS_MAX_COUNTER    4            /* Байт счетчика slave */
+#define FRESHNESS_BITMAP_WORDS   ((EC_MAXSLAVE + 31) / 32)
+
+/* Источник признака свежести */
+typedef enum {
+    FRESHNESS_NONE = 0,
+    FRESHNESS_SM_STATUS,         /* Байт статуса входного SM через FMMU */
+    FRESHNESS_COUNTER            /* Счетчик во входных данных slave */
+} freshness_source_t;
+
+/* Указатель на участок образа процесса (IOmap или буферы zero-copy) */
+typedef uint8_t *(*freshness_image_fn)(size_t offset, size_t len);
+
+/**
+ * Задать счетчик slave вместо статуса SM (до freshness_enable)
+ *
+ * @param offset Смещение в байтах от начала входных данных slave
+ * @param len    1..FRESHNESS_MAX_COUNTER, 0 - убрать счетчик
+ */
+bool freshness_set_counter(int slave, uint16_t offset, uint8_t len);
+
+/**
+ * Включить контроль для slaves группы с входами
+ *
+ * Настраивает FMMU для байтов статуса SM (slaves уже в SAFE-OP/OP) и
+ * запоминает указатели счетчиков в образе. Как и freshness_disable(),
+ * вызывается, когда циклический поток не проверяет свежесть: не запущен
+ * или уже исполнил freshness_request_off().
+ *
+ * @return количество контролируемых slaves или -1 при ошибке
+ */
+int freshness_enable(ecx_contextt *ctx, uint8_t group, int cycles, freshness_image_fn image_ptr);
+
+/**
+ * Запрос на выключение: циклический поток снимает контроль в конце своего
+ * freshness_check(), после приема кадра статуса. Вызывающий ждет цикл и
+ * затем вызывает freshness_disable().
+ */
+void freshness_request_off(void);
+
+/**
+ * Выключить контроль и освободить FMMU
+ */
+void freshness_disable(void);
+
+bool freshness_enabled(void);
+
+/**
+ * Отправка кадра LRD статусов SM (перед обменом PDO)
+ */
+void freshness_send(void);
+
+/**
+ * Прием кадра и проверка признаков (после обмена PDO)
+ *
+ * Вызывается из циклического потока: не выделяет память и не печатает.
+ *
+ * @param inputs_ok false - кадр PDO потерян или WKC не сошелся: счетчики
+ *                  в образе не обновлены и цикл для них не учитывается
+ */
+void freshness_check(int timeout_us, bool inputs_ok);
+
+/**
+ * Битовая карта slaves с устаревшими входами (бит N - slave N)
+ */
+const uint32_t *freshness_stale_bitmap(int *stale_count);
+
+void freshness_print(void);
+
+#endif /* FRESHNESS_H */
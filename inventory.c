@@ -0,0 +1,352 @@
+/*
+ * inventory.c - Инвентаризация линии: идентификация и серийные номера slaves
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "inventory.h"
+#include "timebase.h"
+
+/* Общее задание рабочих потоков */
+typedef struct {
+    ecx_contextt *ctx;
+    inventory_t *inv;
+#ifdef _WIN32
+    volatile LONG next;
+#else
+    int next;
+#endif
+} inventory_job_t;
+
+/**
+ * Следующий slave для опроса (1-based), 0 - работы больше нет
+ */
+static int inv_next_slave(inventory_job_t *job) {
+#ifdef _WIN32
+    int slave = (int)InterlockedIncrement(&job->next);
+#else
+    int slave = __atomic_add_fetch(&job->next, 1, __ATOMIC_RELAXED);
+#endif
+    return slave <= job->inv->count ? slave : 0;
+}
+
+/**
+ * Чтение VISIBLE_STRING объекта с заменой непечатных символов
+ */
+static bool inv_read_string(ecx_contextt *ctx, uint16_t slave, uint16_t index,
+                            char *out, size_t out_len) {
+    char buf[256];
+    int size = sizeof(buf) - 1;
+
+    out[0] = '\0';
+    memset(buf, 0, sizeof(buf));
+    if (ecx_SDOread(ctx, slave, index, 0, FALSE, &size, buf, INVENTORY_SDO_TIMEOUT_US) <= 0) {
+        return false;
+    }
+
+    size_t n = 0;
+    for (int i = 0; i < size && buf[i] != '\0' && n + 1 < out_len; i++) {
+        unsigned char c = (unsigned char)buf[i];
+        out[n++] = (c >= 0x20 && c < 0x7F) ? (char)c : '?';
+    }
+    while (n > 0 && out[n - 1] == ' ') {
+        n--;
+    }
+    out[n] = '\0';
+    return true;
+}
+
+void inventory_read_slave(ecx_contextt *ctx, uint16_t slave, inventory_entry_t *e) {
+    ec_slavet *s = &ctx->slavelist[slave];
+    int64_t t0 = timebase_now_ns();
+
+    memset(e, 0, sizeof(*e));
+    e->slave = slave;
+    e->configadr = s->configadr;
+    e->alias = s->aliasadr;
+    e->vendor = s->eep_man;
+    e->product = s->eep_id;
+    e->revision = s->eep_rev;
+    snprintf(e->name, sizeof(e->name), "%s", s->name);
+
+    /* eep_man/eep_id/eep_rev SOEM читает при сканировании, serial - нет.
+       0 - ошибка чтения или serial не запрограммирован, различить нельзя */
+    e->sii_serial = ecx_readeeprom(ctx, slave, INVENTORY_SII_SERIAL, EC_TIMEOUTEEP);
+    e->sii_serial_ok = e->sii_serial != 0;
+
+    uint16_t state = s->state & 0x0F;
+    e->coe = (s->mbx_proto & ECT_MBXPROT_COE) && state != EC_STATE_NONE &&
+             state != EC_STATE_INIT && state != EC_STATE_BOOT;
+
+    if (e->coe) {
+        int size = sizeof(e->coe_serial);
+        if (ecx_SDOread(ctx, slave, 0x1018, 0x04, FALSE, &size, &e->coe_serial,
+                        INVENTORY_SDO_TIMEOUT_US) > 0) {
+            e->coe_serial_ok = true;
+        } else {
+            e->sdo_errors++;
+        }
+        if (!inv_read_string(ctx, slave, 0x1008, e->device_name, sizeof(e->device_name))) {
+            e->sdo_errors++;
+        }
+        if (!inv_read_string(ctx, slave, 0x1009, e->hw_version, sizeof(e->hw_version))) {
+            e->sdo_errors++;
+        }
+        if (!inv_read_string(ctx, slave, 0x100A, e->sw_version, sizeof(e->sw_version))) {
+            e->sdo_errors++;
+        }
+    }
+
+    e->elapsed_us = (uint32_t)((timebase_now_ns() - t0) / 1000);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI inv_worker(LPVOID p) {
+#else
+static void *inv_worker(void *p) {
+#endif
+    inventory_job_t *job = p;
+    int slave;
+
+    while ((slave = inv_next_slave(job)) != 0) {
+        inventory_read_slave(job->ctx, (uint16_t)slave, &job->inv->entry[slave - 1]);
+    }
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+int inventory_collect(inventory_t *inv, ecx_contextt *ctx, int workers) {
+    inventory_job_t job;
+#ifdef _WIN32
+    HANDLE threads[INVENTORY_MAX_WORKERS];
+#else
+    pthread_t threads[INVENTORY_MAX_WORKERS];
+#endif
+    int started = 0;
+
+    if (workers < 1) workers = 1;
+    if (workers > INVENTORY_MAX_WORKERS) workers = INVENTORY_MAX_WORKERS;
+
+    memset(inv, 0, sizeof(*inv));
+    inv->count = ctx->slavecount;
+    if (inv->count > EC_MAXSLAVE - 1) {
+        inv->count = EC_MAXSLAVE - 1;
+    }
+    if (workers > inv->count) {
+        workers = inv->count > 0 ? inv->count : 1;
+    }
+
+    job.ctx = ctx;
+    job.inv = inv;
+    job.next = 0;
+
+    int64_t t0 = timebase_now_ns();
+
+    for (int i = 0; i < workers; i++) {
+#ifdef _WIN32
+        threads[started] = CreateThread(NULL, 0, inv_worker, &job, 0, NULL);
+        if (threads[started] == NULL) {
+            break;
+        }
+#else
+        if (pthread_create(&threads[started], NULL, inv_worker, &job) != 0) {
+            break;
+        }
+#endif
+        started++;
+    }
+
+    if (started == 0) {
+        /* Потоки недоступны: опрашиваем в текущем */
+        inv_worker(&job);
+        started = 1;
+    } else {
+        for (int i = 0; i < started; i++) {
+#ifdef _WIN32
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+#else
+            pthread_join(threads[i], NULL);
+#endif
+        }
+    }
+
+    inv->workers = started;
+    inv->elapsed_ms = (uint32_t)((timebase_now_ns() - t0) / 1000000);
+    for (int i = 0; i < inv->count; i++) {
+        inv->sdo_errors += inv->entry[i].sdo_errors;
+    }
+
+    /* Отсутствующие необязательные объекты (0x1009, 0x100A) - норма для
+       инвентаризации, их abort коды не должны всплывать в следующих командах */
+    while (ecx_iserror(ctx)) {
+        ecx_elist2string(ctx);
+    }
+
+    return inv->count;
+}
+
+void inventory_print(const inventory_t *inv) {
+    printf("\n=== Line Inventory (%d slaves) ===\n\n", inv->count);
+    printf("%-4s %-20s %-10s %-10s %-10s %-12s %-12s %-12s %-12s\n",
+           "Idx", "Name", "Vendor", "Product", "Revision",
+           "Serial(SII)", "Serial(CoE)", "HW", "SW");
+    printf("------------------------------------------------------------"
+           "----------------------------------------------\n");
+
+    for (int i = 0; i < inv->count; i++) {
+        const inventory_entry_t *e = &inv->entry[i];
+        char sii[16] = "-";
+        char coe[16] = "-";
+
+        if (e->sii_serial_ok) snprintf(sii, sizeof(sii), "%u", e->sii_serial);
+        if (e->coe_serial_ok) snprintf(coe, sizeof(coe), "%u", e->coe_serial);
+
+        printf("%-4u %-20.20s 0x%08X 0x%08X 0x%08X %-12s %-12s %-12.12s %-12.12s\n",
+               e->slave, e->device_name[0] ? e->device_name : e->name,
+               e->vendor, e->product, e->revision, sii, coe,
+               e->hw_version[0] ? e->hw_version : "-",
+               e->sw_version[0] ? e->sw_version : "-");
+    }
+
+    printf("\nCollected in %u ms with %d worker(s), %d SDO read(s) failed or unsupported\n",
+           inv->elapsed_ms, inv->workers, inv->sdo_errors);
+    if (inv->count > 0) {
+        uint32_t slowest = 0;
+        int slowest_idx = 0;
+        for (int i = 0; i < inv->count; i++) {
+            if (inv->entry[i].elapsed_us > slowest) {
+                slowest = inv->entry[i].elapsed_us;
+                slowest_idx = inv->entry[i].slave;
+            }
+        }
+        printf("Slowest slave: %d (%.1f ms)\n", slowest_idx, slowest / 1000.0);
+    }
+    printf("\n");
+}
+
+/* ============================================================================
+ * Экспорт
+ * ============================================================================ */
+
+static void inv_csv_str(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+static void inv_json_str(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', f);
+            fputc(*s, f);
+        } else if ((unsigned char)*s < 0x20) {
+            fprintf(f, "\\u%04x", (unsigned char)*s);
+        } else {
+            fputc(*s, f);
+        }
+    }
+    fputc('"', f);
+}
+
+static void inv_write_csv(const inventory_t *inv, FILE *f) {
+    fprintf(f, "index,station,alias,name,device_name,vendor_id,product_code,revision,"
+               "sii_serial,coe_serial,hw_version,sw_version,sdo_errors\n");
+
+    for (int i = 0; i < inv->count; i++) {
+        const inventory_entry_t *e = &inv->entry[i];
+
+        fprintf(f, "%u,0x%04X,%u,", e->slave, e->configadr, e->alias);
+        inv_csv_str(f, e->name);
+        fputc(',', f);
+        inv_csv_str(f, e->device_name);
+        fprintf(f, ",0x%08X,0x%08X,0x%08X,", e->vendor, e->product, e->revision);
+        if (e->sii_serial_ok) fprintf(f, "%u", e->sii_serial);
+        fputc(',', f);
+        if (e->coe_serial_ok) fprintf(f, "%u", e->coe_serial);
+        fputc(',', f);
+        inv_csv_str(f, e->hw_version);
+        fputc(',', f);
+        inv_csv_str(f, e->sw_version);
+        fprintf(f, ",%d\n", e->sdo_errors);
+    }
+}
+
+static void inv_write_json(const inventory_t *inv, FILE *f) {
+    fprintf(f, "{\n  \"slave_count\": %d,\n  \"elapsed_ms\": %u,\n  \"slaves\": [\n",
+            inv->count, inv->elapsed_ms);
+
+    for (int i = 0; i < inv->count; i++) {
+        const inventory_entry_t *e = &inv->entry[i];
+
+        fprintf(f, "    {\"index\": %u, \"station\": \"0x%04X\", \"alias\": %u, \"name\": ",
+                e->slave, e->configadr, e->alias);
+        inv_json_str(f, e->name);
+        fprintf(f, ", \"device_name\": ");
+        inv_json_str(f, e->device_name);
+        fprintf(f, ", \"vendor_id\": \"0x%08X\", \"product_code\": \"0x%08X\", \"revision\": \"0x%08X\"",
+                e->vendor, e->product, e->revision);
+        if (e->sii_serial_ok) {
+            fprintf(f, ", \"sii_serial\": %u", e->sii_serial);
+        } else {
+            fprintf(f, ", \"sii_serial\": null");
+        }
+        if (e->coe_serial_ok) {
+            fprintf(f, ", \"coe_serial\": %u", e->coe_serial);
+        } else {
+            fprintf(f, ", \"coe_serial\": null");
+        }
+        fprintf(f, ", \"hw_version\": ");
+        inv_json_str(f, e->hw_version);
+        fprintf(f, ", \"sw_version\": ");
+        inv_json_str(f, e->sw_version);
+        fprintf(f, ", \"sdo_errors\": %d}%s\n", e->sdo_errors, i + 1 < inv->count ? "," : "");
+    }
+
+    fprintf(f, "  ]\n}\n");
+}
+
+bool inventory_export(const inventory_t *inv, const char *format, const char *path) {
+    bool csv = strcmp(format, "csv") == 0;
+
+    if (!csv && strcmp(format, "json") != 0) {
+        printf("ERROR: Unknown format '%s' (use csv or json)\n", format);
+        return false;
+    }
+
+    FILE *f = stdout;
+    if (path) {
+        f = fopen(path, "w");
+        if (!f) {
+            printf("ERROR: Cannot open %s for writing\n", path);
+            return false;
+        }
+    }
+
+    if (csv) {
+        inv_write_csv(inv, f);
+    } else {
+        inv_write_json(inv, f);
+    }
+
+    if (path) {
+        fclose(f);
+        printf("Inventory of %d slaves written to %s\n", inv->count, path);
+    }
+    return true;
+}
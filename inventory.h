@@ -0,0 +1,86 @@
+/*
+ * inventory.h - Инвентаризация линии: идентификация и серийные номера slaves
+ *
+ * Для каждого slave собираются идентификаторы из SII (vendor, product,
+ * revision, serial по адресу 0x000E) и объекты CoE: 0x1018:04 (serial),
+ * 0x1008 (имя устройства), 0x1009 (версия железа), 0x100A (версия ПО).
+ *
+ * SDO загрузки идут параллельно из нескольких рабочих потоков: каждый поток
+ * берет следующий slave из общего счетчика и опрашивает его целиком.
+ * Пока один slave готовит ответ в mailbox, остальные потоки занимают шину
+ * своими запросами, поэтому время сбора определяется самыми медленными
+ * slaves, а не их суммой. Каждый поток держит не больше одного индекса
+ * кадра SOEM, число потоков ограничено INVENTORY_MAX_WORKERS.
+ */
+
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "soem/soem.h"
+
+#define INVENTORY_STR_LEN          64
+#define INVENTORY_DEFAULT_WORKERS  4
+#define INVENTORY_MAX_WORKERS      8
+#define INVENTORY_SDO_TIMEOUT_US   200000
+#define INVENTORY_SII_SERIAL       0x000E   /* Адрес серийного номера в SII (слова) */
+
+/* Идентификация одного slave */
+typedef struct {
+    uint16_t slave;
+    uint16_t configadr;
+    uint16_t alias;
+    char name[EC_MAXNAME + 1];              /* Имя из SII */
+    uint32_t vendor;                        /* SII */
+    uint32_t product;
+    uint32_t revision;
+    bool sii_serial_ok;
+    uint32_t sii_serial;
+    bool coe;                               /* CoE доступен (mailbox, не INIT) */
+    bool coe_serial_ok;
+    uint32_t coe_serial;                    /* 0x1018:04 */
+    char device_name[INVENTORY_STR_LEN];    /* 0x1008, пусто если нет */
+    char hw_version[INVENTORY_STR_LEN];     /* 0x1009 */
+    char sw_version[INVENTORY_STR_LEN];     /* 0x100A */
+    int sdo_errors;
+    uint32_t elapsed_us;                    /* Время опроса этого slave */
+} inventory_entry_t;
+
+typedef struct {
+    int count;
+    int workers;
+    int sdo_errors;
+    uint32_t elapsed_ms;
+    inventory_entry_t entry[EC_MAXSLAVE];
+} inventory_t;
+
+/**
+ * Опрос одного slave (SII и CoE)
+ */
+void inventory_read_slave(ecx_contextt *ctx, uint16_t slave, inventory_entry_t *e);
+
+/**
+ * Параллельный опрос всех slaves
+ *
+ * @param workers Число рабочих потоков (1..INVENTORY_MAX_WORKERS)
+ * @return количество опрошенных slaves
+ */
+int inventory_collect(inventory_t *inv, ecx_contextt *ctx, int workers);
+
+/**
+ * Таблица на stdout
+ */
+void inventory_print(const inventory_t *inv);
+
+/**
+ * Выгрузка в CSV или JSON
+ *
+ * @param format "csv" или "json"
+ * @param path   Файл или NULL для stdout
+ * @return false при ошибке открытия файла или неизвестном формате
+ */
+bool inventory_export(const inventory_t *inv, const char *format, const char *path);
+
+#endif /* INVENTORY_H */
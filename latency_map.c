@@ -0,0 +1,316 @@
+/*
+ * latency_map.c - Карта задержек доступа к ESC по позициям slaves
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "latency_map.h"
+#include "rt_check.h"
+#include "timebase.h"
+
+#define LM_READ_LEN   16          /* Времена приема портов 0..3 */
+#define LM_NO_SAMPLE  (-1)
+#define LM_MAX_FRAMES ((EC_MAXSLAVE + LATENCY_MAP_PER_FRAME - 1) / LATENCY_MAP_PER_FRAME)
+
+/* Кадр одного образца */
+typedef struct {
+    uint8 idx;
+    int first;                    /* Первый slave в кадре */
+    int count;
+    uint16 offset[LATENCY_MAP_PER_FRAME];  /* Данные датаграмм в rxbuf */
+    int64_t t_sent;
+} lm_frame_t;
+
+/* Сводка по одной позиции */
+typedef struct {
+    int valid;
+    int32_t loop_med, loop_p99, loop_max;
+    int inc_valid;
+    int inc_hops;                 /* Позиций до ближайшего предка с DC */
+    int32_t inc_med, inc_p99;
+} lm_summary_t;
+
+static ecx_contextt *lm_ctx = NULL;
+static int lm_slaves = 0;
+static int lm_samples = 0;
+static int32_t lm_loop[EC_MAXSLAVE][LATENCY_MAP_MAX_SAMPLES];
+static uint32_t lm_miss[EC_MAXSLAVE];
+static uint32_t lm_frames_sent = 0;
+static uint32_t lm_frames_lost = 0;
+static rt_hist_t lm_rtt;
+static int32_t lm_sort_buf[LATENCY_MAP_MAX_SAMPLES];
+
+static uint32_t lm_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * Петля slave: самый поздний возврат кадра на остальных открытых портах
+ * относительно приема на входном порту (entryport, обычно 0)
+ */
+static int32_t lm_loop_ns(const ec_slavet *s, const uint8_t *data) {
+    uint32_t t0 = lm_le32(data + 4 * s->entryport);
+    uint32_t loop = 0;
+
+    for (int p = 0; p < 4; p++) {
+        if (p != s->entryport && (s->activeports & (1 << p))) {
+            uint32_t d = lm_le32(data + 4 * p) - t0;   /* Переполнение 32-бит счетчика */
+            if (d > loop) {
+                loop = d;
+            }
+        }
+    }
+    return (int32_t)loop;
+}
+
+/**
+ * Один образец: защелка и чтение всех slaves кадрами по LATENCY_MAP_PER_FRAME
+ */
+static void lm_sample(int sample, bool any_dc) {
+    ecx_portt *port = &lm_ctx->port;
+    lm_frame_t frames[LM_MAX_FRAMES];
+    uint8_t zero[LM_READ_LEN];
+    int nframes = 0;
+
+    memset(zero, 0, sizeof(zero));
+    if (any_dc) {
+        uint32 latch = 0;
+        ecx_BWR(port, 0x0000, ECT_REG_DCTIME0, sizeof(latch), &latch, EC_TIMEOUTRET);
+    }
+
+    for (int first = 1; first <= lm_slaves; first += LATENCY_MAP_PER_FRAME) {
+        lm_frame_t *f = &frames[nframes++];
+        f->first = first;
+        f->count = lm_slaves - first + 1;
+        if (f->count > LATENCY_MAP_PER_FRAME) {
+            f->count = LATENCY_MAP_PER_FRAME;
+        }
+        f->idx = ecx_getindex(port);
+
+        for (int k = 0; k < f->count; k++) {
+            uint16 adp = lm_ctx->slavelist[first + k].configadr;
+            if (k == 0) {
+                ecx_setupdatagram(port, &(port->txbuf[f->idx]), EC_CMD_FPRD, f->idx,
+                                  adp, ECT_REG_DCTIME0, LM_READ_LEN, zero);
+                f->offset[k] = EC_HEADERSIZE;
+            } else {
+                f->offset[k] = ecx_adddatagram(port, &(port->txbuf[f->idx]), EC_CMD_FPRD, f->idx,
+                                               k + 1 < f->count, adp, ECT_REG_DCTIME0,
+                                               LM_READ_LEN, zero);
+            }
+        }
+    }
+
+    /* Все кадры образца уходят подряд, прием - после отправки */
+    for (int i = 0; i < nframes; i++) {
+        frames[i].t_sent = timebase_now_ns();
+        ecx_outframe_red(port, frames[i].idx);
+        lm_frames_sent++;
+    }
+
+    for (int i = 0; i < nframes; i++) {
+        lm_frame_t *f = &frames[i];
+        int wkc = ecx_waitinframe(port, f->idx, EC_TIMEOUTRET);
+        int64_t t_recv = timebase_now_ns();
+
+        if (wkc <= EC_NOFRAME) {
+            lm_frames_lost++;
+            for (int k = 0; k < f->count; k++) {
+                lm_miss[f->first + k]++;
+                lm_loop[f->first + k][sample] = LM_NO_SAMPLE;
+            }
+        } else {
+            rt_hist_add(&lm_rtt, t_recv - f->t_sent);
+            for (int k = 0; k < f->count; k++) {
+                int slave = f->first + k;
+                const uint8_t *data = &(port->rxbuf[f->idx][f->offset[k]]);
+                uint16_t dwkc = (uint16_t)(data[LM_READ_LEN] | (data[LM_READ_LEN + 1] << 8));
+
+                if (dwkc != 1) {
+                    lm_miss[slave]++;
+                    lm_loop[slave][sample] = LM_NO_SAMPLE;
+                } else if (lm_ctx->slavelist[slave].hasdc) {
+                    lm_loop[slave][sample] = lm_loop_ns(&lm_ctx->slavelist[slave], data);
+                } else {
+                    lm_loop[slave][sample] = LM_NO_SAMPLE;
+                }
+            }
+        }
+        ecx_setbufstat(port, f->idx, EC_BUF_EMPTY);
+    }
+}
+
+int latency_map_run(ecx_contextt *ctx, int samples) {
+    if (samples < 1 || samples > LATENCY_MAP_MAX_SAMPLES) {
+        return -1;
+    }
+
+    lm_ctx = ctx;
+    lm_slaves = ctx->slavecount < EC_MAXSLAVE ? ctx->slavecount : EC_MAXSLAVE - 1;
+    lm_samples = samples;
+    lm_frames_sent = 0;
+    lm_frames_lost = 0;
+    memset(lm_miss, 0, sizeof(lm_miss));
+    rt_hist_reset(&lm_rtt);
+
+    bool any_dc = false;
+    for (int i = 1; i <= lm_slaves; i++) {
+        if (ctx->slavelist[i].hasdc) {
+            any_dc = true;
+        }
+    }
+
+    for (int s = 0; s < samples; s++) {
+        lm_sample(s, any_dc);
+    }
+    return lm_slaves;
+}
+
+/* ============================================================================
+ * Статистика
+ * ============================================================================ */
+
+static int lm_compare(const void *a, const void *b) {
+    int32_t x = *(const int32_t *)a;
+    int32_t y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int32_t lm_pct(const int32_t *sorted, int n, double pct) {
+    int i = (int)(pct / 100.0 * (n - 1) + 0.5);
+    return sorted[i];
+}
+
+/**
+ * Медиана и хвост петли slave и приращения относительно родителя
+ */
+static void lm_summarize(int slave, lm_summary_t *out) {
+    int parent = lm_ctx->slavelist[slave].parent;
+    int hops = 1;
+    int n = 0;
+
+    memset(out, 0, sizeof(*out));
+    for (int s = 0; s < lm_samples; s++) {
+        if (lm_loop[slave][s] != LM_NO_SAMPLE) {
+            lm_sort_buf[n++] = lm_loop[slave][s];
+        }
+    }
+    if (n > 0) {
+        qsort(lm_sort_buf, (size_t)n, sizeof(int32_t), lm_compare);
+        out->valid = n;
+        out->loop_med = lm_pct(lm_sort_buf, n, 50.0);
+        out->loop_p99 = lm_pct(lm_sort_buf, n, 99.0);
+        out->loop_max = lm_sort_buf[n - 1];
+    }
+
+    /* Slaves без DC между позициями: приращение считается от ближайшего предка с DC */
+    while (parent >= 1 && parent <= lm_slaves && !lm_ctx->slavelist[parent].hasdc) {
+        parent = lm_ctx->slavelist[parent].parent;
+        hops++;
+    }
+
+    /* Приращение по парам из одного образца */
+    if (parent < 1 || parent > lm_slaves) {
+        return;
+    }
+    n = 0;
+    for (int s = 0; s < lm_samples; s++) {
+        if (lm_loop[slave][s] != LM_NO_SAMPLE && lm_loop[parent][s] != LM_NO_SAMPLE) {
+            lm_sort_buf[n++] = lm_loop[parent][s] - lm_loop[slave][s];
+        }
+    }
+    if (n > 0) {
+        qsort(lm_sort_buf, (size_t)n, sizeof(int32_t), lm_compare);
+        out->inc_valid = n;
+        out->inc_hops = hops;
+        out->inc_med = lm_pct(lm_sort_buf, n, 50.0);
+        out->inc_p99 = lm_pct(lm_sort_buf, n, 99.0);
+    }
+}
+
+void latency_map_print(void) {
+    static lm_summary_t sum[EC_MAXSLAVE];
+    static int32_t inc_meds[EC_MAXSLAVE];
+    int ninc = 0;
+
+    if (!lm_ctx || lm_samples == 0) {
+        printf("No latency map collected\n");
+        return;
+    }
+
+    for (int i = 1; i <= lm_slaves; i++) {
+        lm_summarize(i, &sum[i]);
+        if (sum[i].inc_valid && sum[i].inc_hops == 1) {
+            inc_meds[ninc++] = sum[i].inc_med;
+        }
+    }
+
+    int32_t line_inc = 0;
+    if (ninc > 0) {
+        qsort(inc_meds, (size_t)ninc, sizeof(int32_t), lm_compare);
+        line_inc = lm_pct(inc_meds, ninc, 50.0);
+    }
+
+    printf("\n=== ESC Latency Map (%d slaves, %d samples) ===\n", lm_slaves, lm_samples);
+    printf("FPRD frames: %u sent, %u lost; round trip median %u us, p99 %u us, max %.1f us\n",
+           lm_frames_sent, lm_frames_lost, rt_hist_percentile_us(&lm_rtt, 50.0),
+           rt_hist_percentile_us(&lm_rtt, 99.0), lm_rtt.max_ns / 1000.0);
+    printf("(every datagram travels the whole segment: per-position values come from DC port latches)\n\n");
+
+    printf("%-4s %-20s %-6s %10s %10s %10s %10s %10s %6s\n",
+           "Pos", "Name", "Parent", "Loop med", "Loop p99", "Loop max", "Inc med", "Inc p99", "Miss");
+    printf("%-4s %-20s %-6s %10s %10s %10s %10s %10s %6s\n",
+           "", "", "", "[ns]", "[ns]", "[ns]", "[ns]", "[ns]", "");
+    printf("--------------------------------------------------------------"
+           "-------------------------------\n");
+
+    int flagged = 0;
+    for (int i = 1; i <= lm_slaves; i++) {
+        const ec_slavet *s = &lm_ctx->slavelist[i];
+        const lm_summary_t *m = &sum[i];
+        char loop_med[16] = "-", loop_p99[16] = "-", loop_max[16] = "-";
+        char inc_med[16] = "-", inc_p99[16] = "-";
+        const char *note = "";
+
+        if (m->valid) {
+            snprintf(loop_med, sizeof(loop_med), "%d", m->loop_med);
+            snprintf(loop_p99, sizeof(loop_p99), "%d", m->loop_p99);
+            snprintf(loop_max, sizeof(loop_max), "%d", m->loop_max);
+        } else if (!s->hasdc) {
+            note = "no DC";
+        }
+        if (m->inc_valid) {
+            snprintf(inc_med, sizeof(inc_med), "%d", m->inc_med);
+            snprintf(inc_p99, sizeof(inc_p99), "%d", m->inc_p99);
+            int32_t expected = line_inc * m->inc_hops;
+            if (m->inc_med > expected * LATENCY_MAP_OUTLIER_FACTOR &&
+                m->inc_med > expected + LATENCY_MAP_OUTLIER_MIN_NS) {
+                note = "<-- SLOW";
+                flagged++;
+            } else if (m->inc_hops > 1) {
+                note = "inc over non-DC slaves";
+            }
+        }
+        if (!note[0] && s->parent >= 1 && lm_ctx->slavelist[s->parent].topology > 2) {
+            note = "junction";
+        }
+        if (!note[0] && lm_miss[i] > 0) {
+            note = "<-- MISSED";
+            flagged++;
+        }
+
+        printf("%-4d %-20.20s %-6u %10s %10s %10s %10s %10s %6u %s\n",
+               i, s->name, s->parent, loop_med, loop_p99, loop_max, inc_med, inc_p99,
+               lm_miss[i], note);
+    }
+
+    printf("\nLine median increment: %d ns", line_inc);
+    if (flagged > 0) {
+        printf(", %d position(s) flagged\n", flagged);
+    } else {
+        printf(", no abnormal positions\n");
+    }
+    printf("Increment after a junction also contains the loops of branches behind the parent\n\n");
+}
@@ -0,0 +1,44 @@
+/*
+ * latency_map.h - Карта задержек доступа к ESC по позициям slaves
+ *
+ * Каждый образец: BWR в 0x0900 защелкивает время приема кадра на всех
+ * портах всех ESC с DC, затем FPRD 0x0900..0x090F читает защелки каждого
+ * slave. FPRD датаграммы нескольких slaves упакованы в общие кадры, кадры
+ * одного образца отправляются подряд и собираются после отправки всех.
+ *
+ * Кадр EtherCAT проходит весь сегмент независимо от адреса датаграммы,
+ * поэтому время круга FPRD одинаково для всех позиций и выводится общей
+ * строкой. Задержка позиции считается по защелкам: петля slave - время
+ * между приемом кадра на входном порту и его возвратом с дальних портов,
+ * приращение - разница петель родителя и slave (звено и обработка в ESC).
+ * Аномально большие приращения указывают на медленный slave или стык.
+ */
+
+#ifndef LATENCY_MAP_H
+#define LATENCY_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "soem/soem.h"
+
+#define LATENCY_MAP_DEFAULT_SAMPLES 200
+#define LATENCY_MAP_MAX_SAMPLES     500
+#define LATENCY_MAP_PER_FRAME       32      /* FPRD датаграмм в одном кадре */
+#define LATENCY_MAP_OUTLIER_FACTOR  3       /* Приращение > 3 x медианы линии */
+#define LATENCY_MAP_OUTLIER_MIN_NS  500     /* ... и больше медианы хотя бы на 500 нс */
+
+/**
+ * Сбор образцов по всем slaves
+ *
+ * @param samples Количество образцов (1..LATENCY_MAP_MAX_SAMPLES)
+ * @return количество slaves или -1 при ошибке
+ */
+int latency_map_run(ecx_contextt *ctx, int samples);
+
+/**
+ * Таблица по позициям с медианой и хвостом петли и приращения
+ */
+void latency_map_print(void);
+
+#endif /* LATENCY_MAP_H */
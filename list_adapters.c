@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 
 #ifdef _WIN32
 #include "npcap-defs.h"
@@ -30,6 +31,11 @@
 #endif
 
 #include "soem/soem.h"
+#include "ecat_probe.h"
+#include "nic_lowlat.h"
+#include "rt_check.h"
+#include "raw_bench.h"
+#include "timebase.h"
 
 void print_adapters_pcap() {
     pcap_if_t *alldevs;
@@ -231,10 +237,87 @@ void test_soem_init(const char *ifname) {
     }
 }
 
+/**
+ * Параллельный опрос всех интерфейсов на наличие EtherCAT slaves
+ */
+void probe_all_interfaces(int timeout_ms) {
+    ecat_probe_result_t results[ECAT_PROBE_MAX_IFACES];
+
+    int count = ecat_probe_all(results, ECAT_PROBE_MAX_IFACES, timeout_ms);
+    if (count < 0) {
+        printf("ERROR: Failed to enumerate interfaces\n");
+        return;
+    }
+
+    ecat_probe_print(results, count, timeout_ms);
+
+    int best = ecat_probe_select_best(results, count);
+    if (best >= 0) {
+        printf("Recommended interface: %s (%d slave(s), RTT %u us)\n",
+               results[best].name, results[best].slave_count, results[best].rtt_us);
+    } else {
+        printf("No EtherCAT slaves found on any interface.\n");
+    }
+}
+
+/**
+ * Пробный тюнинг NIC: замер RTT, применение low-latency настроек,
+ * повторный замер и откат к исходным настройкам
+ */
+void tune_nic_trial(const char *ifname, int rt_cpu) {
+    ecx_contextt *ctx = calloc(1, sizeof(ecx_contextt));
+    ecat_rtt_stats_t before, after;
+    nic_tune_state_t state;
+
+    if (!ctx) {
+        printf("ERROR: Memory allocation failed\n");
+        return;
+    }
+    if (ecx_init(ctx, ifname) <= 0) {
+        printf("ERROR: ecx_init failed on %s\n", ifname);
+        free(ctx);
+        return;
+    }
+
+    ecat_probe_rtt(&ctx->port, ECAT_RTT_DEFAULT_SAMPLES, &before);
+    if (nic_tune_apply(ifname, rt_cpu, &state)) {
+        ecat_probe_rtt(&ctx->port, ECAT_RTT_DEFAULT_SAMPLES, &after);
+        printf("\nBRD round-trip (%d frames):\n", ECAT_RTT_DEFAULT_SAMPLES);
+        ecat_rtt_print("before:", &before);
+        ecat_rtt_print("after:", &after);
+        if (before.replies > 0 && after.replies > 0) {
+            printf("  median %+d us, p99 %+d us\n",
+                   (int)after.median_us - (int)before.median_us,
+                   (int)after.p99_us - (int)before.p99_us);
+        }
+        nic_tune_restore(&state);
+        printf("To keep these settings while running use: dummy-ecat-cli -i %s --tune-nic\n", ifname);
+    }
+
+    ecx_close(ctx);
+    free(ctx);
+}
+
 void print_usage(const char *prog_name) {
     printf("Usage: %s [options]\n", prog_name);
     printf("\nOptions:\n");
     printf("  -t, --test <interface>  Test SOEM initialization with specified interface\n");
+    printf("  -p, --probe [ms]        Probe all UP interfaces for EtherCAT slaves in parallel\n");
+    printf("                          (default timeout: %d ms)\n", ECAT_PROBE_DEFAULT_TIMEOUT_MS);
+    printf("  -n, --nic-report [if]   Rate NIC settings against EtherCAT low-latency recommendations\n");
+    printf("                          (all UP interfaces if none given, Linux only)\n");
+    printf("  --tune-nic <if>         Trial low-latency NIC tuning: measure RTT, tune, measure,\n");
+    printf("                          restore (Linux only)\n");
+    printf("  -r, --rt-check [us]     Check host real-time readiness for the cycle time\n");
+    printf("                          (default %d us, Linux only)\n", RT_CHECK_DEFAULT_CYCLE_US);
+    printf("  --rt-duration <sec>     Timer latency test duration (default %d s)\n",
+           RT_CHECK_DEFAULT_DURATION_S);
+    printf("  --rt-cpu <n>            CPU core of the cyclic thread (IRQ affinity checks/pinning,\n");
+    printf("                          latency test; default: last online CPU)\n");
+    printf("  --bench <tx_if> [rx_if] Raw-frame TX/RX benchmark: pcap vs AF_PACKET vs PACKET_MMAP\n");
+    printf("                          (rx_if defaults to tx_if; use a veth pair for loopback)\n");
+    printf("  --bench-frames <n>      Frames per size in the throughput test (default %d)\n",
+           RAW_BENCH_DEFAULT_FRAMES);
     printf("  -h, --help              Show this help message\n");
     printf("Example:\n");
     printf("  %s\n", prog_name);
@@ -243,14 +326,33 @@ void print_usage(const char *prog_name) {
 #else
     printf("  sudo %s -t eth0\n", prog_name);
 #endif
+    printf("  %s --probe 200\n", prog_name);
+    printf("  %s --nic-report eth0 --rt-cpu 3\n", prog_name);
+    printf("  %s --rt-check 250 --rt-cpu 3\n", prog_name);
+    printf("  %s --bench ecb0 ecb1 --bench-frames 50000\n", prog_name);
 }
 
 int main(int argc, char *argv[]) {
     const char *test_interface = NULL;
+    bool probe = false;
+    int probe_timeout_ms = ECAT_PROBE_DEFAULT_TIMEOUT_MS;
+    bool nic_report = false;
+    const char *nic_report_iface = NULL;
+    int rt_cpu = -1;
+    const char *tune_iface = NULL;
+    bool rt_check = false;
+    uint32_t rt_cycle_us = RT_CHECK_DEFAULT_CYCLE_US;
+    int rt_duration_s = RT_CHECK_DEFAULT_DURATION_S;
+    const char *bench_tx = NULL;
+    const char *bench_rx = NULL;
+    int bench_frames = RAW_BENCH_DEFAULT_FRAMES;
 
     printf("=== Network Adapter Diagnostic Tool ===\n");
     printf("Version 1.0\n");
 
+    /* Калибровка меток времени для замеров RTT и бенчмарков */
+    timebase_init();
+
 #ifdef _WIN32
     /* Инициализация Winsock */
     WSADATA wsaData;
@@ -270,6 +372,67 @@ int main(int argc, char *argv[]) {
                 print_usage(argv[0]);
                 return 1;
             }
+        } else if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--probe") == 0) {
+            probe = true;
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') {
+                probe_timeout_ms = atoi(argv[++i]);
+                if (probe_timeout_ms <= 0) {
+                    probe_timeout_ms = ECAT_PROBE_DEFAULT_TIMEOUT_MS;
+                }
+            }
+        } else if (strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--nic-report") == 0) {
+            nic_report = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                nic_report_iface = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--tune-nic") == 0) {
+            if (i + 1 < argc) {
+                tune_iface = argv[++i];
+            } else {
+                printf("ERROR: --tune-nic option requires an argument\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--rt-check") == 0) {
+            rt_check = true;
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') {
+                rt_cycle_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+            }
+        } else if (strcmp(argv[i], "--rt-duration") == 0) {
+            if (i + 1 < argc) {
+                rt_duration_s = atoi(argv[++i]);
+            } else {
+                printf("ERROR: --rt-duration option requires an argument\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--rt-cpu") == 0) {
+            if (i + 1 < argc) {
+                rt_cpu = atoi(argv[++i]);
+            } else {
+                printf("ERROR: --rt-cpu option requires an argument\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            if (i + 1 < argc) {
+                bench_tx = argv[++i];
+                if (i + 1 < argc && argv[i + 1][0] != '-') {
+                    bench_rx = argv[++i];
+                }
+            } else {
+                printf("ERROR: --bench option requires an argument\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bench-frames") == 0) {
+            if (i + 1 < argc) {
+                bench_frames = atoi(argv[++i]);
+            } else {
+                printf("ERROR: --bench-frames option requires an argument\n");
+                print_usage(argv[0]);
+                return 1;
+            }
         } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
             print_usage(argv[0]);
             return 0;
@@ -290,6 +453,35 @@ int main(int argc, char *argv[]) {
     /* Показываем адаптеры через Pcap */
     print_adapters_pcap();
 
+    /* Параллельный опрос всех интерфейсов */
+    if (probe) {
+        probe_all_interfaces(probe_timeout_ms);
+    }
+
+    /* Отчет о low-latency настройках адаптеров */
+    if (nic_report) {
+        if (nic_report_iface) {
+            nic_report_print(nic_report_iface, rt_cpu);
+        } else {
+            nic_report_all(rt_cpu);
+        }
+    }
+
+    /* Проверка готовности хоста к real-time циклу */
+    if (rt_check) {
+        rt_check_run(rt_cycle_us, rt_cpu, rt_duration_s);
+    }
+
+    /* Пробный тюнинг NIC */
+    if (tune_iface) {
+        tune_nic_trial(tune_iface, rt_cpu);
+    }
+
+    /* Бенчмарк отправки/приема raw кадров */
+    if (bench_tx) {
+        raw_bench_run(bench_tx, bench_rx, bench_frames);
+    }
+
     /* Если указан интерфейс для теста - тестируем */
     if (test_interface) {
         test_soem_init(test_interface);
@@ -305,6 +497,9 @@ int main(int argc, char *argv[]) {
         printf("3. Run with root privileges (sudo)\n");
         printf("4. Test the interface with: sudo %s -t \"eth0\"\n", argv[0]);
 #endif
+        if (!probe) {
+            printf("5. Find the EtherCAT interface automatically with: %s --probe\n", argv[0]);
+        }
     }
 
 #ifdef _WIN32
@@ -0,0 +1,89 @@
+/*
+ * mem_arena.c - Арены и пулы фиксированных блоков на статической памяти
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mem_arena.h"
+
+static size_t mem_align_up(size_t n) {
+    return (n + MEM_ARENA_ALIGN - 1) & ~(size_t)(MEM_ARENA_ALIGN - 1);
+}
+
+void mem_arena_init(mem_arena_t *a, const char *name, void *buf, size_t size) {
+    memset(a, 0, sizeof(*a));
+    a->name = name;
+    a->base = buf;
+    a->size = size;
+}
+
+void *mem_arena_alloc(mem_arena_t *a, size_t size) {
+    size_t offset = mem_align_up(a->used);
+
+    if (size == 0 || offset > a->size || size > a->size - offset) {
+        a->failures++;
+        return NULL;
+    }
+
+    a->used = offset + size;
+    if (a->used > a->high_water) {
+        a->high_water = a->used;
+    }
+    return a->base + offset;
+}
+
+void mem_arena_reset(mem_arena_t *a) {
+    a->used = 0;
+}
+
+void mem_pool_init(mem_pool_t *p, const char *name, void *buf, size_t size, size_t block_size) {
+    memset(p, 0, sizeof(*p));
+    p->name = name;
+    p->base = buf;
+    p->block_size = mem_align_up(block_size < sizeof(void *) ? sizeof(void *) : block_size);
+    p->block_count = (uint32_t)(size / p->block_size);
+
+    /* Список свободных блоков хранится в самих блоках */
+    for (uint32_t i = p->block_count; i > 0; i--) {
+        void *block = p->base + (size_t)(i - 1) * p->block_size;
+        *(void **)block = p->free_list;
+        p->free_list = block;
+    }
+    p->free_count = p->block_count;
+    p->min_free = p->block_count;
+}
+
+void *mem_pool_alloc(mem_pool_t *p) {
+    void *block = p->free_list;
+
+    if (!block) {
+        p->failures++;
+        return NULL;
+    }
+    p->free_list = *(void **)block;
+    p->free_count--;
+    if (p->free_count < p->min_free) {
+        p->min_free = p->free_count;
+    }
+    return block;
+}
+
+void mem_pool_free(mem_pool_t *p, void *block) {
+    if (!block) {
+        return;
+    }
+    *(void **)block = p->free_list;
+    p->free_list = block;
+    p->free_count++;
+}
+
+void mem_arena_print(const mem_arena_t *a) {
+    printf("  %-12s arena %6zu bytes, used %6zu, high water %6zu, failures %u\n",
+           a->name, a->size, a->used, a->high_water, a->failures);
+}
+
+void mem_pool_print(const mem_pool_t *p) {
+    printf("  %-12s pool  %6u x %zu bytes, free %u (min %u), failures %u\n",
+           p->name, p->block_count, p->block_size, p->free_count, p->min_free, p->failures);
+}
@@ -0,0 +1,76 @@
+/*
+ * mem_arena.h - Арены и пулы фиксированных блоков на статической памяти
+ *
+ * Арена: линейное выделение из буфера, освобождение только целиком
+ * (mem_arena_reset) или до отметки (mem_arena_rewind). Используется для
+ * данных команды: сбрасывается перед каждой командой REPL.
+ *
+ * Пул: блоки одного размера со списком свободных, O(1) выделение и
+ * освобождение. Для данных, которые живут дольше одной команды.
+ *
+ * Ни арена, ни пул не обращаются к malloc; синхронизации нет - каждый
+ * экземпляр принадлежит одной подсистеме и одному потоку.
+ */
+
+#ifndef MEM_ARENA_H
+#define MEM_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MEM_ARENA_ALIGN 16
+
+typedef struct {
+    const char *name;
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    size_t high_water;
+    uint32_t failures;         /* Запросы, не поместившиеся в арену */
+} mem_arena_t;
+
+typedef struct {
+    const char *name;
+    uint8_t *base;
+    size_t block_size;
+    uint32_t block_count;
+    uint32_t free_count;
+    uint32_t min_free;
+    uint32_t failures;
+    void *free_list;
+} mem_pool_t;
+
+void mem_arena_init(mem_arena_t *a, const char *name, void *buf, size_t size);
+
+/**
+ * Выделение size байт (выравнивание MEM_ARENA_ALIGN)
+ * @return NULL если арена исчерпана
+ */
+void *mem_arena_alloc(mem_arena_t *a, size_t size);
+
+void mem_arena_reset(mem_arena_t *a);
+
+static inline size_t mem_arena_mark(const mem_arena_t *a) {
+    return a->used;
+}
+
+static inline void mem_arena_rewind(mem_arena_t *a, size_t mark) {
+    if (mark <= a->used) {
+        a->used = mark;
+    }
+}
+
+/**
+ * Пул из buf; block_size округляется вверх до MEM_ARENA_ALIGN,
+ * количество блоков = size / block_size
+ */
+void mem_pool_init(mem_pool_t *p, const char *name, void *buf, size_t size, size_t block_size);
+
+void *mem_pool_alloc(mem_pool_t *p);
+void mem_pool_free(mem_pool_t *p, void *block);
+
+void mem_arena_print(const mem_arena_t *a);
+void mem_pool_print(const mem_pool_t *p);
+
+#endif /* MEM_ARENA_H */
@@ -0,0 +1,742 @@
+/*
+ * nic_lowlat.c - Отчет о low-latency настройках сетевого адаптера
+ *
+ * Рекомендации для EtherCAT master (кадры 60..1514 байт, 1-4 кадра на цикл):
+ * - коалесцирование прерываний выключено (rx/tx-usecs 0, adaptive off)
+ * - небольшие кольца RX/TX (кэш, а не пропускная способность)
+ * - GRO/LRO выключены (задерживают выдачу кадров стеку)
+ * - IRQ адаптера закреплены за ядром циклического потока или соседним
+ * - линк 100 Мбит/с full duplex (скорость EtherCAT сегмента)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nic_lowlat.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <ifaddrs.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#include <linux/net_tstamp.h>
+#endif
+
+const char *nic_rating_str(nic_rating_t r) {
+    switch (r) {
+        case NIC_RATE_OK:   return " OK ";
+        case NIC_RATE_WARN: return "WARN";
+        case NIC_RATE_BAD:  return "BAD ";
+        default:            return "INFO";
+    }
+}
+
+#ifndef _WIN32
+
+/* Таблица offload'ов: LRO управляется через ETHTOOL_GFLAGS/SFLAGS */
+static const nic_offload_t offload_table[] = {
+    { "rx-checksum",    ETHTOOL_GRXCSUM, ETHTOOL_SRXCSUM, false, false },
+    { "tx-checksum",    ETHTOOL_GTXCSUM, ETHTOOL_STXCSUM, false, false },
+    { "scatter-gather", ETHTOOL_GSG,     ETHTOOL_SSG,     false, false },
+    { "tso",            ETHTOOL_GTSO,    ETHTOOL_STSO,    false, false },
+    { "gso",            ETHTOOL_GGSO,    ETHTOOL_SGSO,    false, false },
+    { "gro",            ETHTOOL_GGRO,    ETHTOOL_SGRO,    false, false },
+    { "lro",            ETHTOOL_GFLAGS,  0,               false, false },
+};
+
+/**
+ * Выполнение ethtool ioctl для интерфейса
+ */
+static int nic_ethtool(const char *ifname, void *cmd) {
+    struct ifreq ifr;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    ifr.ifr_data = cmd;
+
+    int ret = ioctl(fd, SIOCETHTOOL, &ifr);
+    close(fd);
+    return ret;
+}
+
+/**
+ * Чтение первой строки файла sysfs/procfs без перевода строки
+ */
+static bool nic_read_line(const char *path, char *buf, size_t len) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    bool ok = fgets(buf, (int)len, f) != NULL;
+    fclose(f);
+    if (ok) {
+        buf[strcspn(buf, "\r\n")] = '\0';
+    }
+    return ok;
+}
+
+/**
+ * Разбор списка CPU вида "0-3,6" в битовую маску (до 64 ядер)
+ */
+static uint64_t nic_parse_cpulist(const char *list) {
+    uint64_t mask = 0;
+    const char *p = list;
+
+    while (*p) {
+        char *end;
+        long a = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        long b = a;
+        if (*end == '-') {
+            p = end + 1;
+            b = strtol(p, &end, 10);
+        }
+        for (long c = a; c <= b && c < 64; c++) {
+            if (c >= 0) {
+                mask |= 1ULL << c;
+            }
+        }
+        p = (*end == ',') ? end + 1 : end;
+        if (*end != ',' && *end != '\0') {
+            break;
+        }
+    }
+
+    return mask;
+}
+
+static int nic_popcount64(uint64_t v) {
+    int n = 0;
+    while (v) {
+        v &= v - 1;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Добавление IRQ в список (без дубликатов)
+ */
+static void nic_add_irq(nic_settings_t *s, int irq) {
+    for (int i = 0; i < s->irq_count; i++) {
+        if (s->irqs[i].irq == irq) {
+            return;
+        }
+    }
+    if (s->irq_count >= NIC_MAX_IRQS) {
+        return;
+    }
+
+    nic_irq_t *e = &s->irqs[s->irq_count++];
+    char path[128];
+    e->irq = irq;
+    snprintf(path, sizeof(path), "/proc/irq/%d/smp_affinity_list", irq);
+    if (!nic_read_line(path, e->affinity, sizeof(e->affinity))) {
+        strcpy(e->affinity, "?");
+    }
+}
+
+/**
+ * Поиск IRQ адаптера: сначала по именам очередей в /proc/interrupts
+ * ("eth0", "eth0-TxRx-0", ...), затем по msi_irqs и legacy irq устройства
+ */
+static void nic_find_irqs(nic_settings_t *s) {
+    char line[1024];
+    size_t name_len = strlen(s->ifname);
+    FILE *f = fopen("/proc/interrupts", "r");
+
+    if (f) {
+        while (fgets(line, sizeof(line), f)) {
+            char *colon = strchr(line, ':');
+            if (!colon) {
+                continue;
+            }
+            char *end;
+            long irq = strtol(line, &end, 10);
+            if (end == line || end > colon) {
+                continue;
+            }
+
+            /* Имя устройства - последнее поле строки */
+            line[strcspn(line, "\r\n")] = '\0';
+            char *name = strrchr(line, ' ');
+            name = name ? name + 1 : line;
+            if (strncmp(name, s->ifname, name_len) == 0 &&
+                (name[name_len] == '\0' || name[name_len] == '-' ||
+                 name[name_len] == ':' || name[name_len] == '@')) {
+                nic_add_irq(s, (int)irq);
+            }
+        }
+        fclose(f);
+    }
+
+    if (s->irq_count > 0) {
+        return;
+    }
+
+    char path[160];
+    snprintf(path, sizeof(path), "/sys/class/net/%s/device/msi_irqs", s->ifname);
+    DIR *dir = opendir(path);
+    if (dir) {
+        struct dirent *de;
+        while ((de = readdir(dir)) != NULL) {
+            if (de->d_name[0] >= '0' && de->d_name[0] <= '9') {
+                nic_add_irq(s, atoi(de->d_name));
+            }
+        }
+        closedir(dir);
+    }
+
+    if (s->irq_count == 0) {
+        char buf[32];
+        snprintf(path, sizeof(path), "/sys/class/net/%s/device/irq", s->ifname);
+        if (nic_read_line(path, buf, sizeof(buf)) && atoi(buf) > 0) {
+            nic_add_irq(s, atoi(buf));
+        }
+    }
+}
+
+bool nic_settings_read(const char *ifname, nic_settings_t *s) {
+    memset(s, 0, sizeof(*s));
+    strncpy(s->ifname, ifname, sizeof(s->ifname) - 1);
+    s->speed_mbps = -1;
+
+    if (if_nametoindex(ifname) == 0) {
+        return false;
+    }
+
+    struct ethtool_drvinfo drvinfo;
+    memset(&drvinfo, 0, sizeof(drvinfo));
+    drvinfo.cmd = ETHTOOL_GDRVINFO;
+    if (nic_ethtool(ifname, &drvinfo) == 0) {
+        s->have_drvinfo = true;
+        snprintf(s->driver, sizeof(s->driver), "%s", drvinfo.driver);
+        snprintf(s->version, sizeof(s->version), "%s", drvinfo.version);
+        snprintf(s->fw_version, sizeof(s->fw_version), "%s", drvinfo.fw_version);
+        snprintf(s->bus_info, sizeof(s->bus_info), "%s", drvinfo.bus_info);
+    }
+
+    struct ethtool_coalesce coal;
+    memset(&coal, 0, sizeof(coal));
+    coal.cmd = ETHTOOL_GCOALESCE;
+    if (nic_ethtool(ifname, &coal) == 0) {
+        s->have_coalesce = true;
+        s->rx_usecs = coal.rx_coalesce_usecs;
+        s->rx_frames = coal.rx_max_coalesced_frames;
+        s->tx_usecs = coal.tx_coalesce_usecs;
+        s->tx_frames = coal.tx_max_coalesced_frames;
+        s->adaptive_rx = coal.use_adaptive_rx_coalesce != 0;
+        s->adaptive_tx = coal.use_adaptive_tx_coalesce != 0;
+    }
+
+    struct ethtool_ringparam ring;
+    memset(&ring, 0, sizeof(ring));
+    ring.cmd = ETHTOOL_GRINGPARAM;
+    if (nic_ethtool(ifname, &ring) == 0) {
+        s->have_rings = true;
+        s->rx_pending = ring.rx_pending;
+        s->rx_max = ring.rx_max_pending;
+        s->tx_pending = ring.tx_pending;
+        s->tx_max = ring.tx_max_pending;
+    }
+
+    s->offload_count = (int)(sizeof(offload_table) / sizeof(offload_table[0]));
+    for (int i = 0; i < s->offload_count; i++) {
+        nic_offload_t *o = &s->offloads[i];
+        struct ethtool_value val;
+
+        *o = offload_table[i];
+        memset(&val, 0, sizeof(val));
+        val.cmd = o->get_cmd;
+        if (nic_ethtool(ifname, &val) == 0) {
+            o->supported = true;
+            o->enabled = (o->get_cmd == ETHTOOL_GFLAGS) ? (val.data & ETH_FLAG_LRO) != 0
+                                                       : val.data != 0;
+        }
+    }
+
+    struct ethtool_ts_info ts;
+    memset(&ts, 0, sizeof(ts));
+    ts.cmd = ETHTOOL_GET_TS_INFO;
+    if (nic_ethtool(ifname, &ts) == 0) {
+        s->have_ts_info = true;
+        s->so_timestamping = ts.so_timestamping;
+        s->phc_index = ts.phc_index;
+        s->tx_types = ts.tx_types;
+        s->rx_filters = ts.rx_filters;
+    }
+
+    nic_find_irqs(s);
+
+    char path[128], buf[32];
+    snprintf(path, sizeof(path), "/sys/class/net/%s/operstate", ifname);
+    s->link_up = nic_read_line(path, buf, sizeof(buf)) && strcmp(buf, "up") == 0;
+    snprintf(path, sizeof(path), "/sys/class/net/%s/speed", ifname);
+    if (nic_read_line(path, buf, sizeof(buf))) {
+        s->speed_mbps = atoi(buf);
+    }
+    snprintf(path, sizeof(path), "/sys/class/net/%s/duplex", ifname);
+    if (!nic_read_line(path, s->duplex, sizeof(s->duplex))) {
+        strcpy(s->duplex, "unknown");
+    }
+
+    return true;
+}
+
+/**
+ * Печать строки отчета и учет худшей оценки
+ */
+static void nic_item(nic_rating_t *worst, nic_rating_t r, const char *label,
+                     const char *value, const char *hint) {
+    printf("  [%s] %-24s %s\n", nic_rating_str(r), label, value);
+    if (hint && r >= NIC_RATE_WARN) {
+        printf("         -> %s\n", hint);
+    }
+    if (r > *worst) {
+        *worst = r;
+    }
+}
+
+nic_rating_t nic_report_print(const char *ifname, int rt_cpu) {
+    nic_settings_t s;
+    nic_rating_t worst = NIC_RATE_INFO;
+    char value[256], hint[256];
+
+    printf("\n=== NIC Low-Latency Report: %s ===\n\n", ifname);
+
+    if (!nic_settings_read(ifname, &s)) {
+        printf("ERROR: Interface '%s' not found\n", ifname);
+        return NIC_RATE_BAD;
+    }
+
+    /* Драйвер и прошивка */
+    if (s.have_drvinfo) {
+        snprintf(value, sizeof(value), "%s %s, firmware %s, bus %s",
+                 s.driver, s.version, s.fw_version[0] ? s.fw_version : "n/a",
+                 s.bus_info[0] ? s.bus_info : "n/a");
+    } else {
+        snprintf(value, sizeof(value), "unavailable (no ETHTOOL_GDRVINFO)");
+    }
+    nic_item(&worst, NIC_RATE_INFO, "Driver:", value, NULL);
+
+    /* Линк */
+    if (!s.link_up) {
+        nic_item(&worst, NIC_RATE_BAD, "Link:", "down", "check cable and first slave power");
+    } else {
+        nic_rating_t r = NIC_RATE_OK;
+        if (strcmp(s.duplex, "full") != 0) {
+            r = NIC_RATE_BAD;
+        } else if (s.speed_mbps != 100) {
+            r = NIC_RATE_WARN;
+        }
+        snprintf(value, sizeof(value), "%d Mbit/s %s duplex", s.speed_mbps, s.duplex);
+        nic_item(&worst, r, "Link:", value,
+                 "EtherCAT runs at 100 Mbit/s full duplex; other speeds suggest a switch in the path");
+    }
+
+    /* Коалесцирование прерываний */
+    if (s.have_coalesce) {
+        nic_rating_t r = NIC_RATE_OK;
+        if (s.adaptive_rx || s.adaptive_tx || s.rx_usecs > 10 || s.tx_usecs > 10) {
+            r = NIC_RATE_BAD;
+        } else if (s.rx_usecs > 0 || s.tx_usecs > 0 || s.rx_frames > 1 || s.tx_frames > 1) {
+            r = NIC_RATE_WARN;
+        }
+        snprintf(value, sizeof(value),
+                 "rx-usecs %u rx-frames %u adaptive-rx %s, tx-usecs %u tx-frames %u adaptive-tx %s",
+                 s.rx_usecs, s.rx_frames, s.adaptive_rx ? "on" : "off",
+                 s.tx_usecs, s.tx_frames, s.adaptive_tx ? "on" : "off");
+        snprintf(hint, sizeof(hint),
+                 "ethtool -C %s adaptive-rx off adaptive-tx off rx-usecs 0 tx-usecs 0", ifname);
+        nic_item(&worst, r, "IRQ coalescing:", value, hint);
+    } else {
+        nic_item(&worst, NIC_RATE_INFO, "IRQ coalescing:", "not reported by driver", NULL);
+    }
+
+    /* Кольцевые буферы */
+    if (s.have_rings) {
+        nic_rating_t r = (s.rx_pending <= 256 && s.tx_pending <= 256) ? NIC_RATE_OK : NIC_RATE_WARN;
+        snprintf(value, sizeof(value), "rx %u (max %u), tx %u (max %u)",
+                 s.rx_pending, s.rx_max, s.tx_pending, s.tx_max);
+        snprintf(hint, sizeof(hint), "ethtool -G %s rx 64 tx 64 (smaller cache footprint)", ifname);
+        nic_item(&worst, r, "Ring sizes:", value, hint);
+    } else {
+        nic_item(&worst, NIC_RATE_INFO, "Ring sizes:", "not reported by driver", NULL);
+    }
+
+    /* Offload'ы: для raw кадров важны только GRO/LRO */
+    for (int i = 0; i < s.offload_count; i++) {
+        const nic_offload_t *o = &s.offloads[i];
+        char label[32];
+        nic_rating_t r = NIC_RATE_INFO;
+
+        snprintf(label, sizeof(label), "Offload %s:", o->name);
+        if (!o->supported) {
+            nic_item(&worst, NIC_RATE_INFO, label, "n/a", NULL);
+            continue;
+        }
+        if (strcmp(o->name, "lro") == 0) {
+            r = o->enabled ? NIC_RATE_BAD : NIC_RATE_OK;
+        } else if (strcmp(o->name, "gro") == 0) {
+            r = o->enabled ? NIC_RATE_WARN : NIC_RATE_OK;
+        }
+        snprintf(hint, sizeof(hint), "ethtool -K %s %s off", ifname, o->name);
+        nic_item(&worst, r, label, o->enabled ? "on" : "off", hint);
+    }
+
+    /* Аппаратные метки времени */
+    if (s.have_ts_info) {
+        bool hw_rx = (s.so_timestamping & SOF_TIMESTAMPING_RX_HARDWARE) != 0;
+        bool hw_tx = (s.so_timestamping & SOF_TIMESTAMPING_TX_HARDWARE) != 0;
+        bool all = (s.rx_filters & (1u << HWTSTAMP_FILTER_ALL)) != 0;
+        snprintf(value, sizeof(value), "hw-rx %s, hw-tx %s, rx-filter-all %s, PHC %d",
+                 hw_rx ? "yes" : "no", hw_tx ? "yes" : "no", all ? "yes" : "no", s.phc_index);
+        nic_item(&worst, (hw_rx && hw_tx && all) ? NIC_RATE_OK : NIC_RATE_INFO,
+                 "HW timestamping:", value, NULL);
+    } else {
+        nic_item(&worst, NIC_RATE_INFO, "HW timestamping:", "not reported by driver", NULL);
+    }
+
+    /* IRQ и affinity */
+    if (s.irq_count == 0) {
+        nic_item(&worst, NIC_RATE_INFO, "IRQs:", "not found (virtual device?)", NULL);
+    }
+    for (int i = 0; i < s.irq_count; i++) {
+        uint64_t mask = nic_parse_cpulist(s.irqs[i].affinity);
+        int ncpu = nic_popcount64(mask);
+        nic_rating_t r = (ncpu > 0 && ncpu <= 2) ? NIC_RATE_OK : NIC_RATE_WARN;
+        char label[32];
+
+        if (rt_cpu >= 0 && rt_cpu < 64 && r == NIC_RATE_OK) {
+            uint64_t near = 1ULL << rt_cpu;
+            if (rt_cpu > 0) near |= 1ULL << (rt_cpu - 1);
+            if (rt_cpu < 63) near |= 1ULL << (rt_cpu + 1);
+            if ((mask & ~near) != 0) {
+                r = NIC_RATE_WARN;
+            }
+        }
+        snprintf(label, sizeof(label), "IRQ %d:", s.irqs[i].irq);
+        snprintf(value, sizeof(value), "CPUs %s", s.irqs[i].affinity);
+        if (rt_cpu >= 0) {
+            snprintf(hint, sizeof(hint), "echo %d > /proc/irq/%d/smp_affinity_list (RT CPU or neighbour)",
+                     rt_cpu, s.irqs[i].irq);
+        } else {
+            snprintf(hint, sizeof(hint), "pin to the cyclic thread's CPU or a neighbour, stop irqbalance");
+        }
+        nic_item(&worst, r, label, value, hint);
+    }
+
+    printf("\n  Overall: %s\n", nic_rating_str(worst));
+    return worst;
+}
+
+/**
+ * Запись строки в файл sysfs/procfs
+ */
+static bool nic_write_line(const char *path, const char *value) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        return false;
+    }
+    bool ok = fputs(value, f) >= 0;
+    if (fclose(f) != 0) {
+        ok = false;
+    }
+    return ok;
+}
+
+/**
+ * Установка коалесцирования (read-modify-write полной структуры)
+ */
+static bool nic_set_coalesce(const char *ifname, uint32_t rx_usecs, uint32_t rx_frames,
+                             uint32_t tx_usecs, uint32_t tx_frames, bool adaptive_rx, bool adaptive_tx) {
+    struct ethtool_coalesce coal;
+    memset(&coal, 0, sizeof(coal));
+    coal.cmd = ETHTOOL_GCOALESCE;
+    if (nic_ethtool(ifname, &coal) != 0) {
+        return false;
+    }
+    coal.cmd = ETHTOOL_SCOALESCE;
+    coal.rx_coalesce_usecs = rx_usecs;
+    coal.rx_max_coalesced_frames = rx_frames;
+    coal.tx_coalesce_usecs = tx_usecs;
+    coal.tx_max_coalesced_frames = tx_frames;
+    coal.use_adaptive_rx_coalesce = adaptive_rx ? 1 : 0;
+    coal.use_adaptive_tx_coalesce = adaptive_tx ? 1 : 0;
+    return nic_ethtool(ifname, &coal) == 0;
+}
+
+/**
+ * Установка размеров колец
+ */
+static bool nic_set_rings(const char *ifname, uint32_t rx, uint32_t tx) {
+    struct ethtool_ringparam ring;
+    memset(&ring, 0, sizeof(ring));
+    ring.cmd = ETHTOOL_GRINGPARAM;
+    if (nic_ethtool(ifname, &ring) != 0) {
+        return false;
+    }
+    ring.cmd = ETHTOOL_SRINGPARAM;
+    ring.rx_pending = rx;
+    ring.tx_pending = tx;
+    return nic_ethtool(ifname, &ring) == 0;
+}
+
+/**
+ * Включение/выключение offload'а
+ */
+static bool nic_set_offload(const char *ifname, const nic_offload_t *o, bool enable) {
+    struct ethtool_value val;
+    memset(&val, 0, sizeof(val));
+
+    if (o->set_cmd == 0) {
+        /* LRO: через битовую маску флагов */
+        val.cmd = ETHTOOL_GFLAGS;
+        if (nic_ethtool(ifname, &val) != 0) {
+            return false;
+        }
+        val.cmd = ETHTOOL_SFLAGS;
+        val.data = enable ? (val.data | ETH_FLAG_LRO) : (val.data & ~(uint32_t)ETH_FLAG_LRO);
+    } else {
+        val.cmd = o->set_cmd;
+        val.data = enable ? 1 : 0;
+    }
+    return nic_ethtool(ifname, &val) == 0;
+}
+
+/* Маска в hex формате "00000000,0000000f": нулевая - только "0" и "," */
+static bool nic_mask_zero(const char *mask) {
+    return strspn(mask, "0,") == strlen(mask);
+}
+
+/**
+ * Сохранение и обнуление RPS/XPS масок всех очередей
+ *
+ * @param cleared Число очередей с ненулевой маской (обнулены)
+ * @return Число прочитанных очередей
+ */
+static int nic_clear_queue_masks(const char *ifname, const char *prefix, const char *file,
+                                 char saved[][64], int *cleared) {
+    int count = 0;
+
+    *cleared = 0;
+    for (int q = 0; q < NIC_MAX_QUEUES; q++) {
+        char path[160];
+        snprintf(path, sizeof(path), "/sys/class/net/%s/queues/%s-%d/%s", ifname, prefix, q, file);
+        if (!nic_read_line(path, saved[q], 64)) {
+            break;
+        }
+        count = q + 1;
+        /* Трогаем только ненулевые */
+        if (!nic_mask_zero(saved[q]) && nic_write_line(path, "0")) {
+            (*cleared)++;
+        }
+    }
+
+    return count;
+}
+
+static void nic_restore_queue_masks(const char *ifname, const char *prefix, const char *file,
+                                    char saved[][64], int count) {
+    for (int q = 0; q < count; q++) {
+        char path[160];
+        if (nic_mask_zero(saved[q])) {
+            continue;                    /* Не менялась */
+        }
+        snprintf(path, sizeof(path), "/sys/class/net/%s/queues/%s-%d/%s", ifname, prefix, q, file);
+        nic_write_line(path, saved[q]);
+    }
+}
+
+bool nic_tune_apply(const char *ifname, int irq_cpu, nic_tune_state_t *state) {
+    nic_settings_t *o = &state->orig;
+    bool changed = false;
+
+    memset(state, 0, sizeof(*state));
+    if (!nic_settings_read(ifname, o)) {
+        printf("ERROR: Interface '%s' not found\n", ifname);
+        return false;
+    }
+
+    printf("\n=== Tuning NIC %s for low latency ===\n", ifname);
+
+    /* Коалесцирование прерываний */
+    if (o->have_coalesce &&
+        (o->rx_usecs || o->tx_usecs || o->rx_frames > 1 || o->tx_frames > 1 ||
+         o->adaptive_rx || o->adaptive_tx)) {
+        state->coalesce_changed = nic_set_coalesce(ifname, 0, 1, 0, 1, false, false);
+        /* Не все драйверы принимают frames=1, пробуем без изменения frames */
+        if (!state->coalesce_changed) {
+            state->coalesce_changed = nic_set_coalesce(ifname, 0, o->rx_frames, 0, o->tx_frames,
+                                                       false, false);
+        }
+        printf("  Coalescing off:    %s\n", state->coalesce_changed ? "applied" : "FAILED");
+        changed |= state->coalesce_changed;
+    }
+
+    /* Кольца: берем наименьший размер, который принимает драйвер */
+    if (o->have_rings && (o->rx_pending > NIC_TUNE_RING || o->tx_pending > NIC_TUNE_RING)) {
+        for (uint32_t size = NIC_TUNE_RING; size < o->rx_pending || size < o->tx_pending; size *= 2) {
+            uint32_t rx = size < o->rx_pending ? size : o->rx_pending;
+            uint32_t tx = size < o->tx_pending ? size : o->tx_pending;
+            if (nic_set_rings(ifname, rx, tx)) {
+                state->rings_changed = true;
+                printf("  Rings rx/tx:       %u/%u -> %u/%u\n", o->rx_pending, o->tx_pending, rx, tx);
+                break;
+            }
+        }
+        if (!state->rings_changed) {
+            printf("  Rings:             FAILED (driver rejected smaller rings)\n");
+        }
+        changed |= state->rings_changed;
+    }
+
+    /* Offload'ы, объединяющие кадры */
+    for (int i = 0; i < o->offload_count; i++) {
+        const nic_offload_t *off = &o->offloads[i];
+        if (!off->supported || !off->enabled) {
+            continue;
+        }
+        if (strcmp(off->name, "gro") != 0 && strcmp(off->name, "lro") != 0 &&
+            strcmp(off->name, "gso") != 0 && strcmp(off->name, "tso") != 0) {
+            continue;
+        }
+        state->offload_changed[i] = nic_set_offload(ifname, off, false);
+        printf("  Offload %-10s %s\n", off->name, state->offload_changed[i] ? "off" : "FAILED");
+        changed |= state->offload_changed[i];
+    }
+
+    /* IRQ affinity */
+    if (irq_cpu >= 0) {
+        char cpu[16];
+        snprintf(cpu, sizeof(cpu), "%d", irq_cpu);
+        for (int i = 0; i < o->irq_count; i++) {
+            if (strcmp(o->irqs[i].affinity, cpu) == 0) {
+                continue;
+            }
+            if (strcmp(o->irqs[i].affinity, "?") == 0) {
+                /* Исходная маска не прочитана - вернуть было бы нечего */
+                printf("  IRQ %-4d CPUs ? (unreadable), left unchanged\n", o->irqs[i].irq);
+                continue;
+            }
+            char path[64];
+            snprintf(path, sizeof(path), "/proc/irq/%d/smp_affinity_list", o->irqs[i].irq);
+            state->irq_changed[i] = nic_write_line(path, cpu);
+            printf("  IRQ %-4d CPUs %s -> %s  %s\n", o->irqs[i].irq, o->irqs[i].affinity, cpu,
+                   state->irq_changed[i] ? "" : "FAILED (managed IRQ?)");
+            changed |= state->irq_changed[i];
+        }
+    }
+
+    /* RPS/XPS: кадры обрабатываются на ядре, получившем прерывание */
+    int rps_cleared, xps_cleared;
+    state->rps_count = nic_clear_queue_masks(ifname, "rx", "rps_cpus", state->rps_orig, &rps_cleared);
+    state->xps_count = nic_clear_queue_masks(ifname, "tx", "xps_cpus", state->xps_orig, &xps_cleared);
+    if (rps_cleared || xps_cleared) {
+        printf("  RPS/XPS:           disabled on %d rx / %d tx queue(s)\n", rps_cleared, xps_cleared);
+        changed = true;
+    }
+
+    state->applied = changed;
+    if (!changed) {
+        printf("  Nothing to change, settings already low-latency\n");
+    }
+    return changed;
+}
+
+void nic_tune_restore(nic_tune_state_t *state) {
+    if (!state->applied) {
+        return;
+    }
+
+    nic_settings_t *o = &state->orig;
+    const char *ifname = o->ifname;
+
+    if (state->coalesce_changed) {
+        nic_set_coalesce(ifname, o->rx_usecs, o->rx_frames, o->tx_usecs, o->tx_frames,
+                         o->adaptive_rx, o->adaptive_tx);
+    }
+    if (state->rings_changed) {
+        nic_set_rings(ifname, o->rx_pending, o->tx_pending);
+    }
+    for (int i = 0; i < o->offload_count; i++) {
+        if (state->offload_changed[i]) {
+            nic_set_offload(ifname, &o->offloads[i], true);
+        }
+    }
+    for (int i = 0; i < o->irq_count; i++) {
+        if (state->irq_changed[i] && strcmp(o->irqs[i].affinity, "?") != 0) {
+            char path[64];
+            snprintf(path, sizeof(path), "/proc/irq/%d/smp_affinity_list", o->irqs[i].irq);
+            nic_write_line(path, o->irqs[i].affinity);
+        }
+    }
+    nic_restore_queue_masks(ifname, "rx", "rps_cpus", state->rps_orig, state->rps_count);
+    nic_restore_queue_masks(ifname, "tx", "xps_cpus", state->xps_orig, state->xps_count);
+
+    state->applied = false;
+    printf("NIC %s settings restored\n", ifname);
+}
+
+void nic_report_all(int rt_cpu) {
+    struct ifaddrs *ifaddr, *ifa;
+
+    if (getifaddrs(&ifaddr) == -1) {
+        perror("getifaddrs");
+        return;
+    }
+    for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr == NULL || ifa->ifa_addr->sa_family != AF_PACKET)
+            continue;
+        if (!(ifa->ifa_flags & IFF_UP) || (ifa->ifa_flags & IFF_LOOPBACK))
+            continue;
+        nic_report_print(ifa->ifa_name, rt_cpu);
+    }
+    freeifaddrs(ifaddr);
+}
+
+#else /* _WIN32 */
+
+bool nic_settings_read(const char *ifname, nic_settings_t *s) {
+    (void)ifname;
+    memset(s, 0, sizeof(*s));
+    return false;
+}
+
+nic_rating_t nic_report_print(const char *ifname, int rt_cpu) {
+    (void)ifname;
+    (void)rt_cpu;
+    printf("\nNIC low-latency report is only available on Linux.\n");
+    printf("On Windows check adapter properties: Interrupt Moderation = Disabled.\n");
+    return NIC_RATE_INFO;
+}
+
+void nic_report_all(int rt_cpu) {
+    nic_report_print(NULL, rt_cpu);
+}
+
+bool nic_tune_apply(const char *ifname, int irq_cpu, nic_tune_state_t *state) {
+    (void)ifname;
+    (void)irq_cpu;
+    memset(state, 0, sizeof(*state));
+    printf("NIC tuning is only available on Linux.\n");
+    return false;
+}
+
+void nic_tune_restore(nic_tune_state_t *state) {
+    (void)state;
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,135 @@
+/*
+ * nic_lowlat.h - Отчет о low-latency настройках сетевого адаптера
+ *
+ * Собирает через ethtool ioctl и sysfs/procfs параметры интерфейса,
+ * влияющие на время круга EtherCAT кадра (коалесцирование прерываний,
+ * размеры колец, offload'ы, аппаратные метки времени, IRQ и их affinity,
+ * скорость/дуплекс), и оценивает их относительно рекомендаций.
+ *
+ * Только Linux; на других платформах функции сообщают о неподдерживаемости.
+ */
+
+#ifndef NIC_LOWLAT_H
+#define NIC_LOWLAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NIC_MAX_IRQS      32
+#define NIC_MAX_OFFLOADS  8
+#define NIC_NAME_LEN      32
+#define NIC_MAX_QUEUES    16
+#define NIC_TUNE_RING     64    /* Целевой размер колец при тюнинге */
+
+/* Оценка параметра относительно рекомендаций для EtherCAT */
+typedef enum {
+    NIC_RATE_INFO = 0,
+    NIC_RATE_OK,
+    NIC_RATE_WARN,
+    NIC_RATE_BAD
+} nic_rating_t;
+
+/* Один offload (rx-checksum, gro, lro, ...) */
+typedef struct {
+    const char *name;
+    uint32_t get_cmd;           /* ETHTOOL_Gxxx */
+    uint32_t set_cmd;           /* ETHTOOL_Sxxx, 0 если через флаги */
+    bool supported;
+    bool enabled;
+} nic_offload_t;
+
+/* IRQ линия адаптера */
+typedef struct {
+    int irq;
+    char affinity[64];          /* smp_affinity_list */
+} nic_irq_t;
+
+/* Снимок настроек интерфейса */
+typedef struct {
+    char ifname[NIC_NAME_LEN];
+
+    bool have_drvinfo;
+    char driver[32];
+    char version[32];
+    char fw_version[32];
+    char bus_info[32];
+
+    bool have_coalesce;
+    uint32_t rx_usecs, rx_frames, tx_usecs, tx_frames;
+    bool adaptive_rx, adaptive_tx;
+
+    bool have_rings;
+    uint32_t rx_pending, rx_max, tx_pending, tx_max;
+
+    int offload_count;
+    nic_offload_t offloads[NIC_MAX_OFFLOADS];
+
+    bool have_ts_info;
+    uint32_t so_timestamping;
+    int32_t phc_index;
+    uint32_t tx_types;
+    uint32_t rx_filters;
+
+    int irq_count;
+    nic_irq_t irqs[NIC_MAX_IRQS];
+
+    bool link_up;
+    int speed_mbps;             /* -1 если неизвестно */
+    char duplex[16];
+} nic_settings_t;
+
+/* Сохраненное состояние для отката тюнинга */
+typedef struct {
+    bool applied;
+    nic_settings_t orig;                        /* Снимок до изменений */
+    bool coalesce_changed;
+    bool rings_changed;
+    bool offload_changed[NIC_MAX_OFFLOADS];
+    bool irq_changed[NIC_MAX_IRQS];
+    int rps_count;
+    char rps_orig[NIC_MAX_QUEUES][64];          /* rx-N/rps_cpus */
+    int xps_count;
+    char xps_orig[NIC_MAX_QUEUES][64];          /* tx-N/xps_cpus */
+} nic_tune_state_t;
+
+/**
+ * Чтение текущих настроек интерфейса
+ *
+ * @return true если интерфейс существует и хотя бы часть данных прочитана
+ */
+bool nic_settings_read(const char *ifname, nic_settings_t *s);
+
+/**
+ * Вывод отчета с оценкой каждого параметра
+ *
+ * @param rt_cpu Ядро циклического потока для проверки affinity IRQ (-1 если неизвестно)
+ * @return худшая оценка среди параметров
+ */
+nic_rating_t nic_report_print(const char *ifname, int rt_cpu);
+
+/**
+ * Отчет по всем поднятым не-loopback интерфейсам
+ */
+void nic_report_all(int rt_cpu);
+
+/**
+ * Применение low-latency настроек: коалесцирование выключено, маленькие
+ * кольца, GRO/LRO/GSO/TSO выключены, IRQ закреплены за irq_cpu,
+ * RPS/XPS выключены. Исходные значения сохраняются в state.
+ *
+ * @param irq_cpu Ядро для IRQ адаптера (-1 - не трогать affinity)
+ * @return true если хотя бы одна настройка изменена
+ */
+bool nic_tune_apply(const char *ifname, int irq_cpu, nic_tune_state_t *state);
+
+/**
+ * Откат к сохраненным настройкам (повторный вызов безопасен)
+ */
+void nic_tune_restore(nic_tune_state_t *state);
+
+/**
+ * Короткая строка для оценки ("OK", "WARN", ...)
+ */
+const char *nic_rating_str(nic_rating_t r);
+
+#endif /* NIC_LOWLAT_H */
@@ -0,0 +1,843 @@
+/*
+ * path_plan.c - Интерполяция траектории группы осей с просмотром вперед
+ */
+
+#define _GNU_SOURCE  /* CPU_SET, pthread_attr_setaffinity_np */
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "path_plan.h"
+#include "axis_units.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define PP_LINE 0
+#define PP_ARC  1
+
+typedef struct {
+    uint8_t type;
+    int line;
+    double start[PATH_PLAN_MAX_AXES];
+    double end[PATH_PLAN_MAX_AXES];
+    double center[2];            /* Дуга: центр в XY */
+    double radius;
+    double angle0;
+    double sweep;                /* Рад, > 0 - против часовой */
+    double length;
+    double dir_in[PATH_PLAN_MAX_AXES];
+    double dir_out[PATH_PLAN_MAX_AXES];
+    double feed;                 /* Единиц/с */
+    double max_entry;            /* Предел скорости входа: угол и подачи */
+    double entry;                /* По плану */
+} pp_seg_t;
+
+typedef struct {
+    int32_t pos[PATH_PLAN_MAX_AXES];
+} pp_setpoint_t;
+
+/* ============================================================================
+ * Группа и очереди
+ * ============================================================================ */
+
+static volatile bool pp_active = false;
+static int pp_axes = 0;
+static uint16_t pp_slave[PATH_PLAN_MAX_AXES];
+static path_axis_pdo_t pp_pdo[PATH_PLAN_MAX_AXES];
+static double pp_period_s;
+static uint32_t pp_fill_target;
+static double pp_accel = PATH_PLAN_DEFAULT_ACCEL;
+static double pp_junction = PATH_PLAN_DEFAULT_JUNCTION;
+static double pp_rapid = PATH_PLAN_DEFAULT_RAPID / 60.0;
+
+static int pp_state = PATH_IDLE;
+static bool pp_hold;                            /* CLI: тормозить */
+static bool pp_hold_done;                       /* Планировщик: стоит, окно сброшено */
+
+/* Кольцо сегментов: head пишет CLI, tail - планировщик */
+static pp_seg_t pp_ring[PATH_PLAN_SEGMENTS];
+static uint32_t pp_ring_head, pp_ring_tail;
+static uint64_t pp_queued, pp_done;
+
+/* Кольцо уставок: head пишет планировщик, tail - циклический поток */
+static pp_setpoint_t pp_sp[PATH_PLAN_SETPOINTS];
+static uint32_t pp_sp_head, pp_sp_tail;
+static uint64_t pp_setpoints, pp_underruns;
+static uint32_t pp_queue_min;
+
+static uint32_t pp_load(const uint32_t *p) {
+#ifdef _WIN32
+    return *(const volatile uint32_t *)p;        /* Windows: все в одном потоке */
+#else
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void pp_store(uint32_t *p, uint32_t v) {
+#ifdef _WIN32
+    *(volatile uint32_t *)p = v;
+#else
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#endif
+}
+
+static uint64_t pp_load64(const uint64_t *p) {
+#ifdef _WIN32
+    return *(const volatile uint64_t *)p;
+#else
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void pp_add64(uint64_t *p, uint64_t v) {
+#ifdef _WIN32
+    *(volatile uint64_t *)p += v;
+#else
+    __atomic_store_n(p, *p + v, __ATOMIC_RELEASE);   /* Один писатель */
+#endif
+}
+
+static int pp_get_state(void) {
+#ifdef _WIN32
+    return *(volatile int *)&pp_state;
+#else
+    return __atomic_load_n(&pp_state, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void pp_set_state(int st) {
+#ifdef _WIN32
+    *(volatile int *)&pp_state = st;
+#else
+    __atomic_store_n(&pp_state, st, __ATOMIC_RELEASE);
+#endif
+}
+
+static bool pp_cas_state(int from, int to) {
+#ifdef _WIN32
+    if (pp_state != from) {
+        return false;
+    }
+    pp_state = to;
+    return true;
+#else
+    return __atomic_compare_exchange_n(&pp_state, &from, to, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static bool pp_get_flag(const bool *p) {
+#ifdef _WIN32
+    return *(const volatile bool *)p;
+#else
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void pp_set_flag(bool *p, bool v) {
+#ifdef _WIN32
+    *(volatile bool *)p = v;
+#else
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#endif
+}
+
+/* ============================================================================
+ * Планировщик (свой поток; в виртуальном времени - из цикла)
+ * ============================================================================ */
+
+static pp_seg_t pp_win[PATH_PLAN_LOOKAHEAD];
+static int pp_win_n = 0;
+static double pp_s = 0.0;                       /* Пройдено по первому сегменту окна */
+static double pp_v = 0.0;
+static double pp_exit0 = 0.0;                   /* Скорость выхода первого сегмента */
+static double pp_pos[PATH_PLAN_MAX_AXES];       /* Последняя выданная точка */
+static double pp_origin[PATH_PLAN_MAX_AXES];    /* Старт группы: в единицах и точно в инкрементах */
+static int64_t pp_origin_inc[PATH_PLAN_MAX_AXES];
+static int pp_cur_line = 0;
+
+/**
+ * Скорости стыков: обратный проход от конца окна (там - остановка),
+ * затем прямой от текущей скорости до выхода первого сегмента
+ */
+static void pp_replan(void) {
+    double a2 = 2.0 * pp_accel;
+    double next = 0.0;
+
+    for (int k = pp_win_n - 1; k >= 1; k--) {
+        double reach = sqrt(next * next + a2 * pp_win[k].length);
+        pp_win[k].entry = fmin(pp_win[k].max_entry, reach);
+        next = pp_win[k].entry;
+    }
+    if (pp_win_n == 0) {
+        pp_exit0 = 0.0;
+        return;
+    }
+    double reach = sqrt(pp_v * pp_v + a2 * fmax(pp_win[0].length - pp_s, 0.0));
+    pp_exit0 = pp_win_n > 1 ? fmin(pp_win[1].entry, reach) : 0.0;
+}
+
+static void pp_point(const pp_seg_t *g, double s, double *out) {
+    double t = g->length > 0.0 ? s / g->length : 1.0;
+
+    if (g->type == PP_ARC) {
+        double ang = g->angle0 + g->sweep * t;
+        out[0] = g->center[0] + g->radius * cos(ang);
+        out[1] = g->center[1] + g->radius * sin(ang);
+        if (pp_axes > 2) {
+            out[2] = g->start[2] + (g->end[2] - g->start[2]) * t;
+        }
+        return;
+    }
+    for (int i = 0; i < pp_axes; i++) {
+        out[i] = g->start[i] + (g->end[i] - g->start[i]) * t;
+    }
+}
+
+static void pp_pop_front(void) {
+    pp_win_n--;
+    memmove(&pp_win[0], &pp_win[1], (size_t)pp_win_n * sizeof(pp_win[0]));
+    pp_s = 0.0;
+}
+
+static void pp_push_setpoint(void) {
+    uint32_t head = pp_sp_head;
+    pp_setpoint_t *sp = &pp_sp[head & (PATH_PLAN_SETPOINTS - 1)];
+
+    /* От старта, а не от нуля: первая уставка равна факту до отсчета */
+    for (int i = 0; i < pp_axes; i++) {
+        int64_t inc = pp_origin_inc[i] +
+                      axis_units_inc_from_user(pp_slave[i], llround((pp_pos[i] - pp_origin[i]) * AXIS_UNITS_MICRO));
+        sp->pos[i] = (int32_t)(uint32_t)inc;     /* Младшие 32 бита развертки = 0x607A */
+    }
+    pp_store(&pp_sp_head, head + 1);
+}
+
+/**
+ * Сбросить окно и кольцо сегментов (останов или авария)
+ */
+static void pp_flush(void) {
+    pp_win_n = 0;
+    pp_s = 0.0;
+    pp_v = 0.0;
+    pp_store(&pp_ring_tail, pp_load(&pp_ring_head));
+    pp_add64(&pp_done, pp_load64(&pp_queued) - pp_done);
+}
+
+/**
+ * Следующая уставка: скорость по трапеции (разгон, подача, торможение к
+ * выходу сегмента), шаг по длине, переход на следующий сегмент с остатком
+ */
+static void pp_step(void) {
+    double a = pp_accel;
+    double dt = pp_period_s;
+    bool last = false;
+
+    if (pp_get_flag(&pp_hold)) {
+        pp_v = fmax(pp_v - a * dt, 0.0);
+    } else {
+        const pp_seg_t *g = &pp_win[0];
+        double brake = sqrt(pp_exit0 * pp_exit0 + 2.0 * a * fmax(g->length - pp_s, 0.0));
+        double v = fmin(fmin(pp_v + a * dt, g->feed), brake);
+        /* Минимальный шаг: без него торможение к нулю не доходит до конца */
+        pp_v = fmax(v, fmin(a * dt, g->feed));
+    }
+    pp_s += pp_v * dt;
+
+    while (pp_s >= pp_win[0].length) {
+        if (pp_win_n == 1) {
+            pp_s = pp_win[0].length;
+            pp_v = 0.0;
+            last = true;
+            break;
+        }
+        double rest = pp_s - pp_win[0].length;
+        pp_pop_front();
+        pp_add64(&pp_done, 1);
+        pp_s = rest;
+        pp_replan();
+    }
+
+    pp_cur_line = pp_win[0].line;
+    pp_point(&pp_win[0], pp_s, pp_pos);
+    pp_push_setpoint();
+
+    /* Конечная точка в очереди раньше счетчика: цикл по счетчику видит ее */
+    if (last) {
+        pp_pop_front();
+        pp_add64(&pp_done, 1);
+    }
+}
+
+static void pp_pump(void) {
+    int st = pp_get_state();
+
+    if (st == PATH_ABORTED) {
+        if (pp_win_n > 0 || pp_load(&pp_ring_tail) != pp_load(&pp_ring_head)) {
+            pp_flush();
+        }
+        return;
+    }
+
+    /* Новые сегменты в окно */
+    bool changed = false;
+    uint32_t tail = pp_ring_tail;
+    uint32_t head = pp_load(&pp_ring_head);
+    while (pp_win_n < PATH_PLAN_LOOKAHEAD && tail != head) {
+        pp_win[pp_win_n++] = pp_ring[tail % PATH_PLAN_SEGMENTS];
+        tail++;
+        changed = true;
+    }
+    if (changed) {
+        pp_store(&pp_ring_tail, tail);
+        pp_replan();
+    }
+
+    while (pp_win_n > 0 && pp_load(&pp_sp_head) - pp_load(&pp_sp_tail) < pp_fill_target) {
+        pp_step();
+        if (pp_get_flag(&pp_hold) && pp_v == 0.0) {
+            break;
+        }
+    }
+
+    if (pp_get_flag(&pp_hold) && !pp_get_flag(&pp_hold_done) && (pp_win_n == 0 || pp_v == 0.0)) {
+        pp_flush();
+        pp_set_flag(&pp_hold_done, true);
+    }
+}
+
+#ifndef _WIN32
+static pthread_t pp_thread;
+static bool pp_thread_started = false;
+static volatile bool pp_thread_run = false;
+
+static void *pp_thread_fn(void *arg) {
+    (void)arg;
+    long sleep_ns = (long)(pp_period_s * 1e9 / 2);
+    struct timespec ts = {0, sleep_ns > 500000 ? 500000 : sleep_ns};
+
+    while (pp_thread_run) {
+        pp_pump();
+        nanosleep(&ts, NULL);
+    }
+    return NULL;
+}
+#endif
+
+static bool pp_threaded = false;
+static int pp_cpu = -1;
+
+/* ============================================================================
+ * Группа (поток CLI)
+ * ============================================================================ */
+
+bool path_plan_group(int axes, const uint16_t *slaves, const path_axis_pdo_t *pdo,
+                     const int64_t *start_inc, uint32_t period_us, bool threaded, int cpu) {
+    if (axes < 2 || axes > PATH_PLAN_MAX_AXES || period_us == 0 || pp_active) {
+        return false;
+    }
+#ifndef _WIN32
+    if (threaded && cpu >= (int)sysconf(_SC_NPROCESSORS_ONLN)) {
+        printf("ERROR: CPU %d is not online (%ld CPU(s) available)\n", cpu, sysconf(_SC_NPROCESSORS_ONLN));
+        return false;
+    }
+#endif
+
+    pp_axes = axes;
+    for (int i = 0; i < axes; i++) {
+        pp_slave[i] = slaves[i];
+        pp_pdo[i] = pdo[i];
+        pp_origin_inc[i] = start_inc[i];
+        pp_origin[i] = axis_units_user_from_inc(slaves[i], start_inc[i]) / (double)AXIS_UNITS_MICRO;
+        pp_pos[i] = pp_origin[i];
+    }
+    pp_period_s = period_us / 1e6;
+    pp_fill_target = (uint32_t)(PATH_PLAN_QUEUE_MS * 1000u / period_us);
+    if (pp_fill_target < 2) {
+        pp_fill_target = 2;
+    } else if (pp_fill_target > PATH_PLAN_SETPOINTS - 1) {
+        pp_fill_target = PATH_PLAN_SETPOINTS - 1;
+    }
+
+    pp_ring_head = pp_ring_tail = 0;
+    pp_sp_head = pp_sp_tail = 0;
+    pp_queued = pp_done = 0;
+    pp_setpoints = pp_underruns = 0;
+    pp_queue_min = pp_fill_target;
+    pp_win_n = 0;
+    pp_s = pp_v = 0.0;
+    pp_hold = pp_hold_done = false;
+    pp_state = PATH_IDLE;
+
+#ifdef _WIN32
+    (void)cpu;
+    pp_threaded = false;
+    pp_cpu = -1;
+    (void)threaded;
+#else
+    pp_threaded = threaded;
+    pp_cpu = cpu;
+    if (threaded) {
+        pthread_attr_t attr;
+        cpu_set_t set;
+
+        pthread_attr_init(&attr);
+        if (cpu >= 0) {
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        }
+        pp_thread_run = true;
+        if (pthread_create(&pp_thread, &attr, pp_thread_fn, NULL) != 0) {
+            pthread_attr_destroy(&attr);
+            pp_thread_run = false;
+            printf("ERROR: Failed to start the path planner thread\n");
+            return false;
+        }
+        pthread_attr_destroy(&attr);
+        pp_thread_started = true;
+    }
+#endif
+
+    pp_active = true;
+    return true;
+}
+
+void path_plan_release(void) {
+    pp_active = false;
+#ifndef _WIN32
+    if (pp_thread_started) {
+        pp_thread_run = false;
+        pthread_join(pp_thread, NULL);
+        pp_thread_started = false;
+    }
+#endif
+    pp_state = PATH_IDLE;
+}
+
+bool path_plan_active(void) {
+    return pp_active;
+}
+
+void path_plan_set_limits(double accel, double junction, double rapid) {
+    pp_accel = accel;
+    pp_junction = junction;
+    pp_rapid = rapid / 60.0;
+}
+
+void path_plan_stop(void) {
+    if (pp_active && pp_get_state() == PATH_RUNNING) {
+        pp_set_flag(&pp_hold, true);
+    }
+}
+
+/* ============================================================================
+ * Разбор G-code (поток CLI)
+ * ============================================================================ */
+
+static double pp_prog[PATH_PLAN_MAX_AXES];      /* Конец последнего сегмента */
+static bool pp_absolute = true;
+static int pp_motion = 1;
+static double pp_feed = 0.0;                    /* Единиц/с */
+static bool pp_have_prev = false;
+static double pp_prev_dir[PATH_PLAN_MAX_AXES];
+static double pp_prev_feed;
+
+/**
+ * Предел скорости на стыке: окружность, вписанная в угол с отклонением
+ * junction от вершины, при центростремительном ускорении группы
+ */
+static double pp_junction_speed(const double *out_prev, const double *in_next, double v_max) {
+    double cos_t = 0.0;
+
+    for (int i = 0; i < pp_axes; i++) {
+        cos_t -= out_prev[i] * in_next[i];
+    }
+    if (cos_t > 0.999999) {
+        return 0.0;                              /* Разворот */
+    }
+    if (cos_t < -0.999999) {
+        return v_max;                            /* Прямая */
+    }
+    double sin_half = sqrt(0.5 * (1.0 - cos_t));
+    return fmin(v_max, sqrt(pp_accel * pp_junction * sin_half / (1.0 - sin_half)));
+}
+
+static void pp_normalize(double *v, int n) {
+    double len = 0.0;
+    for (int i = 0; i < n; i++) {
+        len += v[i] * v[i];
+    }
+    len = sqrt(len);
+    for (int i = 0; i < n && len > 0.0; i++) {
+        v[i] /= len;
+    }
+}
+
+/**
+ * Касательная дуги в точке угла ang (с учетом подъема по Z)
+ */
+static void pp_arc_dir(const pp_seg_t *g, double ang, double *dir) {
+    double sign = g->sweep >= 0.0 ? 1.0 : -1.0;
+    double xy = g->radius * fabs(g->sweep);
+
+    dir[0] = -sin(ang) * sign * xy;
+    dir[1] = cos(ang) * sign * xy;
+    if (pp_axes > 2) {
+        dir[2] = g->end[2] - g->start[2];
+    }
+    pp_normalize(dir, pp_axes);
+}
+
+static void pp_err(char *error, int size, int line_no, const char *msg) {
+    if (line_no > 0) {
+        snprintf(error, (size_t)size, "line %d: %s", line_no, msg);
+    } else {
+        snprintf(error, (size_t)size, "%s", msg);
+    }
+}
+
+int path_plan_gcode(const char *line, int line_no, char *error, int error_size) {
+    double word[26];
+    bool has[26] = {false};
+    int gcodes[8];
+    int ngcodes = 0;
+    char buf[256];
+    int n = 0;
+
+    if (!pp_active) {
+        pp_err(error, error_size, line_no, "no axis group");
+        return -1;
+    }
+    int st = pp_get_state();
+    if (st == PATH_ABORTED) {
+        pp_err(error, error_size, line_no, "path aborted, set the group again to resync");
+        return -1;
+    }
+    if (st == PATH_RUNNING && pp_get_flag(&pp_hold)) {
+        pp_err(error, error_size, line_no, "path is stopping");
+        return -1;
+    }
+    if (pp_load(&pp_ring_head) - pp_load(&pp_ring_tail) >= PATH_PLAN_SEGMENTS) {
+        return 0;
+    }
+
+    /* Без комментариев и пробелов, в верхнем регистре */
+    bool paren = false;
+    for (const char *p = line; *p && *p != ';' && n < (int)sizeof(buf) - 1; p++) {
+        if (*p == '(') {
+            paren = true;
+        } else if (*p == ')') {
+            paren = false;
+        } else if (!paren && !isspace((unsigned char)*p)) {
+            buf[n++] = (char)toupper((unsigned char)*p);
+        }
+    }
+    buf[n] = '\0';
+
+    for (const char *p = buf; *p;) {
+        char letter = *p++;
+        char *end;
+        double v = strtod(p, &end);
+        if (letter < 'A' || letter > 'Z' || end == p) {
+            pp_err(error, error_size, line_no, "expected <letter><number>");
+            return -1;
+        }
+        p = end;
+        if (letter == 'G') {
+            if (ngcodes < (int)(sizeof(gcodes) / sizeof(gcodes[0]))) {
+                gcodes[ngcodes++] = (int)lround(v);
+            }
+        } else {
+            word[letter - 'A'] = v;
+            has[letter - 'A'] = true;
+        }
+    }
+    if (has['M' - 'A']) {
+        int m = (int)lround(word['M' - 'A']);
+        if (m != 2 && m != 30) {
+            pp_err(error, error_size, line_no, "only M2/M30 supported");
+            return -1;
+        }
+    }
+    for (int k = 0; k < 26; k++) {
+        if (has[k] && !strchr("XYZIJFNM", 'A' + k)) {
+            pp_err(error, error_size, line_no, "unsupported word");
+            return -1;
+        }
+    }
+    if (has['Z' - 'A'] && pp_axes < 3) {
+        pp_err(error, error_size, line_no, "Z word but the group has no Z axis");
+        return -1;
+    }
+
+    /* Модальные коды */
+    int motion = pp_motion;
+    bool absolute = pp_absolute;
+    for (int k = 0; k < ngcodes; k++) {
+        switch (gcodes[k]) {
+            case 0: case 1: case 2: case 3: motion = gcodes[k]; break;
+            case 90: absolute = true; break;
+            case 91: absolute = false; break;
+            case 17: case 21: break;
+            case 18: case 19:
+                pp_err(error, error_size, line_no, "only the XY plane (G17) is supported");
+                return -1;
+            case 20:
+                pp_err(error, error_size, line_no, "inches (G20) not supported, use axis units");
+                return -1;
+            default:
+                pp_err(error, error_size, line_no, "unsupported G code");
+                return -1;
+        }
+    }
+    double feed = has['F' - 'A'] ? word['F' - 'A'] / 60.0 : pp_feed;
+    if (has['F' - 'A'] && feed <= 0.0) {
+        pp_err(error, error_size, line_no, "feed must be positive");
+        return -1;
+    }
+
+    /* Состояние разбора меняется только после всех проверок */
+    pp_motion = motion;
+    pp_absolute = absolute;
+    pp_feed = feed;
+
+    bool move = has['X' - 'A'] || has['Y' - 'A'] || has['Z' - 'A'];
+    if (!move) {
+        return 1;
+    }
+    if (motion != 0 && feed <= 0.0) {
+        pp_err(error, error_size, line_no, "no feed (F) for G1/G2/G3");
+        return -1;
+    }
+
+    /* Траектория закончена или остановлена: продолжаем от последней точки */
+    if (st != PATH_RUNNING) {
+        memcpy(pp_prog, pp_pos, sizeof(pp_prog));
+        pp_have_prev = false;
+        pp_set_flag(&pp_hold, false);
+        pp_set_flag(&pp_hold_done, false);
+        pp_queue_min = pp_fill_target;
+    }
+
+    pp_seg_t g;
+    memset(&g, 0, sizeof(g));
+    g.line = line_no;
+    g.feed = motion == 0 ? pp_rapid : feed;
+    for (int i = 0; i < pp_axes; i++) {
+        double w = has["XYZ"[i] - 'A'] ? word["XYZ"[i] - 'A'] : (absolute ? pp_prog[i] : 0.0);
+        g.start[i] = pp_prog[i];
+        g.end[i] = absolute ? w : pp_prog[i] + w;
+    }
+
+    if (motion == 2 || motion == 3) {
+        double cx = g.start[0] + (has['I' - 'A'] ? word['I' - 'A'] : 0.0);
+        double cy = g.start[1] + (has['J' - 'A'] ? word['J' - 'A'] : 0.0);
+        double r0 = hypot(g.start[0] - cx, g.start[1] - cy);
+        double r1 = hypot(g.end[0] - cx, g.end[1] - cy);
+        if (!has['I' - 'A'] && !has['J' - 'A']) {
+            pp_err(error, error_size, line_no, "arc needs I/J center offset");
+            return -1;
+        }
+        if (fabs(r0 - r1) > PATH_PLAN_ARC_TOLERANCE || r0 <= 0.0) {
+            pp_err(error, error_size, line_no, "arc end point is not on the circle");
+            return -1;
+        }
+        g.type = PP_ARC;
+        g.center[0] = cx;
+        g.center[1] = cy;
+        g.radius = r0;
+        g.angle0 = atan2(g.start[1] - cy, g.start[0] - cx);
+        double sweep = atan2(g.end[1] - cy, g.end[0] - cx) - g.angle0;
+        if (motion == 2 && sweep >= 0.0) {
+            sweep -= 2.0 * M_PI;                 /* По часовой; совпавшие точки - полный круг */
+        } else if (motion == 3 && sweep <= 0.0) {
+            sweep += 2.0 * M_PI;
+        }
+        g.sweep = sweep;
+        double dz = pp_axes > 2 ? g.end[2] - g.start[2] : 0.0;
+        g.length = hypot(r0 * fabs(sweep), dz);
+        /* Центростремительное ускорение на дуге не больше ускорения группы */
+        g.feed = fmin(g.feed, sqrt(pp_accel * r0));
+        pp_arc_dir(&g, g.angle0, g.dir_in);
+        pp_arc_dir(&g, g.angle0 + sweep, g.dir_out);
+    } else {
+        double len = 0.0;
+        for (int i = 0; i < pp_axes; i++) {
+            g.dir_in[i] = g.end[i] - g.start[i];
+            len += g.dir_in[i] * g.dir_in[i];
+        }
+        g.length = sqrt(len);
+        pp_normalize(g.dir_in, pp_axes);
+        memcpy(g.dir_out, g.dir_in, sizeof(g.dir_out));
+    }
+    if (g.length < 1e-9) {
+        return 1;
+    }
+
+    g.max_entry = pp_have_prev
+        ? pp_junction_speed(pp_prev_dir, g.dir_in, fmin(pp_prev_feed, g.feed))
+        : 0.0;
+
+    uint32_t head = pp_ring_head;
+    pp_ring[head % PATH_PLAN_SEGMENTS] = g;
+    pp_store(&pp_ring_head, head + 1);
+    pp_add64(&pp_queued, 1);
+
+    memcpy(pp_prog, g.end, sizeof(pp_prog));
+    memcpy(pp_prev_dir, g.dir_out, sizeof(pp_prev_dir));
+    pp_prev_feed = g.feed;
+    pp_have_prev = true;
+
+    /* Цикл мог объявить DONE между проверкой и записью сегмента */
+    if (!pp_cas_state(PATH_DONE, PATH_RUNNING) && !pp_cas_state(PATH_STOPPED, PATH_RUNNING)) {
+        pp_cas_state(PATH_IDLE, PATH_RUNNING);
+    }
+    return 1;
+}
+
+/* ============================================================================
+ * Цикл (циклический поток)
+ * ============================================================================ */
+
+void path_plan_cycle(void) {
+    if (!pp_active) {
+        return;
+    }
+    int st = pp_get_state();
+    if (st != PATH_RUNNING) {
+        return;
+    }
+    if (!pp_threaded) {
+        pp_pump();
+    }
+
+    /* Ось вышла из Operation Enabled: 0x607A остается на последней уставке */
+    for (int i = 0; i < pp_axes; i++) {
+        uint16_t sw;
+        memcpy(&sw, pp_pdo[i].inputs + pp_pdo[i].statusword, sizeof(sw));
+        if ((sw & 0x6F) != 0x27) {
+            pp_store(&pp_sp_tail, pp_load(&pp_sp_head));
+            pp_set_state(PATH_ABORTED);
+            if (!pp_threaded) {
+                pp_pump();
+            }
+            return;
+        }
+    }
+
+    uint32_t tail = pp_sp_tail;
+    uint32_t head = pp_load(&pp_sp_head);
+    if (head != tail) {
+        const pp_setpoint_t *sp = &pp_sp[tail & (PATH_PLAN_SETPOINTS - 1)];
+        for (int i = 0; i < pp_axes; i++) {
+            memcpy(pp_pdo[i].outputs + pp_pdo[i].target_position, &sp->pos[i], sizeof(int32_t));
+        }
+        pp_store(&pp_sp_tail, tail + 1);
+        pp_add64(&pp_setpoints, 1);
+        /* Запас очереди важен, пока траектория не дописана до конца */
+        if (pp_load64(&pp_done) != pp_load64(&pp_queued) && head - tail - 1 < pp_queue_min) {
+            pp_queue_min = head - tail - 1;
+        }
+        return;
+    }
+
+    if (pp_get_flag(&pp_hold_done)) {
+        pp_set_state(PATH_STOPPED);
+    } else if (pp_load64(&pp_done) == pp_load64(&pp_queued)) {
+        pp_cas_state(PATH_RUNNING, PATH_DONE);
+    } else {
+        pp_add64(&pp_underruns, 1);
+    }
+}
+
+/* ============================================================================
+ * Наблюдение
+ * ============================================================================ */
+
+path_state_t path_plan_state(void) {
+    return (path_state_t)pp_get_state();
+}
+
+void path_plan_info(path_info_t *info) {
+    memset(info, 0, sizeof(*info));
+    info->state = path_plan_state();
+    info->axes = pp_active ? pp_axes : 0;
+    for (int i = 0; i < info->axes; i++) {
+        info->slaves[i] = pp_slave[i];
+        info->position[i] = pp_pos[i];
+    }
+    info->threaded = pp_threaded;
+    info->cpu = pp_cpu;
+    info->accel = pp_accel;
+    info->junction = pp_junction;
+    info->rapid = pp_rapid * 60.0;
+    info->velocity = pp_v;
+    info->line = pp_cur_line;
+    info->segments_queued = pp_load64(&pp_queued);
+    info->segments_done = pp_load64(&pp_done);
+    info->setpoints = pp_load64(&pp_setpoints);
+    info->underruns = pp_load64(&pp_underruns);
+    info->queue_fill = pp_load(&pp_sp_head) - pp_load(&pp_sp_tail);
+    info->queue_min = pp_queue_min;
+}
+
+static const char *pp_state_name(path_state_t st) {
+    switch (st) {
+        case PATH_RUNNING: return "Running";
+        case PATH_DONE: return "Done";
+        case PATH_STOPPED: return "Stopped";
+        case PATH_ABORTED: return "Aborted (axis left Operation Enabled)";
+        default: return "Idle";
+    }
+}
+
+void path_plan_print(void) {
+    path_info_t in;
+
+    path_plan_info(&in);
+    printf("\n=== Path Interpolation ===\n");
+    if (in.axes == 0) {
+        printf("Group:             none ('path group <x> <y> [z]')\n\n");
+        return;
+    }
+    printf("Group:            ");
+    for (int i = 0; i < in.axes; i++) {
+        printf(" %c=slave %u (%s)", "XYZ"[i], in.slaves[i], axis_units_pos_name(in.slaves[i]));
+    }
+    printf("\n");
+    printf("State:             %s\n", pp_state_name(in.state));
+    if (in.threaded) {
+        printf("Planner:           own thread, %s\n", in.cpu >= 0 ? "pinned" : "no CPU pinning");
+        if (in.cpu >= 0) {
+            printf("Planner CPU:       %d\n", in.cpu);
+        }
+    } else {
+        printf("Planner:           in the cyclic step (virtual time)\n");
+    }
+    printf("Limits:            accel %.1f /s^2, junction deviation %.4f, rapid %.0f /min\n",
+           in.accel, in.junction, in.rapid);
+    printf("Position:         ");
+    for (int i = 0; i < in.axes; i++) {
+        printf(" %c %.4f", "XYZ"[i], in.position[i]);
+    }
+    printf("\n");
+    printf("Path velocity:     %.2f /min (line %d)\n", in.velocity * 60.0, in.line);
+    printf("Segments:          %llu done of %llu\n",
+           (unsigned long long)in.segments_done, (unsigned long long)in.segments_queued);
+    printf("Setpoints:         %llu sent, queue %u (min %u of %u), underruns %llu\n",
+           (unsigned long long)in.setpoints, in.queue_fill, in.queue_min, pp_fill_target,
+           (unsigned long long)in.underruns);
+    printf("\n");
+}
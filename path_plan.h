@@ -0,0 +1,125 @@
+/*
+ * path_plan.h - Интерполяция траектории группы осей с просмотром вперед
+ *
+ * Группа из 2-3 осей (X, Y, Z) в Cyclic Synchronous Position. Программа -
+ * подмножество G-code: G0/G1 - прямые, G2/G3 - дуги по часовой/против в
+ * плоскости XY (центр I/J от начала, Z - винтовая), G90/G91, F в единицах
+ * оси в минуту. Координаты - единицы осей (axis_units), абсолютные.
+ *
+ * Три участника, каждый пишет только свою сторону очереди:
+ *   поток CLI - разбор G-code, сегменты в кольцо сегментов;
+ *   поток планировщика - окно просмотра вперед из PATH_PLAN_LOOKAHEAD
+ *     сегментов: обратный и прямой проход по скоростям стыков (ускорение
+ *     группы, отклонение на углу - junction deviation), затем разбиение
+ *     первого сегмента по циклам в уставки;
+ *   циклический поток - одна уставка за цикл в 0x607A всех осей группы.
+ * Очереди - кольца single-producer/single-consumer на __atomic
+ * acquire/release, без блокировок. Планировщик держит в очереди уставок
+ * не больше PATH_PLAN_QUEUE_MS, чтобы останов не ждал длинного хвоста.
+ *
+ * В виртуальном времени и на Windows отдельного потока нет: циклический
+ * шаг сам доливает очередь уставок перед выборкой.
+ *
+ * Если любая ось группы выходит из Operation Enabled, выдача
+ * прекращается в том же цикле (0x607A остается на последней уставке).
+ */
+
+#ifndef PATH_PLAN_H
+#define PATH_PLAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PATH_PLAN_MAX_AXES      3
+#define PATH_PLAN_SEGMENTS      256      /* Кольцо сегментов CLI -> планировщик */
+#define PATH_PLAN_LOOKAHEAD     32       /* Окно планирования */
+#define PATH_PLAN_SETPOINTS     1024     /* Кольцо уставок, степень двойки */
+#define PATH_PLAN_QUEUE_MS      20       /* Уставок вперед, мс */
+#define PATH_PLAN_DEFAULT_ACCEL 500.0    /* Единиц/с^2 */
+#define PATH_PLAN_DEFAULT_JUNCTION 0.01  /* Допустимое отклонение на углу, единиц */
+#define PATH_PLAN_DEFAULT_RAPID 6000.0   /* G0, единиц/мин */
+#define PATH_PLAN_ARC_TOLERANCE 0.005    /* Расхождение радиусов начала и конца дуги */
+
+typedef enum {
+    PATH_IDLE = 0,
+    PATH_RUNNING,
+    PATH_DONE,
+    PATH_STOPPED,                /* path stop: остановлена с торможением */
+    PATH_ABORTED                 /* Ось вышла из Operation Enabled */
+} path_state_t;
+
+/* Где в PDO лежат объекты оси (смещения в байтах) */
+typedef struct {
+    const uint8_t *inputs;
+    uint8_t *outputs;
+    uint16_t statusword;         /* 0x6041 */
+    uint16_t target_position;    /* 0x607A */
+} path_axis_pdo_t;
+
+typedef struct {
+    path_state_t state;
+    int axes;
+    uint16_t slaves[PATH_PLAN_MAX_AXES];
+    bool threaded;
+    int cpu;
+    double accel;
+    double junction;
+    double rapid;
+    double position[PATH_PLAN_MAX_AXES];  /* Точка планировщика, единицы */
+    double velocity;             /* Скорость по траектории, единиц/с */
+    int line;                    /* Строка G-code текущего сегмента */
+    uint64_t segments_queued;
+    uint64_t segments_done;
+    uint64_t setpoints;
+    uint64_t underruns;          /* Цикл без уставки при незаконченной траектории */
+    uint32_t queue_fill;
+    uint32_t queue_min;          /* Минимум заполнения во время движения */
+} path_info_t;
+
+/**
+ * Группа осей; start_inc - текущее развернутое положение осей в инкрементах
+ * (axis_units_position), первая уставка совпадает с ним точно
+ *
+ * Прежняя группа должна быть распущена, а циклический поток - завершить
+ * после этого цикл: состояние переписывается здесь же.
+ *
+ * @param threaded Планировщик в отдельном потоке (Linux, реальное время)
+ * @param cpu      Ядро планировщика, -1 - без привязки
+ * @return false также если группа еще не распущена
+ */
+bool path_plan_group(int axes, const uint16_t *slaves, const path_axis_pdo_t *pdo,
+                     const int64_t *start_inc, uint32_t period_us, bool threaded, int cpu);
+
+/**
+ * Распустить группу (останавливает поток планировщика); циклический поток
+ * может дочитывать уставки до конца текущего цикла
+ */
+void path_plan_release(void);
+
+bool path_plan_active(void);
+
+void path_plan_set_limits(double accel, double junction, double rapid);
+
+/**
+ * Одна строка G-code
+ *
+ * @param error Текст ошибки (буфер вызывающего)
+ * @return 1 - принята, 0 - кольцо сегментов полно (повторить позже), -1 - ошибка
+ */
+int path_plan_gcode(const char *line, int line_no, char *error, int error_size);
+
+/**
+ * Остановить траекторию с торможением по ускорению группы
+ */
+void path_plan_stop(void);
+
+/**
+ * Один цикл: уставка в выходы группы (циклический поток)
+ */
+void path_plan_cycle(void);
+
+path_state_t path_plan_state(void);
+void path_plan_info(path_info_t *info);
+void path_plan_print(void);
+
+#endif /* PATH_PLAN_H */
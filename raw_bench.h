@@ -0,0 +1,30 @@
+/*
+ * raw_bench.h - Бенчмарк отправки/приема raw Ethernet кадров
+ *
+ * Сравнивает pcap, обычный AF_PACKET сокет и PACKET_MMAP кольца (TPACKET_V2)
+ * на кадрах EtherCAT размеров (60..1514 байт): скорость отправки пачкой,
+ * потери на приеме и время круга ping-pong.
+ *
+ * Кадры уходят в tx_if и ожидаются на rx_if: это может быть veth пара
+ * (ip link add ecb0 type veth peer name ecb1), либо один и тот же интерфейс,
+ * если кадры возвращаются EtherCAT сегментом или loopback заглушкой.
+ * Кадры - корректные EtherCAT NOP датаграммы, slaves их не изменяют.
+ */
+
+#ifndef RAW_BENCH_H
+#define RAW_BENCH_H
+
+#include <stdint.h>
+
+#define RAW_BENCH_DEFAULT_FRAMES 10000
+
+/**
+ * Запуск бенчмарка для всех методов и размеров кадров
+ *
+ * @param tx_if  Интерфейс отправки
+ * @param rx_if  Интерфейс приема (NULL - тот же, что tx_if)
+ * @param frames Количество кадров в тесте скорости на каждый размер
+ */
+void raw_bench_run(const char *tx_if, const char *rx_if, int frames);
+
+#endif /* RAW_BENCH_H */
@@ -0,0 +1,479 @@
+/*
+ * rt_check.c - Проверка готовности Linux хоста к real-time циклу EtherCAT
+ */
+
+#define _GNU_SOURCE  /* CPU_SET, pthread_attr_setaffinity_np */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rt_check.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/utsname.h>
+#endif
+
+/* ============================================================================
+ * Гистограмма задержек
+ * ============================================================================ */
+
+void rt_hist_reset(rt_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+    h->min_ns = INT64_MAX;
+}
+
+void rt_hist_add(rt_hist_t *h, int64_t latency_ns) {
+    if (latency_ns < 0) {
+        latency_ns = 0;
+    }
+    int64_t us = latency_ns / 1000;
+    if (us >= RT_HIST_BUCKETS) {
+        h->overflow++;
+    } else {
+        h->buckets[us]++;
+    }
+    if (latency_ns < h->min_ns) h->min_ns = latency_ns;
+    if (latency_ns > h->max_ns) h->max_ns = latency_ns;
+    h->sum_ns += (double)latency_ns;
+    h->count++;
+}
+
+uint32_t rt_hist_percentile_us(const rt_hist_t *h, double pct) {
+    if (h->count == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)((double)h->count * pct / 100.0);
+    uint64_t acc = 0;
+    for (uint32_t i = 0; i < RT_HIST_BUCKETS; i++) {
+        acc += h->buckets[i];
+        if (acc > target) {
+            return i;
+        }
+    }
+    return RT_HIST_BUCKETS;
+}
+
+void rt_hist_print(const rt_hist_t *h) {
+    static const uint32_t edges[] = { 0, 2, 5, 10, 20, 50, 100, 200, 500, RT_HIST_BUCKETS };
+    const size_t nedges = sizeof(edges) / sizeof(edges[0]);
+
+    if (h->count == 0) {
+        printf("  No samples\n");
+        return;
+    }
+
+    printf("  Samples: %llu  min %.1f  avg %.1f  p99 %u  p99.9 %u  max %.1f us\n",
+           (unsigned long long)h->count, h->min_ns / 1000.0, h->sum_ns / h->count / 1000.0,
+           rt_hist_percentile_us(h, 99.0), rt_hist_percentile_us(h, 99.9), h->max_ns / 1000.0);
+    printf("  Histogram:\n");
+
+    /* Корзины по 1 мкс сводятся в логарифмические диапазоны */
+    for (size_t r = 0; r + 1 < nedges; r++) {
+        uint64_t n = 0;
+        for (uint32_t i = edges[r]; i < edges[r + 1]; i++) {
+            n += h->buckets[i];
+        }
+        printf("    %4u..%-4u us: %-10llu %5.2f%%\n", edges[r], edges[r + 1] - 1,
+               (unsigned long long)n, 100.0 * (double)n / (double)h->count);
+    }
+    printf("    >= %-7u us: %-10llu %5.2f%%\n", RT_HIST_BUCKETS,
+           (unsigned long long)h->overflow, 100.0 * (double)h->overflow / (double)h->count);
+}
+
+rt_result_t rt_rate_latency(int64_t max_ns, uint32_t cycle_us) {
+    int64_t cycle_ns = (int64_t)cycle_us * 1000;
+    if (max_ns * 10 < cycle_ns) {
+        return RT_PASS;
+    }
+    if (max_ns * 4 < cycle_ns) {
+        return RT_WARN;
+    }
+    return RT_FAIL;
+}
+
+const char *rt_result_str(rt_result_t r) {
+    switch (r) {
+        case RT_PASS: return "PASS";
+        case RT_WARN: return "WARN";
+        default:      return "FAIL";
+    }
+}
+
+#ifndef _WIN32
+
+/* ============================================================================
+ * Проверки конфигурации хоста
+ * ============================================================================ */
+
+static bool rt_read_line(const char *path, char *buf, size_t len) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    bool ok = fgets(buf, (int)len, f) != NULL;
+    fclose(f);
+    if (ok) {
+        buf[strcspn(buf, "\r\n")] = '\0';
+    }
+    return ok;
+}
+
+/**
+ * Печать пункта отчета и учет худшей оценки
+ */
+static void rt_item(rt_result_t *worst, rt_result_t r, const char *label,
+                    const char *value, const char *hint) {
+    printf("  [%s] %-22s %s\n", rt_result_str(r), label, value);
+    if (hint && r != RT_PASS) {
+        printf("         -> %s\n", hint);
+    }
+    if (r > *worst) {
+        *worst = r;
+    }
+}
+
+/**
+ * Проверка, входит ли cpu в список вида "managed_irq,domain,2-3,5"
+ * (нечисловые флаги isolcpus пропускаются)
+ */
+static bool rt_cpulist_contains(const char *list, int cpu) {
+    const char *p = list;
+
+    while (*p) {
+        if (*p < '0' || *p > '9') {
+            const char *comma = strchr(p, ',');
+            if (!comma) {
+                break;
+            }
+            p = comma + 1;
+            continue;
+        }
+        char *end;
+        long a = strtol(p, &end, 10);
+        long b = a;
+        if (*end == '-') {
+            b = strtol(end + 1, &end, 10);
+        }
+        if (cpu >= a && cpu <= b) {
+            return true;
+        }
+        if (*end != ',') {
+            break;
+        }
+        p = end + 1;
+    }
+
+    return false;
+}
+
+/**
+ * Значение параметра загрузки ядра ("isolcpus=" -> "2-3") или NULL
+ */
+static const char *rt_cmdline_param(const char *cmdline, const char *name, char *buf, size_t len) {
+    size_t name_len = strlen(name);
+    const char *p = cmdline;
+
+    while ((p = strstr(p, name)) != NULL) {
+        if ((p == cmdline || p[-1] == ' ') && p[name_len] == '=') {
+            const char *v = p + name_len + 1;
+            size_t n = strcspn(v, " ");
+            if (n >= len) n = len - 1;
+            memcpy(buf, v, n);
+            buf[n] = '\0';
+            return buf;
+        }
+        p += name_len;
+    }
+    return NULL;
+}
+
+static void rt_check_kernel(rt_result_t *worst, uint32_t cycle_us) {
+    struct utsname u;
+    char buf[64];
+    bool rt = rt_read_line("/sys/kernel/realtime", buf, sizeof(buf)) && atoi(buf) == 1;
+    char value[256];
+
+    if (uname(&u) != 0) {
+        memset(&u, 0, sizeof(u));
+    }
+    if (!rt && strstr(u.version, "PREEMPT_RT")) {
+        rt = true;
+    }
+
+    snprintf(value, sizeof(value), "%s %s", u.release, u.version);
+    if (rt) {
+        rt_item(worst, RT_PASS, "Kernel PREEMPT_RT:", value, NULL);
+    } else if (strstr(u.version, "PREEMPT")) {
+        rt_item(worst, cycle_us >= 1000 ? RT_WARN : RT_FAIL, "Kernel PREEMPT_RT:", value,
+                "full preemption without PREEMPT_RT; install a realtime kernel for sub-ms cycles");
+    } else {
+        rt_item(worst, RT_FAIL, "Kernel PREEMPT_RT:", value, "install a PREEMPT_RT kernel");
+    }
+}
+
+static void rt_check_cmdline(rt_result_t *worst, int cpu) {
+    char cmdline[4096], param[256], value[300], hint[128];
+    static const char *params[] = { "isolcpus", "nohz_full", "rcu_nocbs" };
+
+    if (!rt_read_line("/proc/cmdline", cmdline, sizeof(cmdline))) {
+        cmdline[0] = '\0';
+    }
+
+    for (size_t i = 0; i < sizeof(params) / sizeof(params[0]); i++) {
+        char label[32];
+        rt_result_t r = RT_WARN;
+
+        snprintf(label, sizeof(label), "%s:", params[i]);
+        if (rt_cmdline_param(cmdline, params[i], param, sizeof(param))) {
+            bool hit = rt_cpulist_contains(param, cpu);
+            snprintf(value, sizeof(value), "%s (CPU %d %s)", param, cpu, hit ? "included" : "NOT included");
+            r = hit ? RT_PASS : RT_WARN;
+        } else {
+            snprintf(value, sizeof(value), "not set");
+        }
+        snprintf(hint, sizeof(hint), "add %s=%d to the kernel command line", params[i], cpu);
+        rt_item(worst, r, label, value, hint);
+    }
+}
+
+static void rt_check_cpufreq(rt_result_t *worst, int cpu, uint32_t cycle_us) {
+    char path[128], buf[64], value[256], hint[160];
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu);
+    if (rt_read_line(path, buf, sizeof(buf))) {
+        snprintf(hint, sizeof(hint), "echo performance > %s", path);
+        rt_item(worst, strcmp(buf, "performance") == 0 ? RT_PASS : RT_WARN,
+                "CPU governor:", buf, hint);
+    } else {
+        rt_item(worst, RT_PASS, "CPU governor:", "no cpufreq (fixed frequency)", NULL);
+    }
+
+    /* C-states: выход из глубокого сна должен быть много меньше цикла */
+    int deep = 0;
+    uint32_t worst_exit = 0;
+    char worst_name[32] = "";
+    for (int st = 0; st < 16; st++) {
+        char name[32], lat[32], dis[32];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpuidle/state%d/name", cpu, st);
+        if (!rt_read_line(path, name, sizeof(name))) {
+            break;
+        }
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpuidle/state%d/latency", cpu, st);
+        if (!rt_read_line(path, lat, sizeof(lat))) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpuidle/state%d/disable", cpu, st);
+        if (rt_read_line(path, dis, sizeof(dis)) && atoi(dis) != 0) {
+            continue;
+        }
+        uint32_t exit_us = (uint32_t)strtoul(lat, NULL, 10);
+        if (exit_us > worst_exit) {
+            worst_exit = exit_us;
+            snprintf(worst_name, sizeof(worst_name), "%s", name);
+        }
+        if (exit_us * 10 >= cycle_us) {
+            deep++;
+        }
+    }
+    if (worst_name[0] == '\0') {
+        rt_item(worst, RT_PASS, "C-states:", "no cpuidle states enabled", NULL);
+    } else {
+        rt_result_t r = deep == 0 ? RT_PASS : (worst_exit * 2 < cycle_us ? RT_WARN : RT_FAIL);
+        snprintf(value, sizeof(value), "deepest enabled %s, exit latency %u us (%d state(s) >= 10%% of cycle)",
+                 worst_name, worst_exit, deep);
+        rt_item(worst, r, "C-states:", value,
+                "disable deep states (cpuidle/stateN/disable, processor.max_cstate=1) or hold /dev/cpu_dma_latency");
+    }
+}
+
+static void rt_check_sched(rt_result_t *worst, uint32_t cycle_us) {
+    char buf[64], value[128];
+
+    if (rt_read_line("/proc/sys/kernel/sched_rt_runtime_us", buf, sizeof(buf))) {
+        long runtime = atol(buf);
+        snprintf(value, sizeof(value), "sched_rt_runtime_us = %ld", runtime);
+        rt_item(worst, runtime < 0 ? RT_PASS : RT_WARN, "RT throttling:", value,
+                "echo -1 > /proc/sys/kernel/sched_rt_runtime_us (a busy RT thread is stalled otherwise)");
+    }
+
+    int slack = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+    if (slack >= 0) {
+        snprintf(value, sizeof(value), "%d ns (ignored for SCHED_FIFO threads)", slack);
+        rt_item(worst, (uint64_t)slack * 10 < (uint64_t)cycle_us * 1000 ? RT_PASS : RT_WARN,
+                "Timer slack:", value, "run the cyclic thread with SCHED_FIFO or prctl(PR_SET_TIMERSLACK, 1)");
+    }
+}
+
+static void rt_check_memory(rt_result_t *worst) {
+    char buf[128], line[256];
+
+    if (rt_read_line("/sys/kernel/mm/transparent_hugepage/enabled", buf, sizeof(buf))) {
+        rt_item(worst, strstr(buf, "[always]") ? RT_WARN : RT_PASS, "Transparent hugepages:", buf,
+                "echo madvise > /sys/kernel/mm/transparent_hugepage/enabled (khugepaged compaction stalls)");
+    }
+
+    int swaps = 0;
+    FILE *f = fopen("/proc/swaps", "r");
+    if (f) {
+        while (fgets(line, sizeof(line), f)) {
+            if (strncmp(line, "Filename", 8) != 0) {
+                swaps++;
+            }
+        }
+        fclose(f);
+    }
+    snprintf(buf, sizeof(buf), "%d active swap device(s)", swaps);
+    rt_item(worst, swaps == 0 ? RT_PASS : RT_WARN, "Swap:", buf,
+            "swapoff -a, or rely on mlockall() for the master process");
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+        munlockall();
+        rt_item(worst, RT_PASS, "Memory locking:", "mlockall() allowed", NULL);
+    } else {
+        snprintf(buf, sizeof(buf), "mlockall() failed: %s", strerror(errno));
+        rt_item(worst, RT_FAIL, "Memory locking:", buf, "run as root or raise RLIMIT_MEMLOCK");
+    }
+}
+
+/* ============================================================================
+ * Тест задержки пробуждения таймера
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t cycle_us;
+    int cpu;
+    int duration_s;
+    rt_hist_t *hist;
+    int error;
+} rt_latency_arg_t;
+
+static int64_t rt_ts_ns(const struct timespec *ts) {
+    return (int64_t)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static void rt_ts_add_ns(struct timespec *ts, int64_t ns) {
+    ts->tv_nsec += ns;
+    while (ts->tv_nsec >= 1000000000L) {
+        ts->tv_nsec -= 1000000000L;
+        ts->tv_sec++;
+    }
+}
+
+static void *rt_latency_thread(void *p) {
+    rt_latency_arg_t *arg = p;
+    struct timespec next, now;
+    uint64_t cycles = (uint64_t)arg->duration_s * 1000000ULL / arg->cycle_us;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (uint64_t i = 0; i < cycles; i++) {
+        rt_ts_add_ns(&next, (int64_t)arg->cycle_us * 1000);
+        int ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        if (ret != 0 && ret != EINTR) {
+            arg->error = ret;
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        rt_hist_add(arg->hist, rt_ts_ns(&now) - rt_ts_ns(&next));
+    }
+    return NULL;
+}
+
+static void rt_check_latency(rt_result_t *worst, uint32_t cycle_us, int cpu, int duration_s) {
+    static rt_hist_t hist;
+    rt_latency_arg_t arg = { cycle_us, cpu, duration_s, &hist, 0 };
+    pthread_attr_t attr;
+    pthread_t thread;
+    struct sched_param param;
+    cpu_set_t set;
+    char value[128];
+
+    rt_hist_reset(&hist);
+    printf("\n  Timer latency test: %u us period on CPU %d, SCHED_FIFO %d, %d s...\n",
+           cycle_us, cpu, RT_CHECK_PRIORITY, duration_s);
+    fflush(stdout);
+
+    mlockall(MCL_CURRENT | MCL_FUTURE);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    param.sched_priority = RT_CHECK_PRIORITY;
+    pthread_attr_setschedparam(&attr, &param);
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+
+    bool rt_sched = true;
+    if (pthread_create(&thread, &attr, rt_latency_thread, &arg) != 0) {
+        /* Нет прав на SCHED_FIFO: измеряем с обычным приоритетом */
+        rt_sched = false;
+        pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+        if (pthread_create(&thread, &attr, rt_latency_thread, &arg) != 0) {
+            pthread_attr_destroy(&attr);
+            rt_item(worst, RT_FAIL, "Timer latency:", "failed to start test thread", NULL);
+            return;
+        }
+    }
+    pthread_join(thread, NULL);
+    pthread_attr_destroy(&attr);
+    munlockall();
+
+    rt_hist_print(&hist);
+
+    rt_result_t r = rt_rate_latency(hist.max_ns, cycle_us);
+    snprintf(value, sizeof(value), "max %.1f us vs %u us cycle%s", hist.max_ns / 1000.0, cycle_us,
+             rt_sched ? "" : " (no SCHED_FIFO permission)");
+    rt_item(worst, rt_sched ? r : RT_FAIL, "Timer latency:", value,
+            "max wake-up latency should stay below 10% of the cycle time");
+}
+
+rt_result_t rt_check_run(uint32_t cycle_us, int cpu, int duration_s) {
+    rt_result_t worst = RT_PASS;
+
+    if (cpu < 0) {
+        cpu = (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    }
+    if (cycle_us == 0) {
+        cycle_us = RT_CHECK_DEFAULT_CYCLE_US;
+    }
+    if (duration_s <= 0) {
+        duration_s = RT_CHECK_DEFAULT_DURATION_S;
+    }
+
+    printf("\n=== Real-Time Readiness Check (cycle %u us, CPU %d) ===\n\n", cycle_us, cpu);
+
+    if (cpu >= (int)sysconf(_SC_NPROCESSORS_ONLN)) {
+        printf("ERROR: CPU %d is not online (%ld CPU(s) available)\n", cpu, sysconf(_SC_NPROCESSORS_ONLN));
+        return RT_FAIL;
+    }
+
+    rt_check_kernel(&worst, cycle_us);
+    rt_check_cmdline(&worst, cpu);
+    rt_check_cpufreq(&worst, cpu, cycle_us);
+    rt_check_sched(&worst, cycle_us);
+    rt_check_memory(&worst);
+    rt_check_latency(&worst, cycle_us, cpu, duration_s);
+
+    printf("\n  Overall: %s for a %u us cycle\n", rt_result_str(worst), cycle_us);
+    return worst;
+}
+
+#else /* _WIN32 */
+
+rt_result_t rt_check_run(uint32_t cycle_us, int cpu, int duration_s) {
+    (void)cycle_us;
+    (void)cpu;
+    (void)duration_s;
+    printf("\nReal-time readiness check is only available on Linux.\n");
+    return RT_WARN;
+}
+
+#endif /* _WIN32 */
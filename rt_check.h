@@ -0,0 +1,70 @@
+/*
+ * rt_check.h - Проверка готовности Linux хоста к real-time циклу EtherCAT
+ *
+ * Анализирует ядро (PREEMPT_RT), параметры загрузки (isolcpus, nohz_full,
+ * rcu_nocbs), governor и C-states ядра, RT throttling, timer slack, THP,
+ * swap, блокировку памяти и выполняет короткий cyclictest-подобный тест
+ * задержки пробуждения таймера на выбранном ядре. Каждый пункт получает
+ * оценку PASS/WARN/FAIL относительно требуемого времени цикла.
+ */
+
+#ifndef RT_CHECK_H
+#define RT_CHECK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RT_HIST_BUCKETS        1000    /* Корзины по 1 мкс */
+#define RT_CHECK_DEFAULT_CYCLE_US 1000
+#define RT_CHECK_DEFAULT_DURATION_S 5
+#define RT_CHECK_PRIORITY      80
+
+/* Оценка пункта проверки */
+typedef enum {
+    RT_PASS = 0,
+    RT_WARN,
+    RT_FAIL
+} rt_result_t;
+
+/* Гистограмма задержек пробуждения */
+typedef struct {
+    uint64_t count;
+    uint64_t overflow;                 /* >= RT_HIST_BUCKETS мкс */
+    int64_t min_ns;
+    int64_t max_ns;
+    double sum_ns;
+    uint32_t buckets[RT_HIST_BUCKETS];
+} rt_hist_t;
+
+void rt_hist_reset(rt_hist_t *h);
+void rt_hist_add(rt_hist_t *h, int64_t latency_ns);
+
+/**
+ * Перцентиль в микросекундах (по границам корзин)
+ */
+uint32_t rt_hist_percentile_us(const rt_hist_t *h, double pct);
+
+/**
+ * Вывод сводки и непустых корзин гистограммы
+ */
+void rt_hist_print(const rt_hist_t *h);
+
+/**
+ * Оценка максимальной задержки относительно цикла:
+ * PASS < 10% цикла, WARN < 25%, иначе FAIL
+ */
+rt_result_t rt_rate_latency(int64_t max_ns, uint32_t cycle_us);
+
+const char *rt_result_str(rt_result_t r);
+
+/**
+ * Полная проверка хоста
+ *
+ * @param cycle_us   Требуемое время цикла
+ * @param cpu        Ядро циклического потока (-1 - последнее online ядро)
+ * @param duration_s Длительность теста задержки таймера
+ * @return итоговая (худшая) оценка
+ */
+rt_result_t rt_check_run(uint32_t cycle_us, int cpu, int duration_s);
+
+#endif /* RT_CHECK_H */
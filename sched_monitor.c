@@ -0,0 +1,192 @@
+/*
+ * sched_monitor.c - Мониторинг помех планировщика для циклического потока
+ */
+
+#define _GNU_SOURCE  /* RUSAGE_THREAD */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sched_monitor.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#endif
+
+#ifndef _WIN32
+
+bool sched_monitor_open(sched_monitor_t *m) {
+    char path[64];
+    long tid = syscall(SYS_gettid);
+
+    memset(m, 0, sizeof(*m));
+
+    snprintf(path, sizeof(path), "/proc/self/task/%ld/sched", tid);
+    m->sched_fd = open(path, O_RDONLY);
+    snprintf(path, sizeof(path), "/proc/self/task/%ld/schedstat", tid);
+    m->schedstat_fd = open(path, O_RDONLY);
+
+    return m->sched_fd >= 0 || m->schedstat_fd >= 0;
+}
+
+void sched_monitor_close(sched_monitor_t *m) {
+    if (m->sched_fd >= 0) close(m->sched_fd);
+    if (m->schedstat_fd >= 0) close(m->schedstat_fd);
+    m->sched_fd = -1;
+    m->schedstat_fd = -1;
+    m->has_last = false;
+}
+
+/**
+ * Значение поля "name : value" из /proc/.../sched
+ */
+static uint64_t sched_field(const char *buf, const char *name) {
+    const char *p = strstr(buf, name);
+    if (!p) {
+        return 0;
+    }
+    p = strchr(p, ':');
+    return p ? strtoull(p + 1, NULL, 10) : 0;
+}
+
+static bool sched_read_fd(int fd, char *buf, size_t len) {
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t n = pread(fd, buf, len - 1, 0);
+    if (n <= 0) {
+        return false;
+    }
+    buf[n] = '\0';
+    return true;
+}
+
+bool sched_monitor_sample(sched_monitor_t *m, sched_sample_t *delta) {
+    sched_sample_t now;
+    struct rusage ru;
+    char buf[4096];
+
+    memset(&now, 0, sizeof(now));
+
+    if (getrusage(RUSAGE_THREAD, &ru) == 0) {
+        now.vol_switches = (uint64_t)ru.ru_nvcsw;
+        now.invol_switches = (uint64_t)ru.ru_nivcsw;
+        now.minor_faults = (uint64_t)ru.ru_minflt;
+        now.major_faults = (uint64_t)ru.ru_majflt;
+    }
+    if (sched_read_fd(m->sched_fd, buf, sizeof(buf))) {
+        now.migrations = sched_field(buf, "nr_migrations");
+    }
+    /* schedstat: <время на CPU> <время в очереди> <число квантов> */
+    if (sched_read_fd(m->schedstat_fd, buf, sizeof(buf))) {
+        char *p = strchr(buf, ' ');
+        now.wait_ns = p ? strtoull(p + 1, NULL, 10) : 0;
+    }
+
+    bool ok = m->has_last;
+    if (ok) {
+        delta->vol_switches = now.vol_switches - m->last.vol_switches;
+        delta->invol_switches = now.invol_switches - m->last.invol_switches;
+        delta->minor_faults = now.minor_faults - m->last.minor_faults;
+        delta->major_faults = now.major_faults - m->last.major_faults;
+        delta->migrations = now.migrations - m->last.migrations;
+        delta->wait_ns = now.wait_ns - m->last.wait_ns;
+    }
+    m->last = now;
+    m->has_last = true;
+    return ok;
+}
+
+#else /* _WIN32 */
+
+bool sched_monitor_open(sched_monitor_t *m) {
+    memset(m, 0, sizeof(*m));
+    return false;
+}
+
+void sched_monitor_close(sched_monitor_t *m) {
+    (void)m;
+}
+
+bool sched_monitor_sample(sched_monitor_t *m, sched_sample_t *delta) {
+    (void)m;
+    (void)delta;
+    return false;
+}
+
+#endif /* _WIN32 */
+
+bool sched_sample_interfered(const sched_sample_t *delta, uint64_t wait_threshold_ns) {
+    return delta->invol_switches > 0 || delta->major_faults > 0 ||
+           delta->migrations > 0 || delta->wait_ns > wait_threshold_ns;
+}
+
+static void sched_sample_accumulate(sched_sample_t *acc, const sched_sample_t *d) {
+    acc->vol_switches += d->vol_switches;
+    acc->invol_switches += d->invol_switches;
+    acc->minor_faults += d->minor_faults;
+    acc->major_faults += d->major_faults;
+    acc->migrations += d->migrations;
+    acc->wait_ns += d->wait_ns;
+}
+
+void sched_report_reset(sched_report_t *r, uint32_t every) {
+    memset(r, 0, sizeof(*r));
+    r->every = every;
+}
+
+void sched_report_add(sched_report_t *r, const sched_sample_t *delta, uint32_t overruns,
+                      uint64_t wait_threshold_ns) {
+    r->windows++;
+    sched_sample_accumulate(&r->total, delta);
+
+    if (overruns == 0) {
+        return;
+    }
+    r->overrun_windows++;
+    sched_sample_accumulate(&r->in_overrun, delta);
+    if (sched_sample_interfered(delta, wait_threshold_ns)) {
+        r->host_windows++;
+    }
+    if (overruns > r->worst_overruns) {
+        r->worst_overruns = overruns;
+        r->worst = *delta;
+    }
+}
+
+void sched_report_print(const sched_report_t *r) {
+    if (r->windows == 0) {
+        printf("  No scheduler samples yet (every %u cycles)\n", r->every);
+        return;
+    }
+
+    printf("  Sampled every %u cycles, %llu window(s)\n", r->every, (unsigned long long)r->windows);
+    printf("  %-22s %12s %14s\n", "", "total", "overrun wins");
+    printf("  %-22s %12llu %14llu\n", "Involuntary switches:",
+           (unsigned long long)r->total.invol_switches, (unsigned long long)r->in_overrun.invol_switches);
+    printf("  %-22s %12llu %14llu\n", "Minor page faults:",
+           (unsigned long long)r->total.minor_faults, (unsigned long long)r->in_overrun.minor_faults);
+    printf("  %-22s %12llu %14llu\n", "Major page faults:",
+           (unsigned long long)r->total.major_faults, (unsigned long long)r->in_overrun.major_faults);
+    printf("  %-22s %12llu %14llu\n", "CPU migrations:",
+           (unsigned long long)r->total.migrations, (unsigned long long)r->in_overrun.migrations);
+    printf("  %-22s %9.1f us %11.1f us\n", "Runnable, not running:",
+           r->total.wait_ns / 1000.0, r->in_overrun.wait_ns / 1000.0);
+
+    if (r->overrun_windows == 0) {
+        printf("  No overruns in sampled windows\n");
+        return;
+    }
+
+    printf("  Windows with overruns: %llu, with host interference: %llu\n",
+           (unsigned long long)r->overrun_windows, (unsigned long long)r->host_windows);
+    printf("  Worst window (%u overruns): %llu invol. switches, %llu major faults, "
+           "%llu migrations, %.1f us runnable\n",
+           r->worst_overruns, (unsigned long long)r->worst.invol_switches,
+           (unsigned long long)r->worst.major_faults, (unsigned long long)r->worst.migrations,
+           r->worst.wait_ns / 1000.0);
+}
@@ -0,0 +1,79 @@
+/*
+ * sched_monitor.h - Мониторинг помех планировщика для циклического потока
+ *
+ * Каждые N циклов поток снимает getrusage(RUSAGE_THREAD) и
+ * /proc/self/task/<tid>/{sched,schedstat}: вытеснения, page faults,
+ * миграции между ядрами и время в очереди готовых к выполнению.
+ * Приращения за окно сопоставляются с переполнениями цикла в том же окне,
+ * чтобы отличить помехи хоста от задержек на шине.
+ */
+
+#ifndef SCHED_MONITOR_H
+#define SCHED_MONITOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCHED_MONITOR_DEFAULT_EVERY 1000   /* Циклов в окне выборки */
+
+/* Счетчики (или их приращения за окно) */
+typedef struct {
+    uint64_t vol_switches;     /* Добровольные переключения (сон до следующего цикла) */
+    uint64_t invol_switches;   /* Вытеснения другим потоком */
+    uint64_t minor_faults;
+    uint64_t major_faults;
+    uint64_t migrations;       /* Переносы потока на другое ядро */
+    uint64_t wait_ns;          /* Время готовности без выполнения (runqueue) */
+} sched_sample_t;
+
+/* Источники данных потока; открывается из самого наблюдаемого потока */
+typedef struct {
+    int sched_fd;
+    int schedstat_fd;
+    bool has_last;
+    sched_sample_t last;
+} sched_monitor_t;
+
+/* Накопленная статистика по окнам */
+typedef struct {
+    uint32_t every;            /* Циклов в окне */
+    uint64_t windows;
+    uint64_t overrun_windows;  /* Окна с хотя бы одним переполнением */
+    uint64_t host_windows;     /* ... из них с помехами хоста */
+    sched_sample_t total;
+    sched_sample_t in_overrun; /* Сумма по окнам с переполнениями */
+    sched_sample_t worst;      /* Окно с наибольшим числом переполнений */
+    uint32_t worst_overruns;
+} sched_report_t;
+
+/**
+ * Открытие /proc файлов текущего потока (вызывать из циклического потока)
+ */
+bool sched_monitor_open(sched_monitor_t *m);
+void sched_monitor_close(sched_monitor_t *m);
+
+/**
+ * Снятие счетчиков и вычисление приращений с прошлой выборки.
+ * Без выделения памяти и без stdio - допустимо в циклическом потоке.
+ *
+ * @return false для первой выборки (приращений еще нет) или при ошибке
+ */
+bool sched_monitor_sample(sched_monitor_t *m, sched_sample_t *delta);
+
+/**
+ * Были ли в окне помехи хоста: вытеснения, major faults, миграции
+ * или ожидание в очереди дольше wait_threshold_ns
+ */
+bool sched_sample_interfered(const sched_sample_t *delta, uint64_t wait_threshold_ns);
+
+void sched_report_reset(sched_report_t *r, uint32_t every);
+
+/**
+ * Учет окна с overruns переполнениями цикла
+ */
+void sched_report_add(sched_report_t *r, const sched_sample_t *delta, uint32_t overruns,
+                      uint64_t wait_threshold_ns);
+
+void sched_report_print(const sched_report_t *r);
+
+#endif /* SCHED_MONITOR_H */
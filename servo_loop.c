@@ -0,0 +1,475 @@
+/*
+ * servo_loop.c - Каскадный регулятор положения/скорости на стороне мастера
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "servo_loop.h"
+#include "timebase.h"
+
+#define SV_Q16        65536.0
+#define SV_ONE        ((int64_t)1 << 16)
+#define SV_MAX_ERROR  ((int64_t)1 << 40)     /* Ограничение ошибки до умножения (Q16) */
+
+/* ============================================================================
+ * Состояние осей (SoA: одно поле всех осей подряд)
+ * ============================================================================ */
+
+static volatile bool sv_active[SERVO_MAX_AXES];
+static uint16_t sv_slave[SERVO_MAX_AXES];
+static servo_pdo_t sv_pdo[SERVO_MAX_AXES];
+static servo_gains_t sv_gains[SERVO_MAX_AXES];
+static uint32_t sv_cpr[SERVO_MAX_AXES];
+static bool sv_vel_rpm[SERVO_MAX_AXES];      /* 0x606C в об/мин, иначе инкременты/с */
+
+/* Коэффициенты Q16 (период учтен) */
+static int32_t sv_kp_pos[SERVO_MAX_AXES];
+static int32_t sv_kp_vel[SERVO_MAX_AXES];
+static int32_t sv_ki_vel[SERVO_MAX_AXES];
+static int32_t sv_kd_vel[SERVO_MAX_AXES];
+static int32_t sv_kvff[SERVO_MAX_AXES];
+static int32_t sv_kaff[SERVO_MAX_AXES];
+static int32_t sv_c2r[SERVO_MAX_AXES];       /* об/мин на отсчет/цикл */
+static int64_t sv_vel_lim[SERVO_MAX_AXES];   /* Q16 об/мин */
+static int64_t sv_trq_lim[SERVO_MAX_AXES];   /* Q16 0.1% */
+
+/* Задание */
+static int64_t sv_target[SERVO_MAX_AXES];    /* Q16 отсчеты */
+static int64_t sv_ref[SERVO_MAX_AXES];
+static int64_t sv_step[SERVO_MAX_AXES];      /* Q16 отсчеты за цикл */
+
+/* Память регулятора */
+static int64_t sv_integ[SERVO_MAX_AXES];
+static int64_t sv_verr_prev[SERVO_MAX_AXES];
+static int64_t sv_vff_prev[SERVO_MAX_AXES];
+
+/* Входы и выход цикла */
+static bool sv_ready[SERVO_MAX_AXES];
+static int32_t sv_raw[SERVO_MAX_AXES];       /* Последнее 0x6064 */
+static int64_t sv_pos[SERVO_MAX_AXES];       /* Развернутое положение, отсчеты */
+static int64_t sv_vel[SERVO_MAX_AXES];       /* Q16 об/мин */
+static int16_t sv_torque[SERVO_MAX_AXES];
+
+/* Наблюдение */
+static int32_t sv_perr[SERVO_MAX_AXES];
+static int32_t sv_perr_max[SERVO_MAX_AXES];
+static uint32_t sv_sat[SERVO_MAX_AXES];
+
+static uint32_t sv_period_us = 1000;
+static servo_timing_t sv_timing;
+static uint32_t sv_seq;                      /* seqlock sv_timing: нечетный - идет запись */
+static int64_t sv_last_ns = 0;
+
+static void sv_write_begin(void) {
+#ifdef _WIN32
+    sv_seq++;                                /* Windows: циклы только в вызывающем потоке */
+#else
+    __atomic_store_n(&sv_seq, sv_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+#endif
+}
+
+static void sv_write_end(void) {
+#ifdef _WIN32
+    sv_seq++;
+#else
+    __atomic_store_n(&sv_seq, sv_seq + 1, __ATOMIC_RELEASE);
+#endif
+}
+
+static int32_t sv_q16(double v) {
+    double q = v * SV_Q16;
+    if (q > 2147483647.0) return INT32_MAX;
+    if (q < -2147483648.0) return INT32_MIN;
+    return (int32_t)(q >= 0 ? q + 0.5 : q - 0.5);
+}
+
+static int sv_find(uint16_t slave) {
+    for (int i = 0; i < SERVO_MAX_AXES; i++) {
+        if (sv_active[i] && sv_slave[i] == slave) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int64_t sv_clamp(int64_t v, int64_t lim) {
+    return v > lim ? lim : (v < -lim ? -lim : v);
+}
+
+/* Q16 -> целое с округлением */
+static int64_t sv_round(int64_t q) {
+    return q >= 0 ? (q + SV_ONE / 2) >> 16 : -((-q + SV_ONE / 2) >> 16);
+}
+
+static uint16_t sv_rd16(const uint8_t *p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static int32_t sv_rd32(const uint8_t *p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * Перевод коэффициентов в Q16 для периода оси
+ */
+static void sv_apply_gains(int i) {
+    const servo_gains_t *g = &sv_gains[i];
+    double t = sv_period_us / 1e6;
+
+    sv_kp_pos[i] = sv_q16(g->kp_pos);
+    sv_kp_vel[i] = sv_q16(g->kp_vel);
+    sv_ki_vel[i] = sv_q16(g->ki_vel * t);
+    sv_kd_vel[i] = sv_q16(g->kd_vel / t);
+    sv_kvff[i] = sv_q16(g->kvff);
+    sv_kaff[i] = sv_q16(g->kaff / t);
+    sv_c2r[i] = sv_q16(60.0 / ((double)sv_cpr[i] * t));
+}
+
+static int64_t sv_step_for(int i, uint32_t vel_rpm) {
+    double counts = (double)vel_rpm * sv_cpr[i] / 60.0 * (sv_period_us / 1e6);
+    int64_t step = (int64_t)(counts * SV_Q16);
+    return step > 0 ? step : 1;
+}
+
+/* ============================================================================
+ * Настройка (поток CLI)
+ * ============================================================================ */
+
+void servo_loop_default_gains(servo_gains_t *g) {
+    g->kp_pos = 0.1;
+    g->kp_vel = 2.0;
+    g->ki_vel = 20.0;
+    g->kd_vel = 0.0;
+    g->kvff = 1.0;
+    g->kaff = 0.0;
+}
+
+bool servo_loop_attach(uint16_t slave, const servo_pdo_t *pdo, uint32_t period_us,
+                       uint32_t counts_per_rev, bool vel_rpm, int64_t position) {
+    int slot = -1;
+
+    if (sv_find(slave) >= 0 || period_us == 0 || counts_per_rev == 0) {
+        return false;
+    }
+    for (int i = 0; i < SERVO_MAX_AXES; i++) {
+        if (!sv_active[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        return false;
+    }
+    if (servo_loop_axes() == 0) {
+        sv_period_us = period_us;
+        servo_loop_reset_stats();
+    }
+
+    sv_slave[slot] = slave;
+    sv_pdo[slot] = *pdo;
+    sv_cpr[slot] = counts_per_rev;
+    sv_vel_rpm[slot] = vel_rpm;
+    servo_loop_default_gains(&sv_gains[slot]);
+    sv_apply_gains(slot);
+    sv_vel_lim[slot] = (int64_t)SERVO_DEFAULT_VEL_LIMIT << 16;
+    sv_trq_lim[slot] = (int64_t)SERVO_DEFAULT_TORQUE_LIMIT << 16;
+    sv_step[slot] = sv_step_for(slot, SERVO_DEFAULT_VEL_LIMIT);
+
+    /* Безударное подключение: задание = факт, интегратор пуст. Развертка
+     * продолжает position: ближайшее к нему значение с младшими битами 0x6064 */
+    sv_raw[slot] = sv_rd32(pdo->inputs + pdo->actual_position);
+    sv_pos[slot] = position + (int32_t)((uint32_t)sv_raw[slot] - (uint32_t)position);
+    sv_target[slot] = sv_pos[slot] << 16;
+    sv_ref[slot] = sv_target[slot];
+    sv_integ[slot] = 0;
+    sv_verr_prev[slot] = 0;
+    sv_vff_prev[slot] = 0;
+    sv_torque[slot] = 0;
+    sv_perr[slot] = 0;
+    sv_perr_max[slot] = 0;
+    sv_sat[slot] = 0;
+
+    sv_active[slot] = true;
+    return true;
+}
+
+void servo_loop_detach(uint16_t slave) {
+    int i = sv_find(slave);
+    if (i >= 0) {
+        sv_active[i] = false;
+    }
+}
+
+void servo_loop_detach_all(void) {
+    for (int i = 0; i < SERVO_MAX_AXES; i++) {
+        sv_active[i] = false;
+    }
+}
+
+bool servo_loop_attached(uint16_t slave) {
+    return sv_find(slave) >= 0;
+}
+
+int servo_loop_axes(void) {
+    int n = 0;
+    for (int i = 0; i < SERVO_MAX_AXES; i++) {
+        n += sv_active[i] ? 1 : 0;
+    }
+    return n;
+}
+
+bool servo_loop_set_gains(uint16_t slave, const servo_gains_t *g) {
+    int i = sv_find(slave);
+    if (i < 0) {
+        return false;
+    }
+    sv_gains[i] = *g;
+    sv_apply_gains(i);
+    return true;
+}
+
+bool servo_loop_get_gains(uint16_t slave, servo_gains_t *g) {
+    int i = sv_find(slave);
+    if (i < 0) {
+        return false;
+    }
+    *g = sv_gains[i];
+    return true;
+}
+
+bool servo_loop_set_limits(uint16_t slave, uint32_t vel_rpm, uint16_t torque) {
+    int i = sv_find(slave);
+    if (i < 0 || vel_rpm == 0 || torque == 0) {
+        return false;
+    }
+    sv_vel_lim[i] = (int64_t)vel_rpm << 16;
+    sv_trq_lim[i] = (int64_t)torque << 16;
+    return true;
+}
+
+bool servo_loop_move(uint16_t slave, int64_t target, uint32_t vel_rpm) {
+    int i = sv_find(slave);
+    if (i < 0) {
+        return false;
+    }
+    uint32_t lim = (uint32_t)(sv_vel_lim[i] >> 16);
+    sv_step[i] = sv_step_for(i, vel_rpm == 0 || vel_rpm > lim ? lim : vel_rpm);
+    sv_target[i] = target << 16;
+    return true;
+}
+
+/* ============================================================================
+ * Цикл (циклический поток)
+ * ============================================================================ */
+
+/**
+ * Расчет всех осей одним проходом по массивам
+ */
+static void sv_compute(void) {
+    for (int i = 0; i < SERVO_MAX_AXES; i++) {
+        if (!sv_active[i]) {
+            continue;
+        }
+
+        int64_t pos = sv_pos[i] << 16;
+        if (!sv_ready[i]) {
+            /* Привод не в Operation Enabled: задание следует за фактом */
+            sv_target[i] = pos;
+            sv_ref[i] = pos;
+            sv_integ[i] = 0;
+            sv_verr_prev[i] = 0;
+            sv_vff_prev[i] = 0;
+            sv_torque[i] = 0;
+            continue;
+        }
+
+        /* Генератор задания: шаг к цели не больше sv_step за цикл */
+        int64_t d = sv_clamp(sv_target[i] - sv_ref[i], sv_step[i]);
+        sv_ref[i] += d;
+        int64_t vff = (d * sv_c2r[i]) >> 16;                 /* Q16 об/мин */
+        int64_t aff = vff - sv_vff_prev[i];                   /* Q16 об/мин за цикл */
+        sv_vff_prev[i] = vff;
+
+        /* Контур положения */
+        int64_t perr = sv_clamp(sv_ref[i] - pos, SV_MAX_ERROR);
+        int64_t vcmd = ((sv_kp_pos[i] * perr) >> 16) + ((sv_kvff[i] * vff) >> 16);
+        vcmd = sv_clamp(vcmd, sv_vel_lim[i]);
+
+        /* Контур скорости */
+        int64_t verr = vcmd - sv_vel[i];
+        int64_t u = ((sv_kp_vel[i] * verr) >> 16)
+                  + ((sv_kd_vel[i] * (verr - sv_verr_prev[i])) >> 16)
+                  + ((sv_kaff[i] * aff) >> 16);
+        int64_t integ = sv_integ[i] + ((sv_ki_vel[i] * verr) >> 16);
+        sv_verr_prev[i] = verr;
+
+        /* Anti-windup: в насыщении интегратор не растет в его сторону */
+        int64_t lim = sv_trq_lim[i];
+        u += integ;
+        if (u > lim) {
+            u = lim;
+            if (verr > 0) integ = sv_integ[i];
+            sv_sat[i]++;
+        } else if (u < -lim) {
+            u = -lim;
+            if (verr < 0) integ = sv_integ[i];
+            sv_sat[i]++;
+        }
+        sv_integ[i] = sv_clamp(integ, lim);
+        sv_torque[i] = (int16_t)sv_round(u);
+
+        int32_t e = (int32_t)sv_round(perr);
+        sv_perr[i] = e;
+        if (abs(e) > sv_perr_max[i]) {
+            sv_perr_max[i] = abs(e);
+        }
+    }
+}
+
+void servo_loop_cycle(void) {
+    int64_t now = timebase_now_ns();
+    uint64_t t0 = timebase_ticks();
+    int n = 0;
+
+    /* Сбор входов из PDO */
+    for (int i = 0; i < SERVO_MAX_AXES; i++) {
+        if (!sv_active[i]) {
+            continue;
+        }
+        const servo_pdo_t *p = &sv_pdo[i];
+        sv_ready[i] = (sv_rd16(p->inputs + p->statusword) & 0x6F) == 0x27;
+        /* Развертка: 0x6064 переполняется на длинных прогонах, разность
+         * за цикл по модулю 2^32 всегда много меньше 2^31 */
+        int32_t raw = sv_rd32(p->inputs + p->actual_position);
+        sv_pos[i] += (int32_t)((uint32_t)raw - (uint32_t)sv_raw[i]);
+        sv_raw[i] = raw;
+        int64_t vel = sv_rd32(p->inputs + p->actual_velocity);
+        sv_vel[i] = sv_vel_rpm[i] ? vel << 16 : (vel * 60 << 16) / sv_cpr[i];
+        n++;
+    }
+    if (n == 0) {
+        sv_last_ns = 0;
+        return;
+    }
+
+    sv_compute();
+
+    /* Выходы: момент и Target Position = задание генератора */
+    for (int i = 0; i < SERVO_MAX_AXES; i++) {
+        if (!sv_active[i]) {
+            continue;
+        }
+        const servo_pdo_t *p = &sv_pdo[i];
+        int32_t ref = (int32_t)(uint32_t)sv_round(sv_ref[i]);
+        memcpy(p->outputs + p->target_torque, &sv_torque[i], sizeof(sv_torque[i]));
+        memcpy(p->outputs + p->target_position, &ref, sizeof(ref));
+    }
+
+    int64_t exec = (int64_t)timebase_ticks_to_ns(timebase_ticks() - t0);
+    sv_write_begin();
+    sv_timing.cycles++;
+    sv_timing.exec_sum_ns += (double)exec;
+    if (sv_timing.exec_min_ns == 0 || exec < sv_timing.exec_min_ns) {
+        sv_timing.exec_min_ns = exec;
+    }
+    if (exec > sv_timing.exec_max_ns) {
+        sv_timing.exec_max_ns = exec;
+    }
+    if (sv_last_ns != 0) {
+        int64_t jitter = now - sv_last_ns - (int64_t)sv_period_us * 1000;
+        rt_hist_add(&sv_timing.jitter, jitter < 0 ? -jitter : jitter);
+    }
+    sv_write_end();
+    sv_last_ns = now;
+}
+
+/* ============================================================================
+ * Наблюдение
+ * ============================================================================ */
+
+bool servo_loop_info(uint16_t slave, servo_axis_info_t *info) {
+    int i = sv_find(slave);
+    if (i < 0) {
+        return false;
+    }
+    info->slave = slave;
+    info->ready = sv_ready[i];
+    info->target = sv_target[i] >> 16;
+    info->reference = sv_round(sv_ref[i]);
+    info->position = sv_pos[i];
+    info->velocity = (int32_t)sv_round(sv_vel[i]);
+    info->pos_error = sv_perr[i];
+    info->max_pos_error = sv_perr_max[i];
+    info->torque = sv_torque[i];
+    info->saturated = sv_sat[i];
+    return true;
+}
+
+void servo_loop_timing(servo_timing_t *out) {
+    uint32_t s1, s2;
+
+#ifdef _WIN32
+    (void)s1;
+    (void)s2;
+    memcpy(out, &sv_timing, sizeof(*out));
+#else
+    do {
+        s1 = __atomic_load_n(&sv_seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) {
+            continue;
+        }
+        memcpy(out, &sv_timing, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        s2 = __atomic_load_n(&sv_seq, __ATOMIC_RELAXED);
+    } while ((s1 & 1) || s1 != s2);
+#endif
+    out->period_us = sv_period_us;
+}
+
+void servo_loop_reset_stats(void) {
+    sv_write_begin();
+    memset(&sv_timing, 0, sizeof(sv_timing));
+    rt_hist_reset(&sv_timing.jitter);
+    sv_write_end();
+    for (int i = 0; i < SERVO_MAX_AXES; i++) {
+        sv_perr_max[i] = 0;
+        sv_sat[i] = 0;
+    }
+}
+
+void servo_loop_print(void) {
+    static servo_timing_t t;
+    servo_axis_info_t a;
+
+    printf("\n=== Master Servo Loop (CST) ===\n");
+    printf("Axes:              %d of %d\n", servo_loop_axes(), SERVO_MAX_AXES);
+    if (servo_loop_axes() > 0) {
+        printf("  Slave  Ready  Target      Reference   Position    PosErr  MaxErr  Vel(rpm)  Torque  Sat\n");
+        for (int i = 0; i < SERVO_MAX_AXES; i++) {
+            if (!sv_active[i] || !servo_loop_info(sv_slave[i], &a)) {
+                continue;
+            }
+            printf("  %5u  %-5s  %-10lld  %-10lld  %-10lld  %6d  %6d  %8d  %6.1f%%  %u\n",
+                   a.slave, a.ready ? "yes" : "no", (long long)a.target, (long long)a.reference,
+                   (long long)a.position,
+                   a.pos_error, a.max_pos_error, a.velocity, a.torque / 10.0, a.saturated);
+        }
+    }
+
+    servo_loop_timing(&t);
+    printf("Loop cycles:       %llu at %u us\n", (unsigned long long)t.cycles, t.period_us);
+    if (t.cycles > 0) {
+        printf("Compute time:      min %lld  avg %.0f  max %lld ns (all axes)\n",
+               (long long)t.exec_min_ns, t.exec_sum_ns / t.cycles, (long long)t.exec_max_ns);
+        printf("Period jitter:\n");
+        rt_hist_print(&t.jitter);
+    }
+    printf("\n");
+}
@@ -0,0 +1,122 @@
+/*
+ * servo_loop.h - Каскадный регулятор положения/скорости на стороне мастера
+ *
+ * Для осей в режиме Cyclic Synchronous Torque (0x6060 = 10) мастер сам
+ * замыкает контуры: генератор задания (рампа к цели с ограничением
+ * скорости) -> P по положению + feed-forward скорости -> PI(D) по скорости
+ * + feed-forward ускорения -> Target Torque 0x6071. Anti-windup:
+ * интегратор не растет в сторону насыщения момента и ограничен лимитом.
+ *
+ * Расчет целочисленный (Q16.16, промежуточные в int64) и выполняется
+ * пакетом по всем осям: состояние лежит массивами по осям (SoA), один
+ * проход без вызовов функций на ось. Коэффициенты переводятся в Q16 с
+ * учетом периода при настройке, в цикле нет плавающей точки.
+ *
+ * servo_loop_cycle() вызывается из циклического потока сразу после приема
+ * входов: момент уходит в следующем кадре. Команды CLI меняют задание и
+ * коэффициенты отдельными 32-битными записями; ось включается в расчет
+ * флагом после заполнения ее полей.
+ *
+ * Контур считает по развернутому в int64 положению: 0x6064 переполняется
+ * на длинных прогонах, и ошибка через границу int32 не должна давать
+ * скачок на 2^32 отсчетов. В 0x607A уходят младшие 32 бита задания.
+ *
+ * Единицы: положение - отсчеты, скорость - об/мин (0x606C в инкрементах/с
+ * пересчитывается по разрешению оси), момент - 0.1% номинального
+ * (0x6071/0x6077).
+ */
+
+#ifndef SERVO_LOOP_H
+#define SERVO_LOOP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rt_check.h"
+
+#define SERVO_MAX_AXES              16
+#define SERVO_DEFAULT_VEL_LIMIT     600      /* об/мин */
+#define SERVO_DEFAULT_TORQUE_LIMIT  1000     /* 0.1%: 100% номинального */
+
+/* Коэффициенты в единицах пользователя */
+typedef struct {
+    double kp_pos;               /* об/мин на отсчет ошибки */
+    double kp_vel;               /* 0.1% на об/мин */
+    double ki_vel;               /* 0.1% на об/мин*с */
+    double kd_vel;               /* 0.1% на об/мин/с */
+    double kvff;                 /* Доля feed-forward скорости (1.0 - полная) */
+    double kaff;                 /* 0.1% на об/мин/с ускорения задания */
+} servo_gains_t;
+
+/* Где в PDO лежат объекты оси (смещения в байтах) */
+typedef struct {
+    const uint8_t *inputs;
+    uint8_t *outputs;
+    uint16_t statusword;         /* 0x6041 */
+    uint16_t actual_position;    /* 0x6064 */
+    uint16_t actual_velocity;    /* 0x606C */
+    uint16_t target_position;    /* 0x607A: задание контура (supervise, безударный переход в CSP) */
+    uint16_t target_torque;      /* 0x6071 */
+} servo_pdo_t;
+
+/* Снимок оси */
+typedef struct {
+    uint16_t slave;
+    bool ready;                  /* Привод в Operation Enabled */
+    int64_t target;
+    int64_t reference;           /* Текущее задание генератора */
+    int64_t position;            /* Развернутое 0x6064 */
+    int32_t velocity;
+    int32_t pos_error;
+    int32_t max_pos_error;       /* С момента подключения или сброса */
+    int16_t torque;
+    uint32_t saturated;          /* Циклов с моментом на пределе */
+} servo_axis_info_t;
+
+typedef struct {
+    uint32_t period_us;
+    uint64_t cycles;
+    int64_t exec_min_ns;         /* Время расчета пакета осей */
+    int64_t exec_max_ns;
+    double exec_sum_ns;
+    rt_hist_t jitter;            /* |интервал между вызовами - период| */
+} servo_timing_t;
+
+/**
+ * Подключить ось к регулятору; задание = текущее положение
+ *
+ * @param vel_rpm  0x606C в об/мин (0x60A9), иначе инкременты/с
+ * @param position развернутое положение оси (axis_units_position): цели
+ *                 servo_loop_move() в той же развертке
+ * @return false если нет свободного места или ось уже подключена
+ */
+bool servo_loop_attach(uint16_t slave, const servo_pdo_t *pdo, uint32_t period_us,
+                       uint32_t counts_per_rev, bool vel_rpm, int64_t position);
+
+void servo_loop_detach(uint16_t slave);
+void servo_loop_detach_all(void);
+bool servo_loop_attached(uint16_t slave);
+int servo_loop_axes(void);
+
+void servo_loop_default_gains(servo_gains_t *g);
+bool servo_loop_set_gains(uint16_t slave, const servo_gains_t *g);
+bool servo_loop_get_gains(uint16_t slave, servo_gains_t *g);
+bool servo_loop_set_limits(uint16_t slave, uint32_t vel_rpm, uint16_t torque);
+
+/**
+ * Новая цель; задание идет к ней со скоростью vel_rpm (0 - лимит скорости)
+ */
+bool servo_loop_move(uint16_t slave, int64_t target, uint32_t vel_rpm);
+
+/**
+ * Один цикл всех осей: чтение входов, расчет, запись момента
+ */
+void servo_loop_cycle(void);
+
+bool servo_loop_info(uint16_t slave, servo_axis_info_t *info);
+void servo_loop_timing(servo_timing_t *out);
+void servo_loop_reset_stats(void);
+void servo_loop_print(void);
+
+#endif /* SERVO_LOOP_H */
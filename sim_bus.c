@@ -0,0 +1,234 @@
+/*
+ * sim_bus.c - Симулированная шина EtherCAT для работы без оборудования
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cia402_sim.h"
+#include "sim_bus.h"
+#include "timebase.h"
+
+#define SIM_BUS_CONFIGADR_BASE 0x1001
+#define SIM_BUS_MAX_OBYTES     64
+
+/* ============================================================================
+ * Модель "io": выходы возвращаются во входах, плюс счетчик обменов
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t counter;
+} sim_io_state_t;
+
+static void sim_io_cycle(void *state, const uint8_t *outputs, uint8_t *inputs, int64_t dt_ns) {
+    sim_io_state_t *st = state;
+    (void)dt_ns;
+
+    st->counter++;
+    memcpy(inputs, outputs, 4);
+    memcpy(inputs + 4, &st->counter, sizeof(st->counter));
+}
+
+static const sim_model_t sim_io_model = {
+    .name = "io",
+    .slave_name = "SIM-IO 4/8",
+    .vendor = 0x00000000,
+    .product = 0x00000001,
+    .obytes = 4,
+    .ibytes = 8,
+    .state_size = sizeof(sim_io_state_t),
+    .cycle = sim_io_cycle,
+};
+
+/* Доступные модели */
+static const sim_model_t *const sim_models[] = {
+    &sim_io_model,
+    &cia402_sim_model,
+    &cia402_cst_sim_model,
+    &cia402_mode_sim_model,
+    &cia402_cst_mode_sim_model,
+};
+
+#define SIM_MODEL_COUNT (sizeof(sim_models) / sizeof(sim_models[0]))
+
+/* ============================================================================
+ * Шина
+ * ============================================================================ */
+
+static const sim_model_t *sim_model = NULL;
+static int sim_count = 0;
+static uint8_t *sim_state = NULL;         /* count x state_size */
+static uint16_t sim_al_state = EC_STATE_INIT;
+static int64_t sim_last_ns = 0;
+static bool sim_exchanged = false;
+static char sim_desc[64];
+
+/* Выходы, которые видят модели вне OP */
+static const uint8_t sim_safe_outputs[SIM_BUS_MAX_OBYTES];
+
+static const sim_model_t *sim_find_model(const char *name) {
+    for (size_t i = 0; i < SIM_MODEL_COUNT; i++) {
+        if (strcmp(sim_models[i]->name, name) == 0) {
+            return sim_models[i];
+        }
+    }
+    return NULL;
+}
+
+bool sim_bus_create(const char *model, int count) {
+    const sim_model_t *m = sim_find_model(model ? model : SIM_BUS_DEFAULT_MODEL);
+
+    if (!m || count < 1 || count >= EC_MAXSLAVE) {
+        return false;
+    }
+
+    sim_bus_destroy();
+    /* Состояние выделяется один раз: в цикле обмена памяти не берем */
+    sim_state = calloc((size_t)count, m->state_size ? m->state_size : 1);
+    if (!sim_state) {
+        return false;
+    }
+
+    sim_model = m;
+    sim_count = count;
+    for (int i = 0; i < count; i++) {
+        if (m->init) {
+            m->init(sim_state + (size_t)i * m->state_size, i + 1);
+        }
+    }
+    snprintf(sim_desc, sizeof(sim_desc), "%d x %s", count, m->name);
+    return true;
+}
+
+void sim_bus_destroy(void) {
+    free(sim_state);
+    sim_state = NULL;
+    sim_model = NULL;
+    sim_count = 0;
+    sim_al_state = EC_STATE_INIT;
+    sim_exchanged = false;
+}
+
+bool sim_bus_active(void) {
+    return sim_model != NULL;
+}
+
+const char *sim_bus_describe(void) {
+    return sim_model ? sim_desc : "none";
+}
+
+const sim_model_t *sim_bus_model(void) {
+    return sim_model;
+}
+
+void *sim_bus_slave_state(uint16_t slave) {
+    if (!sim_model || slave < 1 || slave > sim_count) {
+        return NULL;
+    }
+    return sim_state + (size_t)(slave - 1) * sim_model->state_size;
+}
+
+int sim_bus_scan(ecx_contextt *ctx, uint8_t *iomap, size_t iomap_size) {
+    size_t obytes = (size_t)sim_model->obytes * sim_count;
+    size_t ibytes = (size_t)sim_model->ibytes * sim_count;
+    ec_groupt *grp = &ctx->grouplist[0];
+
+    if (obytes + ibytes > iomap_size || sim_model->obytes > SIM_BUS_MAX_OBYTES) {
+        return -1;
+    }
+
+    memset(iomap, 0, obytes + ibytes);
+    memset(ctx->slavelist, 0, sizeof(ctx->slavelist));
+    memset(grp, 0, sizeof(*grp));
+
+    ctx->slavecount = sim_count;
+    for (int i = 1; i <= sim_count; i++) {
+        ec_slavet *s = &ctx->slavelist[i];
+
+        snprintf(s->name, sizeof(s->name), "%s", sim_model->slave_name);
+        s->eep_man = sim_model->vendor;
+        s->eep_id = sim_model->product;
+        s->configadr = (uint16)(SIM_BUS_CONFIGADR_BASE + i - 1);
+        s->state = EC_STATE_PRE_OP;
+        s->parent = (uint16)(i - 1);
+        s->activeports = i < sim_count ? 0x03 : 0x01;
+        s->group = 0;
+
+        s->Obytes = sim_model->obytes;
+        s->Obits = (uint16)(sim_model->obytes * 8);
+        s->outputs = sim_model->obytes ? iomap + (size_t)(i - 1) * sim_model->obytes : NULL;
+        s->Ibytes = sim_model->ibytes;
+        s->Ibits = (uint16)(sim_model->ibytes * 8);
+        s->inputs = sim_model->ibytes ? iomap + obytes + (size_t)(i - 1) * sim_model->ibytes : NULL;
+    }
+
+    grp->Obytes = (uint32)obytes;
+    grp->Ibytes = (uint32)ibytes;
+    grp->outputs = iomap;
+    grp->inputs = iomap + obytes;
+    grp->outputsWKC = (uint16)(sim_model->obytes ? sim_count : 0);
+    grp->inputsWKC = (uint16)(sim_model->ibytes ? sim_count : 0);
+
+    sim_al_state = EC_STATE_PRE_OP;
+    sim_exchanged = false;
+    return sim_count;
+}
+
+void sim_bus_set_state(ecx_contextt *ctx, uint16_t state) {
+    sim_al_state = state;
+    for (int i = 1; i <= ctx->slavecount; i++) {
+        ctx->slavelist[i].state = state;
+    }
+    ctx->slavelist[0].state = state;
+}
+
+int sim_bus_exchange(ecx_contextt *ctx) {
+    if (!sim_model || sim_al_state < EC_STATE_SAFE_OP) {
+        return 0;
+    }
+
+    int64_t now = timebase_now_ns();
+    int64_t dt = sim_exchanged ? now - sim_last_ns : 0;
+    bool op = sim_al_state == EC_STATE_OPERATIONAL;
+
+    sim_last_ns = now;
+    sim_exchanged = true;
+
+    for (int i = 1; i <= ctx->slavecount; i++) {
+        ec_slavet *s = &ctx->slavelist[i];
+        const uint8_t *out = op && s->outputs ? s->outputs : sim_safe_outputs;
+        sim_model->cycle(sim_state + (size_t)(i - 1) * sim_model->state_size, out, s->inputs, dt);
+    }
+
+    return (op ? ctx->grouplist[0].outputsWKC * 2 : 0) + ctx->grouplist[0].inputsWKC;
+}
+
+int sim_bus_sdo_write(uint16_t slave, uint16_t index, uint8_t subindex, const void *data, int size) {
+    void *st = sim_bus_slave_state(slave);
+    if (!st || !sim_model->sdo_write) {
+        return 0;
+    }
+    return sim_model->sdo_write(st, index, subindex, data, size) >= 0 ? 1 : 0;
+}
+
+int sim_bus_sdo_read(uint16_t slave, uint16_t index, uint8_t subindex, void *data, int *size) {
+    void *st = sim_bus_slave_state(slave);
+    if (!st || !sim_model->sdo_read) {
+        return 0;
+    }
+    int n = sim_model->sdo_read(st, index, subindex, data, *size);
+    if (n < 0) {
+        return 0;
+    }
+    *size = n;
+    return 1;
+}
+
+void sim_bus_print_models(void) {
+    for (size_t i = 0; i < SIM_MODEL_COUNT; i++) {
+        const sim_model_t *m = sim_models[i];
+        printf("    %-16s %-25s outputs %u, inputs %u bytes\n",
+               m->name, m->slave_name, m->obytes, m->ibytes);
+    }
+}
@@ -0,0 +1,100 @@
+/*
+ * sim_bus.h - Симулированная шина EtherCAT для работы без оборудования
+ *
+ * Заполняет ecx_context так же, как ecx_config_init + ecx_config_map_group:
+ * slavelist (имена, идентификаторы, адреса), раскладку IOmap (сначала
+ * выходы всех slaves, затем входы) и ожидаемый WKC группы 0. Обмен
+ * вызывает модель каждого slave: выходы мастера -> модель -> входы.
+ * Модель получает интервал с прошлого обмена по timebase_now_ns(), поэтому
+ * в виртуальном времени (--virtual-time) результат не зависит от скорости
+ * хоста.
+ */
+
+#ifndef SIM_BUS_H
+#define SIM_BUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "soem/soem.h"
+
+#define SIM_BUS_DEFAULT_MODEL "io"
+
+/* Модель симулированного slave */
+typedef struct {
+    const char *name;            /* Имя модели в --sim <count>:<model> */
+    const char *slave_name;      /* Имя slave в slavelist */
+    uint32_t vendor;
+    uint32_t product;
+    uint16_t obytes;             /* Размер выходов (RxPDO) */
+    uint16_t ibytes;             /* Размер входов (TxPDO) */
+    size_t state_size;           /* Байт состояния модели на один slave */
+
+    void (*init)(void *state, int slave);
+    /* Один обмен; dt_ns - время с прошлого обмена (0 в первом) */
+    void (*cycle)(void *state, const uint8_t *outputs, uint8_t *inputs, int64_t dt_ns);
+    /* SDO: количество байт или -1 (abort) */
+    int (*sdo_write)(void *state, uint16_t index, uint8_t subindex, const void *data, int size);
+    int (*sdo_read)(void *state, uint16_t index, uint8_t subindex, void *data, int size);
+} sim_model_t;
+
+/**
+ * Создание шины: count slaves модели model
+ *
+ * @return false если модель неизвестна или count вне 1..EC_MAXSLAVE-1
+ */
+bool sim_bus_create(const char *model, int count);
+
+void sim_bus_destroy(void);
+
+bool sim_bus_active(void);
+
+/**
+ * Описание шины для статуса ("200 x io")
+ */
+const char *sim_bus_describe(void);
+
+/**
+ * "Сканирование": slavelist и раскладка процесса в IOmap
+ *
+ * @return количество slaves или -1 если образ не помещается в IOmap
+ */
+int sim_bus_scan(ecx_contextt *ctx, uint8_t *iomap, size_t iomap_size);
+
+/**
+ * Переход всех slaves в состояние (модели начинают обмен в OP)
+ */
+void sim_bus_set_state(ecx_contextt *ctx, uint16_t state);
+
+/**
+ * Обмен процессными данными группы 0
+ *
+ * @return WKC как у LRW: 2 x slaves с выходами + slaves с входами (в OP)
+ */
+int sim_bus_exchange(ecx_contextt *ctx);
+
+/**
+ * SDO доступ к модели
+ *
+ * @return 1 при успехе (как wkc ecx_SDOwrite/ecx_SDOread), 0 - abort
+ */
+int sim_bus_sdo_write(uint16_t slave, uint16_t index, uint8_t subindex, const void *data, int size);
+int sim_bus_sdo_read(uint16_t slave, uint16_t index, uint8_t subindex, void *data, int *size);
+
+/**
+ * Модель шины или NULL
+ */
+const sim_model_t *sim_bus_model(void);
+
+/**
+ * Состояние модели slave (для команд и тестов модели)
+ */
+void *sim_bus_slave_state(uint16_t slave);
+
+/**
+ * Список моделей для справки
+ */
+void sim_bus_print_models(void);
+
+#endif /* SIM_BUS_H */
@@ -0,0 +1,545 @@
+/*
+ * supervise.c - Контроль осей мастером: ошибка слежения, скорость, позиция
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "supervise.h"
+#include "axis_units.h"
+
+#define SP_CW_QUICK_STOP 0x0004
+#define SP_CW_HALT       0x0100
+
+/* ============================================================================
+ * Состояние осей (SoA)
+ * ============================================================================ */
+
+static volatile bool sp_active[SUPERVISE_MAX_AXES];
+static int sp_hi = 0;                            /* Слотов в работе (верхняя граница) */
+static uint16_t sp_slave[SUPERVISE_MAX_AXES];
+static supervise_pdo_t sp_pdo[SUPERVISE_MAX_AXES];
+
+/* Пределы; выключенный предел хранится как недостижимый */
+static uint32_t sp_follow_win[SUPERVISE_MAX_AXES];
+static uint32_t sp_vel_lim[SUPERVISE_MAX_AXES];   /* Единицы привода 0x606C */
+static int64_t sp_follow_eff[SUPERVISE_MAX_AXES];
+static int64_t sp_vel_eff[SUPERVISE_MAX_AXES];
+static bool sp_pos_on[SUPERVISE_MAX_AXES];
+static int32_t sp_pos_min[SUPERVISE_MAX_AXES];
+static int32_t sp_pos_max[SUPERVISE_MAX_AXES];
+static uint8_t sp_reaction[SUPERVISE_MAX_AXES];
+
+/* Входы цикла и результат проверки */
+static uint8_t sp_enabled[SUPERVISE_MAX_AXES];   /* 0xFF - слот активен и привод в Operation Enabled */
+static int32_t sp_pos[SUPERVISE_MAX_AXES];
+static int32_t sp_vel[SUPERVISE_MAX_AXES];
+static int32_t sp_tgt[SUPERVISE_MAX_AXES];
+static int64_t sp_ferr[SUPERVISE_MAX_AXES];
+static uint8_t sp_viol[SUPERVISE_MAX_AXES];
+static volatile uint8_t sp_latched[SUPERVISE_MAX_AXES];
+
+/* Движения */
+static int32_t sp_prev_tgt[SUPERVISE_MAX_AXES];
+static bool sp_moving[SUPERVISE_MAX_AXES];
+static uint32_t sp_still[SUPERVISE_MAX_AXES];
+static uint64_t sp_move_start[SUPERVISE_MAX_AXES];
+static int32_t sp_move_from[SUPERVISE_MAX_AXES];
+static int32_t sp_move_max[SUPERVISE_MAX_AXES];
+
+/* Статистика оси */
+static int32_t sp_max_ferr[SUPERVISE_MAX_AXES];
+static uint32_t sp_moves[SUPERVISE_MAX_AXES];
+static uint32_t sp_trips[SUPERVISE_MAX_AXES];
+
+/* Журналы (seqlock: поток пишет, CLI копирует) */
+static uint64_t sp_cycle = 0;
+static uint64_t sp_event_count = 0;
+static uint64_t sp_move_count = 0;
+static supervise_event_t sp_events[SUPERVISE_EVENTS];
+static supervise_move_t sp_move_log[SUPERVISE_MOVES];
+static uint32_t sp_seq;
+
+static void sp_write_begin(void) {
+#ifdef _WIN32
+    sp_seq++;                                    /* Windows: циклы только в вызывающем потоке */
+#else
+    __atomic_store_n(&sp_seq, sp_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+#endif
+}
+
+static void sp_write_end(void) {
+#ifdef _WIN32
+    sp_seq++;
+#else
+    __atomic_store_n(&sp_seq, sp_seq + 1, __ATOMIC_RELEASE);
+#endif
+}
+
+static int sp_find(uint16_t slave) {
+    for (int i = 0; i < sp_hi; i++) {
+        if (sp_active[i] && sp_slave[i] == slave) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int32_t sp_rd32(const uint8_t *p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static const char *sp_violation_name(uint8_t v) {
+    switch (v) {
+        case SUPERVISE_FOLLOWING: return "following error";
+        case SUPERVISE_VELOCITY: return "velocity limit";
+        case SUPERVISE_POSITION: return "position limit";
+        default: return "?";
+    }
+}
+
+static const char *sp_reaction_name(uint8_t r) {
+    switch (r) {
+        case SUPERVISE_QUICK_STOP: return "quick stop";
+        case SUPERVISE_HALT: return "halt";
+        default: return "event";
+    }
+}
+
+/* ============================================================================
+ * Настройка (поток CLI)
+ * ============================================================================ */
+
+bool supervise_attach(uint16_t slave, const supervise_pdo_t *pdo) {
+    int slot = -1;
+
+    if (sp_find(slave) >= 0) {
+        return true;
+    }
+    for (int i = 0; i < SUPERVISE_MAX_AXES; i++) {
+        if (!sp_active[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        return false;
+    }
+
+    sp_slave[slot] = slave;
+    sp_pdo[slot] = *pdo;
+    sp_follow_win[slot] = 0;
+    sp_vel_lim[slot] = 0;
+    sp_follow_eff[slot] = INT64_MAX;
+    sp_vel_eff[slot] = INT64_MAX;
+    sp_pos_on[slot] = false;
+    sp_pos_min[slot] = INT32_MIN;
+    sp_pos_max[slot] = INT32_MAX;
+    sp_reaction[slot] = SUPERVISE_QUICK_STOP;
+    sp_latched[slot] = 0;
+    sp_prev_tgt[slot] = sp_rd32(pdo->outputs + pdo->target_position);
+    sp_moving[slot] = false;
+    sp_max_ferr[slot] = 0;
+    sp_moves[slot] = 0;
+    sp_trips[slot] = 0;
+
+    if (slot >= sp_hi) {
+        sp_hi = slot + 1;
+    }
+    sp_active[slot] = true;
+    return true;
+}
+
+void supervise_detach(uint16_t slave) {
+    int i = sp_find(slave);
+    if (i >= 0) {
+        sp_active[i] = false;
+    }
+}
+
+void supervise_detach_all(void) {
+    for (int i = 0; i < SUPERVISE_MAX_AXES; i++) {
+        sp_active[i] = false;
+    }
+}
+
+int supervise_axes(void) {
+    int n = 0;
+    for (int i = 0; i < sp_hi; i++) {
+        n += sp_active[i] ? 1 : 0;
+    }
+    return n;
+}
+
+bool supervise_set_following(uint16_t slave, uint32_t window) {
+    int i = sp_find(slave);
+    if (i < 0) {
+        return false;
+    }
+    sp_follow_win[i] = window;
+    sp_follow_eff[i] = window ? (int64_t)window : INT64_MAX;
+    return true;
+}
+
+bool supervise_set_velocity(uint16_t slave, int64_t vel) {
+    int i = sp_find(slave);
+    if (i < 0) {
+        return false;
+    }
+    int32_t drive = axis_units_drive_from_vel(slave, vel < 0 ? -vel : vel);
+    uint32_t lim = drive < 0 ? (uint32_t)INT32_MAX : (uint32_t)drive;
+    if (vel != 0 && lim == 0) {
+        lim = 1;                             /* Меньше единицы привода - не выключение */
+    }
+    sp_vel_lim[i] = lim;
+    sp_vel_eff[i] = lim ? (int64_t)lim : INT64_MAX;
+    return true;
+}
+
+bool supervise_set_position(uint16_t slave, bool enabled, int32_t min, int32_t max) {
+    int i = sp_find(slave);
+    if (i < 0 || (enabled && min >= max)) {
+        return false;
+    }
+    /* Порядок записей: сначала расширить, затем сузить - без ложного срабатывания */
+    sp_pos_min[i] = INT32_MIN;
+    sp_pos_max[i] = INT32_MAX;
+    sp_pos_on[i] = enabled;
+    if (enabled) {
+        sp_pos_min[i] = min;
+        sp_pos_max[i] = max;
+    }
+    return true;
+}
+
+bool supervise_set_reaction(uint16_t slave, supervise_reaction_t reaction) {
+    int i = sp_find(slave);
+    if (i < 0) {
+        return false;
+    }
+    sp_reaction[i] = (uint8_t)reaction;
+    return true;
+}
+
+bool supervise_reset(uint16_t slave) {
+    int i = sp_find(slave);
+    if (i < 0) {
+        return false;
+    }
+    sp_latched[i] = 0;
+    return true;
+}
+
+/* ============================================================================
+ * Цикл (циклический поток)
+ * ============================================================================ */
+
+/**
+ * Проверка всех осей одним проходом без ветвлений
+ */
+static void sp_check(int n) {
+    for (int i = 0; i < n; i++) {
+        int64_t ferr = (int64_t)sp_tgt[i] - sp_pos[i];
+        int64_t aferr = ferr < 0 ? -ferr : ferr;
+        int64_t avel = sp_vel[i] < 0 ? -(int64_t)sp_vel[i] : sp_vel[i];
+        uint8_t v = (uint8_t)((aferr > sp_follow_eff[i]) |
+                              ((avel > sp_vel_eff[i]) << 1) |
+                              (((sp_pos[i] < sp_pos_min[i]) | (sp_pos[i] > sp_pos_max[i])) << 2));
+        sp_viol[i] = v & sp_enabled[i];
+        sp_ferr[i] = aferr;
+    }
+}
+
+static void sp_log_event(int i, uint8_t violation) {
+    supervise_event_t *e = &sp_events[sp_event_count % SUPERVISE_EVENTS];
+
+    e->cycle = sp_cycle;
+    e->slave = sp_slave[i];
+    e->violation = violation;
+    switch (violation) {
+        case SUPERVISE_FOLLOWING:
+            e->value = (int32_t)(sp_ferr[i] > INT32_MAX ? INT32_MAX : sp_ferr[i]);
+            e->limit = (int32_t)sp_follow_win[i];
+            break;
+        case SUPERVISE_VELOCITY:
+            e->value = sp_vel[i];
+            e->limit = (int32_t)sp_vel_lim[i];
+            break;
+        default:
+            e->value = sp_pos[i];
+            e->limit = sp_pos[i] < sp_pos_min[i] ? sp_pos_min[i] : sp_pos_max[i];
+            break;
+    }
+    sp_event_count++;
+}
+
+/**
+ * Учет движения: максимум ошибки, пока задание меняется и после остановки
+ */
+static void sp_track_move(int i) {
+    int32_t ferr = (int32_t)(sp_ferr[i] > INT32_MAX ? INT32_MAX : sp_ferr[i]);
+    bool changed = sp_tgt[i] != sp_prev_tgt[i];
+
+    if (sp_enabled[i] && changed) {
+        if (!sp_moving[i]) {
+            sp_moving[i] = true;
+            sp_move_start[i] = sp_cycle;
+            sp_move_from[i] = sp_prev_tgt[i];
+            sp_move_max[i] = 0;
+        }
+        sp_still[i] = 0;
+    } else if (sp_moving[i]) {
+        sp_still[i]++;
+    }
+    sp_prev_tgt[i] = sp_tgt[i];
+
+    if (!sp_moving[i]) {
+        return;
+    }
+    if (sp_enabled[i] && ferr > sp_move_max[i]) {
+        sp_move_max[i] = ferr;
+    }
+    if (sp_still[i] >= SUPERVISE_SETTLE_CYCLES || !sp_enabled[i]) {
+        supervise_move_t *m = &sp_move_log[sp_move_count % SUPERVISE_MOVES];
+        m->slave = sp_slave[i];
+        m->start_cycle = sp_move_start[i];
+        m->cycles = (uint32_t)(sp_cycle - sp_move_start[i]);
+        m->distance = sp_tgt[i] - sp_move_from[i];
+        m->max_following = sp_move_max[i];
+        sp_move_count++;
+        sp_moves[i]++;
+        sp_moving[i] = false;
+    }
+}
+
+/**
+ * Реакция зафиксированного нарушения в Controlword выходов
+ */
+static void sp_react(int i) {
+    if (sp_latched[i] && sp_reaction[i] != SUPERVISE_EVENT_ONLY) {
+        const supervise_pdo_t *p = &sp_pdo[i];
+        uint16_t cw;
+        memcpy(&cw, p->outputs + p->control_word, sizeof(cw));
+        if (sp_reaction[i] == SUPERVISE_QUICK_STOP) {
+            cw &= (uint16_t)~SP_CW_QUICK_STOP;
+        } else {
+            cw |= SP_CW_HALT;
+        }
+        memcpy(p->outputs + p->control_word, &cw, sizeof(cw));
+    }
+}
+
+/**
+ * Цикл без свежих входов: только повтор реакций (Controlword могли
+ * переписать команды CLI)
+ */
+static void sp_reassert(int n) {
+    for (int i = 0; i < n; i++) {
+        if (sp_active[i]) {
+            sp_react(i);
+        }
+    }
+}
+
+void supervise_cycle(bool inputs_ok) {
+    int n = sp_hi;
+
+    if (n == 0) {
+        return;
+    }
+
+    /* Без свежих входов проверок нет, но зафиксированная реакция остается в выходах */
+    if (!inputs_ok) {
+        sp_reassert(n);
+        return;
+    }
+
+    /* Сбор входов и текущего задания */
+    for (int i = 0; i < n; i++) {
+        const supervise_pdo_t *p = &sp_pdo[i];
+        uint16_t sw;
+        if (!sp_active[i]) {
+            sp_enabled[i] = 0;
+            continue;
+        }
+        memcpy(&sw, p->inputs + p->statusword, sizeof(sw));
+        sp_enabled[i] = (sw & 0x6F) == 0x27 ? 0xFF : 0x00;
+        sp_pos[i] = sp_rd32(p->inputs + p->actual_position);
+        sp_vel[i] = sp_rd32(p->inputs + p->actual_velocity);
+        sp_tgt[i] = sp_rd32(p->outputs + p->target_position);
+    }
+
+    sp_check(n);
+
+    /* Реакция в выходах этого цикла */
+    sp_write_begin();
+    for (int i = 0; i < n; i++) {
+        if (!sp_active[i]) {
+            continue;
+        }
+        int32_t ferr = (int32_t)(sp_ferr[i] > INT32_MAX ? INT32_MAX : sp_ferr[i]);
+        if (sp_enabled[i] && sp_follow_win[i] && ferr > sp_max_ferr[i]) {
+            sp_max_ferr[i] = ferr;
+        }
+        sp_track_move(i);
+
+        uint8_t fresh = sp_viol[i] & (uint8_t)~sp_latched[i];
+        if (fresh) {
+            sp_latched[i] |= fresh;
+            sp_trips[i]++;
+            for (uint8_t bit = SUPERVISE_FOLLOWING; bit <= SUPERVISE_POSITION; bit <<= 1) {
+                if (fresh & bit) {
+                    sp_log_event(i, bit);
+                }
+            }
+        }
+        sp_react(i);
+    }
+    sp_cycle++;
+    sp_write_end();
+}
+
+uint64_t supervise_trips(void) {
+    return sp_event_count;
+}
+
+/* ============================================================================
+ * Наблюдение
+ * ============================================================================ */
+
+bool supervise_info(uint16_t slave, supervise_axis_info_t *info) {
+    int i = sp_find(slave);
+    if (i < 0) {
+        return false;
+    }
+    info->slave = slave;
+    info->follow_window = sp_follow_win[i];
+    info->velocity_limit = sp_vel_lim[i];
+    info->position_limits = sp_pos_on[i];
+    info->position_min = sp_pos_min[i];
+    info->position_max = sp_pos_max[i];
+    info->reaction = (supervise_reaction_t)sp_reaction[i];
+    info->latched = sp_latched[i];
+    info->following = (int32_t)(sp_ferr[i] > INT32_MAX ? INT32_MAX : sp_ferr[i]);
+    info->max_following = sp_max_ferr[i];
+    info->moves = sp_moves[i];
+    info->trips = sp_trips[i];
+    return true;
+}
+
+/**
+ * Согласованная копия журналов
+ */
+static void sp_snapshot(supervise_event_t *events, uint64_t *nevents,
+                        supervise_move_t *moves, uint64_t *nmoves, uint64_t *cycle) {
+    uint32_t s1, s2;
+
+#ifdef _WIN32
+    (void)s1;
+    (void)s2;
+    memcpy(events, sp_events, sizeof(sp_events));
+    memcpy(moves, sp_move_log, sizeof(sp_move_log));
+    *nevents = sp_event_count;
+    *nmoves = sp_move_count;
+    *cycle = sp_cycle;
+#else
+    do {
+        s1 = __atomic_load_n(&sp_seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) {
+            continue;
+        }
+        memcpy(events, sp_events, sizeof(sp_events));
+        memcpy(moves, sp_move_log, sizeof(sp_move_log));
+        *nevents = sp_event_count;
+        *nmoves = sp_move_count;
+        *cycle = sp_cycle;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        s2 = __atomic_load_n(&sp_seq, __ATOMIC_RELAXED);
+    } while ((s1 & 1) || s1 != s2);
+#endif
+}
+
+void supervise_print(void) {
+    static supervise_event_t events[SUPERVISE_EVENTS];
+    static supervise_move_t moves[SUPERVISE_MOVES];
+    uint64_t nevents, nmoves, cycle;
+    supervise_axis_info_t a;
+    char limits[32];
+    char error[16];
+    char vel[16];
+
+    sp_snapshot(events, &nevents, moves, &nmoves, &cycle);
+
+    printf("\n=== Axis Supervision ===\n");
+    printf("Axes:              %d (checked %llu cycles, %llu trips)\n", supervise_axes(),
+           (unsigned long long)cycle, (unsigned long long)nevents);
+    if (supervise_axes() == 0) {
+        printf("\n");
+        return;
+    }
+
+    printf("  Slave  Follow  Velocity        Position limits          Reaction    Error  MaxErr  Moves  Latched\n");
+    for (int i = 0; i < sp_hi; i++) {
+        if (!sp_active[i] || !supervise_info(sp_slave[i], &a)) {
+            continue;
+        }
+        if (a.position_limits) {
+            snprintf(limits, sizeof(limits), "%d..%d", a.position_min, a.position_max);
+        } else {
+            snprintf(limits, sizeof(limits), "off");
+        }
+        if (a.velocity_limit) {
+            snprintf(vel, sizeof(vel), "%.6g %s",
+                     axis_units_vel_from_drive(a.slave, (int32_t)a.velocity_limit) / (double)AXIS_UNITS_MICRO,
+                     axis_units_vel_name(a.slave));
+        } else {
+            snprintf(vel, sizeof(vel), "off");
+        }
+        /* Без окна слежения 0x607A может не вестись мастером (PV): ошибку не показываем */
+        if (a.follow_window) {
+            snprintf(error, sizeof(error), "%d", a.following);
+        } else {
+            snprintf(error, sizeof(error), "-");
+        }
+        printf("  %5u  %6u  %-14s  %-23s  %-10s  %5s  %6d  %5u  %s%s%s%s\n",
+               a.slave, a.follow_window, vel, limits, sp_reaction_name(a.reaction),
+               error, a.max_following, a.moves, a.latched ? "" : "-",
+               (a.latched & SUPERVISE_FOLLOWING) ? "F" : "",
+               (a.latched & SUPERVISE_VELOCITY) ? "V" : "",
+               (a.latched & SUPERVISE_POSITION) ? "P" : "");
+    }
+
+    if (nevents > 0) {
+        uint64_t first = nevents > SUPERVISE_EVENTS ? nevents - SUPERVISE_EVENTS : 0;
+        printf("Trips (last %llu):\n", (unsigned long long)(nevents - first));
+        for (uint64_t k = first; k < nevents; k++) {
+            const supervise_event_t *e = &events[k % SUPERVISE_EVENTS];
+            if (e->violation == SUPERVISE_VELOCITY) {
+                printf("  cycle %-10llu slave %-4u %-16s %.1f (limit %.1f) %s\n",
+                       (unsigned long long)e->cycle, e->slave, sp_violation_name(e->violation),
+                       axis_units_vel_from_drive(e->slave, e->value) / (double)AXIS_UNITS_MICRO,
+                       axis_units_vel_from_drive(e->slave, e->limit) / (double)AXIS_UNITS_MICRO,
+                       axis_units_vel_name(e->slave));
+                continue;
+            }
+            printf("  cycle %-10llu slave %-4u %-16s %d (limit %d)\n",
+                   (unsigned long long)e->cycle, e->slave, sp_violation_name(e->violation),
+                   e->value, e->limit);
+        }
+    }
+    if (nmoves > 0) {
+        uint64_t first = nmoves > SUPERVISE_MOVES ? nmoves - SUPERVISE_MOVES : 0;
+        printf("Moves (last %llu):\n", (unsigned long long)(nmoves - first));
+        for (uint64_t k = first; k < nmoves; k++) {
+            const supervise_move_t *m = &moves[k % SUPERVISE_MOVES];
+            printf("  cycle %-10llu slave %-4u %8u cycles  distance %-10d max following %d\n",
+                   (unsigned long long)m->start_cycle, m->slave, m->cycles, m->distance,
+                   m->max_following);
+        }
+    }
+    printf("\n");
+}
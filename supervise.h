@@ -0,0 +1,131 @@
+/*
+ * supervise.h - Контроль осей мастером: ошибка слежения, скорость, позиция
+ *
+ * Запасной рубеж для приводов с неверно настроенными внутренними
+ * пределами. Каждый цикл после приема входов по всем осям сразу:
+ *   |0x607A Target Position - 0x6064 Position Actual| > окна слежения,
+ *   |0x606C Velocity Actual| > предела скорости,
+ *   0x6064 вне программных пределов [min, max].
+ * Проверка - один проход по массивам осей без ветвлений, реакция - в
+ * выходах того же цикла (уходят следующим кадром): Quick Stop (сброс бита
+ * 2 Controlword), Halt (бит 8) или только событие. Реакция фиксируется и
+ * повторяется каждый цикл до supervise ... reset, чтобы команды CLI не
+ * сняли ее случайной записью Controlword.
+ *
+ * Предел скорости задается в единицах скорости оси (axis_units: об/мин или
+ * единицы/мин) и хранится в единицах привода 0x606C: в цикле пересчета нет.
+ *
+ * Окно слежения сравнивает 0x607A с фактом и имеет смысл для осей, где
+ * мастер ведет 0x607A: CSP/PP и оси servo (там 0x607A - задание контура).
+ *
+ * Движение - интервал, пока 0x607A меняется, плюс SUPERVISE_SETTLE_CYCLES
+ * после остановки задания. По каждому движению хранится максимум ошибки.
+ */
+
+#ifndef SUPERVISE_H
+#define SUPERVISE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SUPERVISE_MAX_AXES      256
+#define SUPERVISE_SETTLE_CYCLES 100      /* Циклов без изменения задания - конец движения */
+#define SUPERVISE_EVENTS        32       /* Последние срабатывания */
+#define SUPERVISE_MOVES         16       /* Последние движения */
+
+/* Нарушения (битовая маска) */
+#define SUPERVISE_FOLLOWING     0x01
+#define SUPERVISE_VELOCITY      0x02
+#define SUPERVISE_POSITION      0x04
+
+typedef enum {
+    SUPERVISE_QUICK_STOP = 0,
+    SUPERVISE_HALT,
+    SUPERVISE_EVENT_ONLY
+} supervise_reaction_t;
+
+/* Где в PDO лежат объекты оси (смещения в байтах) */
+typedef struct {
+    const uint8_t *inputs;
+    uint8_t *outputs;
+    uint16_t statusword;         /* 0x6041 */
+    uint16_t actual_position;    /* 0x6064 */
+    uint16_t actual_velocity;    /* 0x606C */
+    uint16_t control_word;       /* 0x6040 */
+    uint16_t target_position;    /* 0x607A */
+} supervise_pdo_t;
+
+/* Срабатывание */
+typedef struct {
+    uint64_t cycle;
+    uint16_t slave;
+    uint8_t violation;           /* SUPERVISE_* */
+    int32_t value;               /* Ошибка, скорость (единицы привода) или положение */
+    int32_t limit;
+} supervise_event_t;
+
+/* Завершенное движение */
+typedef struct {
+    uint16_t slave;
+    uint64_t start_cycle;
+    uint32_t cycles;
+    int32_t distance;            /* Изменение задания */
+    int32_t max_following;
+} supervise_move_t;
+
+/* Снимок оси */
+typedef struct {
+    uint16_t slave;
+    uint32_t follow_window;      /* 0 - выключено */
+    uint32_t velocity_limit;     /* Единицы привода 0x606C, 0 - выключено */
+    bool position_limits;
+    int32_t position_min;
+    int32_t position_max;
+    supervise_reaction_t reaction;
+    uint8_t latched;             /* Нарушения с последнего reset */
+    int32_t following;           /* Текущая ошибка */
+    int32_t max_following;       /* За все время */
+    uint32_t moves;
+    uint32_t trips;
+} supervise_axis_info_t;
+
+/**
+ * Подключить ось (повторный вызов - уже подключена, true)
+ */
+bool supervise_attach(uint16_t slave, const supervise_pdo_t *pdo);
+void supervise_detach(uint16_t slave);
+void supervise_detach_all(void);
+int supervise_axes(void);
+
+bool supervise_set_following(uint16_t slave, uint32_t window);
+/**
+ * Предел |0x606C|
+ *
+ * @param vel скорость оси в миллионных долях (AXIS_UNITS_MICRO), 0 - выключено
+ */
+bool supervise_set_velocity(uint16_t slave, int64_t vel);
+bool supervise_set_position(uint16_t slave, bool enabled, int32_t min, int32_t max);
+bool supervise_set_reaction(uint16_t slave, supervise_reaction_t reaction);
+
+/**
+ * Снять зафиксированную реакцию
+ */
+bool supervise_reset(uint16_t slave);
+
+/**
+ * Один цикл всех осей (циклический поток)
+ *
+ * @param inputs_ok false - кадр потерян или WKC не сошелся: проверки
+ *                  пропускаются, зафиксированные реакции пишутся все равно
+ */
+void supervise_cycle(bool inputs_ok);
+
+/**
+ * Срабатываний с подключения
+ */
+uint64_t supervise_trips(void);
+
+bool supervise_info(uint16_t slave, supervise_axis_info_t *info);
+void supervise_print(void);
+
+#endif /* SUPERVISE_H */
@@ -0,0 +1,378 @@
+/*
+ * timebase.c - Дешевые метки времени для горячего пути
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "timebase.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if !defined(_WIN32) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#include <cpuid.h>
+#define TB_HAVE_TSC 1
+#endif
+
+/* ns = base_ns + (ticks - base_ticks) * mult >> shift */
+typedef struct {
+    uint64_t base_ticks;
+    int64_t base_ns;
+    uint64_t mult;
+    uint32_t shift;
+} tb_params_t;
+
+static timebase_source_t tb_src = TIMEBASE_CLOCK;
+static tb_params_t tb_params = { 0, 0, 1, 0 };
+#ifndef _WIN32
+static uint32_t tb_seq;                   /* seqlock для tb_params */
+#endif
+static double tb_freq_hz = 1e9;
+
+/* Начало длинного окна калибровки и расписание уточнений */
+static uint64_t tb_anchor_ticks;
+static int64_t tb_anchor_ns;
+static uint64_t tb_recal_interval;
+static uint64_t tb_next_recal;
+static uint32_t tb_recal_busy;
+static uint64_t tb_recal_count;
+static int64_t tb_last_error_ns;
+static int64_t tb_max_error_ns;
+
+/* Виртуальное время симуляции: продвигает движок циклов, не часы хоста */
+static volatile bool tb_virtual = false;
+static volatile int64_t tb_virtual_ns;
+
+/**
+ * Эталонное время: CLOCK_MONOTONIC (Linux) или QPC (Windows)
+ */
+static int64_t tb_clock_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    int64_t sec = now.QuadPart / freq.QuadPart;
+    int64_t rem = now.QuadPart % freq.QuadPart;
+    return sec * 1000000000LL + rem * 1000000000LL / freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+static uint64_t tb_read_ticks(timebase_source_t src) {
+    switch (src) {
+#ifdef TB_HAVE_TSC
+    case TIMEBASE_TSC:
+        return __rdtsc();
+#endif
+#ifdef _WIN32
+    case TIMEBASE_QPC: {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        return (uint64_t)now.QuadPart;
+    }
+#endif
+    default:
+        return (uint64_t)tb_clock_ns();
+    }
+}
+
+static uint64_t tb_scale(const tb_params_t *p, uint64_t ticks) {
+    uint64_t mask = ((uint64_t)1 << p->shift) - 1;
+    /* Старшая и младшая части отдельно: произведение не переполняет 64 бита */
+    return (ticks >> p->shift) * p->mult + (((ticks & mask) * p->mult) >> p->shift);
+}
+
+/**
+ * Множитель и сдвиг для частоты: наибольший сдвиг, при котором mult < 2^32
+ */
+static void tb_set_scale(tb_params_t *p, double freq_hz) {
+    uint32_t shift = 32;
+    double mult = 1e9 * 4294967296.0 / freq_hz;
+
+    while (shift > 0 && mult >= 4294967296.0) {
+        shift--;
+        mult /= 2.0;
+    }
+    p->mult = (uint64_t)(mult + 0.5);
+    p->shift = shift;
+}
+
+#ifdef _WIN32
+
+/* Параметры QPC задаются один раз в timebase_init() и больше не меняются */
+static void tb_load(tb_params_t *out) {
+    *out = tb_params;
+}
+
+static void tb_store(const tb_params_t *p) {
+    tb_params = *p;
+}
+
+#else
+
+static void tb_load(tb_params_t *out) {
+    uint32_t s1, s2;
+    do {
+        s1 = __atomic_load_n(&tb_seq, __ATOMIC_ACQUIRE);
+        *out = tb_params;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        s2 = __atomic_load_n(&tb_seq, __ATOMIC_RELAXED);
+    } while ((s1 & 1) || s1 != s2);
+}
+
+static void tb_store(const tb_params_t *p) {
+    __atomic_store_n(&tb_seq, tb_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    tb_params = *p;
+    __atomic_store_n(&tb_seq, tb_seq + 1, __ATOMIC_RELEASE);
+}
+
+#endif /* _WIN32 */
+
+#ifdef TB_HAVE_TSC
+
+static bool tb_has_invariant_tsc(void) {
+    unsigned int a, b, c, d;
+
+    if (!__get_cpuid(0x80000000, &a, &b, &c, &d) || a < 0x80000007) {
+        return false;
+    }
+    __get_cpuid(0x80000007, &a, &b, &c, &d);
+    return (d & (1u << 8)) != 0;
+}
+
+/**
+ * Пара (TSC, CLOCK_MONOTONIC) с минимальным окном между чтениями
+ */
+static void tb_sample_pair(uint64_t *ticks, int64_t *ns) {
+    uint64_t best = UINT64_MAX;
+
+    for (int i = 0; i < 8; i++) {
+        uint64_t t0 = __rdtsc();
+        int64_t n = tb_clock_ns();
+        uint64_t t1 = __rdtsc();
+        if (t1 - t0 < best) {
+            best = t1 - t0;
+            *ticks = t0 + (t1 - t0) / 2;
+            *ns = n;
+        }
+    }
+}
+
+#endif /* TB_HAVE_TSC */
+
+timebase_source_t timebase_init(void) {
+    tb_params_t p = { 0, 0, 1, 0 };
+
+#ifdef _WIN32
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    tb_freq_hz = (double)freq.QuadPart;
+    tb_set_scale(&p, tb_freq_hz);
+    tb_store(&p);
+    tb_src = TIMEBASE_QPC;
+#elif defined(TB_HAVE_TSC)
+    if (tb_has_invariant_tsc()) {
+        struct timespec pause = { 0, TIMEBASE_CALIBRATION_MS * 1000000L };
+        uint64_t t1;
+        int64_t n1;
+
+        tb_sample_pair(&tb_anchor_ticks, &tb_anchor_ns);
+        nanosleep(&pause, NULL);
+        tb_sample_pair(&t1, &n1);
+
+        tb_freq_hz = (double)(t1 - tb_anchor_ticks) * 1e9 / (double)(n1 - tb_anchor_ns);
+        p.base_ticks = t1;
+        p.base_ns = n1;
+        tb_set_scale(&p, tb_freq_hz);
+        tb_store(&p);
+
+        tb_recal_interval = (uint64_t)(tb_freq_hz * TIMEBASE_RECAL_INTERVAL_MS / 1000.0);
+        __atomic_store_n(&tb_next_recal, t1 + tb_recal_interval, __ATOMIC_RELAXED);
+        __atomic_store_n(&tb_src, TIMEBASE_TSC, __ATOMIC_RELEASE);
+    }
+#endif
+
+    return tb_src;
+}
+
+timebase_source_t timebase_source(void) {
+    return tb_src;
+}
+
+const char *timebase_source_name(timebase_source_t src) {
+    switch (src) {
+        case TIMEBASE_TSC: return "TSC (invariant, calibrated)";
+        case TIMEBASE_QPC: return "QueryPerformanceCounter";
+        default:           return "clock_gettime(CLOCK_MONOTONIC)";
+    }
+}
+
+uint64_t timebase_ticks(void) {
+    return tb_read_ticks(tb_src);
+}
+
+uint64_t timebase_ticks_to_ns(uint64_t ticks) {
+    tb_params_t p;
+    tb_load(&p);
+    return tb_scale(&p, ticks);
+}
+
+int64_t timebase_now_ns(void) {
+    if (tb_virtual) {
+        return tb_virtual_ns;
+    }
+
+    tb_params_t p;
+    tb_load(&p);
+    uint64_t t = tb_read_ticks(tb_src);
+
+    if (t >= p.base_ticks) {
+        return p.base_ns + (int64_t)tb_scale(&p, t - p.base_ticks);
+    }
+    return p.base_ns - (int64_t)tb_scale(&p, p.base_ticks - t);
+}
+
+void timebase_set_virtual(bool on) {
+    if (on && !tb_virtual) {
+        /* Продолжение шкалы с текущего момента: дедлайны остаются в прошлом/будущем */
+        tb_virtual_ns = timebase_now_ns();
+    }
+    tb_virtual = on;
+}
+
+bool timebase_virtual(void) {
+    return tb_virtual;
+}
+
+void timebase_virtual_set(int64_t ns) {
+    if (ns > tb_virtual_ns) {
+        tb_virtual_ns = ns;
+    }
+}
+
+void timebase_maintain(void) {
+#ifdef TB_HAVE_TSC
+    if (tb_src != TIMEBASE_TSC) {
+        return;
+    }
+    if (__rdtsc() < __atomic_load_n(&tb_next_recal, __ATOMIC_RELAXED)) {
+        return;
+    }
+    /* Пересчитывает только один поток */
+    if (__atomic_exchange_n(&tb_recal_busy, 1, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    tb_params_t p;
+    uint64_t t;
+    int64_t n;
+
+    tb_load(&p);
+    tb_sample_pair(&t, &n);
+
+    int64_t now = p.base_ns + (int64_t)tb_scale(&p, t - p.base_ticks);
+    int64_t err = now - n;
+    tb_last_error_ns = err;
+    if (llabs(err) > tb_max_error_ns) {
+        tb_max_error_ns = llabs(err);
+    }
+
+    /* Частота по всему окну с момента старта: погрешность чтения размывается */
+    tb_freq_hz = (double)(t - tb_anchor_ticks) * 1e9 / (double)(n - tb_anchor_ns);
+
+    /*
+     * Шкала не перескакивает на эталон, а продолжается с текущего значения:
+     * ошибка сливается за следующий интервал наклоном не более
+     * TIMEBASE_MAX_SLEW_PPM, так что время не идет назад и не прыгает
+     */
+    double slew = -(double)err / (TIMEBASE_RECAL_INTERVAL_MS * 1e6);
+    if (slew > TIMEBASE_MAX_SLEW_PPM * 1e-6) {
+        slew = TIMEBASE_MAX_SLEW_PPM * 1e-6;
+    } else if (slew < -TIMEBASE_MAX_SLEW_PPM * 1e-6) {
+        slew = -TIMEBASE_MAX_SLEW_PPM * 1e-6;
+    }
+    p.base_ticks = t;
+    p.base_ns = now;
+    tb_set_scale(&p, tb_freq_hz / (1.0 + slew));
+    tb_store(&p);
+
+    tb_recal_count++;
+    __atomic_store_n(&tb_next_recal, t + tb_recal_interval, __ATOMIC_RELAXED);
+    __atomic_store_n(&tb_recal_busy, 0, __ATOMIC_RELEASE);
+#endif
+}
+
+void timebase_print(void) {
+    tb_params_t p;
+    tb_load(&p);
+
+    if (tb_virtual) {
+        printf("Clock:             virtual (simulation), now %.6f s\n", tb_virtual_ns / 1e9);
+    }
+    printf("Source:            %s\n", timebase_source_name(tb_src));
+    printf("Frequency:         %.6f MHz\n", tb_freq_hz / 1e6);
+    printf("Scale:             mult %llu, shift %u\n", (unsigned long long)p.mult, p.shift);
+    if (tb_src == TIMEBASE_TSC) {
+        printf("Recalibrations:    %llu (every %d ms), last error %lld ns, max %lld ns\n",
+               (unsigned long long)tb_recal_count, TIMEBASE_RECAL_INTERVAL_MS,
+               (long long)tb_last_error_ns, (long long)tb_max_error_ns);
+    }
+}
+
+void timebase_bench(int iterations) {
+    volatile uint64_t sink = 0;
+    int64_t t0, t1;
+
+    if (iterations <= 0) {
+        iterations = TIMEBASE_BENCH_DEFAULT_ITERATIONS;
+    }
+
+    printf("Cost per call (%d iterations):\n", iterations);
+
+    t0 = tb_clock_ns();
+    for (int i = 0; i < iterations; i++) {
+        sink += timebase_ticks();
+    }
+    t1 = tb_clock_ns();
+    printf("  timebase_ticks():        %6.1f ns\n", (double)(t1 - t0) / iterations);
+
+    t0 = tb_clock_ns();
+    for (int i = 0; i < iterations; i++) {
+        sink += (uint64_t)timebase_now_ns();
+    }
+    t1 = tb_clock_ns();
+    printf("  timebase_now_ns():       %6.1f ns\n", (double)(t1 - t0) / iterations);
+
+    t0 = tb_clock_ns();
+    for (int i = 0; i < iterations; i++) {
+        sink += (uint64_t)tb_clock_ns();
+    }
+    t1 = tb_clock_ns();
+#ifdef _WIN32
+    printf("  QueryPerformanceCounter: %6.1f ns\n", (double)(t1 - t0) / iterations);
+#else
+    printf("  clock_gettime(MONOTONIC):%6.1f ns\n", (double)(t1 - t0) / iterations);
+#endif
+
+    /* Согласованность шкал: timebase против середины двух чтений эталона */
+    if (tb_virtual) {
+        (void)sink;
+        return;
+    }
+    int64_t r0 = tb_clock_ns();
+    int64_t now = timebase_now_ns();
+    int64_t r1 = tb_clock_ns();
+    int64_t diff = now - (r0 + (r1 - r0) / 2);
+    printf("  timebase vs reference:   %+lld ns\n", (long long)diff);
+    (void)sink;
+}
@@ -0,0 +1,87 @@
+/*
+ * timebase.h - Дешевые метки времени для горячего пути
+ *
+ * На x86 с invariant TSC (CPUID 0x80000007 EDX[8]) метка времени - это
+ * rdtsc, пересчитанный в наносекунды умножением и сдвигом. Частота TSC
+ * калибруется по CLOCK_MONOTONIC при старте и уточняется по все более
+ * длинному окну в timebase_maintain(), так что timebase_now_ns() остается
+ * в шкале CLOCK_MONOTONIC. Расхождение с эталоном убирается подстройкой
+ * наклона (slew), а не шагом, поэтому время монотонно, но может отставать
+ * или опережать CLOCK_MONOTONIC на величину последней ошибки калибровки.
+ *
+ * Без invariant TSC используется clock_gettime(CLOCK_MONOTONIC),
+ * на Windows - QueryPerformanceCounter.
+ */
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TIMEBASE_CALIBRATION_MS   20
+#define TIMEBASE_RECAL_INTERVAL_MS 1000
+#define TIMEBASE_MAX_SLEW_PPM     500
+#define TIMEBASE_BENCH_DEFAULT_ITERATIONS 1000000
+
+typedef enum {
+    TIMEBASE_CLOCK = 0,        /* clock_gettime(CLOCK_MONOTONIC) */
+    TIMEBASE_TSC,              /* rdtsc + калибровка */
+    TIMEBASE_QPC               /* QueryPerformanceCounter */
+} timebase_source_t;
+
+/**
+ * Выбор источника и начальная калибровка (~TIMEBASE_CALIBRATION_MS).
+ * До вызова timebase_now_ns() работает через clock_gettime.
+ */
+timebase_source_t timebase_init(void);
+
+timebase_source_t timebase_source(void);
+const char *timebase_source_name(timebase_source_t src);
+
+/**
+ * Сырые тики источника (для интервалов в горячем пути)
+ */
+uint64_t timebase_ticks(void);
+
+/**
+ * Перевод интервала в тиках в наносекунды
+ */
+uint64_t timebase_ticks_to_ns(uint64_t ticks);
+
+/**
+ * Монотонное время в наносекундах в шкале CLOCK_MONOTONIC
+ */
+int64_t timebase_now_ns(void);
+
+/**
+ * Виртуальное время для симуляции шины: timebase_now_ns() возвращает
+ * значение, заданное timebase_virtual_set(), и не зависит от часов хоста.
+ * Включение продолжает шкалу с текущего момента.
+ */
+void timebase_set_virtual(bool on);
+bool timebase_virtual(void);
+
+/**
+ * Продвинуть виртуальное время (только вперед)
+ */
+void timebase_virtual_set(int64_t ns);
+
+/**
+ * Уточнение калибровки раз в TIMEBASE_RECAL_INTERVAL_MS. Дешево между
+ * пересчетами (одно чтение тиков); можно вызывать из циклического потока.
+ * Ошибка сливается за следующий интервал (не более TIMEBASE_MAX_SLEW_PPM).
+ */
+void timebase_maintain(void);
+
+/**
+ * Источник, частота и погрешность калибровки
+ */
+void timebase_print(void);
+
+/**
+ * Сравнение стоимости вызова timebase и clock_gettime
+ */
+void timebase_bench(int iterations);
+
+#endif /* TIMEBASE_H */
@@ -0,0 +1,407 @@
+/*
+ * tune.c - Снятие переходной и частотной характеристики привода
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tune.h"
+#include "axis_units.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef enum {
+    TUNE_STEP = 0,
+    TUNE_CHIRP
+} tune_kind_t;
+
+/* Настройка записи (пишется потоком CLI до запуска) */
+static tune_kind_t tn_kind;
+static uint16_t tn_slave;
+static tune_pdo_t tn_pdo;
+static uint32_t tn_period_us;
+static double tn_inc_per_vel;            /* Отсчетов за минуту на единицу скорости */
+static uint32_t tn_samples;
+static uint32_t tn_pretrigger;
+static double tn_amplitude;              /* Единицы скорости оси */
+static double tn_f0, tn_f1;
+
+/* Состояние записи (циклический поток) */
+static volatile int tn_state = TUNE_IDLE;
+static volatile bool tn_abort_req = false;
+static uint32_t tn_count;
+static double tn_cmd;                    /* Задание, ушедшее в текущем кадре */
+static int32_t tn_pos0;
+static double tn_tpos;                   /* Интеграл задания скорости, отсчеты */
+
+/* Записи */
+static double tn_tvel[TUNE_MAX_SAMPLES];  /* Единицы скорости оси */
+static double tn_avel[TUNE_MAX_SAMPLES];
+static int32_t tn_tpos_buf[TUNE_MAX_SAMPLES];
+static int32_t tn_apos[TUNE_MAX_SAMPLES];
+
+/* Рабочие массивы БПФ: задание и факт */
+static double tn_xr[TUNE_MAX_SAMPLES], tn_xi[TUNE_MAX_SAMPLES];
+static double tn_yr[TUNE_MAX_SAMPLES], tn_yi[TUNE_MAX_SAMPLES];
+static uint32_t tn_fft_n;
+
+/* Задание в единицах оси -> 0x60FF в единицах привода */
+static void tn_write_velocity(double vel) {
+    int32_t drive = axis_units_drive_from_vel(tn_slave, llround(vel * AXIS_UNITS_MICRO));
+    memcpy(tn_pdo.outputs + tn_pdo.target_velocity, &drive, sizeof(drive));
+}
+
+static int32_t tn_rd32(const uint8_t *p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static bool tn_start(uint16_t slave, const tune_pdo_t *pdo, uint32_t period_us,
+                     uint32_t counts_per_rev, uint32_t samples) {
+    axis_units_info_t ai;
+
+    if (tn_state == TUNE_RUNNING || period_us == 0 || counts_per_rev == 0 ||
+        samples < 16 || samples > TUNE_MAX_SAMPLES || !axis_units_info(slave, &ai)) {
+        return false;
+    }
+    tn_slave = slave;
+    tn_pdo = *pdo;
+    tn_period_us = period_us;
+    /* Скорость оси - об/мин мотора или единицы/мин */
+    tn_inc_per_vel = ai.user ? counts_per_rev / ai.units_per_rev : counts_per_rev;
+    tn_samples = samples;
+    tn_count = 0;
+    tn_cmd = 0.0;
+    tn_tpos = 0.0;
+    tn_abort_req = false;
+    tn_fft_n = 0;
+    tn_write_velocity(0.0);
+    return true;
+}
+
+bool tune_start_step(uint16_t slave, const tune_pdo_t *pdo, uint32_t period_us,
+                     uint32_t counts_per_rev, int64_t amplitude, uint32_t samples) {
+    if (amplitude == 0 || !tn_start(slave, pdo, period_us, counts_per_rev, samples)) {
+        return false;
+    }
+    tn_kind = TUNE_STEP;
+    tn_amplitude = amplitude / (double)AXIS_UNITS_MICRO;
+    tn_pretrigger = samples * TUNE_PRETRIGGER_PERCENT / 100;
+    tn_state = TUNE_RUNNING;
+    return true;
+}
+
+bool tune_start_chirp(uint16_t slave, const tune_pdo_t *pdo, uint32_t period_us,
+                      uint32_t counts_per_rev, double f0, double f1, int64_t amplitude,
+                      uint32_t samples) {
+    double nyquist = 0.5e6 / period_us;
+
+    if (amplitude == 0 || f0 <= 0.0 || f1 <= f0 || f1 >= nyquist ||
+        !tn_start(slave, pdo, period_us, counts_per_rev, samples)) {
+        return false;
+    }
+    tn_kind = TUNE_CHIRP;
+    tn_amplitude = amplitude / (double)AXIS_UNITS_MICRO;
+    tn_f0 = f0;
+    tn_f1 = f1;
+    tn_pretrigger = 0;
+    tn_state = TUNE_RUNNING;
+    return true;
+}
+
+tune_state_t tune_state(void) {
+    return (tune_state_t)tn_state;
+}
+
+void tune_abort(void) {
+    if (tn_state == TUNE_RUNNING) {
+        tn_abort_req = true;
+    }
+}
+
+/* ============================================================================
+ * Цикл (циклический поток)
+ * ============================================================================ */
+
+void tune_cycle(void) {
+    if (tn_state != TUNE_RUNNING) {
+        return;
+    }
+
+    uint16_t sw;
+    memcpy(&sw, tn_pdo.inputs + tn_pdo.statusword, sizeof(sw));
+    if ((sw & 0x6F) != 0x27 || tn_abort_req) {
+        tn_cmd = 0.0;
+        tn_write_velocity(0.0);
+        tn_state = TUNE_ABORTED;
+        return;
+    }
+
+    /* Образец: задание этого кадра и принятый ответ */
+    uint32_t i = tn_count;
+    double t = tn_period_us / 1e6;
+    tn_apos[i] = tn_rd32(tn_pdo.inputs + tn_pdo.actual_position);
+    tn_avel[i] = axis_units_vel_from_drive(tn_slave, tn_rd32(tn_pdo.inputs + tn_pdo.actual_velocity)) /
+                 (double)AXIS_UNITS_MICRO;
+    if (i == 0) {
+        tn_pos0 = tn_apos[0];
+    }
+    tn_tvel[i] = tn_cmd;
+    tn_tpos_buf[i] = tn_pos0 + (int32_t)lround(tn_tpos);
+    tn_tpos += tn_cmd * (tn_inc_per_vel / 60.0) * t;
+    tn_count = ++i;
+
+    if (i >= tn_samples) {
+        tn_cmd = 0.0;
+        tn_write_velocity(0.0);
+        tn_state = TUNE_DONE;
+        return;
+    }
+
+    /* Задание следующего кадра */
+    if (tn_kind == TUNE_STEP) {
+        tn_cmd = i >= tn_pretrigger ? tn_amplitude : 0;
+    } else {
+        double ts = i * t;
+        double span = tn_samples * t;
+        double phase = 2.0 * M_PI * (tn_f0 * ts + (tn_f1 - tn_f0) * ts * ts / (2.0 * span));
+        tn_cmd = tn_amplitude * sin(phase);
+    }
+    tn_write_velocity(tn_cmd);
+}
+
+/* ============================================================================
+ * Анализ (поток CLI)
+ * ============================================================================ */
+
+/**
+ * Комплексное БПФ по месту (radix-2, n - степень двойки)
+ */
+static void tn_fft(double *re, double *im, uint32_t n) {
+    for (uint32_t i = 1, j = 0; i < n; i++) {
+        uint32_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            double tr = re[i], ti = im[i];
+            re[i] = re[j];
+            im[i] = im[j];
+            re[j] = tr;
+            im[j] = ti;
+        }
+    }
+
+    for (uint32_t len = 2; len <= n; len <<= 1) {
+        double ang = -2.0 * M_PI / len;
+        double wr = cos(ang), wi = sin(ang);
+        for (uint32_t i = 0; i < n; i += len) {
+            double cr = 1.0, ci = 0.0;
+            for (uint32_t k = 0; k < len / 2; k++) {
+                uint32_t a = i + k, b = i + k + len / 2;
+                double vr = re[b] * cr - im[b] * ci;
+                double vi = re[b] * ci + im[b] * cr;
+                re[b] = re[a] - vr;
+                im[b] = im[a] - vi;
+                re[a] += vr;
+                im[a] += vi;
+                double nr = cr * wr - ci * wi;
+                ci = cr * wi + ci * wr;
+                cr = nr;
+            }
+        }
+    }
+}
+
+/**
+ * Спектры задания и факта скорости (среднее убрано, дополнение нулями)
+ */
+static void tn_spectra(void) {
+    uint32_t n = 1;
+    double mx = 0.0, my = 0.0;
+
+    while (n < tn_count) {
+        n <<= 1;
+    }
+    for (uint32_t i = 0; i < tn_count; i++) {
+        mx += tn_tvel[i];
+        my += tn_avel[i];
+    }
+    mx /= tn_count;
+    my /= tn_count;
+
+    for (uint32_t i = 0; i < n; i++) {
+        tn_xr[i] = i < tn_count ? tn_tvel[i] - mx : 0.0;
+        tn_yr[i] = i < tn_count ? tn_avel[i] - my : 0.0;
+        tn_xi[i] = 0.0;
+        tn_yi[i] = 0.0;
+    }
+    tn_fft(tn_xr, tn_xi, n);
+    tn_fft(tn_yr, tn_yi, n);
+    tn_fft_n = n;
+}
+
+/**
+ * H(f) = Sxy / Sxx по бинам полосы [f_lo, f_hi]
+ */
+static bool tn_response(double f_lo, double f_hi, double *gain_db, double *phase_deg) {
+    double df = 1e6 / tn_period_us / tn_fft_n;
+    uint32_t b0 = (uint32_t)ceil(f_lo / df);
+    uint32_t b1 = (uint32_t)floor(f_hi / df);
+    double sr = 0.0, si = 0.0, sxx = 0.0;
+
+    if (b1 < b0) {
+        b1 = b0;                         /* Полоса уже бина: ближайший бин */
+    }
+    for (uint32_t k = b0; k <= b1 && k < tn_fft_n / 2; k++) {
+        /* Y * conj(X) */
+        sr += tn_yr[k] * tn_xr[k] + tn_yi[k] * tn_xi[k];
+        si += tn_yi[k] * tn_xr[k] - tn_yr[k] * tn_xi[k];
+        sxx += tn_xr[k] * tn_xr[k] + tn_xi[k] * tn_xi[k];
+    }
+    if (sxx <= 0.0) {
+        return false;
+    }
+    sr /= sxx;
+    si /= sxx;
+    *gain_db = 20.0 * log10(fmax(sqrt(sr * sr + si * si), 1e-9));
+    *phase_deg = atan2(si, sr) * 180.0 / M_PI;
+    return true;
+}
+
+static void tn_print_step(void) {
+    double t = tn_period_us / 1e3;       /* мс на образец */
+    uint32_t pre = tn_pretrigger;
+    uint32_t tail = tn_count / 10;
+    double base = 0.0, final = 0.0;
+    int32_t follow_max = 0;
+
+    for (uint32_t i = 0; i < pre; i++) {
+        base += tn_avel[i];
+    }
+    base = pre ? base / pre : 0.0;
+    for (uint32_t i = tn_count - tail; i < tn_count; i++) {
+        final += tn_avel[i];
+    }
+    final /= tail;
+    for (uint32_t i = 0; i < tn_count; i++) {
+        int32_t e = abs(tn_tpos_buf[i] - tn_apos[i]);
+        follow_max = e > follow_max ? e : follow_max;
+    }
+
+    const char *unit = axis_units_vel_name(tn_slave);
+    printf("Step:              0 -> %g %s at %.1f ms\n", tn_amplitude, unit, pre * t);
+    double delta = final - base;
+    if (fabs(delta) < fabs(tn_amplitude) * 0.01) {
+        printf("Response:          none (velocity stayed at %.1f %s)\n", final, unit);
+        return;
+    }
+
+    /* Нормированный ответ: 0 - до ступени, 1 - установившееся значение */
+    int64_t t10 = -1, t90 = -1, settle = pre;
+    double peak = 0.0;
+    for (uint32_t i = pre; i < tn_count; i++) {
+        double r = (tn_avel[i] - base) / delta;
+        if (t10 < 0 && r >= 0.1) t10 = i;
+        if (t90 < 0 && r >= 0.9) t90 = i;
+        if (r > peak) peak = r;
+        if (fabs(r - 1.0) > 0.02) settle = i + 1;
+    }
+
+    printf("Final velocity:    %.1f %s (steady-state error %.1f %s, %.1f%%)\n",
+           final, unit, tn_amplitude - final, unit, 100.0 * (tn_amplitude - final) / tn_amplitude);
+    if (t10 >= 0) {
+        printf("Dead time:         %.1f ms (to 10%%)\n", (t10 - pre) * t);
+    }
+    if (t10 >= 0 && t90 >= 0) {
+        printf("Rise time:         %.1f ms (10-90%%)\n", (t90 - t10) * t);
+    } else {
+        printf("Rise time:         not reached 90%% within the record\n");
+    }
+    printf("Overshoot:         %.1f%%\n", peak > 1.0 ? (peak - 1.0) * 100.0 : 0.0);
+    if (settle < (int64_t)tn_count) {
+        printf("Settling time:     %.1f ms (2%% band)\n", (settle - pre) * t);
+    } else {
+        printf("Settling time:     not settled within the record\n");
+    }
+    printf("Following error:   max %d counts (target position = integral of target velocity)\n",
+           follow_max);
+}
+
+static void tn_print_chirp(void) {
+    double ratio = pow(tn_f1 / tn_f0, 1.0 / (TUNE_RESPONSE_POINTS - 1));
+    double half = sqrt(ratio);
+    double ref_db = 0.0, gain, phase;
+    bool have_ref = false;
+
+    tn_spectra();
+    printf("Chirp:             %.2f -> %.2f Hz, %g %s, FFT %u points (%.3f Hz bins)\n",
+           tn_f0, tn_f1, tn_amplitude, axis_units_vel_name(tn_slave), tn_fft_n, 1e6 / tn_period_us / tn_fft_n);
+    printf("  Freq(Hz)   Gain(dB)   Phase(deg)\n");
+    for (int p = 0; p < TUNE_RESPONSE_POINTS; p++) {
+        double f = tn_f0 * pow(ratio, p);
+        if (!tn_response(f / half, f * half, &gain, &phase)) {
+            continue;
+        }
+        if (!have_ref) {
+            ref_db = gain;
+            have_ref = true;
+        }
+        printf("  %8.2f   %8.2f   %10.1f\n", f, gain, phase);
+    }
+
+    /* Полоса: первая точка мелкой сетки на 3 дБ ниже начального уровня */
+    const int fine = 200;
+    double fine_ratio = pow(tn_f1 / tn_f0, 1.0 / (fine - 1));
+    double fine_half = sqrt(fine_ratio);
+    for (int p = 0; have_ref && p < fine; p++) {
+        double f = tn_f0 * pow(fine_ratio, p);
+        if (tn_response(f / fine_half, f * fine_half, &gain, &phase) && gain < ref_db - 3.0) {
+            printf("Bandwidth (-3 dB): %.2f Hz (phase %.0f deg)\n", f, phase);
+            return;
+        }
+    }
+    printf("Bandwidth (-3 dB): above %.2f Hz\n", tn_f1);
+}
+
+void tune_print_result(void) {
+    if (tn_state == TUNE_IDLE || tn_state == TUNE_RUNNING) {
+        printf("No finished tuning record\n");
+        return;
+    }
+
+    printf("\n=== Tuning Result (Slave %u) ===\n", tn_slave);
+    printf("Record:            %u samples at %u us (%.3f s)%s\n", tn_count, tn_period_us,
+           tn_count * tn_period_us / 1e6, tn_state == TUNE_ABORTED ? ", ABORTED" : "");
+    if (tn_count < 16) {
+        printf("Too few samples for analysis\n\n");
+        return;
+    }
+    if (tn_kind == TUNE_STEP) {
+        tn_print_step();
+    } else {
+        tn_print_chirp();
+    }
+    printf("\n");
+}
+
+bool tune_save_csv(const char *path) {
+    FILE *f;
+
+    if (tn_state == TUNE_IDLE || tn_state == TUNE_RUNNING || !(f = fopen(path, "w"))) {
+        return false;
+    }
+    fprintf(f, "time_s,target_position,actual_position,target_velocity,actual_velocity\n");
+    for (uint32_t i = 0; i < tn_count; i++) {
+        fprintf(f, "%.6f,%d,%d,%.3f,%.3f\n", i * tn_period_us / 1e6,
+                tn_tpos_buf[i], tn_apos[i], tn_tvel[i], tn_avel[i]);
+    }
+    fclose(f);
+    return true;
+}
@@ -0,0 +1,90 @@
+/*
+ * tune.h - Снятие переходной и частотной характеристики привода
+ *
+ * Возбуждение подается из циклического потока в Target Velocity (0x60FF)
+ * каждый цикл: ступень (tune-step) или синус с линейно растущей частотой
+ * f0 -> f1 (tune-chirp). В тот же цикл по принятым входам записываются
+ * задание и факт положения и скорости. Буферы выделены статически на
+ * TUNE_MAX_SAMPLES циклов, в цикле нет выделения памяти и вывода.
+ *
+ * Обработка после записи, в потоке CLI: для ступени - время нарастания
+ * 10-90%, перерегулирование, время установления 2% и статическая ошибка;
+ * для chirp - БПФ задания и факта, H(f) = Y(f) / X(f) в логарифмически
+ * расставленных точках диапазона и полоса по уровню -3 дБ.
+ *
+ * Скорость - в единицах оси (axis_units: об/мин или единицы/мин): задание
+ * пересчитывается в единицы привода 0x60FF, факт 0x606C - обратно.
+ *
+ * Запись прерывается, если привод выходит из Operation Enabled.
+ */
+
+#ifndef TUNE_H
+#define TUNE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TUNE_MAX_SAMPLES            16384    /* Степень двойки: размер БПФ */
+#define TUNE_DEFAULT_STEP_VEL       100      /* Единицы скорости оси */
+#define TUNE_DEFAULT_STEP_MS        500
+#define TUNE_DEFAULT_CHIRP_VEL      50
+#define TUNE_PRETRIGGER_PERCENT     10       /* Доля записи до ступени */
+#define TUNE_RESPONSE_POINTS        12       /* Точек частотной характеристики */
+
+typedef enum {
+    TUNE_IDLE = 0,
+    TUNE_RUNNING,
+    TUNE_DONE,
+    TUNE_ABORTED
+} tune_state_t;
+
+/* Где в PDO лежат объекты оси (смещения в байтах) */
+typedef struct {
+    const uint8_t *inputs;
+    uint8_t *outputs;
+    uint16_t statusword;         /* 0x6041 */
+    uint16_t actual_position;    /* 0x6064 */
+    uint16_t actual_velocity;    /* 0x606C */
+    uint16_t target_velocity;    /* 0x60FF */
+} tune_pdo_t;
+
+/**
+ * Ступень скорости amplitude на samples циклов (с предзаписью нуля)
+ *
+ * @param counts_per_rev разрешение оси (0x608F): задание положения -
+ *                       интеграл задания скорости
+ * @param amplitude      скорость оси в миллионных долях (AXIS_UNITS_MICRO)
+ */
+bool tune_start_step(uint16_t slave, const tune_pdo_t *pdo, uint32_t period_us,
+                     uint32_t counts_per_rev, int64_t amplitude, uint32_t samples);
+
+/**
+ * Синус amplitude с частотой f0 -> f1 Гц на samples циклов
+ */
+bool tune_start_chirp(uint16_t slave, const tune_pdo_t *pdo, uint32_t period_us,
+                      uint32_t counts_per_rev, double f0, double f1, int64_t amplitude,
+                      uint32_t samples);
+
+tune_state_t tune_state(void);
+
+/**
+ * Остановить запись (задание скорости 0 выставит следующий цикл)
+ */
+void tune_abort(void);
+
+/**
+ * Один цикл: запись входов и задание следующего цикла
+ */
+void tune_cycle(void);
+
+/**
+ * Анализ последней записи
+ */
+void tune_print_result(void);
+
+/**
+ * Запись в CSV: время, задание/факт положения и скорости
+ */
+bool tune_save_csv(const char *path);
+
+#endif /* TUNE_H */
@@ -0,0 +1,426 @@
+/*
+ * wkc_diag.c - Поиск slave, из-за которого не сходится WKC группы
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "wkc_diag.h"
+
+/* Заголовок датаграммы без поля длины кадра и WKC */
+#define WD_DATAGRAM_OVERHEAD (EC_HEADERSIZE - EC_ELENGTHSIZE + EC_WKCSIZE)
+#define WD_FRAME_BUDGET      (EC_MAXLRWDATA + WD_DATAGRAM_OVERHEAD)
+#define WD_MAX_DATAGRAMS     (3 * EC_MAXSLAVE)
+
+typedef enum {
+    WD_OUT = 0,                  /* LWR выходов */
+    WD_IN,                       /* LRD входов */
+    WD_AL                        /* FPRD AL Status */
+} wd_kind_t;
+
+/* Одна датаграмма раздельного обмена */
+typedef struct {
+    uint8_t kind;
+    uint8_t frame;
+    uint16_t slave_first;        /* Slaves, чьи данные покрывает датаграмма */
+    uint16_t slave_last;
+    uint8_t expect;              /* Ожидаемый WKC */
+    uint32_t image_offset;
+    uint16_t length;
+    uint16_t rx_offset;          /* Заполняется при сборке кадра */
+} wd_datagram_t;
+
+static ecx_contextt *wd_ctx = NULL;
+static uint8_t wd_group = 0;
+static uint8_t *wd_image = NULL;
+static wd_datagram_t wd_dg[WD_MAX_DATAGRAMS];
+static int wd_ndg = 0;
+static int wd_nframes = 0;
+static uint8 wd_frame_idx[WKC_DIAG_MAX_FRAMES];
+static uint8_t wd_reasons[EC_MAXSLAVE];
+static uint16_t wd_al[EC_MAXSLAVE];
+static uint8 wd_al_data[2];            /* Данные FPRD: ESC их перезаписывает только в кадре */
+static wkc_diag_slave_t wd_slaves[EC_MAXSLAVE];
+
+static bool wd_armed = false;          /* Публикует раскладку циклическому потоку */
+static int wd_window = WKC_DIAG_DEFAULT_WINDOW;
+static int wd_window_left = 0;         /* Только циклический поток (и arm после останова) */
+static bool wd_window_found = false;
+
+/* Счетчики с момента взведения */
+static uint64_t wd_cycles = 0;
+static uint64_t wd_anomalies = 0;
+static uint64_t wd_first_anomaly = 0;
+static uint64_t wd_last_anomaly = 0;
+static int wd_last_wkc = 0;
+static int wd_last_expected = 0;
+static uint64_t wd_investigated = 0;
+static uint64_t wd_lost_frames = 0;
+static uint32_t wd_windows = 0;
+static uint32_t wd_unattributed = 0;
+
+static bool wd_get_armed(void) {
+#ifdef _WIN32
+    return *(const volatile bool *)&wd_armed;   /* Windows: все в одном потоке */
+#else
+    return __atomic_load_n(&wd_armed, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static void wd_set_armed(bool v) {
+#ifdef _WIN32
+    *(volatile bool *)&wd_armed = v;
+#else
+    __atomic_store_n(&wd_armed, v, __ATOMIC_RELEASE);
+#endif
+}
+
+/**
+ * Длина данных slave в байтах (битовые slaves занимают часть байта)
+ */
+static uint16_t wd_data_len(uint32_t bytes, uint16_t bits, uint8_t startbit) {
+    if (bytes > 0) {
+        return (uint16_t)bytes;
+    }
+    return (uint16_t)((startbit + bits + 7) / 8);
+}
+
+/**
+ * Датаграмма для данных slave; пересекающиеся диапазоны образа сливаются
+ */
+static bool wd_plan_add(wd_kind_t kind, uint16_t slave, uint32_t offset, uint16_t length) {
+    if (wd_ndg > 0) {
+        wd_datagram_t *prev = &wd_dg[wd_ndg - 1];
+        if (kind != WD_AL && prev->kind == kind && offset < prev->image_offset + prev->length) {
+            uint32_t end = offset + length;
+            if (end > prev->image_offset + prev->length) {
+                prev->length = (uint16_t)(end - prev->image_offset);
+            }
+            prev->slave_last = slave;
+            prev->expect++;
+            return true;
+        }
+    }
+    if (wd_ndg >= WD_MAX_DATAGRAMS) {
+        return false;
+    }
+
+    wd_datagram_t *d = &wd_dg[wd_ndg++];
+    memset(d, 0, sizeof(*d));
+    d->kind = (uint8_t)kind;
+    d->slave_first = slave;
+    d->slave_last = slave;
+    d->expect = 1;
+    d->image_offset = offset;
+    d->length = length;
+    return true;
+}
+
+/**
+ * Раскладка датаграмм по кадрам
+ */
+static bool wd_plan_frames(void) {
+    int used = 0;
+
+    wd_nframes = 1;
+    for (int i = 0; i < wd_ndg; i++) {
+        int size = wd_dg[i].length + WD_DATAGRAM_OVERHEAD;
+        if (used > 0 && used + size > WD_FRAME_BUDGET) {
+            wd_nframes++;
+            used = 0;
+        }
+        if (wd_nframes > WKC_DIAG_MAX_FRAMES || size > WD_FRAME_BUDGET) {
+            return false;
+        }
+        wd_dg[i].frame = (uint8_t)(wd_nframes - 1);
+        used += size;
+    }
+    return true;
+}
+
+bool wkc_diag_arm(ecx_contextt *ctx, uint8_t group, int window) {
+    ec_groupt *grp = &ctx->grouplist[group];
+    int count = ctx->slavecount < EC_MAXSLAVE ? ctx->slavecount : EC_MAXSLAVE - 1;
+
+    wd_set_armed(false);
+    wd_ctx = ctx;
+    wd_group = group;
+    wd_image = grp->outputs ? grp->outputs : grp->inputs;
+    wd_window = window > 0 ? window : WKC_DIAG_DEFAULT_WINDOW;
+    wd_ndg = 0;
+    if (!wd_image) {
+        return false;
+    }
+
+    /* Образ: сначала выходы всех slaves, затем входы - в порядке slaves */
+    for (int i = 1; i <= count; i++) {
+        ec_slavet *s = &ctx->slavelist[i];
+        if (s->group == group && s->outputs && s->Obits > 0 &&
+            !wd_plan_add(WD_OUT, (uint16_t)i, (uint32_t)(s->outputs - wd_image),
+                         wd_data_len(s->Obytes, s->Obits, s->Ostartbit))) {
+            return false;
+        }
+    }
+    for (int i = 1; i <= count; i++) {
+        ec_slavet *s = &ctx->slavelist[i];
+        if (s->group == group && s->inputs && s->Ibits > 0 &&
+            !wd_plan_add(WD_IN, (uint16_t)i, (uint32_t)(s->inputs - wd_image),
+                         wd_data_len(s->Ibytes, s->Ibits, s->Istartbit))) {
+            return false;
+        }
+    }
+    for (int i = 1; i <= count; i++) {
+        if (ctx->slavelist[i].group == group && !wd_plan_add(WD_AL, (uint16_t)i, 0, 2)) {
+            return false;
+        }
+    }
+
+    if (!wd_plan_frames()) {
+        return false;
+    }
+
+    memset(wd_slaves, 0, sizeof(wd_slaves));
+    wd_cycles = 0;
+    wd_anomalies = 0;
+    wd_first_anomaly = 0;
+    wd_last_anomaly = 0;
+    wd_investigated = 0;
+    wd_lost_frames = 0;
+    wd_windows = 0;
+    wd_unattributed = 0;
+    wd_window_left = 0;
+    wd_set_armed(true);
+    return true;
+}
+
+void wkc_diag_disarm(void) {
+    /* Окно не трогаем: его ведет циклический поток, arm() сбросит */
+    wd_set_armed(false);
+}
+
+bool wkc_diag_armed(void) {
+    return wd_get_armed();
+}
+
+bool wkc_diag_investigating(void) {
+    return wd_get_armed() && wd_window_left > 0;
+}
+
+int wkc_diag_exchange(int timeout_us) {
+    ecx_portt *port = &wd_ctx->port;
+    ec_groupt *grp = &wd_ctx->grouplist[wd_group];
+    bool started[WKC_DIAG_MAX_FRAMES];
+    bool lost = false;
+    int wkc_out = 0;
+    int wkc_in = 0;
+
+    memset(started, 0, sizeof(started));
+
+    /* Сборка кадров: данные выходов берутся из IOmap на этом цикле */
+    for (int i = 0; i < wd_ndg; i++) {
+        wd_datagram_t *d = &wd_dg[i];
+        uint8 idx;
+        uint8 cmd;
+        uint16 adp;
+        uint16 ado;
+
+        if (d->kind == WD_AL) {
+            cmd = EC_CMD_FPRD;
+            adp = wd_ctx->slavelist[d->slave_first].configadr;
+            ado = ECT_REG_ALSTAT;
+        } else {
+            uint32_t logadr = grp->logstartaddr + d->image_offset;
+            cmd = d->kind == WD_OUT ? EC_CMD_LWR : EC_CMD_LRD;
+            adp = (uint16)(logadr & 0xFFFF);
+            ado = (uint16)(logadr >> 16);
+        }
+        void *data = d->kind == WD_AL ? (void *)wd_al_data : (void *)(wd_image + d->image_offset);
+
+        if (!started[d->frame]) {
+            idx = ecx_getindex(port);
+            wd_frame_idx[d->frame] = idx;
+            started[d->frame] = true;
+            ecx_setupdatagram(port, &(port->txbuf[idx]), cmd, idx, adp, ado, d->length, data);
+            d->rx_offset = EC_HEADERSIZE;
+        } else {
+            idx = wd_frame_idx[d->frame];
+            bool more = i + 1 < wd_ndg && wd_dg[i + 1].frame == d->frame;
+            d->rx_offset = ecx_adddatagram(port, &(port->txbuf[idx]), cmd, idx, more,
+                                           adp, ado, d->length, data);
+        }
+    }
+
+    for (int f = 0; f < wd_nframes; f++) {
+        ecx_outframe_red(port, wd_frame_idx[f]);
+    }
+
+    bool frame_ok[WKC_DIAG_MAX_FRAMES];
+    for (int f = 0; f < wd_nframes; f++) {
+        frame_ok[f] = ecx_waitinframe(port, wd_frame_idx[f], timeout_us) > EC_NOFRAME;
+        if (!frame_ok[f]) {
+            lost = true;
+        }
+    }
+
+    memset(wd_reasons, 0, sizeof(wd_reasons));
+    memset(wd_al, 0, sizeof(wd_al));
+    for (int i = 0; i < wd_ndg && !lost; i++) {
+        wd_datagram_t *d = &wd_dg[i];
+        const uint8_t *rx = &(port->rxbuf[wd_frame_idx[d->frame]][d->rx_offset]);
+        int wkc = rx[d->length] | (rx[d->length + 1] << 8);
+        uint8_t reason = 0;
+
+        switch (d->kind) {
+            case WD_OUT:
+                wkc_out += wkc;
+                if (wkc < d->expect) reason = WKC_DIAG_NO_OUTPUTS;
+                break;
+            case WD_IN:
+                wkc_in += wkc;
+                memcpy(wd_image + d->image_offset, rx, d->length);
+                if (wkc < d->expect) reason = WKC_DIAG_NO_INPUTS;
+                break;
+            default: {
+                uint16_t al = (uint16_t)(rx[0] | (rx[1] << 8));
+                if (wkc != 1) {
+                    reason = WKC_DIAG_NO_RESPONSE;
+                } else {
+                    wd_al[d->slave_first] = al;
+                    if ((al & 0x0F) != EC_STATE_OPERATIONAL || (al & EC_STATE_ERROR)) {
+                        reason = WKC_DIAG_BAD_STATE;
+                    }
+                }
+                break;
+            }
+        }
+        if (reason && d->expect > 1) {
+            reason |= WKC_DIAG_SHARED;
+        }
+        for (int s = d->slave_first; reason && s <= d->slave_last; s++) {
+            wd_reasons[s] |= reason;
+        }
+    }
+
+    for (int f = 0; f < wd_nframes; f++) {
+        ecx_setbufstat(port, wd_frame_idx[f], EC_BUF_EMPTY);
+    }
+
+    if (lost) {
+        wd_lost_frames++;
+        return EC_NOFRAME;
+    }
+
+    /* Номер цикла этого обмена: wkc_diag_note() увеличит счетчик следом */
+    uint64_t cycle = wd_cycles + 1;
+    for (int s = 1; s < EC_MAXSLAVE; s++) {
+        if (!wd_reasons[s]) {
+            continue;
+        }
+        wkc_diag_slave_t *st = &wd_slaves[s];
+        if (st->fail_cycles == 0) {
+            st->first_fail_cycle = cycle;
+        }
+        st->fail_cycles++;
+        st->last_fail_cycle = cycle;
+        st->reasons |= wd_reasons[s];
+        st->al_status = wd_al[s];
+        wd_window_found = true;
+    }
+    wd_investigated++;
+
+    return wkc_out * 2 + wkc_in;
+}
+
+void wkc_diag_note(int wkc, int expected) {
+    if (!wd_get_armed()) {
+        return;
+    }
+
+    wd_cycles++;
+    if (wd_window_left > 0) {
+        wd_window_left--;
+        if (wd_window_left == 0 && !wd_window_found) {
+            wd_unattributed++;
+        }
+        return;
+    }
+
+    if (wkc < expected) {
+        wd_anomalies++;
+        if (wd_first_anomaly == 0) {
+            wd_first_anomaly = wd_cycles;
+        }
+        wd_last_anomaly = wd_cycles;
+        wd_last_wkc = wkc;
+        wd_last_expected = expected;
+        wd_window_left = wd_window;
+        wd_window_found = false;
+        wd_windows++;
+    }
+}
+
+static void wd_reason_str(uint8_t reasons, char *buf, size_t len) {
+    buf[0] = '\0';
+    if (reasons & WKC_DIAG_NO_RESPONSE) strncat(buf, "no-response ", len - strlen(buf) - 1);
+    if (reasons & WKC_DIAG_BAD_STATE)   strncat(buf, "state ", len - strlen(buf) - 1);
+    if (reasons & WKC_DIAG_NO_OUTPUTS)  strncat(buf, "outputs ", len - strlen(buf) - 1);
+    if (reasons & WKC_DIAG_NO_INPUTS)   strncat(buf, "inputs ", len - strlen(buf) - 1);
+    if (reasons & WKC_DIAG_SHARED)      strncat(buf, "(shared byte) ", len - strlen(buf) - 1);
+}
+
+void wkc_diag_print(void) {
+    printf("\n=== WKC Diagnostics ===\n");
+    bool armed = wd_get_armed();
+    printf("Mode:              %s", armed ? "armed" : "off");
+    if (armed) {
+        printf(" (%d datagrams in %d frame(s) per investigated cycle, window %d cycles)",
+               wd_ndg, wd_nframes, wd_window);
+    }
+    printf("\n");
+    if (!wd_ctx) {
+        printf("\n");
+        return;
+    }
+
+    printf("Cycles:            %llu\n", (unsigned long long)wd_cycles);
+    printf("WKC anomalies:     %llu", (unsigned long long)wd_anomalies);
+    if (wd_anomalies > 0) {
+        printf(" (first at cycle %llu, last at cycle %llu: WKC %d, expected %d)",
+               (unsigned long long)wd_first_anomaly, (unsigned long long)wd_last_anomaly,
+               wd_last_wkc, wd_last_expected);
+    }
+    printf("\n");
+    printf("Investigated:      %llu cycle(s) in %u window(s), %u window(s) without a culprit\n",
+           (unsigned long long)wd_investigated, wd_windows, wd_unattributed);
+    if (wd_lost_frames > 0) {
+        printf("Lost frames:       %llu (cycle not attributed)\n", (unsigned long long)wd_lost_frames);
+    }
+    if (wkc_diag_investigating()) {
+        printf("Investigating:     %d cycle(s) left\n", wd_window_left);
+    }
+    printf("\n");
+
+    int shown = 0;
+    for (int s = 1; s <= wd_ctx->slavecount && s < EC_MAXSLAVE; s++) {
+        const wkc_diag_slave_t *st = &wd_slaves[s];
+        char reasons[96];
+
+        if (st->fail_cycles == 0) {
+            continue;
+        }
+        if (shown++ == 0) {
+            printf("%-5s %-20s %-10s %-12s %-12s %-8s %s\n",
+                   "Slave", "Name", "Failures", "First cycle", "Last cycle", "AL", "Reason");
+            printf("--------------------------------------------------------------------------------\n");
+        }
+        wd_reason_str(st->reasons, reasons, sizeof(reasons));
+        printf("%-5d %-20.20s %-10u %-12llu %-12llu 0x%04X   %s\n",
+               s, wd_ctx->slavelist[s].name, st->fail_cycles,
+               (unsigned long long)st->first_fail_cycle, (unsigned long long)st->last_fail_cycle,
+               st->al_status, reasons);
+    }
+    if (shown == 0) {
+        printf("No slave attributed%s\n", wd_anomalies ? " (anomalies were transient)" : "");
+    }
+    printf("\n");
+}
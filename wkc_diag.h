@@ -0,0 +1,78 @@
+/*
+ * wkc_diag.h - Поиск slave, из-за которого не сходится WKC группы
+ *
+ * Пока режим взведен, каждый цикл только сравнивает WKC группы с ожидаемым.
+ * При недоборе следующие WKC_DIAG_DEFAULT_WINDOW циклов обмен выполняется
+ * раздельными датаграммами: для каждого slave LWR его выходов, LRD его
+ * входов и FPRD AL Status. WKC каждой датаграммы показывает, какой slave
+ * не участвует в обмене, AL Status - в каком он состоянии. Обмен при этом
+ * остается полноценным: выходы пишутся, входы копируются в IOmap.
+ *
+ * Slaves с битовыми данными делят байт с соседями: датаграмма такого
+ * байта ожидает WKC от всех slaves в нем, и недобор указывает на группу.
+ *
+ * Работает с образом в IOmap (не в режиме zero-copy). Функции обмена
+ * вызываются из циклического потока и не выделяют память и не печатают.
+ */
+
+#ifndef WKC_DIAG_H
+#define WKC_DIAG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "soem/soem.h"
+
+#define WKC_DIAG_DEFAULT_WINDOW  100     /* Циклов раздельного обмена после недобора */
+#define WKC_DIAG_MAX_FRAMES      (EC_MAXBUF / 2)
+
+/* Причины недобора у slave (битовая маска) */
+#define WKC_DIAG_NO_OUTPUTS  0x01        /* LWR выходов не засчитан */
+#define WKC_DIAG_NO_INPUTS   0x02        /* LRD входов не засчитан */
+#define WKC_DIAG_NO_RESPONSE 0x04        /* FPRD AL Status без ответа */
+#define WKC_DIAG_BAD_STATE   0x08        /* Не OP или флаг ошибки AL */
+#define WKC_DIAG_SHARED      0x10        /* Данные в общем байте с соседями */
+
+/* Итог по одному slave */
+typedef struct {
+    uint32_t fail_cycles;        /* Циклов расследования с недобором у этого slave */
+    uint64_t first_fail_cycle;   /* Номер цикла (от взведения) первого недобора */
+    uint64_t last_fail_cycle;
+    uint8_t reasons;             /* Объединение WKC_DIAG_* за все циклы */
+    uint16_t al_status;          /* AL Status в последнем цикле с недобором */
+} wkc_diag_slave_t;
+
+/**
+ * Взвести режим для группы: раскладка датаграмм по slaves строится здесь
+ *
+ * Раскладку читает wkc_diag_exchange(): если циклический поток запущен,
+ * вызывающий сначала снимает режим (wkc_diag_disarm) и ждет завершения
+ * цикла, и только затем взводит заново.
+ *
+ * @return false если раскладка не помещается в WKC_DIAG_MAX_FRAMES кадров
+ */
+bool wkc_diag_arm(ecx_contextt *ctx, uint8_t group, int window);
+
+void wkc_diag_disarm(void);
+bool wkc_diag_armed(void);
+
+/**
+ * true - текущий цикл нужно выполнить через wkc_diag_exchange()
+ */
+bool wkc_diag_investigating(void);
+
+/**
+ * Раздельный обмен с атрибуцией WKC по slaves
+ *
+ * @return эквивалент WKC группы (2 x выходы + входы) или EC_NOFRAME
+ */
+int wkc_diag_exchange(int timeout_us);
+
+/**
+ * Учет результата цикла: при недоборе запускает окно расследования
+ */
+void wkc_diag_note(int wkc, int expected);
+
+void wkc_diag_print(void);
+
+#endif /* WKC_DIAG_H */